@@ -50,6 +50,12 @@ inline void AtomicOr(volatile u32& target, u32 value)
 	__sync_or_and_fetch(&target, value);
 }
 
+// Stores desired if target still holds expected; returns whether it did.
+inline bool AtomicCompareExchange(volatile s32& target, s32 expected, s32 desired)
+{
+	return __sync_bool_compare_and_swap(&target, expected, desired);
+}
+
 // Support clang versions older than 3.4.
 #if __clang__ && !__has_feature(cxx_atomic)
 template <typename T>
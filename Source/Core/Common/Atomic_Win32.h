@@ -57,6 +57,12 @@ inline void AtomicOr(volatile u32& target, u32 value)
 	_InterlockedOr((volatile LONG*)&target, (LONG)value);
 }
 
+// Stores desired if target still holds expected; returns whether it did.
+inline bool AtomicCompareExchange(volatile s32& target, s32 expected, s32 desired)
+{
+	return _InterlockedCompareExchange((volatile LONG*)&target, (LONG)desired, (LONG)expected) == (LONG)expected;
+}
+
 template <typename T>
 inline T AtomicLoad(volatile T& src)
 {
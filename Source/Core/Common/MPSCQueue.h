@@ -0,0 +1,95 @@
+// Copyright 2015 Dolphin Emulator Project
+// Licensed under GPLv2
+// Refer to the license.txt file included.
+
+#pragma once
+
+// a lockless thread-safe,
+// multiple writer, single reader queue
+//
+// Push may be called from any number of threads at once. Pop and Clear must
+// only ever be called by one thread at a time.
+//
+// This is the intrusive queue by Dmitry Vyukov: writers swap themselves in as
+// the new head with a single atomic exchange, and link the previous head to
+// themselves afterwards. A writer that is between those two steps makes the
+// queue look empty past that point to the reader until it finishes, so Pop
+// may return false while another thread is still inside Push.
+
+#include <atomic>
+#include <utility>
+
+namespace Common
+{
+
+template <typename T>
+class MPSCQueue
+{
+public:
+	MPSCQueue()
+	{
+		m_head.store(&m_stub, std::memory_order_relaxed);
+		m_tail = &m_stub;
+	}
+
+	~MPSCQueue()
+	{
+		Clear();
+		if (m_tail != &m_stub)
+			delete m_tail;
+	}
+
+	MPSCQueue(const MPSCQueue&) = delete;
+	MPSCQueue& operator=(const MPSCQueue&) = delete;
+
+	bool Empty() const
+	{
+		return !m_tail->next.load(std::memory_order_acquire);
+	}
+
+	template <typename Arg>
+	void Push(Arg&& t)
+	{
+		Node* node = new Node(std::forward<Arg>(t));
+		Node* prev = m_head.exchange(node, std::memory_order_acq_rel);
+		prev->next.store(node, std::memory_order_release);
+	}
+
+	bool Pop(T& t)
+	{
+		Node* next = m_tail->next.load(std::memory_order_acquire);
+		if (!next)
+			return false;
+
+		// next becomes the new stub; its value is handed out and the old stub
+		// (which is either m_stub or a node that was popped before) is freed.
+		t = std::move(next->value);
+		if (m_tail != &m_stub)
+			delete m_tail;
+		m_tail = next;
+		return true;
+	}
+
+	void Clear()
+	{
+		T t;
+		while (Pop(t)) {}
+	}
+
+private:
+	struct Node
+	{
+		Node() : next(nullptr) {}
+		template <typename Arg>
+		explicit Node(Arg&& t) : next(nullptr), value(std::forward<Arg>(t)) {}
+
+		std::atomic<Node*> next;
+		T value;
+	};
+
+	std::atomic<Node*> m_head;
+	Node* m_tail;
+	Node m_stub;
+};
+
+}
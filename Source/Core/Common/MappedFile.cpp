@@ -0,0 +1,128 @@
+// Copyright 2015 Dolphin Emulator Project
+// Licensed under GPLv2
+// Refer to the license.txt file included.
+
+#include <string>
+#include <sys/stat.h>
+
+#include "Common/CommonTypes.h"
+#include "Common/MappedFile.h"
+#include "Common/StringUtil.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
+#ifdef BSD4_4
+#define stat64 stat
+#endif
+
+namespace File
+{
+
+static bool GetFileStamp(const std::string& filename, u64* size, s64* mtime, u64* inode)
+{
+	struct stat64 file_info;
+#ifdef _WIN32
+	if (_tstat64(UTF8ToTStr(filename).c_str(), &file_info) != 0)
+		return false;
+	// There are no inode numbers to tell a replaced file apart.
+	*inode = 0;
+#else
+	if (stat64(filename.c_str(), &file_info) != 0)
+		return false;
+	*inode = file_info.st_ino;
+#endif
+	*size = file_info.st_size;
+	*mtime = file_info.st_mtime;
+	return true;
+}
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+bool MappedFile::Open(const std::string& filename)
+{
+	Close();
+
+	u64 size;
+	if (!GetFileStamp(filename, &size, &m_mtime, &m_inode))
+		return false;
+
+	if (size != 0)
+	{
+#ifdef _WIN32
+		// Sharing everything lets the file be replaced while it's mapped.
+		HANDLE file = CreateFile(UTF8ToTStr(filename).c_str(), GENERIC_READ,
+		                         FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+		                         nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file == INVALID_HANDLE_VALUE)
+			return false;
+
+		HANDLE mapping = CreateFileMapping(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		CloseHandle(file);
+		if (!mapping)
+			return false;
+
+		void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		if (!data)
+		{
+			CloseHandle(mapping);
+			return false;
+		}
+		m_mapping = mapping;
+#else
+		int fd = open(filename.c_str(), O_RDONLY);
+		if (fd < 0)
+			return false;
+
+		// The mapping stays valid after the descriptor is closed.
+		void* data = mmap(nullptr, (size_t)size, PROT_READ, MAP_SHARED, fd, 0);
+		close(fd);
+		if (data == MAP_FAILED)
+			return false;
+#endif
+		m_data = (const u8*)data;
+	}
+
+	m_filename = filename;
+	m_size = size;
+	m_open = true;
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if (m_data)
+	{
+#ifdef _WIN32
+		UnmapViewOfFile(m_data);
+		CloseHandle(m_mapping);
+		m_mapping = nullptr;
+#else
+		munmap((void*)m_data, (size_t)m_size);
+#endif
+	}
+
+	m_data = nullptr;
+	m_size = 0;
+	m_open = false;
+}
+
+bool MappedFile::HasChanged() const
+{
+	u64 size, inode;
+	s64 mtime;
+	if (!GetFileStamp(m_filename, &size, &mtime, &inode))
+		return true;
+
+	return size != m_size || mtime != m_mtime || inode != m_inode;
+}
+
+}  // namespace
@@ -0,0 +1,53 @@
+// Copyright 2015 Dolphin Emulator Project
+// Licensed under GPLv2
+// Refer to the license.txt file included.
+
+#pragma once
+
+#include <string>
+
+#include "Common/Common.h"
+#include "Common/CommonTypes.h"
+
+namespace File
+{
+
+// A read-only view of a whole host file in memory.
+//
+// The file can still be changed by others while it's mapped. Writes show up in
+// the mapping, and replacing the file (writing a new one and renaming it over
+// the old one) leaves the old contents mapped. Truncating it is the dangerous
+// case: touching the pages past its new end crashes on POSIX systems, and on
+// Windows the truncation fails instead. Users have to check HasChanged() before
+// reading, and map the file again when it returns true.
+class MappedFile : public NonCopyable
+{
+public:
+	MappedFile() {}
+	~MappedFile();
+
+	bool Open(const std::string& filename);
+	void Close();
+
+	bool IsOpen() const { return m_open; }
+	// nullptr for empty files.
+	const u8* GetData() const { return m_data; }
+	u64 GetSize() const { return m_size; }
+
+	// Whether the file at the path that was opened has changed size, been
+	// modified or been replaced since. Costs a stat() call.
+	bool HasChanged() const;
+
+private:
+	std::string m_filename;
+	bool m_open = false;
+	const u8* m_data = nullptr;
+	u64 m_size = 0;
+	s64 m_mtime = 0;
+	u64 m_inode = 0;
+#ifdef _WIN32
+	void* m_mapping = nullptr;
+#endif
+};
+
+}  // namespace
@@ -0,0 +1,67 @@
+// Copyright 2015 Dolphin Emulator Project
+// Licensed under GPLv2
+// Refer to the license.txt file included.
+
+// Wakeup signal between one producer and one consumer thread that both poll
+// shared state (such as a ring buffer's read and write pointers) for work.
+//
+// * Set(): called by the producer after it has published new work.
+// * Wait(has_work, timeout): called by the consumer when it ran out of work.
+//   Spins for a short while, since new work usually shows up again quickly
+//   under load, and then parks the thread until Set() is called or the
+//   timeout expires. Returns early as soon as has_work() returns true.
+//
+// Set() is cheap while the consumer isn't parked: one atomic increment and
+// one load. The timeout only matters for work that is published without a
+// matching Set().
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+
+#include "Common/CommonTypes.h"
+#include "Common/Event.h"
+#include "Common/Thread.h"
+
+namespace Common {
+
+class SpinEvent final
+{
+public:
+	void Set()
+	{
+		// Pairs with the stores and loads in Wait(): either the consumer sees
+		// the new count before it parks, or we see that it is parked.
+		m_count.fetch_add(1, std::memory_order_seq_cst);
+		if (m_parked.load(std::memory_order_seq_cst))
+			m_event.Set();
+	}
+
+	template <typename Pred, class Rep, class Period>
+	void Wait(Pred has_work, const std::chrono::duration<Rep, Period>& timeout)
+	{
+		const u32 seen = m_count.load(std::memory_order_acquire);
+
+		for (int i = 0; i < SPIN_COUNT; i++)
+		{
+			if (has_work() || m_count.load(std::memory_order_acquire) != seen)
+				return;
+			Common::YieldCPU();
+		}
+
+		m_parked.store(true, std::memory_order_seq_cst);
+		if (!has_work() && m_count.load(std::memory_order_seq_cst) == seen)
+			m_event.WaitFor(timeout);
+		m_parked.store(false, std::memory_order_relaxed);
+	}
+
+private:
+	static const int SPIN_COUNT = 1000;
+
+	std::atomic<u32> m_count{0};
+	std::atomic<bool> m_parked{false};
+	Event m_event;
+};
+
+}  // namespace Common
@@ -0,0 +1,101 @@
+// Copyright 2015 Dolphin Emulator Project
+// Licensed under GPLv2
+// Refer to the license.txt file included.
+
+#include <algorithm>
+
+#include "Common/Thread.h"
+#include "Common/ThreadPool.h"
+
+namespace Common
+{
+
+unsigned int ThreadPool::GetDefaultThreadCount()
+{
+	return std::max(1u, std::thread::hardware_concurrency());
+}
+
+ThreadPool::ThreadPool(unsigned int num_threads)
+	: m_next(0)
+{
+	if (num_threads == 0)
+		num_threads = GetDefaultThreadCount();
+
+	for (unsigned int i = 1; i < num_threads; i++)
+		m_workers.emplace_back(&ThreadPool::WorkerThread, this);
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lk(m_lock);
+		m_quit = true;
+	}
+	m_work_cv.notify_all();
+
+	for (std::thread& worker : m_workers)
+		worker.join();
+}
+
+void ThreadPool::ParallelFor(size_t count, const std::function<void(size_t)>& func)
+{
+	if (count == 0)
+		return;
+
+	// Not worth waking anybody up for.
+	if (m_workers.empty() || count == 1)
+	{
+		for (size_t i = 0; i < count; i++)
+			func(i);
+		return;
+	}
+
+	std::lock_guard<std::mutex> batch_lk(m_batch_lock);
+
+	{
+		std::lock_guard<std::mutex> lk(m_lock);
+		m_func = &func;
+		m_count = count;
+		m_next.store(0);
+		m_active = m_workers.size();
+		m_generation++;
+	}
+	m_work_cv.notify_all();
+
+	RunJobs();
+
+	std::unique_lock<std::mutex> lk(m_lock);
+	m_done_cv.wait(lk, [this] { return m_active == 0; });
+	m_func = nullptr;
+}
+
+void ThreadPool::RunJobs()
+{
+	size_t i;
+	while ((i = m_next.fetch_add(1)) < m_count)
+		(*m_func)(i);
+}
+
+void ThreadPool::WorkerThread()
+{
+	Common::SetCurrentThreadName("Worker thread");
+
+	u64 seen_generation = 0;
+	std::unique_lock<std::mutex> lk(m_lock);
+	while (true)
+	{
+		m_work_cv.wait(lk, [&] { return m_quit || m_generation != seen_generation; });
+		if (m_quit)
+			return;
+		seen_generation = m_generation;
+
+		lk.unlock();
+		RunJobs();
+		lk.lock();
+
+		if (--m_active == 0)
+			m_done_cv.notify_one();
+	}
+}
+
+}  // namespace Common
@@ -0,0 +1,67 @@
+// Copyright 2015 Dolphin Emulator Project
+// Licensed under GPLv2
+// Refer to the license.txt file included.
+
+// A fixed set of worker threads for running batches of independent jobs.
+//
+// * ParallelFor(count, func): calls func(i) for every i in [0, count), spread
+//   across the workers and the calling thread, and returns once all of them
+//   have finished. The order in which jobs run is unspecified, so anything
+//   that needs a deterministic result must write to per-index storage and
+//   combine it on the calling thread afterwards.
+//
+// Only one batch runs at a time; concurrent ParallelFor calls are serialized.
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "Common/CommonTypes.h"
+
+namespace Common
+{
+
+class ThreadPool final
+{
+public:
+	// num_threads is the total amount of threads that work on a batch,
+	// including the calling thread. 0 picks one per host core.
+	explicit ThreadPool(unsigned int num_threads = 0);
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	unsigned int GetThreadCount() const { return (unsigned int)m_workers.size() + 1; }
+
+	void ParallelFor(size_t count, const std::function<void(size_t)>& func);
+
+	static unsigned int GetDefaultThreadCount();
+
+private:
+	void WorkerThread();
+	void RunJobs();
+
+	std::vector<std::thread> m_workers;
+
+	std::mutex m_batch_lock;
+
+	std::mutex m_lock;
+	std::condition_variable m_work_cv;
+	std::condition_variable m_done_cv;
+	u64 m_generation = 0;
+	size_t m_active = 0;
+	bool m_quit = false;
+
+	const std::function<void(size_t)>* m_func = nullptr;
+	size_t m_count = 0;
+	std::atomic<size_t> m_next;
+};
+
+}  // namespace Common
@@ -4,6 +4,7 @@
 
 #include <memory>
 #include <string>
+#include <vector>
 
 #include "Common/CommonPaths.h"
 #include "Common/FileUtil.h"
@@ -100,7 +101,8 @@ bool CBoot::Boot_WiiWAD(const std::string& _pFilename)
 	std::unique_ptr<CDolLoader> pDolLoader;
 	if (pContent->m_pData)
 	{
-		pDolLoader = std::make_unique<CDolLoader>(pContent->m_pData, pContent->m_Size);
+		std::vector<u8> data = pContent->m_pData->Get();
+		pDolLoader = std::make_unique<CDolLoader>(data.data(), (u32)data.size());
 	}
 	else
 	{
@@ -140,6 +140,7 @@ static const struct
 	{ "UndoSaveState",       351 /* WXK_F12 */,   4 /* wxMOD_SHIFT */ },
 	{ "SaveStateFile",       0,                   0 /* wxMOD_NONE */ },
 	{ "LoadStateFile",       0,                   0 /* wxMOD_NONE */ },
+	{ "Rewind",              0,                   0 /* wxMOD_NONE */ },
 };
 
 SConfig::SConfig()
@@ -299,6 +300,7 @@ void SConfig::SaveGameListSettings(IniFile& ini)
 	gamelist->Set("ListSortSecondary", m_ListSort2);
 
 	gamelist->Set("ColorCompressed", m_ColorCompressed);
+	gamelist->Set("DedupReport", m_DedupReport);
 
 	gamelist->Set("ColumnPlatform", m_showSystemColumn);
 	gamelist->Set("ColumnBanner", m_showBannerColumn);
@@ -316,6 +318,10 @@ void SConfig::SaveCoreSettings(IniFile& ini)
 	core->Set("HLE_BS2", m_LocalCoreStartupParameter.bHLE_BS2);
 	core->Set("CPUCore", m_LocalCoreStartupParameter.iCPUCore);
 	core->Set("Fastmem", m_LocalCoreStartupParameter.bFastmem);
+	core->Set("JITBlockProfile", m_LocalCoreStartupParameter.bJITBlockProfile);
+	core->Set("EnableRewind", m_LocalCoreStartupParameter.bRewind);
+	core->Set("RewindInterval", m_LocalCoreStartupParameter.iRewindInterval);
+	core->Set("RewindMemory", m_LocalCoreStartupParameter.iRewindMemory);
 	core->Set("CPUThread", m_LocalCoreStartupParameter.bCPUThread);
 	core->Set("DSPHLE", m_LocalCoreStartupParameter.bDSPHLE);
 	core->Set("SkipIdle", m_LocalCoreStartupParameter.bSkipIdle);
@@ -350,6 +356,7 @@ void SConfig::SaveCoreSettings(IniFile& ini)
 	core->Set("GPUDeterminismMode", m_LocalCoreStartupParameter.m_strGPUDeterminismMode);
 	core->Set("GameCubeAdapter", m_GameCubeAdapter);
 	core->Set("GameCubeAdapterThread", m_GameCubeAdapterThread);
+	core->Set("DumpDiscReads", m_DumpDiscReads);
 }
 
 void SConfig::SaveMovieSettings(IniFile& ini)
@@ -367,6 +374,7 @@ void SConfig::SaveDSPSettings(IniFile& ini)
 	IniFile::Section* dsp = ini.GetOrCreateSection("DSP");
 
 	dsp->Set("EnableJIT", m_DSPEnableJIT);
+	dsp->Set("ParallelAX", m_DSPParallelAX);
 	dsp->Set("DumpAudio", m_DumpAudio);
 	dsp->Set("Backend", sBackend);
 	dsp->Set("Volume", m_Volume);
@@ -521,6 +529,7 @@ void SConfig::LoadGameListSettings(IniFile& ini)
 
 	// Determines if compressed games display in blue
 	gamelist->Get("ColorCompressed", &m_ColorCompressed, true);
+	gamelist->Get("DedupReport", &m_DedupReport, false);
 
 	// Gamelist columns toggles
 	gamelist->Get("ColumnPlatform",   &m_showSystemColumn,  true);
@@ -545,6 +554,10 @@ void SConfig::LoadCoreSettings(IniFile& ini)
 	core->Get("CPUCore",      &m_LocalCoreStartupParameter.iCPUCore, SCoreStartupParameter::CORE_INTERPRETER);
 #endif
 	core->Get("Fastmem",           &m_LocalCoreStartupParameter.bFastmem,      true);
+	core->Get("JITBlockProfile",   &m_LocalCoreStartupParameter.bJITBlockProfile, false);
+	core->Get("EnableRewind",      &m_LocalCoreStartupParameter.bRewind,       false);
+	core->Get("RewindInterval",    &m_LocalCoreStartupParameter.iRewindInterval, 30);
+	core->Get("RewindMemory",      &m_LocalCoreStartupParameter.iRewindMemory, 512);
 	core->Get("DSPHLE",            &m_LocalCoreStartupParameter.bDSPHLE,       true);
 	core->Get("CPUThread",         &m_LocalCoreStartupParameter.bCPUThread,    true);
 	core->Get("SkipIdle",          &m_LocalCoreStartupParameter.bSkipIdle,     true);
@@ -587,6 +600,7 @@ void SConfig::LoadCoreSettings(IniFile& ini)
 	core->Get("GPUDeterminismMode",        &m_LocalCoreStartupParameter.m_strGPUDeterminismMode, "auto");
 	core->Get("GameCubeAdapter",           &m_GameCubeAdapter,                             true);
 	core->Get("GameCubeAdapterThread",     &m_GameCubeAdapterThread,                       true);
+	core->Get("DumpDiscReads",             &m_DumpDiscReads,                               false);
 }
 
 void SConfig::LoadMovieSettings(IniFile& ini)
@@ -604,6 +618,7 @@ void SConfig::LoadDSPSettings(IniFile& ini)
 	IniFile::Section* dsp = ini.GetOrCreateSection("DSP");
 
 	dsp->Get("EnableJIT", &m_DSPEnableJIT, true);
+	dsp->Get("ParallelAX", &m_DSPParallelAX, false);
 	dsp->Get("DumpAudio", &m_DumpAudio, false);
 #if defined __linux__ && HAVE_ALSA
 	dsp->Get("Backend", &sBackend, BACKEND_ALSA);
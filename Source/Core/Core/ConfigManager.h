@@ -90,6 +90,10 @@ struct SConfig : NonCopyable
 	// Toggles whether compressed titles show up in blue in the game list
 	bool m_ColorCompressed;
 
+	// Whether compressing several titles at once also reports how many blocks
+	// they have in common. Costs a SHA-1 of every block.
+	bool m_DedupReport;
+
 	std::string m_WirelessMac;
 	bool m_PauseMovie;
 	bool m_ShowLag;
@@ -101,6 +105,7 @@ struct SConfig : NonCopyable
 
 	// DSP settings
 	bool m_DSPEnableJIT;
+	bool m_DSPParallelAX;
 	bool m_DSPCaptureLog;
 	bool m_DumpAudio;
 	bool m_IsMuted;
@@ -112,6 +117,9 @@ struct SConfig : NonCopyable
 	bool m_GameCubeAdapter;
 	bool m_GameCubeAdapterThread;
 
+	// Record every disc read to Dump/DiscReads for replaying with discbench
+	bool m_DumpDiscReads;
+
 	SysConf* m_SYSCONF;
 
 	// Save settings
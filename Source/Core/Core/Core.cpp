@@ -575,6 +575,18 @@ void RequestRefreshInfo()
 	s_request_refresh_info = true;
 }
 
+static void PauseAndLockOthers(bool doLock, bool unpauseOnUnlock)
+{
+	ExpansionInterface::PauseAndLock(doLock, unpauseOnUnlock);
+
+	// audio has to come after CPU, because CPU thread can wait for audio thread (m_throttle).
+	AudioCommon::PauseAndLock(doLock, unpauseOnUnlock);
+	DSP::GetDSPEmulator()->PauseAndLock(doLock, unpauseOnUnlock);
+
+	// video has to come after CPU, because CPU thread can wait for video thread (s_efbAccessRequested).
+	g_video_backend->PauseAndLock(doLock, unpauseOnUnlock);
+}
+
 bool PauseAndLock(bool doLock, bool unpauseOnUnlock)
 {
 	if (!IsRunning())
@@ -587,15 +599,18 @@ bool PauseAndLock(bool doLock, bool unpauseOnUnlock)
 
 	// first pause or unpause the CPU
 	bool wasUnpaused = CCPU::PauseAndLock(doLock, unpauseOnUnlock);
-	ExpansionInterface::PauseAndLock(doLock, unpauseOnUnlock);
+	PauseAndLockOthers(doLock, unpauseOnUnlock);
+	return wasUnpaused;
+}
 
-	// audio has to come after CPU, because CPU thread can wait for audio thread (m_throttle).
-	AudioCommon::PauseAndLock(doLock, unpauseOnUnlock);
-	DSP::GetDSPEmulator()->PauseAndLock(doLock, unpauseOnUnlock);
+void PauseAndLockFromCPUThread(bool doLock)
+{
+	_assert_(IsCPUThread());
+	if (!IsRunning())
+		return;
 
-	// video has to come after CPU, because CPU thread can wait for video thread (s_efbAccessRequested).
-	g_video_backend->PauseAndLock(doLock, unpauseOnUnlock);
-	return wasUnpaused;
+	// the CPU thread only runs while the emulator does, so that's what to go back to
+	PauseAndLockOthers(doLock, true);
 }
 
 // Apply Frame Limit and Display FPS info
@@ -77,6 +77,11 @@ void UpdateTitle();
 // the return value of the first call should be passed in as the second argument of the second call.
 bool PauseAndLock(bool doLock, bool unpauseOnUnlock=true);
 
+// the same for code running on the CPU thread, where the CPU is already stopped:
+// only the other systems are paused and locked. unlike PauseAndLock, this doesn't
+// nest, so it's safe while another thread is in PauseAndLock waiting for the CPU.
+void PauseAndLockFromCPUThread(bool doLock);
+
 // for calling back into UI code without introducing a dependency on it in core
 typedef void(*StoppedCallbackFunc)(void);
 void SetOnStoppedCallback(StoppedCallbackFunc callback);
@@ -73,6 +73,10 @@ void SCoreStartupParameter::LoadDefaults()
 	bRunCompareServer = false;
 	bDSPHLE = true;
 	bFastmem = true;
+	bJITBlockProfile = false;
+	bRewind = false;
+	iRewindInterval = 30;
+	iRewindMemory = 512;
 	bFPRF = false;
 	bBAT = false;
 	bMMU = false;
@@ -113,6 +113,7 @@ enum Hotkey
 	HK_UNDO_SAVE_STATE,
 	HK_SAVE_STATE_FILE,
 	HK_LOAD_STATE_FILE,
+	HK_REWIND,
 
 	NUM_HOTKEYS,
 };
@@ -142,7 +143,8 @@ struct SCoreStartupParameter
 		CORE_JIT64,
 		CORE_JITIL64,
 		CORE_JITARM,
-		CORE_JITARM64
+		CORE_JITARM64,
+		CORE_CACHEDINTERPRETER
 	};
 	int iCPUCore;
 
@@ -160,6 +162,15 @@ struct SCoreStartupParameter
 	bool bJITILTimeProfiling;
 	bool bJITILOutputIR;
 
+	// Remember the blocks a game runs often and precompile them on the next boot.
+	bool bJITBlockProfile;
+
+	// In-memory rewind: capture every iRewindInterval frames, keep at most
+	// iRewindMemory MiB of history.
+	bool bRewind;
+	int iRewindInterval;
+	int iRewindMemory;
+
 	bool bFastmem;
 	bool bFPRF;
 
@@ -2,12 +2,15 @@
 // Licensed under GPLv2
 // Refer to the license.txt file included.
 
+#include <algorithm>
 #include <cinttypes>
+#include <climits>
 #include <string>
 #include <vector>
 
+#include "Common/Atomic.h"
 #include "Common/ChunkFile.h"
-#include "Common/FifoQueue.h"
+#include "Common/MPSCQueue.h"
 #include "Common/StringUtil.h"
 #include "Common/Thread.h"
 
@@ -27,26 +30,35 @@ struct EventType
 {
 	TimedCallback callback;
 	std::string name;
+	// How many events of this type are in event_queue, so that IsScheduled
+	// and RemoveEvent don't have to look when there are none.
+	u32 num_scheduled;
 };
 
 static std::vector<EventType> event_types;
 
-struct BaseEvent
+struct Event
 {
 	s64 time;
+	// Events that are due at the same time run in the order they were
+	// scheduled in.
+	u64 fifo_order;
 	u64 userdata;
 	int type;
 };
 
-typedef LinkedListItem<BaseEvent> Event;
+// Whether a should run after b.
+static bool EventIsLater(const Event& a, const Event& b)
+{
+	return a.time > b.time || (a.time == b.time && a.fifo_order > b.fifo_order);
+}
 
 // STATE_TO_SAVE
-static Event *first;
-static std::mutex tsWriteLock;
-static Common::FifoQueue<BaseEvent, false> tsQueue;
-
-// event pools
-static Event *eventPool = nullptr;
+// A binary min-heap on (time, fifo_order); event_queue.front() is the next
+// event to run.
+static std::vector<Event> event_queue;
+static u64 event_fifo_id;
+static Common::MPSCQueue<Event> tsQueue;
 
 float lastOCFactor;
 int slicelength;
@@ -65,22 +77,6 @@ static int ev_lost;
 
 static void (*advanceCallback)(int cyclesExecuted) = nullptr;
 
-static Event* GetNewEvent()
-{
-	if (!eventPool)
-		return new Event;
-
-	Event* ev = eventPool;
-	eventPool = ev->next;
-	return ev;
-}
-
-static void FreeEvent(Event* ev)
-{
-	ev->next = eventPool;
-	eventPool = ev;
-}
-
 static void EmptyTimedCallback(u64 userdata, int cyclesLate) {}
 
 static int DowncountToCycles(int downcount)
@@ -93,11 +89,27 @@ static int CyclesToDowncount(int cycles)
 	return (int)(cycles * lastOCFactor);
 }
 
+// ForceExceptionCheck_Threadsafe adds this to the downcount. That ends the slice
+// like any negative downcount does, but leaves the real downcount recoverable,
+// so the cycles cut off don't get counted as executed.
+static const int FORCED_DOWNCOUNT = INT_MIN / 2;
+
+// Reads the downcount once, so another thread forcing the slice to end can't
+// slip in between the check and the use.
+static int ReadDowncount()
+{
+	int downcount = PowerPC::ppcState.downcount;
+	if (downcount < FORCED_DOWNCOUNT / 2)
+		downcount -= FORCED_DOWNCOUNT;
+	return downcount;
+}
+
 int RegisterEvent(const std::string& name, TimedCallback callback)
 {
 	EventType type;
 	type.name = name;
 	type.callback = callback;
+	type.num_scheduled = 0;
 
 	// check for existing type with same name.
 	// we want event type names to remain unique so that we can use them for serialization.
@@ -119,7 +131,7 @@ int RegisterEvent(const std::string& name, TimedCallback callback)
 
 void UnregisterAllEvents()
 {
-	if (first)
+	if (!event_queue.empty())
 		PanicAlertT("Cannot unregister events with events pending");
 	event_types.clear();
 }
@@ -137,20 +149,36 @@ void Init()
 
 void Shutdown()
 {
-	std::lock_guard<std::mutex> lk(tsWriteLock);
 	MoveEvents();
 	ClearPendingEvents();
 	UnregisterAllEvents();
+}
 
-	while (eventPool)
-	{
-		Event *ev = eventPool;
-		eventPool = ev->next;
-		delete ev;
-	}
+static void PushEvent(const Event& ev)
+{
+	event_types[ev.type].num_scheduled++;
+	event_queue.push_back(ev);
+	std::push_heap(event_queue.begin(), event_queue.end(), EventIsLater);
+}
+
+static Event PopEvent()
+{
+	std::pop_heap(event_queue.begin(), event_queue.end(), EventIsLater);
+	Event ev = event_queue.back();
+	event_queue.pop_back();
+	event_types[ev.type].num_scheduled--;
+	return ev;
+}
+
+// The queue in the order the events will run in.
+static std::vector<Event> GetSortedEvents()
+{
+	std::vector<Event> events(event_queue);
+	std::sort(events.begin(), events.end(), [](const Event& a, const Event& b) { return EventIsLater(b, a); });
+	return events;
 }
 
-static void EventDoState(PointerWrap &p, BaseEvent* ev)
+static void EventDoState(PointerWrap &p, Event* ev)
 {
 	p.Do(ev->time);
 
@@ -186,7 +214,6 @@ static void EventDoState(PointerWrap &p, BaseEvent* ev)
 
 void DoState(PointerWrap &p)
 {
-	std::lock_guard<std::mutex> lk(tsWriteLock);
 	p.Do(slicelength);
 	p.Do(globalTimer);
 	p.Do(idledCycles);
@@ -199,7 +226,36 @@ void DoState(PointerWrap &p)
 
 	MoveEvents();
 
-	p.DoLinkedList<BaseEvent, GetNewEvent, FreeEvent, EventDoState>(first);
+	// The events are stored in the order they run in, each one preceded by a
+	// nonzero byte and the whole list followed by a zero byte. This is what
+	// the old linked list based queue wrote, so existing states still load.
+	if (p.GetMode() == PointerWrap::MODE_READ)
+	{
+		ClearPendingEvents();
+		while (true)
+		{
+			u8 more = 0;
+			p.Do(more);
+			if (!more || p.GetMode() != PointerWrap::MODE_READ)
+				break;
+
+			Event ev;
+			EventDoState(p, &ev);
+			ev.fifo_order = event_fifo_id++;
+			PushEvent(ev);
+		}
+	}
+	else
+	{
+		for (Event& ev : GetSortedEvents())
+		{
+			u8 more = 1;
+			p.Do(more);
+			EventDoState(p, &ev);
+		}
+		u8 more = 0;
+		p.Do(more);
+	}
 	p.DoMarker("CoreTimingEvents");
 }
 
@@ -217,9 +273,9 @@ u64 GetIdleTicks()
 // schedule things to be executed on the main thread.
 void ScheduleEvent_Threadsafe(int cyclesIntoFuture, int event_type, u64 userdata)
 {
-	std::lock_guard<std::mutex> lk(tsWriteLock);
 	Event ne;
 	ne.time = globalTimer + cyclesIntoFuture;
+	ne.fifo_order = 0;
 	ne.type = event_type;
 	ne.userdata = userdata;
 	tsQueue.Push(ne);
@@ -241,30 +297,9 @@ void ScheduleEvent_Threadsafe_Immediate(int event_type, u64 userdata)
 
 void ClearPendingEvents()
 {
-	while (first)
-	{
-		Event *e = first->next;
-		FreeEvent(first);
-		first = e;
-	}
-}
-
-static void AddEventToQueue(Event* ne)
-{
-	Event* prev = nullptr;
-	Event** pNext = &first;
-	for (;;)
-	{
-		Event*& next = *pNext;
-		if (!next || ne->time < next->time)
-		{
-			ne->next = next;
-			next = ne;
-			break;
-		}
-		prev = next;
-		pNext = &prev->next;
-	}
+	event_queue.clear();
+	for (EventType& type : event_types)
+		type.num_scheduled = 0;
 }
 
 // This must be run ONLY from within the CPU thread
@@ -272,11 +307,12 @@ static void AddEventToQueue(Event* ne)
 // than Advance
 void ScheduleEvent(int cyclesIntoFuture, int event_type, u64 userdata)
 {
-	Event *ne = GetNewEvent();
-	ne->userdata = userdata;
-	ne->type = event_type;
-	ne->time = globalTimer + cyclesIntoFuture;
-	AddEventToQueue(ne);
+	Event ne;
+	ne.time = globalTimer + cyclesIntoFuture;
+	ne.fifo_order = event_fifo_id++;
+	ne.userdata = userdata;
+	ne.type = event_type;
+	PushEvent(ne);
 }
 
 void RegisterAdvanceCallback(void (*callback)(int cyclesExecuted))
@@ -286,56 +322,18 @@ void RegisterAdvanceCallback(void (*callback)(int cyclesExecuted))
 
 bool IsScheduled(int event_type)
 {
-	if (!first)
-		return false;
-	Event *e = first;
-	while (e)
-	{
-		if (e->type == event_type)
-			return true;
-		e = e->next;
-	}
-	return false;
+	return event_types[event_type].num_scheduled != 0;
 }
 
 void RemoveEvent(int event_type)
 {
-	if (!first)
+	if (!event_types[event_type].num_scheduled)
 		return;
 
-	while (first)
-	{
-		if (first->type == event_type)
-		{
-			Event *next = first->next;
-			FreeEvent(first);
-			first = next;
-		}
-		else
-		{
-			break;
-		}
-	}
-
-	if (!first)
-		return;
-
-	Event *prev = first;
-	Event *ptr = prev->next;
-	while (ptr)
-	{
-		if (ptr->type == event_type)
-		{
-			prev->next = ptr->next;
-			FreeEvent(ptr);
-			ptr = prev->next;
-		}
-		else
-		{
-			prev = ptr;
-			ptr = ptr->next;
-		}
-	}
+	auto it = std::remove_if(event_queue.begin(), event_queue.end(), [&](const Event& e) { return e.type == event_type; });
+	event_queue.erase(it, event_queue.end());
+	std::make_heap(event_queue.begin(), event_queue.end(), EventIsLater);
+	event_types[event_type].num_scheduled = 0;
 }
 
 void RemoveAllEvents(int event_type)
@@ -351,13 +349,25 @@ void SetMaximumSlice(int maximumSliceLength)
 
 void ForceExceptionCheck(int cycles)
 {
-	if (DowncountToCycles(PowerPC::ppcState.downcount) > cycles)
+	int downcount = ReadDowncount();
+	if (DowncountToCycles(downcount) > cycles)
 	{
-		slicelength -= (DowncountToCycles(PowerPC::ppcState.downcount) - cycles); // Account for cycles already executed by adjusting the slicelength
+		slicelength -= (DowncountToCycles(downcount) - cycles); // Account for cycles already executed by adjusting the slicelength
 		PowerPC::ppcState.downcount = CyclesToDowncount(cycles);
 	}
 }
 
+void ForceExceptionCheck_Threadsafe()
+{
+	// The CPU thread changes the downcount without atomics. If it does so between
+	// the load and the exchange, the exchange fails; if it read the downcount
+	// before the exchange and writes it after, the exchange is overwritten. Either
+	// way the slice just runs to its normal end.
+	int downcount = Common::AtomicLoad(PowerPC::ppcState.downcount);
+	if (downcount > 0)
+		Common::AtomicCompareExchange(PowerPC::ppcState.downcount, downcount, downcount + FORCED_DOWNCOUNT);
+}
+
 void ResetSliceLength()
 {
 	maxSliceLength = MAX_SLICE_LENGTH;
@@ -369,35 +379,20 @@ void ProcessFifoWaitEvents()
 {
 	MoveEvents();
 
-	if (!first)
-		return;
-
-	while (first)
+	while (!event_queue.empty() && event_queue.front().time <= globalTimer)
 	{
-		if (first->time <= globalTimer)
-		{
-			Event* evt = first;
-			first = first->next;
-			event_types[evt->type].callback(evt->userdata, (int)(globalTimer - evt->time));
-			FreeEvent(evt);
-		}
-		else
-		{
-			break;
-		}
+		Event evt = PopEvent();
+		event_types[evt.type].callback(evt.userdata, (int)(globalTimer - evt.time));
 	}
 }
 
 void MoveEvents()
 {
-	BaseEvent sevt;
-	while (tsQueue.Pop(sevt))
+	Event evt;
+	while (tsQueue.Pop(evt))
 	{
-		Event *evt = GetNewEvent();
-		evt->time = sevt.time;
-		evt->userdata = sevt.userdata;
-		evt->type = sevt.type;
-		AddEventToQueue(evt);
+		evt.fifo_order = event_fifo_id++;
+		PushEvent(evt);
 	}
 }
 
@@ -405,36 +400,27 @@ void Advance()
 {
 	MoveEvents();
 
-	int cyclesExecuted = slicelength - DowncountToCycles(PowerPC::ppcState.downcount);
+	int cyclesExecuted = slicelength - DowncountToCycles(ReadDowncount());
 	globalTimer += cyclesExecuted;
 	lastOCFactor = SConfig::GetInstance().m_OCFactor;
 	PowerPC::ppcState.downcount = CyclesToDowncount(slicelength);
 
-	while (first)
+	while (!event_queue.empty() && event_queue.front().time <= globalTimer)
 	{
-		if (first->time <= globalTimer)
-		{
-			//LOG(POWERPC, "[Scheduler] %s     (%lld, %lld) ",
-			//             event_types[first->type].name ? event_types[first->type].name : "?", (u64)globalTimer, (u64)first->time);
-			Event* evt = first;
-			first = first->next;
-			event_types[evt->type].callback(evt->userdata, (int)(globalTimer - evt->time));
-			FreeEvent(evt);
-		}
-		else
-		{
-			break;
-		}
+		Event evt = PopEvent();
+		//LOG(POWERPC, "[Scheduler] %s     (%lld, %lld) ",
+		//             event_types[evt.type].name.c_str(), (u64)globalTimer, (u64)evt.time);
+		event_types[evt.type].callback(evt.userdata, (int)(globalTimer - evt.time));
 	}
 
-	if (!first)
+	if (event_queue.empty())
 	{
 		WARN_LOG(POWERPC, "WARNING - no events in queue. Setting downcount to 10000");
 		PowerPC::ppcState.downcount += CyclesToDowncount(10000);
 	}
 	else
 	{
-		slicelength = (int)(first->time - globalTimer);
+		slicelength = (int)(event_queue.front().time - globalTimer);
 		if (slicelength > maxSliceLength)
 			slicelength = maxSliceLength;
 		PowerPC::ppcState.downcount = CyclesToDowncount(slicelength);
@@ -446,12 +432,8 @@ void Advance()
 
 void LogPendingEvents()
 {
-	Event *ptr = first;
-	while (ptr)
-	{
-		INFO_LOG(POWERPC, "PENDING: Now: %" PRId64 " Pending: %" PRId64 " Type: %d", globalTimer, ptr->time, ptr->type);
-		ptr = ptr->next;
-	}
+	for (const Event& ev : GetSortedEvents())
+		INFO_LOG(POWERPC, "PENDING: Now: %" PRId64 " Pending: %" PRId64 " Type: %d", globalTimer, ev.time, ev.type);
 }
 
 void Idle()
@@ -470,7 +452,7 @@ void Idle()
 		}
 	}
 
-	idledCycles += PowerPC::ppcState.downcount;
+	idledCycles += ReadDowncount();
 	PowerPC::ppcState.downcount = 0;
 
 	Advance();
@@ -478,19 +460,17 @@ void Idle()
 
 std::string GetScheduledEventsSummary()
 {
-	Event *ptr = first;
 	std::string text = "Scheduled events\n";
 	text.reserve(1000);
-	while (ptr)
+	for (const Event& ev : GetSortedEvents())
 	{
-		unsigned int t = ptr->type;
+		unsigned int t = ev.type;
 		if (t >= event_types.size())
 			PanicAlertT("Invalid event type %i", t);
 
-		const std::string& name = event_types[ptr->type].name;
+		const std::string& name = event_types[ev.type].name;
 
-		text += StringFromFormat("%s : %" PRIi64 " %016" PRIx64 "\n", name.c_str(), ptr->time, ptr->userdata);
-		ptr = ptr->next;
+		text += StringFromFormat("%s : %" PRIi64 " %016" PRIx64 "\n", name.c_str(), ev.time, ev.userdata);
 	}
 	return text;
 }
@@ -81,6 +81,9 @@ u64 GetFakeTBStartTicks();
 void SetFakeTBStartTicks(u64 val);
 
 void ForceExceptionCheck(int cycles);
+// Makes the CPU thread end its slice after the block it's in, so that events
+// scheduled from other threads run promptly. Guest timing isn't affected.
+void ForceExceptionCheck_Threadsafe();
 
 extern int slicelength;
 
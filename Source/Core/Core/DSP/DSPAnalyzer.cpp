@@ -62,6 +62,63 @@ const u16 idle_skip_sigs[NUM_IDLE_SIGS][MAX_IDLE_SIG_SIZE + 1] =
 	  0, 0 }
 };
 
+// Besides the signatures above, any short loop that just polls a mailbox
+// register until it changes is idle: a conditional jump back to at most this
+// many words before it, over nothing but mailbox loads and flag tests.
+#define MAX_POLL_LOOP_SIZE 6
+
+static bool IsMailboxAddress(u16 addr)
+{
+	// DMBH, DMBL, CMBH, CMBL
+	return addr >= 0xfffc;
+}
+
+// Returns the size of inst if it is part of a mailbox polling loop, and sets
+// reads_mailbox if it loads one of the mailbox registers. Returns 0 if inst
+// can't be part of one.
+static int GetPollLoopInstSize(int addr, bool* reads_mailbox)
+{
+	UDSPInstruction inst = dsp_imem_read(addr);
+
+	// LRS $(0x18+D), @M. Like the signatures, this assumes that $cr is 0xff.
+	if ((inst & 0xf800) == 0x2000)
+	{
+		*reads_mailbox |= IsMailboxAddress(0xff00 | (inst & 0xff));
+		return 1;
+	}
+	// LR $D, @M
+	if ((inst & 0xffe0) == 0x00c0)
+	{
+		*reads_mailbox |= IsMailboxAddress(dsp_imem_read(addr + 1));
+		return 2;
+	}
+	// CMPI, ANDF, ANDCF
+	if ((inst & 0xfeff) == 0x0280 || (inst & 0xfeff) == 0x02a0 || (inst & 0xfeff) == 0x02c0)
+		return 2;
+	// TSTAXH, TST, without an extended opcode
+	if ((inst & 0xfeff) == 0x8600 || (inst & 0xf7ff) == 0xb100)
+		return 1;
+
+	return 0;
+}
+
+static bool IsPollLoop(int loop_start, int jump_addr)
+{
+	if (loop_start >= jump_addr || jump_addr - loop_start > MAX_POLL_LOOP_SIZE)
+		return false;
+
+	bool reads_mailbox = false;
+	int addr = loop_start;
+	while (addr < jump_addr)
+	{
+		int size = GetPollLoopInstSize(addr, &reads_mailbox);
+		if (!size)
+			return false;
+		addr += size;
+	}
+	return addr == jump_addr && reads_mailbox;
+}
+
 static void Reset()
 {
 	code_flags.fill(0);
@@ -112,6 +169,17 @@ static void AnalyzeRange(int start_addr, int end_addr)
 			code_flags[last_arithmetic] |= CODE_UPDATE_SR;
 		}
 
+		// Jcc
+		if ((inst & 0xfff0) == 0x0290 && inst != 0x029f)
+		{
+			u16 dest = dsp_imem_read(addr + 1);
+			if (IsPollLoop(dest, addr))
+			{
+				INFO_LOG(DSPLLE, "Polling loop found at %04x", dest);
+				code_flags[dest] |= CODE_IDLE_SKIP;
+			}
+		}
+
 		// If an instruction potentially raises exceptions, mark the following
 		// instruction as needing to check for exceptions
 		if (opcode->opcode == 0x00c0 ||
@@ -23,6 +23,9 @@
 
    ====================================================================*/
 
+#include <string>
+#include <vector>
+
 #include "Common/CommonTypes.h"
 #include "Common/Event.h"
 #include "Common/FileUtil.h"
@@ -345,24 +348,28 @@ void CompileCurrent()
 {
 	dspjit->Compile(g_dsp.pc);
 
-	bool retry = true;
-
-	while (retry)
+	// Compile whatever the new block jumps to right away, so that it can be
+	// linked to it the next time it is compiled.
+	std::vector<u16> pending(dspjit->unresolvedJumps[g_dsp.pc]);
+	while (!pending.empty())
 	{
-		retry = false;
-		for (u16 i = 0x0000; i < 0xffff; ++i)
-		{
-			if (!dspjit->unresolvedJumps[i].empty())
-			{
-				u16 addrToCompile = dspjit->unresolvedJumps[i].front();
-				dspjit->Compile(addrToCompile);
-				if (!dspjit->unresolvedJumps[i].empty())
-					retry = true;
-			}
-		}
+		u16 addr = pending.back();
+		pending.pop_back();
+		if (dspjit->IsCompiled(addr))
+			continue;
+
+		dspjit->Compile(addr);
+		const std::vector<u16>& jumps = dspjit->unresolvedJumps[addr];
+		pending.insert(pending.end(), jumps.begin(), jumps.end());
 	}
 }
 
+void DSPCore_WriteProfileResults(const std::string& filename)
+{
+	if (dspjit)
+		dspjit->WriteProfileResults(filename);
+}
+
 u16 DSPCore_ReadRegister(int reg)
 {
 	switch (reg)
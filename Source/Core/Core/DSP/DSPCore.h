@@ -327,6 +327,9 @@ void DSPCore_SetException(u8 level);
 
 void CompileCurrent();
 
+// Dumps the DSP JIT's block profile, if the JIT is in use.
+void DSPCore_WriteProfileResults(const std::string& filename);
+
 enum DSPCoreState
 {
 	DSPCORE_STOP = 0,
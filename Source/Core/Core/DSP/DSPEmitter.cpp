@@ -2,7 +2,12 @@
 // Licensed under GPLv2
 // Refer to the license.txt file included.
 
+#include <algorithm>
+#include <cinttypes>
 #include <cstring>
+#include <vector>
+
+#include "Common/FileUtil.h"
 
 #include "Core/DSP/DSPAnalyzer.h"
 #include "Core/DSP/DSPCore.h"
@@ -10,12 +15,15 @@
 #include "Core/DSP/DSPHost.h"
 #include "Core/DSP/DSPInterpreter.h"
 #include "Core/DSP/DSPMemoryMap.h"
-
-#define MAX_BLOCK_SIZE 250
-#define DSP_IDLE_SKIP_CYCLES 0x1000
+#include "Core/PowerPC/Profiler.h"
 
 using namespace Gen;
 
+// How often each block ran. Only counted for blocks compiled while
+// Profiler::g_ProfileBlocks is set. Static so that the compiled code can
+// address it directly.
+static u64 block_exec_count[MAX_BLOCKS];
+
 DSPEmitter::DSPEmitter() : gpr(*this), storeIndex(-1), storeIndex2(-1)
 {
 	m_compiledCode = nullptr;
@@ -35,11 +43,7 @@ DSPEmitter::DSPEmitter() : gpr(*this), storeIndex(-1), storeIndex2(-1)
 
 	//clear all of the block references
 	for (int i = 0x0000; i < MAX_BLOCKS; i++)
-	{
-		blocks[i] = (DSPCompiledCode)stubEntryPoint;
-		blockLinks[i] = nullptr;
-		blockSize[i] = 0;
-	}
+		ResetBlock(i);
 }
 
 DSPEmitter::~DSPEmitter()
@@ -50,14 +54,29 @@ DSPEmitter::~DSPEmitter()
 	FreeCodeSpace();
 }
 
+void DSPEmitter::ResetBlock(u16 addr)
+{
+	blocks[addr] = (DSPCompiledCode)stubEntryPoint;
+	blockLinks[addr] = nullptr;
+	blockSize[addr] = 0;
+	unresolvedJumps[addr].clear();
+	block_exec_count[addr] = 0;
+}
+
 void DSPEmitter::ClearIRAM()
 {
 	for (int i = 0x0000; i < 0x1000; i++)
+		ResetBlock(i);
+
+	// Blocks outside IRAM that are waiting on an IRAM block keep waiting for
+	// it to be compiled again. The IRAM waiters are gone and will register
+	// themselves again when they get recompiled.
+	for (int i = 0x0000; i < MAX_BLOCKS; i++)
 	{
-		blocks[i] = (DSPCompiledCode)stubEntryPoint;
-		blockLinks[i] = nullptr;
-		blockSize[i] = 0;
-		unresolvedJumps[i].clear();
+		std::vector<u16>& waiting = waitingBlocks[i];
+		waiting.erase(std::remove_if(waiting.begin(), waiting.end(),
+		                             [](u16 addr) { return addr < 0x1000; }),
+		              waiting.end());
 	}
 	g_dsp.reset_dspjit_codespace = true;
 }
@@ -70,10 +89,8 @@ void DSPEmitter::ClearIRAMandDSPJITCodespaceReset()
 
 	for (int i = 0x0000; i < 0x10000; i++)
 	{
-		blocks[i] = (DSPCompiledCode)stubEntryPoint;
-		blockLinks[i] = nullptr;
-		blockSize[i] = 0;
-		unresolvedJumps[i].clear();
+		ResetBlock(i);
+		waitingBlocks[i].clear();
 	}
 	g_dsp.reset_dspjit_codespace = false;
 }
@@ -219,6 +236,9 @@ void DSPEmitter::Compile(u16 start_addr)
 
 	blockLinkEntry = GetCodePtr();
 
+	if (Profiler::g_ProfileBlocks)
+		ADD(64, M(&block_exec_count[start_addr]), Imm8(1));
+
 	compilePC = start_addr;
 	bool fixup_pc = false;
 	blockSize[start_addr] = 0;
@@ -237,7 +257,8 @@ void DSPEmitter::Compile(u16 start_addr)
 		compilePC += opcode->size;
 
 		// If the block was trying to link into itself, remove the link
-		unresolvedJumps[start_addr].remove(compilePC);
+		std::vector<u16>& jumps = unresolvedJumps[start_addr];
+		jumps.erase(std::remove(jumps.begin(), jumps.end(), compilePC), jumps.end());
 
 		fixup_pc = true;
 
@@ -263,17 +284,16 @@ void DSPEmitter::Compile(u16 start_addr)
 			// end of each block and in this order
 			DSPJitRegCache c(gpr);
 			HandleLoop();
-			gpr.saveRegs();
-			if (!DSPHost::OnThread() && DSPAnalyzer::code_flags[start_addr] & DSPAnalyzer::CODE_IDLE_SKIP)
-			{
-				MOV(16, R(EAX), Imm16(DSP_IDLE_SKIP_CYCLES));
-			}
-			else
-			{
-				MOV(16, R(EAX), Imm16(blockSize[start_addr]));
-			}
-			JMP(returnDispatcher, true);
-			gpr.loadRegs(false);
+
+			// The body of a BLOOP usually gets a block of its own. Keep going
+			// around without a trip through the dispatcher.
+			gpr.flushRegs();
+			CMP(16, M(&g_dsp.pc), Imm16(start_addr));
+			FixupBranch notLoopStart = J_CC(CC_NE, true);
+			WriteBlockLink(start_addr);
+			SetJumpTarget(notLoopStart);
+
+			WriteBranchExit();
 			gpr.flushRegs(c,false);
 
 			SetJumpTarget(rLoopAddressExit);
@@ -295,20 +315,8 @@ void DSPEmitter::Compile(u16 start_addr)
 				CMP(16, R(AX), Imm16(compilePC));
 				FixupBranch rNoBranch = J_CC(CC_Z, true);
 
-				DSPJitRegCache c(gpr);
 				//don't update g_dsp.pc -- the branch insn already did
-				gpr.saveRegs();
-				if (!DSPHost::OnThread() && DSPAnalyzer::code_flags[start_addr] & DSPAnalyzer::CODE_IDLE_SKIP)
-				{
-					MOV(16, R(EAX), Imm16(DSP_IDLE_SKIP_CYCLES));
-				}
-				else
-				{
-					MOV(16, R(EAX), Imm16(blockSize[start_addr]));
-				}
-				JMP(returnDispatcher, true);
-				gpr.loadRegs(false);
-				gpr.flushRegs(c,false);
+				WriteBranchExit();
 
 				SetJumpTarget(rNoBranch);
 			}
@@ -321,10 +329,33 @@ void DSPEmitter::Compile(u16 start_addr)
 		}
 	}
 
+	if (blockSize[start_addr] == 0)
+	{
+		// just a safeguard, should never happen anymore.
+		// if it does we might get stuck over in RunForCycles.
+		ERROR_LOG(DSPLLE, "Block at 0x%04x has zero size", start_addr);
+		blockSize[start_addr] = 1;
+	}
+
 	if (fixup_pc)
 	{
 		MOV(16, M(&(g_dsp.pc)), Imm16(compilePC));
+
+		// The block got cut off for its size or in front of an idle skip.
+		// Carry on with the next one.
+		WriteLinkToBlock(compilePC);
+	}
+
+	gpr.saveRegs();
+	if (!DSPHost::OnThread() && DSPAnalyzer::code_flags[start_addr] & DSPAnalyzer::CODE_IDLE_SKIP)
+	{
+		MOV(16, R(EAX), Imm16(DSP_IDLE_SKIP_CYCLES));
+	}
+	else
+	{
+		MOV(16, R(EAX), Imm16(blockSize[start_addr]));
 	}
+	JMP(returnDispatcher, true);
 
 	blocks[start_addr] = (DSPCompiledCode)entryPoint;
 
@@ -334,42 +365,62 @@ void DSPEmitter::Compile(u16 start_addr)
 	{
 		blockLinks[start_addr] = blockLinkEntry;
 
-		for (u16 i = 0x0000; i < 0xffff; ++i)
+		// Blocks that were waiting for this one to be linkable get
+		// recompiled the next time they run.
+		for (u16 waiting : waitingBlocks[start_addr])
 		{
-			if (!unresolvedJumps[i].empty())
-			{
-				// Check if there were any blocks waiting for this block to be linkable
-				size_t size = unresolvedJumps[i].size();
-				unresolvedJumps[i].remove(start_addr);
-				if (unresolvedJumps[i].size() < size)
-				{
-					// Mark the block to be recompiled again
-					blocks[i] = (DSPCompiledCode)stubEntryPoint;
-					blockLinks[i] = nullptr;
-					blockSize[i] = 0;
-				}
-			}
+			std::vector<u16>& jumps = unresolvedJumps[waiting];
+			auto it = std::remove(jumps.begin(), jumps.end(), start_addr);
+			if (it == jumps.end())
+				continue;
+
+			jumps.erase(it, jumps.end());
+			blocks[waiting] = (DSPCompiledCode)stubEntryPoint;
+			blockLinks[waiting] = nullptr;
+			blockSize[waiting] = 0;
+		}
+		waitingBlocks[start_addr].clear();
+	}
+	else
+	{
+		for (u16 dest : unresolvedJumps[start_addr])
+		{
+			std::vector<u16>& waiting = waitingBlocks[dest];
+			if (std::find(waiting.begin(), waiting.end(), start_addr) == waiting.end())
+				waiting.push_back(start_addr);
 		}
 	}
+}
 
-	if (blockSize[start_addr] == 0)
+void DSPEmitter::WriteProfileResults(const std::string& filename)
+{
+	std::vector<BlockStat> stats;
+	u64 cost_sum = 0;
+	for (int i = 0; i < MAX_BLOCKS; i++)
 	{
-		// just a safeguard, should never happen anymore.
-		// if it does we might get stuck over in RunForCycles.
-		ERROR_LOG(DSPLLE, "Block at 0x%04x has zero size", start_addr);
-		blockSize[start_addr] = 1;
+		if (!block_exec_count[i])
+			continue;
+
+		// Every instruction is counted as one cycle, like the dispatcher does.
+		u64 cost = block_exec_count[i] * blockSize[i];
+		stats.push_back(BlockStat(i, cost));
+		cost_sum += cost;
 	}
 
-	gpr.saveRegs();
-	if (!DSPHost::OnThread() && DSPAnalyzer::code_flags[start_addr] & DSPAnalyzer::CODE_IDLE_SKIP)
+	std::sort(stats.begin(), stats.end());
+	File::IOFile f(filename, "w");
+	if (!f)
 	{
-		MOV(16, R(EAX), Imm16(DSP_IDLE_SKIP_CYCLES));
+		PanicAlert("Failed to open %s", filename.c_str());
+		return;
 	}
-	else
+	fprintf(f.GetHandle(), "addr\truns\tsize\tcycles\tpercent\n");
+	for (const BlockStat& stat : stats)
 	{
-		MOV(16, R(EAX), Imm16(blockSize[start_addr]));
+		fprintf(f.GetHandle(), "%04x\t%" PRIu64 "\t%u\t%" PRIu64 "\t%.2f\n",
+		        stat.blockNum, block_exec_count[stat.blockNum], blockSize[stat.blockNum],
+		        stat.cost, 100.0 * (double)stat.cost / (double)cost_sum);
 	}
-	JMP(returnDispatcher, true);
 }
 
 const u8 *DSPEmitter::CompileStub()
@@ -4,7 +4,8 @@
 
 #pragma once
 
-#include <list>
+#include <string>
+#include <vector>
 
 #include "Common/x64ABI.h"
 #include "Common/x64Emitter.h"
@@ -14,6 +15,8 @@
 
 #define COMPILED_CODE_SIZE 2097152
 #define MAX_BLOCKS         0x10000
+#define MAX_BLOCK_SIZE     250
+#define DSP_IDLE_SKIP_CYCLES 0x1000
 
 typedef u32 (*DSPCompiledCode)();
 typedef const u8 *Block;
@@ -35,6 +38,12 @@ public:
 	void Compile(u16 start_addr);
 	void ClearCallFlag();
 
+	bool IsCompiled(u16 addr) const { return blocks[addr] != (DSPCompiledCode)stubEntryPoint; }
+
+	// Writes how often each block ran while Profiler::g_ProfileBlocks was set
+	// when it got compiled, most expensive first.
+	void WriteProfileResults(const std::string& filename);
+
 	bool FlagsNeeded();
 
 	void Default(UDSPInstruction inst);
@@ -123,6 +132,8 @@ public:
 
 	// Branch
 	void HandleLoop();
+	void WriteBranchExit();
+	void WriteBlockLink(u16 dest);
 	void jcc(const UDSPInstruction opc);
 	void jmprcc(const UDSPInstruction opc);
 	void call(const UDSPInstruction opc);
@@ -250,12 +261,15 @@ public:
 	u16 startAddr;
 	Block *blockLinks;
 	u16 *blockSize;
-	std::list<u16> unresolvedJumps[MAX_BLOCKS];
+	// The blocks each block would link to if they were linkable.
+	std::vector<u16> unresolvedJumps[MAX_BLOCKS];
 
 	DSPJitRegCache gpr;
 private:
 	DSPCompiledCode *blocks;
 	Block blockLinkEntry;
+	// The reverse of unresolvedJumps: the blocks waiting for each block.
+	std::vector<u16> waitingBlocks[MAX_BLOCKS];
 	u16 compileSR;
 
 	// The index of the last stored ext value (compile time).
@@ -267,6 +281,10 @@ private:
 
 	void Update_SR_Register(Gen::X64Reg val = Gen::EAX);
 
+	void WriteLinkJump(Block target, u16 target_size);
+	void WriteLinkToBlock(u16 dest);
+	void ResetBlock(u16 addr);
+
 	void get_long_prod(Gen::X64Reg long_prod = Gen::RAX);
 	void get_long_prod_round_prodl(Gen::X64Reg long_prod = Gen::RAX);
 	void set_long_prod();
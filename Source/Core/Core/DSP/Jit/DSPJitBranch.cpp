@@ -4,6 +4,7 @@
 
 #include "Core/DSP/DSPAnalyzer.h"
 #include "Core/DSP/DSPEmitter.h"
+#include "Core/DSP/DSPHost.h"
 #include "Core/DSP/DSPMemoryMap.h"
 #include "Core/DSP/DSPStacks.h"
 
@@ -73,60 +74,104 @@ static void ReJitConditional(const UDSPInstruction opc, DSPEmitter& emitter)
 	emitter.SetJumpTarget(skipCode);
 }
 
-static void WriteBranchExit(DSPEmitter& emitter)
+static bool IsIdleSkipBlock(u16 start_addr)
 {
-	DSPJitRegCache c(emitter.gpr);
-	emitter.gpr.saveRegs();
-	if (DSPAnalyzer::code_flags[emitter.startAddr] & DSPAnalyzer::CODE_IDLE_SKIP)
+	// These have to go back to the dispatcher to give up the time slice.
+	return !DSPHost::OnThread() && DSPAnalyzer::code_flags[start_addr] & DSPAnalyzer::CODE_IDLE_SKIP;
+}
+
+void DSPEmitter::WriteBranchExit()
+{
+	DSPJitRegCache c(gpr);
+	gpr.saveRegs();
+	if (IsIdleSkipBlock(startAddr))
 	{
-		emitter.MOV(16, R(EAX), Imm16(0x1000));
+		MOV(16, R(EAX), Imm16(DSP_IDLE_SKIP_CYCLES));
 	}
 	else
 	{
-		emitter.MOV(16, R(EAX), Imm16(emitter.blockSize[emitter.startAddr]));
+		MOV(16, R(EAX), Imm16(blockSize[startAddr]));
+	}
+	JMP(returnDispatcher, true);
+	gpr.loadRegs(false);
+	gpr.flushRegs(c,false);
+}
+
+// Jumps straight to the code at target if the DSP is still running and has
+// enough cycles left for the rest of this block and target_size more.
+// Otherwise falls through, with the registers flushed.
+void DSPEmitter::WriteLinkJump(Block target, u16 target_size)
+{
+	gpr.flushRegs();
+
+	TEST(8, M(&g_dsp.cr), Imm8(CR_HALT));
+	FixupBranch halted = J_CC(CC_NZ);
+	FixupBranch interrupted;
+	if (DSPHost::OnThread())
+	{
+		CMP(8, M(const_cast<bool*>(&g_dsp.external_interrupt_waiting)), Imm8(0));
+		interrupted = J_CC(CC_NE);
+	}
+
+	// Check if we have enough cycles to execute the next block
+	MOV(16, R(ECX), M(&cyclesLeft));
+	CMP(16, R(ECX), Imm16(blockSize[startAddr] + target_size));
+	FixupBranch notEnoughCycles = J_CC(CC_BE);
+
+	SUB(16, R(ECX), Imm16(blockSize[startAddr]));
+	MOV(16, M(&cyclesLeft), R(ECX));
+	JMP(target, true);
+
+	SetJumpTarget(notEnoughCycles);
+	SetJumpTarget(halted);
+	if (DSPHost::OnThread())
+		SetJumpTarget(interrupted);
+}
+
+void DSPEmitter::WriteBlockLink(u16 dest)
+{
+	if (IsIdleSkipBlock(startAddr))
+		return;
+
+	// A jump back to the start of the block being compiled can go straight to
+	// its entry. Its final size isn't known yet, so assume the worst.
+	if (dest == startAddr)
+	{
+		WriteLinkJump(blockLinkEntry, MAX_BLOCK_SIZE);
+		return;
 	}
-	emitter.JMP(emitter.returnDispatcher, true);
-	emitter.gpr.loadRegs(false);
-	emitter.gpr.flushRegs(c,false);
+
+	// Anything else in this block has no entry point of its own.
+	if (dest > startAddr && dest <= compilePC)
+		return;
+
+	WriteLinkToBlock(dest);
 }
 
-static void WriteBlockLink(DSPEmitter& emitter, u16 dest)
+void DSPEmitter::WriteLinkToBlock(u16 dest)
 {
+	if (IsIdleSkipBlock(startAddr))
+		return;
+
 	// Jump directly to the called block if it has already been compiled.
-	if (!(dest >= emitter.startAddr && dest <= emitter.compilePC))
+	if (blockLinks[dest] != nullptr)
+	{
+		WriteLinkJump(blockLinks[dest], blockSize[dest]);
+	}
+	else
 	{
-		if (emitter.blockLinks[dest] != nullptr )
-		{
-			emitter.gpr.flushRegs();
-			// Check if we have enough cycles to execute the next block
-			emitter.MOV(16, R(ECX), M(&cyclesLeft));
-			emitter.CMP(16, R(ECX), Imm16(emitter.blockSize[emitter.startAddr] + emitter.blockSize[dest]));
-			FixupBranch notEnoughCycles = emitter.J_CC(CC_BE);
-
-			emitter.SUB(16, R(ECX), Imm16(emitter.blockSize[emitter.startAddr]));
-			emitter.MOV(16, M(&cyclesLeft), R(ECX));
-			emitter.JMP(emitter.blockLinks[dest], true);
-			emitter.SetJumpTarget(notEnoughCycles);
-		}
-		else
-		{
-			// The destination has not been compiled yet.  Add it to the list
-			// of blocks that this block is waiting on.
-			emitter.unresolvedJumps[emitter.startAddr].push_back(dest);
-		}
+		// The destination has not been compiled yet.  Add it to the list
+		// of blocks that this block is waiting on.
+		unresolvedJumps[startAddr].push_back(dest);
 	}
 }
 
 static void r_jcc(const UDSPInstruction opc, DSPEmitter& emitter)
 {
 	u16 dest = dsp_imem_read(emitter.compilePC + 1);
-	const DSPOPCTemplate *opcode = GetOpTemplate(opc);
-
-	// If the block is unconditional, attempt to link block
-	if (opcode->uncond_branch)
-		WriteBlockLink(emitter, dest);
+	emitter.WriteBlockLink(dest);
 	emitter.MOV(16, M(&(g_dsp.pc)), Imm16(dest));
-	WriteBranchExit(emitter);
+	emitter.WriteBranchExit();
 }
 // Generic jmp implementation
 // Jcc addressA
@@ -148,7 +193,7 @@ static void r_jmprcc(const UDSPInstruction opc, DSPEmitter& emitter)
 	//no need to handle DSP_REG_STx.
 	emitter.dsp_op_read_reg(reg, RAX, NONE);
 	emitter.MOV(16, M(&g_dsp.pc), R(EAX));
-	WriteBranchExit(emitter);
+	emitter.WriteBranchExit();
 }
 // Generic jmpr implementation
 // JMPcc $R
@@ -166,13 +211,9 @@ static void r_call(const UDSPInstruction opc, DSPEmitter& emitter)
 	emitter.MOV(16, R(DX), Imm16(emitter.compilePC + 2));
 	emitter.dsp_reg_store_stack(DSP_STACK_C);
 	u16 dest = dsp_imem_read(emitter.compilePC + 1);
-	const DSPOPCTemplate *opcode = GetOpTemplate(opc);
-
-	// If the block is unconditional, attempt to link block
-	if (opcode->uncond_branch)
-		WriteBlockLink(emitter, dest);
+	emitter.WriteBlockLink(dest);
 	emitter.MOV(16, M(&(g_dsp.pc)), Imm16(dest));
-	WriteBranchExit(emitter);
+	emitter.WriteBranchExit();
 }
 // Generic call implementation
 // CALLcc addressA
@@ -195,7 +236,7 @@ static void r_callr(const UDSPInstruction opc, DSPEmitter& emitter)
 	emitter.dsp_reg_store_stack(DSP_STACK_C);
 	emitter.dsp_op_read_reg(reg, RAX, NONE);
 	emitter.MOV(16, M(&g_dsp.pc), R(EAX));
-	WriteBranchExit(emitter);
+	emitter.WriteBranchExit();
 }
 // Generic callr implementation
 // CALLRcc $R
@@ -223,14 +264,14 @@ void DSPEmitter::ifcc(const UDSPInstruction opc)
 {
 	MOV(16, M(&g_dsp.pc), Imm16((compilePC + 1) + opTable[dsp_imem_read(compilePC + 1)]->size));
 	ReJitConditional<r_ifcc>(opc, *this);
-	WriteBranchExit(*this);
+	WriteBranchExit();
 }
 
 static void r_ret(const UDSPInstruction opc, DSPEmitter& emitter)
 {
 	emitter.dsp_reg_load_stack(DSP_STACK_C);
 	emitter.MOV(16, M(&g_dsp.pc), R(DX));
-	WriteBranchExit(emitter);
+	emitter.WriteBranchExit();
 }
 
 // Generic ret implementation
@@ -338,7 +379,7 @@ void DSPEmitter::loop(const UDSPInstruction opc)
 	SetJumpTarget(cnt);
 	//		dsp_skip_inst();
 	MOV(16, M(&g_dsp.pc), Imm16(loop_pc + opTable[dsp_imem_read(loop_pc)]->size));
-	WriteBranchExit(*this);
+	WriteBranchExit();
 	gpr.flushRegs(c,false);
 	SetJumpTarget(exit);
 }
@@ -371,7 +412,7 @@ void DSPEmitter::loopi(const UDSPInstruction opc)
 	{
 //		dsp_skip_inst();
 		MOV(16, M(&g_dsp.pc), Imm16(loop_pc + opTable[dsp_imem_read(loop_pc)]->size));
-		WriteBranchExit(*this);
+		WriteBranchExit();
 	}
 }
 
@@ -409,7 +450,7 @@ void DSPEmitter::bloop(const UDSPInstruction opc)
 	//		g_dsp.pc = loop_pc;
 	//		dsp_skip_inst();
 	MOV(16, M(&g_dsp.pc), Imm16(loop_pc + opTable[dsp_imem_read(loop_pc)]->size));
-	WriteBranchExit(*this);
+	WriteBranchExit();
 	gpr.flushRegs(c,false);
 	SetJumpTarget(exit);
 }
@@ -445,6 +486,6 @@ void DSPEmitter::bloopi(const UDSPInstruction opc)
 //		g_dsp.pc = loop_pc;
 //		dsp_skip_inst();
 		MOV(16, M(&g_dsp.pc), Imm16(loop_pc + opTable[dsp_imem_read(loop_pc)]->size));
-		WriteBranchExit(*this);
+		WriteBranchExit();
 	}
 }
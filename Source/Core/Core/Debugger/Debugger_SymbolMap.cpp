@@ -42,7 +42,7 @@ static bool IsStackBottom(u32 addr)
 	return !addr || !Memory::IsRAMAddress(addr);
 }
 
-static void WalkTheStack(const std::function<void(u32)>& stack_step)
+void WalkTheStack(const std::function<void(u32)>& stack_step)
 {
 	if (!IsStackBottom(PowerPC::ppcState.gpr[1]))
 	{
@@ -4,6 +4,7 @@
 
 #pragma once
 
+#include <functional>
 #include <string>
 #include <vector>
 
@@ -19,6 +20,9 @@ struct CallstackEntry
 	u32 vAddress;
 };
 
+// Calls stack_step with the return address saved in each frame of the guest
+// stack, innermost first. Doesn't include LR.
+void WalkTheStack(const std::function<void(u32)>& stack_step);
 bool GetCallstack(std::vector<CallstackEntry> &output);
 void PrintCallstack();
 void PrintCallstack(LogTypes::LOG_TYPE type, LogTypes::LOG_LEVELS level);
@@ -4,6 +4,7 @@
 
 #include "Common/FileUtil.h"
 #include "Common/MathUtil.h"
+#include "Common/StdMakeUnique.h"
 
 #include "Core/ConfigManager.h"
 #include "Core/HW/DSP.h"
@@ -22,6 +23,9 @@ AXUCode::AXUCode(DSPHLE* dsphle, u32 crc)
 	DSP::GenerateDSPInterruptFromDSPEmu(DSP::INT_DSP);
 
 	LoadResamplingCoefficients();
+
+	if (SConfig::GetInstance().m_DSPParallelAX && Common::ThreadPool::GetDefaultThreadCount() > 1)
+		m_voice_pool = std::make_unique<Common::ThreadPool>();
 }
 
 AXUCode::~AXUCode()
@@ -387,25 +391,25 @@ void AXUCode::ProcessPBList(u32 pb_addr)
 	// 32KHz to 48KHz, but AX always process at 32KHz.
 	const u32 spms = 32;
 
-	AXPB pb;
+	AXBuffers buffers = {{
+		m_samples_left,
+		m_samples_right,
+		m_samples_surround,
+		m_samples_auxA_left,
+		m_samples_auxA_right,
+		m_samples_auxA_surround,
+		m_samples_auxB_left,
+		m_samples_auxB_right,
+		m_samples_auxB_surround
+	}};
 
-	while (pb_addr)
-	{
-		AXBuffers buffers = {{
-			m_samples_left,
-			m_samples_right,
-			m_samples_surround,
-			m_samples_auxA_left,
-			m_samples_auxA_right,
-			m_samples_auxA_surround,
-			m_samples_auxB_left,
-			m_samples_auxB_right,
-			m_samples_auxB_surround
-		}};
-
-		if (!ReadPB(pb_addr, pb))
-			break;
+	static const u32 buffer_sizes[] = {
+		32 * 5, 32 * 5, 32 * 5,
+		32 * 5, 32 * 5, 32 * 5,
+		32 * 5, 32 * 5, 32 * 5
+	};
 
+	ProcessVoices(pb_addr, buffers, buffer_sizes, m_voice_pool.get(), [this](AXPB& pb, AXBuffers& voice_buffers) {
 		u32 updates_addr = HILO_TO_32(pb.updates.data);
 		u16* updates = (u16*)HLEMemory_Get_Pointer(updates_addr);
 
@@ -413,17 +417,14 @@ void AXUCode::ProcessPBList(u32 pb_addr)
 		{
 			ApplyUpdatesForMs(curr_ms, (u16*)&pb, pb.updates.num_updates, updates);
 
-			ProcessVoice(pb, buffers, spms, ConvertMixerControl(pb.mixer_control),
+			ProcessVoice(pb, voice_buffers, spms, ConvertMixerControl(pb.mixer_control),
 			             m_coeffs_available ? m_coeffs : nullptr);
 
 			// Forward the buffers
-			for (u32 i = 0; i < sizeof (buffers.ptrs) / sizeof (buffers.ptrs[0]); ++i)
-				buffers.ptrs[i] += spms;
+			for (u32 i = 0; i < sizeof (voice_buffers.ptrs) / sizeof (voice_buffers.ptrs[0]); ++i)
+				voice_buffers.ptrs[i] += spms;
 		}
-
-		WritePB(pb_addr, pb);
-		pb_addr = HILO_TO_32(pb.next_pb);
-	}
+	});
 }
 
 void AXUCode::MixAUXSamples(int aux_id, u32 write_addr, u32 read_addr)
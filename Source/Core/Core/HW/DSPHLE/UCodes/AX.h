@@ -12,6 +12,9 @@
 
 #pragma once
 
+#include <memory>
+
+#include "Common/ThreadPool.h"
 #include "Core/HW/DSPHLE/UCodes/AXStructs.h"
 #include "Core/HW/DSPHLE/UCodes/UCodes.h"
 
@@ -96,6 +99,10 @@ protected:
 	bool m_coeffs_available;
 	s16 m_coeffs[0x800];
 
+	// Processes the voices of a PB list on several threads. Only set up if
+	// DSP/ParallelAX is enabled and there is more than one core to use.
+	std::unique_ptr<Common::ThreadPool> m_voice_pool;
+
 	void LoadResamplingCoefficients();
 
 	// Copy a command list from memory to our temp buffer
@@ -12,10 +12,17 @@
 #error AXVoice.h included without specifying version
 #endif
 
-#include <functional>
+#include <algorithm>
+#include <set>
+#include <vector>
+
+#ifdef _M_X86
+#include <emmintrin.h>
+#endif
 
 #include "Common/CommonTypes.h"
 #include "Common/MathUtil.h"
+#include "Common/ThreadPool.h"
 #include "Core/HW/DSP.h"
 #include "Core/HW/Memmap.h"
 #include "Core/HW/DSPHLE/UCodes/AX.h"
@@ -29,6 +36,10 @@
 # define MAX_SAMPLES_PER_FRAME 96
 #endif
 
+// Input samples for a frame are decoded into a buffer before resampling if
+// there are at most this many (i.e. unless the ratio is above 4.0).
+#define MAX_INPUT_SAMPLES_PER_FRAME (MAX_SAMPLES_PER_FRAME * 4)
+
 // Put all of that in an anonymous namespace to avoid stupid compilers merging
 // functions from AX GC and AX Wii.
 namespace {
@@ -127,91 +138,95 @@ void DumpPB(const PB_TYPE& pb)
 }
 #endif
 
-// Simulated accelerator state.
-static u32 acc_loop_addr, acc_end_addr;
-static u32* acc_cur_addr;
-static PB_TYPE* acc_pb;
-static bool acc_end_reached;
+// Simulated accelerator state. Kept per voice being processed, so that
+// voices can be processed on several threads.
+struct AcceleratorState
+{
+	u32 loop_addr, end_addr;
+	u32* cur_addr;
+	PB_TYPE* pb;
+	bool end_reached;
+};
 
 // Sets up the simulated accelerator.
-void AcceleratorSetup(PB_TYPE* pb, u32* cur_addr)
+void AcceleratorSetup(AcceleratorState* acc, PB_TYPE* pb, u32* cur_addr)
 {
-	acc_pb = pb;
-	acc_loop_addr = HILO_TO_32(pb->audio_addr.loop_addr);
-	acc_end_addr = HILO_TO_32(pb->audio_addr.end_addr);
-	acc_cur_addr = cur_addr;
-	acc_end_reached = false;
+	acc->pb = pb;
+	acc->loop_addr = HILO_TO_32(pb->audio_addr.loop_addr);
+	acc->end_addr = HILO_TO_32(pb->audio_addr.end_addr);
+	acc->cur_addr = cur_addr;
+	acc->end_reached = false;
 }
 
 // Reads a sample from the simulated accelerator. Also handles looping and
 // disabling streams that reached the end (this is done by an exception raised
 // by the accelerator on real hardware).
-u16 AcceleratorGetSample()
+u16 AcceleratorGetSample(AcceleratorState* acc)
 {
 	u16 ret;
 	u8 step_size_bytes = 0;
 
-	// See below for explanations about acc_end_reached.
-	if (acc_end_reached)
+	// See below for explanations about end_reached.
+	if (acc->end_reached)
 		return 0;
 
-	switch (acc_pb->audio_addr.sample_format)
+	switch (acc->pb->audio_addr.sample_format)
 	{
 		case 0x00: // ADPCM
 		{
 			// ADPCM decoding, not much to explain here.
-			if ((*acc_cur_addr & 15) == 0)
+			if ((*acc->cur_addr & 15) == 0)
 			{
-				acc_pb->adpcm.pred_scale = DSP::ReadARAM((*acc_cur_addr & ~15) >> 1);
-				*acc_cur_addr += 2;
+				acc->pb->adpcm.pred_scale = DSP::ReadARAM((*acc->cur_addr & ~15) >> 1);
+				*acc->cur_addr += 2;
 			}
 
-			if ((acc_end_addr & 15) == 0)
+			if ((acc->end_addr & 15) == 0)
 				step_size_bytes = 1;
 			else
 				step_size_bytes = 2;
 
-			int scale = 1 << (acc_pb->adpcm.pred_scale & 0xF);
-			int coef_idx = (acc_pb->adpcm.pred_scale >> 4) & 0x7;
+			int scale = 1 << (acc->pb->adpcm.pred_scale & 0xF);
+			int coef_idx = (acc->pb->adpcm.pred_scale >> 4) & 0x7;
 
-			s32 coef1 = acc_pb->adpcm.coefs[coef_idx * 2 + 0];
-			s32 coef2 = acc_pb->adpcm.coefs[coef_idx * 2 + 1];
+			s32 coef1 = acc->pb->adpcm.coefs[coef_idx * 2 + 0];
+			s32 coef2 = acc->pb->adpcm.coefs[coef_idx * 2 + 1];
 
-			int temp = (*acc_cur_addr & 1) ?
-					(DSP::ReadARAM(*acc_cur_addr >> 1) & 0xF) :
-					(DSP::ReadARAM(*acc_cur_addr >> 1) >> 4);
+			int temp = (*acc->cur_addr & 1) ?
+					(DSP::ReadARAM(*acc->cur_addr >> 1) & 0xF) :
+					(DSP::ReadARAM(*acc->cur_addr >> 1) >> 4);
 
 			if (temp >= 8)
 				temp -= 16;
 
-			int val = (scale * temp) + ((0x400 + coef1 * acc_pb->adpcm.yn1 + coef2 * acc_pb->adpcm.yn2) >> 11);
+			int val = (scale * temp) + ((0x400 + coef1 * acc->pb->adpcm.yn1 + coef2 * acc->pb->adpcm.yn2) >> 11);
 			MathUtil::Clamp(&val, -0x7FFF, 0x7FFF);
 
-			acc_pb->adpcm.yn2 = acc_pb->adpcm.yn1;
-			acc_pb->adpcm.yn1 = val;
-			*acc_cur_addr += 1;
+			acc->pb->adpcm.yn2 = acc->pb->adpcm.yn1;
+			acc->pb->adpcm.yn1 = val;
+			*acc->cur_addr += 1;
 			ret = val;
 			break;
 		}
 
 		case 0x0A: // 16-bit PCM audio
-			ret = (DSP::ReadARAM(*acc_cur_addr * 2) << 8) | DSP::ReadARAM(*acc_cur_addr * 2 + 1);
-			acc_pb->adpcm.yn2 = acc_pb->adpcm.yn1;
-			acc_pb->adpcm.yn1 = ret;
+			ret = (DSP::ReadARAM(*acc->cur_addr * 2) << 8) | DSP::ReadARAM(*acc->cur_addr * 2 + 1);
+			acc->pb->adpcm.yn2 = acc->pb->adpcm.yn1;
+			acc->pb->adpcm.yn1 = ret;
 			step_size_bytes = 2;
-			*acc_cur_addr += 1;
+			*acc->cur_addr += 1;
 			break;
 
 		case 0x19: // 8-bit PCM audio
-			ret = DSP::ReadARAM(*acc_cur_addr) << 8;
-			acc_pb->adpcm.yn2 = acc_pb->adpcm.yn1;
-			acc_pb->adpcm.yn1 = ret;
+			ret = DSP::ReadARAM(*acc->cur_addr) << 8;
+			acc->pb->adpcm.yn2 = acc->pb->adpcm.yn1;
+			acc->pb->adpcm.yn1 = ret;
 			step_size_bytes = 2;
-			*acc_cur_addr += 1;
+			*acc->cur_addr += 1;
 			break;
 
 		default:
-			ERROR_LOG(DSPHLE, "Unknown sample format: %d", acc_pb->audio_addr.sample_format);
+			ERROR_LOG(DSPHLE, "Unknown sample format: %d", acc->pb->audio_addr.sample_format);
 			return 0;
 	}
 
@@ -219,29 +234,29 @@ u16 AcceleratorGetSample()
 	//
 	// On real hardware, this would raise an interrupt that is handled by the
 	// UCode. We simulate what this interrupt does here.
-	if (*acc_cur_addr == (acc_end_addr + step_size_bytes - 1))
+	if (*acc->cur_addr == (acc->end_addr + step_size_bytes - 1))
 	{
 		// loop back to loop_addr.
-		*acc_cur_addr = acc_loop_addr;
+		*acc->cur_addr = acc->loop_addr;
 
-		if (acc_pb->audio_addr.looping)
+		if (acc->pb->audio_addr.looping)
 		{
 			// Set the ADPCM infos to continue processing at loop_addr.
 			//
 			// For some reason, yn1 and yn2 aren't set if the voice is not of
 			// stream type. This is what the AX UCode does and I don't really
 			// know why.
-			acc_pb->adpcm.pred_scale = acc_pb->adpcm_loop_info.pred_scale;
-			if (!acc_pb->is_stream)
+			acc->pb->adpcm.pred_scale = acc->pb->adpcm_loop_info.pred_scale;
+			if (!acc->pb->is_stream)
 			{
-				acc_pb->adpcm.yn1 = acc_pb->adpcm_loop_info.yn1;
-				acc_pb->adpcm.yn2 = acc_pb->adpcm_loop_info.yn2;
+				acc->pb->adpcm.yn1 = acc->pb->adpcm_loop_info.yn1;
+				acc->pb->adpcm.yn2 = acc->pb->adpcm_loop_info.yn2;
 			}
 		}
 		else
 		{
 			// Non looping voice reached the end -> running = 0.
-			acc_pb->running = 0;
+			acc->pb->running = 0;
 
 #ifdef AX_WII
 			// One of the few meaningful differences between AXGC and AXWii:
@@ -249,7 +264,7 @@ u16 AcceleratorGetSample()
 			// samples at the loop address, AXWii has the 0000 samples
 			// internally in DRAM and use an internal pointer to it (loop addr
 			// does not contain 0000 samples on AXWii!).
-			acc_end_reached = true;
+			acc->end_reached = true;
 #endif
 		}
 	}
@@ -277,7 +292,8 @@ u16 AcceleratorGetSample()
 // We start getting samples not from sample 0, but 0.<curr_pos_frac>. This
 // avoids discontinuities in the audio stream, especially with very low ratios
 // which interpolate a lot of values between two "real" samples.
-u32 ResampleAudio(std::function<s16(u32)> input_callback, s16* output, u32 count,
+template <typename InputCallback>
+u32 ResampleAudio(InputCallback input_callback, s16* output, u32 count,
                   s16* last_samples, u32 curr_pos, u32 ratio, int srctype,
                   const s16* coeffs)
 {
@@ -398,14 +414,39 @@ u32 ResampleAudio(std::function<s16(u32)> input_callback, s16* output, u32 count
 void GetInputSamples(PB_TYPE& pb, s16* samples, u16 count, const s16* coeffs)
 {
 	u32 cur_addr = HILO_TO_32(pb.audio_addr.cur_addr);
-	AcceleratorSetup(&pb, &cur_addr);
+	AcceleratorState acc;
+	AcceleratorSetup(&acc, &pb, &cur_addr);
 
 	if (coeffs)
 		coeffs += pb.coef_select * 0x200;
-	u32 curr_pos = ResampleAudio([](u32) { return AcceleratorGetSample(); },
-	                             samples, count, pb.src.last_samples,
-	                             pb.src.cur_addr_frac, HILO_TO_32(pb.src.ratio),
-	                             pb.src_type, coeffs);
+
+	// The resampler consumes one input sample each time the position crosses
+	// an integer, so we know up front how many it will need. Decoding them
+	// all first keeps the accelerator out of the resampling loop; the
+	// accelerator doesn't touch anything the resampler uses, so the result is
+	// the same.
+	const u32 ratio = HILO_TO_32(pb.src.ratio);
+	u64 input_count = count;
+	if (pb.src_type == SRCTYPE_LINEAR || pb.src_type == SRCTYPE_POLYPHASE)
+		input_count = ((u64)pb.src.cur_addr_frac + (u64)ratio * count) >> 16;
+
+	u32 curr_pos;
+	if (input_count <= MAX_INPUT_SAMPLES_PER_FRAME)
+	{
+		s16 input[MAX_INPUT_SAMPLES_PER_FRAME];
+		for (u32 i = 0; i < input_count; ++i)
+			input[i] = AcceleratorGetSample(&acc);
+
+		curr_pos = ResampleAudio([&input](u32 i) { return input[i]; },
+		                         samples, count, pb.src.last_samples,
+		                         pb.src.cur_addr_frac, ratio, pb.src_type, coeffs);
+	}
+	else
+	{
+		curr_pos = ResampleAudio([&acc](u32) { return AcceleratorGetSample(&acc); },
+		                         samples, count, pb.src.last_samples,
+		                         pb.src.cur_addr_frac, ratio, pb.src_type, coeffs);
+	}
 	pb.src.cur_addr_frac = (curr_pos & 0xFFFF);
 
 	// Update current position in the PB.
@@ -413,6 +454,57 @@ void GetInputSamples(PB_TYPE& pb, s16* samples, u16 count, const s16* coeffs)
 	pb.audio_addr.cur_addr_lo = (u16)(cur_addr & 0xFFFF);
 }
 
+#ifdef _M_X86
+// Volumes for 8 consecutive samples, starting at <volume> and ramping by
+// <volume_delta> per sample. Wraps around like the scalar code does.
+__m128i VolumeRamp(u16 volume, u16 volume_delta)
+{
+	return _mm_add_epi16(_mm_set1_epi16((s16)volume),
+	                     _mm_mullo_epi16(_mm_set1_epi16((s16)volume_delta),
+	                                     _mm_setr_epi16(0, 1, 2, 3, 4, 5, 6, 7)));
+}
+
+// (sample * volume) >> 15 for 8 samples, clamped to [-32767, 32767]. The
+// volumes are unsigned, so this can't use the signed multiplies directly: the
+// high half of a signed * unsigned product is the high half of the unsigned
+// product, minus the volume where the sample is negative.
+__m128i ScaleSamples(__m128i samples, __m128i volumes)
+{
+	__m128i lo = _mm_mullo_epi16(samples, volumes);
+	__m128i hi = _mm_mulhi_epu16(samples, volumes);
+	hi = _mm_sub_epi16(hi, _mm_and_si128(_mm_srai_epi16(samples, 15), volumes));
+
+	__m128i first = _mm_srai_epi32(_mm_unpacklo_epi16(lo, hi), 15);
+	__m128i second = _mm_srai_epi32(_mm_unpackhi_epi16(lo, hi), 15);
+	return _mm_max_epi16(_mm_packs_epi32(first, second), _mm_set1_epi16(-32767));
+}
+#endif
+
+// Apply a volume ramp to samples in place. The volume is updated to the one
+// for the sample after the last.
+void ApplyVolume(s16* samples, u32 count, u16* volume, u16 volume_delta)
+{
+	u32 i = 0;
+
+#ifdef _M_X86
+	__m128i vol = VolumeRamp(*volume, volume_delta);
+	const __m128i vol_step = _mm_set1_epi16((s16)(volume_delta * 8));
+	for (; i + 8 <= count; i += 8)
+	{
+		__m128i* p = (__m128i*)(samples + i);
+		_mm_storeu_si128(p, ScaleSamples(_mm_loadu_si128(p), vol));
+		vol = _mm_add_epi16(vol, vol_step);
+	}
+	*volume += (u16)(volume_delta * i);
+#endif
+
+	for (; i < count; ++i)
+	{
+		samples[i] = MathUtil::Clamp(((s32)samples[i] * *volume) >> 15, -32767, 32767);	// -32768 ?
+		*volume += volume_delta;
+	}
+}
+
 // Add samples to an output buffer, with optional volume ramping.
 void MixAdd(int* out, const s16* input, u32 count, u16* pvol, s16* dpop, bool ramp)
 {
@@ -425,7 +517,32 @@ void MixAdd(int* out, const s16* input, u32 count, u16* pvol, s16* dpop, bool ra
 	if (!ramp)
 		volume_delta = 0;
 
-	for (u32 i = 0; i < count; ++i)
+	u32 i = 0;
+
+#ifdef _M_X86
+	if (count >= 8)
+	{
+		__m128i vol = VolumeRamp(volume, volume_delta);
+		const __m128i vol_step = _mm_set1_epi16((s16)(volume_delta * 8));
+		__m128i scaled = _mm_setzero_si128();
+		for (; i + 8 <= count; i += 8)
+		{
+			scaled = ScaleSamples(_mm_loadu_si128((const __m128i*)(input + i)), vol);
+			vol = _mm_add_epi16(vol, vol_step);
+
+			// Sign extend to 32 bits and accumulate.
+			__m128i* o = (__m128i*)(out + i);
+			__m128i first = _mm_srai_epi32(_mm_unpacklo_epi16(scaled, scaled), 16);
+			__m128i second = _mm_srai_epi32(_mm_unpackhi_epi16(scaled, scaled), 16);
+			_mm_storeu_si128(o, _mm_add_epi32(_mm_loadu_si128(o), first));
+			_mm_storeu_si128(o + 1, _mm_add_epi32(_mm_loadu_si128(o + 1), second));
+		}
+		volume += (u16)(volume_delta * i);
+		*dpop = (s16)_mm_extract_epi16(scaled, 7);
+	}
+#endif
+
+	for (; i < count; ++i)
 	{
 		s64 sample = input[i];
 		sample *= volume;
@@ -461,11 +578,7 @@ void ProcessVoice(PB_TYPE& pb, const AXBuffers& buffers, u16 count, AXMixControl
 	GetInputSamples(pb, samples, count, coeffs);
 
 	// Apply a global volume ramp using the volume envelope parameters.
-	for (u32 i = 0; i < count; ++i)
-	{
-		samples[i] = MathUtil::Clamp(((s32)samples[i] * pb.vol_env.cur_volume) >> 15, -32767, 32767);	// -32768 ?
-		pb.vol_env.cur_volume += pb.vol_env.cur_volume_delta;
-	}
+	ApplyVolume(samples, count, &pb.vol_env.cur_volume, (u16)pb.vol_env.cur_volume_delta);
 
 	// Optionally, execute a low pass filter
 	// TODO: LPF code is currently broken, causing Super Monkey Ball sound
@@ -564,4 +677,121 @@ void ProcessVoice(PB_TYPE& pb, const AXBuffers& buffers, u16 count, AXMixControl
 #endif
 }
 
+// Runs every voice in the PB list starting at pb_addr through
+// process_voice(pb, buffers), which mixes one voice into the buffers it is
+// given and must not touch anything but the PB and those buffers.
+// buffer_sizes has the length of each of the buffers.
+//
+// With a thread pool, the whole list is read first and split into one run of
+// consecutive voices per thread. Each run is mixed into zeroed buffers of its
+// own, which are then added to the real ones run by run. Mixing is integer
+// addition, so the output and the PBs written back are exactly what
+// processing the voices one by one gives. Lists where that can't be known in
+// advance (a PB that appears twice, or an update that relinks the list) are
+// processed one by one.
+template <typename ProcessFunc>
+void ProcessVoices(u32 pb_addr, const AXBuffers& buffers, const u32* buffer_sizes,
+                   Common::ThreadPool* pool, ProcessFunc process_voice)
+{
+	const u32 num_buffers = sizeof (buffers.ptrs) / sizeof (buffers.ptrs[0]);
+
+	if (pool)
+	{
+		std::vector<u32> addrs;
+		std::vector<PB_TYPE> pbs;
+		std::set<u32> seen;
+		bool linear = true;
+
+		u32 addr = pb_addr;
+		while (addr)
+		{
+			if (!seen.insert(addr).second)
+			{
+				linear = false;
+				break;
+			}
+
+			pbs.emplace_back();
+			if (!ReadPB(addr, pbs.back()))
+			{
+				pbs.pop_back();
+				break;
+			}
+			addrs.push_back(addr);
+			addr = HILO_TO_32(pbs.back().next_pb);
+		}
+		const u32 end_addr = addr;
+
+		if (linear)
+		{
+			u32 run_size = 0;
+			for (u32 i = 0; i < num_buffers; ++i)
+				run_size += buffer_sizes[i];
+
+			const size_t num_runs = std::min<size_t>(pool->GetThreadCount(), pbs.size());
+			std::vector<int> run_samples(num_runs * run_size, 0);
+
+			pool->ParallelFor(num_runs, [&](size_t run) {
+				AXBuffers run_buffers;
+				int* ptr = &run_samples[run * run_size];
+				for (u32 i = 0; i < num_buffers; ++i)
+				{
+					run_buffers.ptrs[i] = ptr;
+					ptr += buffer_sizes[i];
+				}
+
+				const size_t first = pbs.size() * run / num_runs;
+				const size_t last = pbs.size() * (run + 1) / num_runs;
+				for (size_t i = first; i < last; ++i)
+				{
+					AXBuffers voice_buffers = run_buffers;
+					process_voice(pbs[i], voice_buffers);
+				}
+			});
+
+			for (size_t i = 0; i < pbs.size(); ++i)
+			{
+				u32 next_addr = i + 1 < pbs.size() ? addrs[i + 1] : end_addr;
+				if ((u32)HILO_TO_32(pbs[i].next_pb) != next_addr)
+					linear = false;
+			}
+
+			if (linear)
+			{
+				for (size_t run = 0; run < num_runs; ++run)
+				{
+					const int* src = &run_samples[run * run_size];
+					for (u32 i = 0; i < num_buffers; ++i)
+					{
+						for (u32 j = 0; j < buffer_sizes[i]; ++j)
+							buffers.ptrs[i][j] += src[j];
+						src += buffer_sizes[i];
+					}
+				}
+
+				for (size_t i = 0; i < pbs.size(); ++i)
+					WritePB(addrs[i], pbs[i]);
+
+				return;
+			}
+		}
+
+		// Nothing has been written yet, so start over one by one.
+	}
+
+	PB_TYPE pb;
+
+	while (pb_addr)
+	{
+		if (!ReadPB(pb_addr, pb))
+			break;
+
+		AXBuffers voice_buffers = buffers;
+		process_voice(pb, voice_buffers);
+
+		WritePB(pb_addr, pb);
+		pb_addr = HILO_TO_32(pb.next_pb);
+	}
+}
+
 } // namespace
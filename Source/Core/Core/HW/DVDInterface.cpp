@@ -4,10 +4,15 @@
 
 #include <cinttypes>
 #include <cmath>
+#include <ctime>
+#include <string>
 
 #include "AudioCommon/AudioCommon.h"
 
+#include "Common/CommonPaths.h"
 #include "Common/CommonTypes.h"
+#include "Common/FileUtil.h"
+#include "Common/StringUtil.h"
 
 #include "Core/ConfigManager.h"
 #include "Core/CoreTiming.h"
@@ -15,12 +20,14 @@
 #include "Core/VolumeHandler.h"
 #include "Core/HW/AudioInterface.h"
 #include "Core/HW/DVDInterface.h"
+#include "Core/HW/DVDThread.h"
 #include "Core/HW/Memmap.h"
 #include "Core/HW/MMIO.h"
 #include "Core/HW/ProcessorInterface.h"
 #include "Core/HW/StreamADPCM.h"
 #include "Core/HW/SystemTimers.h"
 #include "Core/PowerPC/PowerPC.h"
+#include "DiscIO/ReadTrace.h"
 
 static const double PI = 3.14159265358979323846264338328;
 
@@ -289,6 +296,8 @@ void DoState(PointerWrap &p)
 	p.Do(g_last_read_time);
 
 	p.Do(g_bStopAtTrackEnd);
+
+	DVDThread::DoState(p);
 }
 
 static void TransferComplete(u64 userdata, int cyclesLate)
@@ -328,6 +337,7 @@ static u32 ProcessDTKSamples(short *tempPCM, u32 num_samples)
 
 		u8 tempADPCM[NGCADPCM::ONE_BLOCK_SIZE];
 		// TODO: What if we can't read from AudioPos?
+		DVDThread::WaitUntilIdle();
 		VolumeHandler::ReadToPtr(tempADPCM, AudioPos, sizeof(tempADPCM), false);
 		AudioPos += sizeof(tempADPCM);
 		NGCADPCM::DecodeBlock(tempPCM + samples_processed * 2, tempADPCM);
@@ -362,6 +372,49 @@ static void DTKStreamingCallback(u64 userdata, int cyclesLate)
 	CoreTiming::ScheduleEvent(ticks_to_dtk - cyclesLate, dtk);
 }
 
+// Disc read trace, recorded when SConfig::m_DumpDiscReads is set
+static DiscIO::ReadTraceWriter s_read_trace;
+static bool s_read_trace_failed;
+
+static void TraceDiscEvent(DiscIO::ReadTraceEvent::EType type, u64 offset, u32 length, bool decrypt)
+{
+	if (!SConfig::GetInstance().m_DumpDiscReads || s_read_trace_failed)
+		return;
+
+	if (!s_read_trace.IsOpen())
+	{
+		// One file per session
+		std::string dir = File::GetUserPath(D_DUMP_IDX) + "DiscReads" DIR_SEP;
+		File::CreateFullPath(dir);
+		std::string game_id = VolumeHandler::IsValid() ? VolumeHandler::GetVolume()->GetUniqueID() : "";
+		std::string filename = StringFromFormat("%s%s_%" PRIu64 ".txt", dir.c_str(), game_id.c_str(), (u64)time(nullptr));
+		if (!s_read_trace.Open(filename, game_id))
+		{
+			ERROR_LOG(DVDINTERFACE, "Couldn't open %s for the disc read trace", filename.c_str());
+			s_read_trace_failed = true;
+			return;
+		}
+		NOTICE_LOG(DVDINTERFACE, "Recording disc reads to %s", filename.c_str());
+	}
+
+	// Multiplying the ticks first would overflow after a few hours.
+	const u64 ticks = CoreTiming::GetTicks();
+	const u64 ticks_per_second = SystemTimers::GetTicksPerSecond();
+
+	DiscIO::ReadTraceEvent event;
+	event.type = type;
+	event.time_us = ticks / ticks_per_second * 1000000 + ticks % ticks_per_second * 1000000 / ticks_per_second;
+	event.offset = offset;
+	event.length = length;
+	event.decrypt = decrypt;
+	s_read_trace.Write(event);
+}
+
+void TracePartitionChange(u64 partition_offset)
+{
+	TraceDiscEvent(DiscIO::ReadTraceEvent::OPEN_PARTITION, partition_offset, 0, false);
+}
+
 void Init()
 {
 	m_DISR.Hex        = 0;
@@ -390,6 +443,8 @@ void Init()
 	g_last_read_offset = 0;
 	g_last_read_time = 0;
 
+	s_read_trace_failed = false;
+
 	ejectDisc = CoreTiming::RegisterEvent("EjectDisc", EjectDiscCallback);
 	insertDisc = CoreTiming::RegisterEvent("InsertDisc", InsertDiscCallback);
 
@@ -397,10 +452,14 @@ void Init()
 	dtk = CoreTiming::RegisterEvent("StreamingTimer", DTKStreamingCallback);
 
 	CoreTiming::ScheduleEvent(0, dtk);
+
+	DVDThread::Start();
 }
 
 void Shutdown()
 {
+	DVDThread::Stop();
+	s_read_trace.Close();
 }
 
 void SetDiscInside(bool _DiscInside)
@@ -424,6 +483,7 @@ void EjectDiscCallback(u64 userdata, int cyclesLate)
 {
 	// Empty the drive
 	SetDiscInside(false);
+	DVDThread::WaitUntilIdle();
 	VolumeHandler::EjectVolume();
 }
 
@@ -432,6 +492,7 @@ void InsertDiscCallback(u64 userdata, int cyclesLate)
 	std::string& SavedFileName = SConfig::GetInstance().m_LocalCoreStartupParameter.m_strFilename;
 	std::string *_FileName = (std::string *)userdata;
 
+	DVDThread::WaitUntilIdle();
 	if (!VolumeHandler::SetVolumeName(*_FileName))
 	{
 		// Put back the old one
@@ -469,7 +530,8 @@ void SetLidOpen(bool _bOpen)
 
 bool DVDRead(u64 _iDVDOffset, u32 _iRamAddress, u32 _iLength, bool decrypt)
 {
-		return VolumeHandler::ReadToPtr(Memory::GetPointer(_iRamAddress), _iDVDOffset, _iLength, decrypt);
+	DVDThread::WaitUntilIdle();
+	return VolumeHandler::ReadToPtr(Memory::GetPointer(_iRamAddress), _iDVDOffset, _iLength, decrypt);
 }
 
 void RegisterMMIO(MMIO::Mapping* mmio, u32 base)
@@ -630,8 +692,21 @@ DVDCommandResult ExecuteReadCommand(u64 DVD_offset, u32 output_address,
 		return result;
 	}
 
-	if (!DVDRead(DVD_offset, output_address, DVD_length, decrypt))
-		PanicAlertT("Can't read from DVD_Plugin - DVD-Interface: Fatal Error");
+	TraceDiscEvent(DiscIO::ReadTraceEvent::READ, DVD_offset, DVD_length, decrypt);
+
+	if (SConfig::GetInstance().m_LocalCoreStartupParameter.bFastDiscSpeed)
+	{
+		// The caller completes the command right away, so there's nothing to
+		// overlap the host read with.
+		if (!DVDRead(DVD_offset, output_address, DVD_length, decrypt))
+			PanicAlertT("Can't read from DVD_Plugin - DVD-Interface: Fatal Error");
+	}
+	else
+	{
+		// The caller schedules its completion at the same tick, after this.
+		DVDThread::StartRead(DVD_offset, output_address, DVD_length, decrypt,
+		                     (int)result.ticks_until_completion);
+	}
 
 	result.interrupt_type = INT_TCINT;
 	return result;
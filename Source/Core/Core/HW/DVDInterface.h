@@ -108,4 +108,7 @@ extern bool g_bStream;
 DVDCommandResult ExecuteCommand(u32 command_0, u32 command_1, u32 command_2,
 	u32 output_address, u32 output_length, bool write_to_DIIMMBUF);
 
+// Adds a Wii partition switch to the disc read trace, if one is being recorded
+void TracePartitionChange(u64 partition_offset);
+
 } // end of namespace DVDInterface
@@ -0,0 +1,157 @@
+// Copyright 2015 Dolphin Emulator Project
+// Licensed under GPLv2
+// Refer to the license.txt file included.
+
+#include <cinttypes>
+#include <thread>
+#include <vector>
+
+#include "Common/ChunkFile.h"
+#include "Common/CommonTypes.h"
+#include "Common/Event.h"
+#include "Common/Flag.h"
+#include "Common/MsgHandler.h"
+#include "Common/Thread.h"
+
+#include "Core/CoreTiming.h"
+#include "Core/VolumeHandler.h"
+#include "Core/HW/DVDThread.h"
+#include "Core/HW/Memmap.h"
+
+namespace DVDThread
+{
+
+static int s_finish_read;
+
+static std::thread s_dvd_thread;
+static Common::Event s_request_event;
+static Common::Event s_done_event;
+static Common::Flag s_quit;
+
+// The read in flight. Set up by the CPU thread before s_request_event is
+// set, and only touched again by it once s_read_done is set.
+static bool s_read_pending;
+static u64 s_dvd_offset;
+static u32 s_output_address;
+static u32 s_length;
+static bool s_decrypt;
+
+// Written by the DVD thread before it sets s_read_done.
+static std::vector<u8> s_buffer;
+static bool s_read_success;
+static Common::Flag s_read_done;
+
+static void DVDThreadFunc()
+{
+	Common::SetCurrentThreadName("DVD thread");
+
+	while (true)
+	{
+		s_request_event.Wait();
+		if (s_quit.IsSet())
+			return;
+
+		s_read_success = VolumeHandler::ReadToPtr(s_buffer.data(), s_dvd_offset, s_length, s_decrypt);
+		s_read_done.Set();
+		s_done_event.Set();
+	}
+}
+
+void WaitUntilIdle()
+{
+	if (!s_read_pending)
+		return;
+
+	while (!s_read_done.IsSet())
+		s_done_event.Wait();
+}
+
+static void FinishRead()
+{
+	if (!s_read_pending)
+		return;
+
+	if (!s_read_done.IsSet())
+	{
+		DEBUG_LOG(DVDINTERFACE, "Waiting for the host to read 0x%x bytes at 0x%09" PRIx64, s_length, s_dvd_offset);
+		WaitUntilIdle();
+	}
+
+	s_read_pending = false;
+
+	if (s_read_success)
+		Memory::CopyToEmu(s_output_address, s_buffer.data(), s_length);
+	else
+		PanicAlertT("Can't read from DVD_Plugin - DVD-Interface: Fatal Error");
+}
+
+static void FinishReadCallback(u64 userdata, int cyclesLate)
+{
+	FinishRead();
+}
+
+void Start()
+{
+	s_finish_read = CoreTiming::RegisterEvent("DVDReadFinished", FinishReadCallback);
+
+	s_read_pending = false;
+	s_read_done.Clear();
+	s_quit.Clear();
+	s_dvd_thread = std::thread(DVDThreadFunc);
+}
+
+void Stop()
+{
+	if (s_dvd_thread.joinable())
+	{
+		s_quit.Set();
+		s_request_event.Set();
+		s_dvd_thread.join();
+	}
+
+	s_read_pending = false;
+	std::vector<u8>().swap(s_buffer);
+}
+
+void DoState(PointerWrap &p)
+{
+	// The buffer goes into the state rather than the read being restarted
+	// on load, since the disc may have been swapped in between.
+	WaitUntilIdle();
+
+	p.Do(s_read_pending);
+	p.Do(s_dvd_offset);
+	p.Do(s_output_address);
+	p.Do(s_length);
+	p.Do(s_decrypt);
+	p.Do(s_read_success);
+	p.Do(s_buffer);
+
+	if (p.GetMode() == PointerWrap::MODE_READ)
+		s_read_done.Set();
+}
+
+void StartRead(u64 dvd_offset, u32 output_address, u32 length, bool decrypt, int ticks_until_completion)
+{
+	// A new command can only be issued once the previous one has completed,
+	// but don't rely on games to respect that. The event for the old read
+	// must not complete the new one.
+	if (s_read_pending)
+	{
+		CoreTiming::RemoveEvent(s_finish_read);
+		FinishRead();
+	}
+
+	s_read_pending = true;
+	s_dvd_offset = dvd_offset;
+	s_output_address = output_address;
+	s_length = length;
+	s_decrypt = decrypt;
+	s_buffer.resize(length);
+	s_read_done.Clear();
+	s_request_event.Set();
+
+	CoreTiming::ScheduleEvent(ticks_until_completion, s_finish_read);
+}
+
+}
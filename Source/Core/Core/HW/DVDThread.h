@@ -0,0 +1,35 @@
+// Copyright 2015 Dolphin Emulator Project
+// Licensed under GPLv2
+// Refer to the license.txt file included.
+
+// Reads disc data for DVDInterface on a separate host thread.
+//
+// A read is handed to the thread as soon as the emulated drive accepts the
+// command. The data is only copied into emulated memory once the emulated
+// read time has passed, so what the game sees doesn't depend on how fast the
+// host happens to be. The CPU thread only has to wait if the host read is
+// still in progress by then (compressed and encrypted images can be slow).
+
+#pragma once
+
+#include "Common/CommonTypes.h"
+
+class PointerWrap;
+
+namespace DVDThread
+{
+
+void Start();
+void Stop();
+void DoState(PointerWrap &p);
+
+// Waits for the host read in progress, if any. Anything else on the CPU
+// thread that touches the volume has to call this first.
+void WaitUntilIdle();
+
+// Starts reading into output_address. The data arrives in emulated memory
+// ticks_until_completion ticks from now, before any other event scheduled
+// for the same tick after this call.
+void StartRead(u64 dvd_offset, u32 output_address, u32 length, bool decrypt, int ticks_until_completion);
+
+}
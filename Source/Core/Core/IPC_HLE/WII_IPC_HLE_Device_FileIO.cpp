@@ -3,6 +3,8 @@
 // Refer to the license.txt file included.
 
 #include <algorithm>
+#include <map>
+#include <memory>
 
 #include "Common/ChunkFile.h"
 #include "Common/CommonTypes.h"
@@ -16,6 +18,11 @@
 
 static Common::replace_v replacements;
 
+// Host files that are open through FileIO descriptors. On the Wii, all
+// descriptors for a file see each other's writes right away, so descriptors
+// for the same path share one host handle.
+static std::map<std::string, std::weak_ptr<File::IOFile>> openFiles;
+
 // This is used by several of the FileIO and /dev/fs functions
 std::string HLE_IPC_BuildFilename(std::string path_wii)
 {
@@ -33,6 +40,26 @@ std::string HLE_IPC_BuildFilename(std::string path_wii)
 	return path_full;
 }
 
+void HLE_IPC_CloseHostFiles(const std::string& path)
+{
+	for (auto iter = openFiles.begin(); iter != openFiles.end();)
+	{
+		const std::string& open_path = iter->first;
+		if (open_path == path || (open_path.size() > path.size() &&
+		                          open_path.compare(0, path.size(), path) == 0 &&
+		                          open_path[path.size()] == '/'))
+		{
+			if (auto file = iter->second.lock())
+				file->Close();
+			iter = openFiles.erase(iter);
+		}
+		else
+		{
+			++iter;
+		}
+	}
+}
+
 void HLE_IPC_CreateVirtualFATFilesystem()
 {
 	const int cdbSize = 0x01400000;
@@ -76,6 +103,7 @@ CWII_IPC_HLE_Device_FileIO::CWII_IPC_HLE_Device_FileIO(u32 _DeviceID, const std:
 
 CWII_IPC_HLE_Device_FileIO::~CWII_IPC_HLE_Device_FileIO()
 {
+	CloseFile();
 }
 
 IPCCommandResult CWII_IPC_HLE_Device_FileIO::Close(u32 _CommandAddress, bool _bForce)
@@ -83,6 +111,8 @@ IPCCommandResult CWII_IPC_HLE_Device_FileIO::Close(u32 _CommandAddress, bool _bF
 	INFO_LOG(WII_IPC_FILEIO, "FileIO: Close %s (DeviceID=%08x)", m_Name.c_str(), m_DeviceID);
 	m_Mode = 0;
 
+	CloseFile();
+
 	// Close always return 0 for success
 	if (_CommandAddress && !_bForce)
 		Memory::Write_U32(0, _CommandAddress + 4);
@@ -103,6 +133,7 @@ IPCCommandResult CWII_IPC_HLE_Device_FileIO::Open(u32 _CommandAddress, u32 _Mode
 		"Read and Write"
 	};
 
+	CloseFile();
 	m_filepath = HLE_IPC_BuildFilename(m_Name);
 
 	// The file must exist before we can open it
@@ -124,27 +155,68 @@ IPCCommandResult CWII_IPC_HLE_Device_FileIO::Open(u32 _CommandAddress, u32 _Mode
 	return IPC_DEFAULT_REPLY;
 }
 
-File::IOFile CWII_IPC_HLE_Device_FileIO::OpenFile()
+bool CWII_IPC_HLE_Device_FileIO::OpenFile()
 {
-	const char* open_mode = "";
+	if (m_file && m_file->IsOpen())
+	{
+		// Handles stay open across requests, so an earlier failure mustn't
+		// stick to them.
+		m_file->Clear();
+		return true;
+	}
+	// Closed by HLE_IPC_CloseHostFiles.
+	m_file.reset();
 
 	switch (m_Mode)
 	{
 	case ISFS_OPEN_READ:
-		open_mode = "rb";
-		break;
-
 	case ISFS_OPEN_WRITE:
 	case ISFS_OPEN_RW:
-		open_mode = "r+b";
 		break;
 
 	default:
 		PanicAlertT("FileIO: Unknown open mode : 0x%02x", m_Mode);
-		break;
+		return false;
+	}
+
+	m_file = openFiles[m_filepath].lock();
+	if (!m_file || !m_file->IsOpen())
+	{
+		// Shared handles are opened for writing whatever this descriptor's
+		// mode is, since other descriptors may need to write. The mode is
+		// checked by Read and Write.
+		m_file = std::make_shared<File::IOFile>(m_filepath, "r+b");
+		if (!m_file->IsOpen() && m_Mode == ISFS_OPEN_READ)
+			m_file = std::make_shared<File::IOFile>(m_filepath, "rb");
+
+		if (!m_file->IsOpen())
+		{
+			m_file.reset();
+			openFiles.erase(m_filepath);
+			return false;
+		}
+
+		// Requests read and write straight between the host file and
+		// emulated memory. Without stdio buffering, writes are also visible
+		// to everything else that opens the file on the host (/dev/fs,
+		// ES, ...) right away.
+		setvbuf(m_file->GetHandle(), nullptr, _IONBF, 0);
+		openFiles[m_filepath] = m_file;
 	}
 
-	return File::IOFile(m_filepath, open_mode);
+	m_file->Clear();
+	return true;
+}
+
+void CWII_IPC_HLE_Device_FileIO::CloseFile()
+{
+	if (!m_file)
+		return;
+
+	m_file.reset();
+	auto iter = openFiles.find(m_filepath);
+	if (iter != openFiles.end() && iter->second.expired())
+		openFiles.erase(iter);
 }
 
 IPCCommandResult CWII_IPC_HLE_Device_FileIO::Seek(u32 _CommandAddress)
@@ -153,11 +225,11 @@ IPCCommandResult CWII_IPC_HLE_Device_FileIO::Seek(u32 _CommandAddress)
 	const s32 SeekPosition = Memory::Read_U32(_CommandAddress + 0xC);
 	const s32 Mode = Memory::Read_U32(_CommandAddress + 0x10);
 
-	if (auto file = OpenFile())
+	if (OpenFile())
 	{
 		ReturnValue = FS_RESULT_FATAL;
 
-		const s32 fileSize = (s32) file.GetSize();
+		const s32 fileSize = (s32) m_file->GetSize();
 		INFO_LOG(WII_IPC_FILEIO, "FileIO: Seek Pos: 0x%08x, Mode: %i (%s, Length=0x%08x)", SeekPosition, Mode, m_Name.c_str(), fileSize);
 
 		switch (Mode)
@@ -217,8 +289,7 @@ IPCCommandResult CWII_IPC_HLE_Device_FileIO::Read(u32 _CommandAddress)
 	const u32 Address = Memory::Read_U32(_CommandAddress + 0xC); // Read to this memory address
 	const u32 Size    = Memory::Read_U32(_CommandAddress + 0x10);
 
-
-	if (auto file = OpenFile())
+	if (OpenFile())
 	{
 		if (m_Mode == ISFS_OPEN_WRITE)
 		{
@@ -227,9 +298,9 @@ IPCCommandResult CWII_IPC_HLE_Device_FileIO::Read(u32 _CommandAddress)
 		else
 		{
 			INFO_LOG(WII_IPC_FILEIO, "FileIO: Read 0x%x bytes to 0x%08x from %s", Size, Address, m_Name.c_str());
-			file.Seek(m_SeekPos, SEEK_SET);
-			ReturnValue = (u32)fread(Memory::GetPointer(Address), 1, Size, file.GetHandle());
-			if (ReturnValue != Size && ferror(file.GetHandle()))
+			m_file->Seek(m_SeekPos, SEEK_SET);
+			ReturnValue = (u32)fread(Memory::GetPointer(Address), 1, Size, m_file->GetHandle());
+			if (ReturnValue != Size && ferror(m_file->GetHandle()))
 			{
 				ReturnValue = FS_EACCESS;
 			}
@@ -256,7 +327,7 @@ IPCCommandResult CWII_IPC_HLE_Device_FileIO::Write(u32 _CommandAddress)
 	const u32 Address = Memory::Read_U32(_CommandAddress + 0xC); // Write data from this memory address
 	const u32 Size    = Memory::Read_U32(_CommandAddress + 0x10);
 
-	if (auto file = OpenFile())
+	if (OpenFile())
 	{
 		if (m_Mode == ISFS_OPEN_READ)
 		{
@@ -265,8 +336,8 @@ IPCCommandResult CWII_IPC_HLE_Device_FileIO::Write(u32 _CommandAddress)
 		else
 		{
 			INFO_LOG(WII_IPC_FILEIO, "FileIO: Write 0x%04x bytes from 0x%08x to %s", Size, Address, m_Name.c_str());
-			file.Seek(m_SeekPos, SEEK_SET);
-			if (file.WriteBytes(Memory::GetPointer(Address), Size))
+			m_file->Seek(m_SeekPos, SEEK_SET);
+			if (m_file->WriteBytes(Memory::GetPointer(Address), Size))
 			{
 				ReturnValue = Size;
 				m_SeekPos += Size;
@@ -296,9 +367,9 @@ IPCCommandResult CWII_IPC_HLE_Device_FileIO::IOCtl(u32 _CommandAddress)
 	{
 	case ISFS_IOCTL_GETFILESTATS:
 		{
-			if (auto file = OpenFile())
+			if (OpenFile())
 			{
-				u32 m_FileLength = (u32)file.GetSize();
+				u32 m_FileLength = (u32)m_file->GetSize();
 
 				const u32 BufferOut = Memory::Read_U32(_CommandAddress + 0x18);
 				INFO_LOG(WII_IPC_FILEIO, "  File: %s, Length: %i, Pos: %i", m_Name.c_str(), m_FileLength, m_SeekPos);
@@ -333,5 +404,11 @@ void CWII_IPC_HLE_Device_FileIO::DoState(PointerWrap &p)
 	p.Do(m_Mode);
 	p.Do(m_SeekPos);
 
-	m_filepath = HLE_IPC_BuildFilename(m_Name);
+	if (p.GetMode() == PointerWrap::MODE_READ)
+	{
+		// The state may be for another file altogether. The next request
+		// opens whatever it refers to.
+		CloseFile();
+		m_filepath = HLE_IPC_BuildFilename(m_Name);
+	}
 }
@@ -4,11 +4,19 @@
 
 #pragma once
 
+#include <memory>
+#include <string>
+
 #include "Common/FileUtil.h"
 #include "Core/IPC_HLE/WII_IPC_HLE_Device.h"
 
 std::string HLE_IPC_BuildFilename(std::string _pFilename);
 void HLE_IPC_CreateVirtualFATFilesystem();
+// Closes the host handles FileIO descriptors keep open for path (a full host
+// path, as returned by HLE_IPC_BuildFilename) and anything below it. Has to be
+// called before the file is deleted or replaced; the descriptors reopen the
+// file by name on their next request.
+void HLE_IPC_CloseHostFiles(const std::string& path);
 
 class CWII_IPC_HLE_Device_FileIO : public IWII_IPC_HLE_Device
 {
@@ -25,7 +33,10 @@ public:
 	IPCCommandResult IOCtl(u32 _CommandAddress) override;
 	void DoState(PointerWrap &p) override;
 
-	File::IOFile OpenFile();
+	// Opens the host file if this descriptor doesn't have it open yet.
+	// Returns whether it is open.
+	bool OpenFile();
+	void CloseFile();
 
 private:
 	enum
@@ -72,4 +83,5 @@ private:
 	u32 m_SeekPos;
 
 	std::string m_filepath;
+	std::shared_ptr<File::IOFile> m_file;
 };
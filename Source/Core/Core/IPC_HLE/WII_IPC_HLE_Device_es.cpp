@@ -36,6 +36,7 @@
 // need to include this before polarssl/aes.h,
 // otherwise we may not get __STDC_FORMAT_MACROS
 #include <cinttypes>
+#include <vector>
 
 #include <polarssl/aes.h>
 
@@ -50,6 +51,7 @@
 #include "Core/Movie.h"
 #include "Core/VolumeHandler.h"
 #include "Core/Boot/Boot_DOL.h"
+#include "Core/HW/DVDThread.h"
 #include "Core/IPC_HLE/WII_IPC_HLE_Device_es.h"
 #include "Core/IPC_HLE/WII_IPC_HLE_Device_usb.h"
 #include "Core/PowerPC/PowerPC.h"
@@ -114,6 +116,7 @@ void CWII_IPC_HLE_Device_es::OpenInternal()
 	{
 		// blindly grab the titleID from the disc - it's unencrypted at:
 		// offset 0x0F8001DC and 0x0F80044C
+		DVDThread::WaitUntilIdle();
 		VolumeHandler::GetVolume()->GetTitleID((u8*)&m_TitleID);
 		m_TitleID = Common::swap64(m_TitleID);
 	}
@@ -408,8 +411,8 @@ IPCCommandResult CWII_IPC_HLE_Device_es::IOCtlV(u32 _CommandAddress)
 				{
 					if (rContent.m_pContent->m_pData)
 					{
-						u8* pSrc = &rContent.m_pContent->m_pData[rContent.m_Position];
-						memcpy(pDest, pSrc, Size);
+						if (!rContent.m_pContent->m_pData->GetRange(rContent.m_Position, Size, pDest))
+							ERROR_LOG(WII_IPC_ES, "ES: failed to read %u bytes from %u!", Size, rContent.m_Position);
 					}
 					else
 					{
@@ -918,7 +921,8 @@ IPCCommandResult CWII_IPC_HLE_Device_es::IOCtlV(u32 _CommandAddress)
 						std::unique_ptr<CDolLoader> pDolLoader;
 						if (pContent->m_pData)
 						{
-							pDolLoader = std::make_unique<CDolLoader>(pContent->m_pData, pContent->m_Size);
+							std::vector<u8> data = pContent->m_pData->Get();
+							pDolLoader = std::make_unique<CDolLoader>(data.data(), (u32)data.size());
 						}
 						else
 						{
@@ -1093,6 +1097,7 @@ u32 CWII_IPC_HLE_Device_es::ES_DIVerify(u8* _pTMD, u32 _sz)
 {
 	u64 titleID = 0xDEADBEEFDEADBEEFull;
 	u64 tmdTitleID = Common::swap64(*(u64*)(_pTMD+0x18c));
+	DVDThread::WaitUntilIdle();
 	VolumeHandler::GetVolume()->GetTitleID((u8*)&titleID);
 	if (Common::swap64(titleID) != tmdTitleID)
 	{
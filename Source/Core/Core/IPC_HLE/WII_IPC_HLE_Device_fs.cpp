@@ -35,6 +35,7 @@ IPCCommandResult CWII_IPC_HLE_Device_fs::Open(u32 _CommandAddress, u32 _Mode)
 	// clear tmp folder
 	{
 		std::string Path = File::GetUserPath(D_WIIUSER_IDX) + "tmp";
+		HLE_IPC_CloseHostFiles(Path);
 		File::DeleteDirRecursively(Path);
 		File::CreateDir(Path);
 	}
@@ -380,6 +381,7 @@ s32 CWII_IPC_HLE_Device_fs::ExecuteCommand(u32 _Parameter, u32 _BufferIn, u32 _B
 
 			std::string Filename = HLE_IPC_BuildFilename(Memory::GetString(_BufferIn+Offset, 64));
 			Offset += 64;
+			HLE_IPC_CloseHostFiles(Filename);
 			if (File::Delete(Filename))
 			{
 				INFO_LOG(WII_IPC_FILEIO, "FS: DeleteFile %s", Filename.c_str());
@@ -408,6 +410,9 @@ s32 CWII_IPC_HLE_Device_fs::ExecuteCommand(u32 _Parameter, u32 _BufferIn, u32 _B
 			std::string FilenameRename = HLE_IPC_BuildFilename(Memory::GetString(_BufferIn+Offset, 64));
 			Offset += 64;
 
+			HLE_IPC_CloseHostFiles(Filename);
+			HLE_IPC_CloseHostFiles(FilenameRename);
+
 			// try to make the basis directory
 			File::CreateFullPath(FilenameRename);
 
@@ -498,6 +503,7 @@ void CWII_IPC_HLE_Device_fs::DoState(PointerWrap& p)
 	std::string Path = File::GetUserPath(D_WIIUSER_IDX) + "tmp";
 	if (p.GetMode() == PointerWrap::MODE_READ)
 	{
+		HLE_IPC_CloseHostFiles(Path);
 		File::DeleteDirRecursively(Path);
 		File::CreateDir(Path);
 
@@ -0,0 +1,169 @@
+// Copyright 2015 Dolphin Emulator Project
+// Licensed under GPLv2
+// Refer to the license.txt file included.
+
+#include "Common/Atomic.h"
+#include "Core/ConfigManager.h"
+#include "Core/CoreTiming.h"
+#include "Core/HLE/HLE.h"
+#include "Core/PowerPC/CachedInterpreter.h"
+#include "Core/PowerPC/JitInterface.h"
+#include "Core/PowerPC/PowerPC.h"
+#include "Core/PowerPC/PPCTables.h"
+
+void CachedInterpreter::Init()
+{
+	m_code.reserve(CODE_SIZE);
+
+	jo.enableBlocklink = false;
+
+	m_block_cache.Init();
+}
+
+void CachedInterpreter::Shutdown()
+{
+	m_block_cache.Shutdown();
+}
+
+void CachedInterpreter::ClearCache()
+{
+	m_code.clear();
+	m_block_cache.Clear();
+}
+
+void CachedInterpreter::SingleStep()
+{
+	Interpreter::getInstance()->SingleStep();
+}
+
+// The same as the non-debugging loop in Interpreter::Run: the downcount is only
+// checked once the interpreter says a block ended, which needn't be where one
+// of our blocks ends.
+void CachedInterpreter::Run()
+{
+	// Breakpoints and the like are handled by the interpreter's own loop.
+	if (SConfig::GetInstance().m_LocalCoreStartupParameter.bEnableDebugging)
+	{
+		Interpreter::getInstance()->Run();
+		return;
+	}
+
+	while (!PowerPC::GetState())
+	{
+		while (PowerPC::ppcState.downcount > 0)
+		{
+			Interpreter::m_EndBlock = false;
+
+			int cycles = 0;
+			while (!Interpreter::m_EndBlock)
+			{
+				cycles += ExecuteBlock();
+			}
+			PowerPC::ppcState.downcount -= cycles;
+		}
+
+		CoreTiming::Advance();
+
+		if (PowerPC::ppcState.Exceptions)
+		{
+			PowerPC::CheckExceptions();
+			PC = NPC;
+		}
+	}
+}
+
+// Runs the block at PC until it ends, or until an instruction leaves it or ends
+// the interpreter's block. Returns the cycles taken.
+int CachedInterpreter::ExecuteBlock()
+{
+	int block_num = m_block_cache.GetBlockNumberFromStartAddress(PC);
+	if (block_num < 0)
+	{
+		Jit(PC);
+		block_num = m_block_cache.GetBlockNumberFromStartAddress(PC);
+	}
+
+	const Instruction* code = reinterpret_cast<const Instruction*>(m_block_cache.GetCodePointers()[block_num]);
+
+	int cycles = 0;
+	for (;; code++)
+	{
+		if (!code->function)
+			return cycles + Interpreter::getInstance()->SingleStepInner();
+
+		NPC = PC + sizeof(UGeckoInstruction);
+
+		// See Interpreter::SingleStepInner.
+		if (code->uses_fpu && !((UReg_MSR&)MSR).FP)
+		{
+			Common::AtomicOr(PowerPC::ppcState.Exceptions, EXCEPTION_FPU_UNAVAILABLE);
+			PowerPC::CheckExceptions();
+			Interpreter::m_EndBlock = true;
+		}
+		else
+		{
+			code->function(code->inst);
+			if (PowerPC::ppcState.Exceptions & EXCEPTION_DSI)
+			{
+				PowerPC::CheckExceptions();
+				Interpreter::m_EndBlock = true;
+			}
+		}
+
+		PC = NPC;
+		cycles += code->cycles;
+
+		if (code->end || Interpreter::m_EndBlock || PC != code->address + sizeof(UGeckoInstruction))
+			return cycles;
+	}
+}
+
+void CachedInterpreter::Jit(u32 address)
+{
+	if (m_code.size() + MAX_BLOCK_SIZE > CODE_SIZE || m_block_cache.IsFull())
+		ClearCache();
+
+	int block_num = m_block_cache.AllocateBlock(address);
+	JitBlock* b = m_block_cache.GetBlock(block_num);
+
+	size_t start = m_code.size();
+	const bool mmu = SConfig::GetInstance().m_LocalCoreStartupParameter.bMMU;
+
+	for (u32 i = 0; i < MAX_BLOCK_SIZE; i++, address += sizeof(UGeckoInstruction))
+	{
+		// Like the JIT, don't let blocks cross pages that might get remapped.
+		if (mmu && i > 0 && (address & 0xfff) == 0)
+			break;
+
+		// HLE hooks, failed fetches and invalid opcodes need the interpreter's own
+		// handling, which goes in a block of its own.
+		UGeckoInstruction inst = 0;
+		if (HLE::GetFunctionIndex(address) == 0)
+			inst = JitInterface::ReadOpcodeJIT(address);
+		if (inst.hex == 0 || (m_infoTable[inst.OPCD]->type & 0xFFFFFF) == OPTYPE_INVALID)
+		{
+			if (i == 0)
+			{
+				Instruction generic = { nullptr, inst, address, 0, false, true };
+				m_code.push_back(generic);
+			}
+			break;
+		}
+
+		const GekkoOPInfo* opinfo = GetOpInfo(inst);
+		Instruction instruction = { GetInterpreterOp(inst), inst, address, opinfo->numCycles, PPCTables::UsesFPU(inst), false };
+		m_code.push_back(instruction);
+
+		if (opinfo->flags & FL_ENDBLOCK)
+			break;
+	}
+	m_code.back().end = true;
+
+	b->checkedEntry = reinterpret_cast<const u8*>(&m_code[start]);
+	b->normalEntry = b->checkedEntry;
+	b->runCount = 0;
+	b->originalSize = (u32)(m_code.size() - start);
+	b->codeSize = b->originalSize * sizeof(Instruction);
+
+	m_block_cache.FinalizeBlock(block_num, false, b->checkedEntry);
+}
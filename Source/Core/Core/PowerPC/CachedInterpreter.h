@@ -0,0 +1,80 @@
+// Copyright 2015 Dolphin Emulator Project
+// Licensed under GPLv2
+// Refer to the license.txt file included.
+
+#pragma once
+
+#include <vector>
+
+#include "Common/CommonTypes.h"
+
+#include "Core/PowerPC/Gekko.h"
+#include "Core/PowerPC/Interpreter/Interpreter.h"
+#include "Core/PowerPC/JitCommon/JitBase.h"
+#include "Core/PowerPC/JitCommon/JitCache.h"
+
+// The interpreter, but with the instructions of each block fetched and decoded
+// once into a list of handlers. Blocks live in a JitBaseBlockCache, so icbi and
+// the other ways of invalidating JIT code drop them the same way. Timing and
+// exceptions behave as in Interpreter::Run.
+class CachedInterpreter : public JitBase
+{
+public:
+	CachedInterpreter() {}
+	~CachedInterpreter() {}
+
+	void Init() override;
+	void Shutdown() override;
+
+	bool HandleFault(uintptr_t access_address, SContext* ctx) override { return false; }
+
+	void ClearCache() override;
+
+	void Run() override;
+	void SingleStep() override;
+
+	void Jit(u32 address) override;
+
+	JitBaseBlockCache* GetBlockCache() override { return &m_block_cache; }
+
+	const char* GetName() override
+	{
+		return "Cached Interpreter";
+	}
+
+	const CommonAsmRoutinesBase* GetAsmRoutines() override { return nullptr; }
+
+private:
+	struct Instruction
+	{
+		// Null means the instruction has to go through Interpreter::SingleStepInner,
+		// e.g. because there is an HLE hook on it.
+		Interpreter::_interpreterInstruction function;
+		UGeckoInstruction inst;
+		u32 address;
+		int cycles;
+		bool uses_fpu;
+		// Last instruction of the block.
+		bool end;
+	};
+
+	class BlockCache : public JitBaseBlockCache
+	{
+	private:
+		// Blocks are never linked and there's no code to patch.
+		void WriteLinkBlock(u8* location, const u8* address) override {}
+		void WriteDestroyBlock(const u8* location, u32 address) override {}
+	};
+
+	enum
+	{
+		CODE_SIZE = 1024 * 1024,
+		MAX_BLOCK_SIZE = 1024,
+	};
+
+	int ExecuteBlock();
+
+	BlockCache m_block_cache;
+	// Allocated once, so that the blocks can point into it.
+	std::vector<Instruction> m_code;
+};
@@ -4,6 +4,7 @@
 
 #include <map>
 #include <string>
+#include <vector>
 
 // for the PROFILER stuff
 #ifdef _WIN32
@@ -206,10 +207,15 @@ void Jit64::Init()
 	code_block.m_gpa = &js.gpa;
 	code_block.m_fpa = &js.fpa;
 	EnableOptimization();
+
+	const SCoreStartupParameter& startup = SConfig::GetInstance().m_LocalCoreStartupParameter;
+	if (startup.bJITBlockProfile && !js.memcheck && !startup.bEnableDebugging && !startup.bJITNoBlockCache)
+		m_block_profile.Init(startup.GetUniqueID());
 }
 
 void Jit64::ClearCache()
 {
+	RecordHotBlocks();
 	blocks.Clear();
 	trampolines.ClearCodeSpace();
 	farcode.ClearCodeSpace();
@@ -219,6 +225,9 @@ void Jit64::ClearCache()
 
 void Jit64::Shutdown()
 {
+	RecordHotBlocks();
+	m_block_profile.Shutdown();
+
 	FreeStack();
 	FreeCodeSpace();
 
@@ -321,6 +330,23 @@ void Jit64::WriteExit(u32 destination, bool bl, u32 after)
 	if (!m_enable_blr_optimization)
 		bl = false;
 
+	// If the destination has been compiled and takes registers on entry, pass
+	// them on. This is only code for this exit; the caches stay as they were.
+	const JitBlock* linked = nullptr;
+	if (!bl && jo.enableBlocklink)
+	{
+		int block = blocks.GetBlockNumberFromStartAddress(destination);
+		if (block >= 0 && blocks.GetBlock(block)->preloadCheckedEntry)
+			linked = blocks.GetBlock(block);
+	}
+	RegCacheState gpr_state;
+	if (linked)
+	{
+		gpr_state = gpr.GetState();
+		// The entry registers are callee-saved, so they make it through Cleanup.
+		gpr.BindToEntryRegisters(linked->preloadGPRs);
+	}
+
 	Cleanup();
 
 	if (bl)
@@ -331,10 +357,156 @@ void Jit64::WriteExit(u32 destination, bool bl, u32 after)
 
 	SUB(32, PPCSTATE(downcount), Imm32(js.downcountAmount));
 
-	JustWriteExit(destination, bl, after);
+	JustWriteExit(destination, bl, after, linked != nullptr);
+
+	if (linked)
+		gpr.SetState(gpr_state);
+}
+
+bool Jit64::CanBranchWithinBlock(const PPCAnalyst::CodeOp& op)
+{
+	if (op.branchToIndex < 0 || !jo.enableBlocklink)
+		return false;
+
+	// The performance monitor is only updated on exits (see Cleanup).
+	if (MMCR0.Hex || MMCR1.Hex)
+		return false;
+
+	// A loop, or a jump ahead to a label that's still to come.
+	auto it = m_branch_targets.find(op.branchToIndex);
+	if (it != m_branch_targets.end() && it->second.code)
+		return true;
+	return op.branchToIndex > js.instructionNumber;
+}
+
+// Writes the taken path of a branch that stays within the block. The register
+// caches are left as they were, for the path that doesn't branch.
+void Jit64::WriteBranchWithinBlock(const PPCAnalyst::CodeOp& op)
+{
+	RegCacheState gpr_state = gpr.GetState();
+	RegCacheState fpr_state = fpr.GetState();
+
+	BranchTarget& target = m_branch_targets[op.branchToIndex];
+	target.address = op.branchTo;
+	if (target.has_state)
+	{
+		gpr.Reconcile(target.gpr_state);
+		fpr.Reconcile(target.fpr_state);
+	}
+	else
+	{
+		gpr.PrepareJoin(BitSet32(0));
+		fpr.PrepareJoin(BitSet32(0));
+		target.gpr_state = gpr.GetState();
+		target.fpr_state = fpr.GetState();
+		target.has_state = true;
+	}
+
+	if (target.code)
+	{
+		// Back to the top of a loop. Do what going through a block link would:
+		// check the gather pipe, and leave for the timing code when the slice is up.
+		if (jo.optimizeGatherPipe && js.fifoBytesThisBlock > 0)
+		{
+			BitSet32 registersInUse = CallerSavedRegistersInUse();
+			ABI_PushRegistersAndAdjustStack(registersInUse, 0);
+			ABI_CallFunction((void *)&GPFifo::CheckGatherPipe);
+			ABI_PopRegistersAndAdjustStack(registersInUse, 0);
+		}
+		SUB(32, PPCSTATE(downcount), Imm32(js.downcountAmount));
+		J_CC(CC_NBE, target.code);
+
+		gpr.Flush();
+		fpr.Flush();
+		MOV(32, PPCSTATE(pc), Imm32(op.branchTo));
+		JMP(asm_routines.doTiming, true);
+	}
+	else
+	{
+		SUB(32, PPCSTATE(downcount), Imm32(js.downcountAmount));
+		target.pending.push_back(J(true));
+	}
+
+	gpr.SetState(gpr_state);
+	fpr.SetState(fpr_state);
+}
+
+void Jit64::WriteBranchTarget(u32 index)
+{
+	BranchTarget& target = m_branch_targets[index];
+	target.address = js.compilerPC;
+
+	// For a loop, get what it works on into registers before it starts.
+	BitSet32 gprs, fprs;
+	const PPCAnalyst::CodeOp* ops = js.op - index;
+	u32 loop_end = index;
+	for (u32 i = index; i < code_block.m_num_instructions; i++)
+	{
+		if (ops[i].branchToIndex == (int)index)
+			loop_end = i;
+	}
+	for (u32 i = index; i < loop_end; i++)
+	{
+		gprs |= ops[i].regsIn | ops[i].regsOut;
+		fprs |= ops[i].fregsIn;
+		if (ops[i].fregOut >= 0)
+			fprs[ops[i].fregOut] = true;
+	}
+
+	// Charge the cycles so far here, so that the paths jumping in only
+	// have to charge their own.
+	if (js.downcountAmount)
+	{
+		SUB(32, PPCSTATE(downcount), Imm32(js.downcountAmount));
+		js.downcountAmount = 0;
+	}
+
+	if (target.has_state)
+	{
+		gpr.Reconcile(target.gpr_state);
+		fpr.Reconcile(target.fpr_state);
+	}
+	else
+	{
+		gpr.PrepareJoin(gprs);
+		fpr.PrepareJoin(fprs);
+		target.gpr_state = gpr.GetState();
+		target.fpr_state = fpr.GetState();
+		target.has_state = true;
+	}
+
+	for (FixupBranch& branch : target.pending)
+		SetJumpTarget(branch);
+	target.pending.clear();
+	target.code = GetCodePtr();
+
+	// The other paths in may not have checked that the FPU is enabled.
+	js.firstFPInstructionFound = false;
+}
+
+void Jit64::WritePendingBranchTargets()
+{
+	// Labels the block never got to, because HLE replaced the rest of it:
+	// leave the block from there instead.
+	for (auto& entry : m_branch_targets)
+	{
+		BranchTarget& target = entry.second;
+		if (target.code || target.pending.empty())
+			continue;
+
+		for (FixupBranch& branch : target.pending)
+			SetJumpTarget(branch);
+		gpr.SetState(target.gpr_state);
+		fpr.SetState(target.fpr_state);
+		gpr.Flush();
+		fpr.Flush();
+		// Already charged before the jumps.
+		js.downcountAmount = 0;
+		WriteExit(target.address);
+	}
 }
 
-void Jit64::JustWriteExit(u32 destination, bool bl, u32 after)
+void Jit64::JustWriteExit(u32 destination, bool bl, u32 after, bool preloaded)
 {
 	//If nobody has taken care of this yet (this can be removed when all branches are done)
 	JitBlock *b = js.curBlock;
@@ -348,7 +520,7 @@ void Jit64::JustWriteExit(u32 destination, bool bl, u32 after)
 	{
 		// It exists! Joy of joy!
 		JitBlock* jb = blocks.GetBlock(block);
-		const u8* addr = jb->checkedEntry;
+		const u8* addr = preloaded ? jb->preloadCheckedEntry : jb->checkedEntry;
 		linkData.exitPtrs = GetWritableCodePtr();
 		if (bl)
 			CALL(addr);
@@ -522,6 +694,8 @@ void Jit64::Jit(u32 em_address)
 				analyzer.ClearOption(PPCAnalyst::PPCAnalyzer::OPTION_CONDITIONAL_CONTINUE);
 				analyzer.ClearOption(PPCAnalyst::PPCAnalyzer::OPTION_BRANCH_MERGE);
 				analyzer.ClearOption(PPCAnalyst::PPCAnalyzer::OPTION_CARRY_MERGE);
+				analyzer.ClearOption(PPCAnalyst::PPCAnalyzer::OPTION_COMPLEX_BLOCK);
+				analyzer.ClearOption(PPCAnalyst::PPCAnalyzer::OPTION_FORWARD_JUMP);
 			}
 			Trace();
 		}
@@ -543,6 +717,90 @@ void Jit64::Jit(u32 em_address)
 	int block_num = blocks.AllocateBlock(em_address);
 	JitBlock *b = blocks.GetBlock(block_num);
 	blocks.FinalizeBlock(block_num, jo.enableBlocklink, DoJit(em_address, &code_buffer, b, nextPC));
+
+	if (m_block_profile.IsActive())
+	{
+		m_block_profile.BlockCompiled(em_address, b->originalSize);
+		if (m_block_profile.HasPendingBlocks())
+			PrecompileProfiledBlocks();
+	}
+}
+
+// Adds the blocks that ran often enough to the profile, before the cache
+// forgets how often they ran.
+void Jit64::RecordHotBlocks()
+{
+	if (!m_block_profile.IsActive())
+		return;
+
+	for (int i = 0; i < blocks.GetNumBlocks(); i++)
+	{
+		const JitBlock* b = blocks.GetBlock(i);
+		if (!b->invalid && b->runCount >= JitBlockProfile::HOT_BLOCK_RUNS)
+			m_block_profile.RecordBlock(b->originalAddress);
+	}
+}
+
+// Compiles blocks that were hot in a previous session, a few at a time on
+// each block miss, as soon as their code shows up in memory unchanged.
+void Jit64::PrecompileProfiledBlocks()
+{
+	const u32 CHECKS_PER_MISS = 32;
+
+	std::vector<u32> addresses;
+	m_block_profile.TakeValidBlocks(CHECKS_PER_MISS, &addresses);
+	if (addresses.empty())
+		return;
+
+	// The profile validated the code in RAM, so read it from there. Going
+	// through the emulated icache would fill it with lines the game hasn't
+	// fetched yet.
+	UReg_HID0 old_hid0 = HID0;
+	HID0.ICE = 0;
+
+	for (u32 address : addresses)
+	{
+		if (GetSpaceLeft() < 0x10000 ||
+		    farcode.GetSpaceLeft() < 0x10000 ||
+		    trampolines.GetSpaceLeft() < 0x10000 ||
+		    blocks.IsFull() ||
+		    m_clear_cache_asap)
+		{
+			break;
+		}
+
+		if (blocks.GetBlockNumberFromStartAddress(address) >= 0)
+			continue;
+
+		u32 nextPC = analyzer.Analyze(address, &code_block, &code_buffer, code_buffer.GetSize());
+		if (code_block.m_memory_exception)
+			continue;
+
+		int block_num = blocks.AllocateBlock(address);
+		JitBlock *b = blocks.GetBlock(block_num);
+		blocks.FinalizeBlock(block_num, jo.enableBlocklink, DoJit(address, &code_buffer, b, nextPC));
+	}
+
+	HID0 = old_hid0;
+}
+
+// The first registers a block reads before writing them, if it reads them soon
+// enough to be worth loading up front.
+static BitSet32 FindEntryRegisters(const PPCAnalyst::CodeBlock& code_block, const PPCAnalyst::CodeOp* ops)
+{
+	const u32 LOOKAHEAD = 8;
+
+	BitSet32 entry, written;
+	for (u32 i = 0; i < code_block.m_num_instructions && i < LOOKAHEAD; i++)
+	{
+		for (int reg : ops[i].regsIn & ~written)
+		{
+			if (entry.Count() < RegCache::MAX_ENTRY_REGISTERS)
+				entry[reg] = true;
+		}
+		written |= ops[i].regsOut;
+	}
+	return entry;
 }
 
 const u8* Jit64::DoJit(u32 em_address, PPCAnalyst::CodeBuffer *code_buf, JitBlock *b, u32 nextPC)
@@ -552,6 +810,7 @@ const u8* Jit64::DoJit(u32 em_address, PPCAnalyst::CodeBuffer *code_buf, JitBloc
 	js.blockStart = em_address;
 	js.fifoBytesThisBlock = 0;
 	js.curBlock = b;
+	m_branch_targets.clear();
 	jit->js.numLoadStoreInst = 0;
 	jit->js.numFloatingPointInst = 0;
 
@@ -561,10 +820,29 @@ const u8* Jit64::DoJit(u32 em_address, PPCAnalyst::CodeBuffer *code_buf, JitBloc
 	b->checkedEntry = start;
 	b->runCount = 0;
 
+	// Registers passed in by the blocks that link here; the debugging aids
+	// below go in front of the loads, so don't bother with them.
+	BitSet32 entry_gprs;
+	if (!ImHereDebug && !Profiler::g_ProfileBlocks && jo.enableBlocklink)
+		entry_gprs = FindEntryRegisters(code_block, ops);
+	b->preloadGPRs = entry_gprs;
+
 	// Downcount flag check. The last block decremented downcounter, and the flag should still be available.
 	FixupBranch skip = J_CC(CC_NBE);
 	MOV(32, PPCSTATE(pc), Imm32(js.blockStart));
 	JMP(asm_routines.doTiming, true);  // downcount hit zero - go doTiming.
+
+	// The same check for exits that loaded the entry registers themselves.
+	// JitBlockCache::DestroyBlock overwrites it like the one above.
+	FixupBranch skip_preloaded;
+	b->preloadCheckedEntry = nullptr;
+	if (entry_gprs)
+	{
+		b->preloadCheckedEntry = GetCodePtr();
+		skip_preloaded = J_CC(CC_NBE, true);
+		MOV(32, PPCSTATE(pc), Imm32(js.blockStart));
+		JMP(asm_routines.doTiming, true);
+	}
 	SetJumpTarget(skip);
 
 	const u8 *normalEntry = GetCodePtr();
@@ -597,6 +875,19 @@ const u8* Jit64::DoJit(u32 em_address, PPCAnalyst::CodeBuffer *code_buf, JitBloc
 	// They use the information in gpa/fpa to preload commonly used registers.
 	gpr.Start();
 	fpr.Start();
+	if (entry_gprs)
+	{
+		gpr.BindToEntryRegisters(entry_gprs);
+		SetJumpTarget(skip_preloaded);
+	}
+
+	// The block profile only keeps blocks that run often; count the runs, unless
+	// the profiling code above already does.
+	if (m_block_profile.IsActive() && !Profiler::g_ProfileBlocks)
+	{
+		MOV(64, R(RSCRATCH), Imm64((u64)&b->runCount));
+		ADD(32, MatR(RSCRATCH), Imm8(1));
+	}
 
 	js.downcountAmount = 0;
 	if (!SConfig::GetInstance().m_LocalCoreStartupParameter.bEnableDebugging)
@@ -613,6 +904,10 @@ const u8* Jit64::DoJit(u32 em_address, PPCAnalyst::CodeBuffer *code_buf, JitBloc
 		js.instructionNumber = i;
 		js.instructionsLeft = (code_block.m_num_instructions - 1) - i;
 		const GekkoOPInfo *opinfo = ops[i].opinfo;
+
+		if (ops[i].isBranchTarget)
+			WriteBranchTarget(i);
+
 		js.downcountAmount += opinfo->numCycles;
 		js.fastmemLoadStore = NULL;
 		js.fixupExceptionHandler = false;
@@ -642,6 +937,9 @@ const u8* Jit64::DoJit(u32 em_address, PPCAnalyst::CodeBuffer *code_buf, JitBloc
 			js.next_compilerPC = ops[i + 1].address;
 			js.next_op = &ops[i + 1];
 			js.next_inst_bp = SConfig::GetInstance().m_LocalCoreStartupParameter.bEnableDebugging && breakpoints.IsAddressBreakPoint(ops[i + 1].address);
+			// A label goes in between, so don't merge with it.
+			if (ops[i + 1].isBranchTarget)
+				js.next_inst = 0;
 		}
 
 		if (jo.optimizeGatherPipe && js.fifoBytesThisBlock >= 32)
@@ -806,11 +1104,15 @@ const u8* Jit64::DoJit(u32 em_address, PPCAnalyst::CodeBuffer *code_buf, JitBloc
 				SwitchToNearCode();
 			}
 
-			// If we have a register that will never be used again, flush it.
-			for (int j : ~ops[i].gprInUse)
-				gpr.StoreFromRegister(j);
-			for (int j : ~ops[i].fprInUse)
-				fpr.StoreFromRegister(j);
+			// If we have a register that will never be used again, flush it. The last
+			// instruction has either exited already or leaves it to the flush below.
+			if (!js.isLastInstruction)
+			{
+				for (int j : ~ops[i].gprInUse)
+					gpr.StoreFromRegister(j);
+				for (int j : ~ops[i].fprInUse)
+					fpr.StoreFromRegister(j);
+			}
 
 			if (opinfo->flags & FL_LOADSTORE)
 				++jit->js.numLoadStoreInst;
@@ -850,11 +1152,13 @@ const u8* Jit64::DoJit(u32 em_address, PPCAnalyst::CodeBuffer *code_buf, JitBloc
 
 	if (code_block.m_broken)
 	{
-		gpr.Flush();
+		gpr.Flush(FLUSH_KEEP_REGISTERS);
 		fpr.Flush();
 		WriteExit(nextPC);
 	}
 
+	WritePendingBranchTargets();
+
 	b->codeSize = (u32)(GetCodePtr() - normalEntry);
 	b->originalSize = code_block.m_num_instructions;
 
@@ -890,4 +1194,6 @@ void Jit64::EnableOptimization()
 	analyzer.SetOption(PPCAnalyst::PPCAnalyzer::OPTION_CONDITIONAL_CONTINUE);
 	analyzer.SetOption(PPCAnalyst::PPCAnalyzer::OPTION_BRANCH_MERGE);
 	analyzer.SetOption(PPCAnalyst::PPCAnalyzer::OPTION_CARRY_MERGE);
+	analyzer.SetOption(PPCAnalyst::PPCAnalyzer::OPTION_COMPLEX_BLOCK);
+	analyzer.SetOption(PPCAnalyst::PPCAnalyzer::OPTION_FORWARD_JUMP);
 }
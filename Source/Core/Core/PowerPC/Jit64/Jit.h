@@ -18,6 +18,9 @@
 // ----------
 #pragma once
 
+#include <map>
+#include <vector>
+
 #include "Common/x64ABI.h"
 #include "Common/x64Analyzer.h"
 #include "Common/x64Emitter.h"
@@ -35,6 +38,7 @@
 #include "Core/PowerPC/JitCommon/Jit_Util.h"
 #include "Core/PowerPC/JitCommon/JitBase.h"
 #include "Core/PowerPC/JitCommon/JitCache.h"
+#include "Core/PowerPC/JitCommon/JitProfile.h"
 
 class Jit64 : public Jitx86Base
 {
@@ -54,6 +58,29 @@ private:
 	bool m_clear_cache_asap;
 	u8* m_stack;
 
+	JitBlockProfile m_block_profile;
+	void PrecompileProfiledBlocks();
+	void RecordHotBlocks();
+
+	// Labels for the branches that stay within the block being compiled, by the
+	// index of the instruction they land on. The first path to get to a label
+	// decides the register cache state there, the others reconcile with it.
+	struct BranchTarget
+	{
+		u32 address;
+		// Where the label is, once it has been written.
+		const u8* code;
+		bool has_state;
+		RegCacheState gpr_state;
+		RegCacheState fpr_state;
+		// Forward branches waiting for the label.
+		std::vector<Gen::FixupBranch> pending;
+	};
+	std::map<u32, BranchTarget> m_branch_targets;
+
+	void WriteBranchTarget(u32 index);
+	void WritePendingBranchTargets();
+
 public:
 	Jit64() : code_buffer(32000) {}
 	~Jit64() {}
@@ -103,7 +130,9 @@ public:
 	// Utilities for use by opcodes
 
 	void WriteExit(u32 destination, bool bl = false, u32 after = 0);
-	void JustWriteExit(u32 destination, bool bl, u32 after);
+	bool CanBranchWithinBlock(const PPCAnalyst::CodeOp& op);
+	void WriteBranchWithinBlock(const PPCAnalyst::CodeOp& op);
+	void JustWriteExit(u32 destination, bool bl, u32 after, bool preloaded = false);
 	void WriteExitDestInRSCRATCH(bool bl = false, u32 after = 0);
 	void WriteBLRExit();
 	void WriteExceptionExit();
@@ -102,33 +102,33 @@ BitSet32 GPRRegCache::GetRegUtilization()
 
 BitSet32 FPURegCache::GetRegUtilization()
 {
-	return jit->js.op->gprInReg;
+	return jit->js.op->fprInXmm;
 }
 
-BitSet32 GPRRegCache::CountRegsIn(size_t preg, u32 lookahead)
+u32 GPRRegCache::NextUse(size_t preg, u32 lookahead)
 {
-	BitSet32 regsUsed;
-	for (u32 i = 1; i < lookahead; i++)
+	for (u32 i = 1; i <= lookahead; i++)
 	{
-		BitSet32 regsIn = jit->js.op[i].regsIn;
-		regsUsed |= regsIn;
-		if (regsIn[preg])
-			return regsUsed;
+		const PPCAnalyst::CodeOp& op = jit->js.op[i];
+		if (op.regsIn[preg])
+			return i;
+		if (op.regsOut[preg])
+			break;
 	}
-	return regsUsed;
+	return 0;
 }
 
-BitSet32 FPURegCache::CountRegsIn(size_t preg, u32 lookahead)
+u32 FPURegCache::NextUse(size_t preg, u32 lookahead)
 {
-	BitSet32 regsUsed;
-	for (u32 i = 1; i < lookahead; i++)
+	for (u32 i = 1; i <= lookahead; i++)
 	{
-		BitSet32 regsIn = jit->js.op[i].fregsIn;
-		regsUsed |= regsIn;
-		if (regsIn[preg])
-			return regsUsed;
+		const PPCAnalyst::CodeOp& op = jit->js.op[i];
+		if (op.fregsIn[preg])
+			return i;
+		if (op.fregOut == (s8)preg)
+			break;
 	}
-	return regsUsed;
+	return 0;
 }
 
 // Estimate roughly how bad it would be to de-allocate this register. Higher score
@@ -145,19 +145,16 @@ float RegCache::ScoreRegister(X64Reg xr)
 	if (xregs[xr].dirty)
 		score += 2;
 
-	// If the register isn't actually needed in a physical register for a later instruction,
-	// writing it back to the register file isn't quite as bad.
+	// Otherwise, evict the register that is read again furthest away, as long as
+	// it's read again at all before it gets overwritten.
 	if (GetRegUtilization()[preg])
 	{
 		// Don't look too far ahead; we don't want to have quadratic compilation times for
 		// enormous block sizes!
-		// This actually improves register allocation a tiny bit; I'm not sure why.
 		u32 lookahead = std::min(jit->js.instructionsLeft, 64);
-		// Count how many other registers are going to be used before we need this one again.
-		u32 regs_in_count = CountRegsIn(preg, lookahead).Count();
-		// Totally ad-hoc heuristic to bias based on how many other registers we'll need
-		// before this one gets used again.
-		score += 1 + 2 * (5 - log2f(1 + (float)regs_in_count));
+		u32 distance = NextUse(preg, lookahead);
+		if (distance)
+			score += 1 + 2 * (6 - log2f((float)distance));
 	}
 
 	return score;
@@ -360,6 +357,10 @@ void RegCache::StoreFromRegister(size_t i, FlushMode mode)
 				xregs[xr].ppcReg = INVALID_REG;
 				xregs[xr].dirty = false;
 			}
+			else if (mode == FLUSH_KEEP_REGISTERS)
+			{
+				xregs[xr].dirty = false;
+			}
 		}
 		else
 		{
@@ -369,7 +370,7 @@ void RegCache::StoreFromRegister(size_t i, FlushMode mode)
 		OpArg newLoc = GetDefaultLocation(i);
 		if (doStore)
 			StoreRegister(i, newLoc);
-		if (mode == FLUSH_ALL)
+		if (mode == FLUSH_ALL || (mode == FLUSH_KEEP_REGISTERS && regs[i].location.IsImm()))
 		{
 			regs[i].location = newLoc;
 			regs[i].away = false;
@@ -430,6 +431,133 @@ void RegCache::Flush(FlushMode mode, BitSet32 regsToFlush)
 	}
 }
 
+RegCacheState RegCache::GetState() const
+{
+	RegCacheState state;
+	state.regs = regs;
+	state.xregs = xregs;
+	return state;
+}
+
+void RegCache::SetState(const RegCacheState& state)
+{
+	regs = state.regs;
+	xregs = state.xregs;
+}
+
+void RegCache::PrepareJoin(BitSet32 preload)
+{
+	// Keep a couple of registers for the instructions themselves.
+	const int MIN_FREE_REGISTERS = 3;
+
+	for (size_t i = 0; i < regs.size(); i++)
+	{
+		if (regs[i].away && regs[i].location.IsImm())
+		{
+			if (preload[i] && NumFreeRegisters() > MIN_FREE_REGISTERS)
+				BindToRegister(i, true, true);
+			else
+				StoreFromRegister(i);
+		}
+	}
+
+	for (int i : preload)
+	{
+		if (NumFreeRegisters() <= MIN_FREE_REGISTERS)
+			break;
+		if (!regs[i].away)
+			BindToRegister(i, true, false);
+	}
+
+	// Other paths may have changed them.
+	for (auto& xreg : xregs)
+	{
+		if (!xreg.free)
+			xreg.dirty = true;
+	}
+}
+
+void RegCache::Reconcile(const RegCacheState& state)
+{
+	// Write back everything that isn't where the join point wants it. Immediates
+	// the join point has in a register are loaded right into it below.
+	for (size_t i = 0; i < regs.size(); i++)
+	{
+		if (!regs[i].away)
+			continue;
+
+		const PPCCachedReg& target = state.regs[i];
+		if (target.away && (regs[i].location.IsImm() || regs[i].location.IsSimpleReg(target.location.GetSimpleReg())))
+			continue;
+
+		StoreFromRegister(i);
+	}
+
+	for (size_t i = 0; i < regs.size(); i++)
+	{
+		const PPCCachedReg& target = state.regs[i];
+		if (!target.away)
+			continue;
+
+		X64Reg xr = target.location.GetSimpleReg();
+		if (!IsBound(i))
+		{
+			_assert_msg_(DYNA_REC, xregs[xr].free, "Reconcile: x64 reg %i is still in use", xr);
+			LoadRegister(i, xr);
+			xregs[xr].free = false;
+			xregs[xr].ppcReg = i;
+			xregs[xr].dirty = true;
+			regs[i].away = true;
+			regs[i].location = ::Gen::R(xr);
+		}
+
+		if (xregs[xr].dirty && !state.xregs[xr].dirty)
+			StoreFromRegister(i, FLUSH_MAINTAIN_STATE);
+		xregs[xr].dirty = state.xregs[xr].dirty;
+	}
+}
+
+void RegCache::BindToEntryRegisters(BitSet32 entry)
+{
+	size_t aCount;
+	const int* aOrder = GetAllocationOrder(aCount);
+	_assert_msg_(DYNA_REC, entry.Count() <= MAX_ENTRY_REGISTERS, "Too many entry registers");
+
+	for (size_t i = 0; i < regs.size(); i++)
+	{
+		if (entry[i] && IsBound(i))
+		{
+			StoreFromRegister(i, FLUSH_MAINTAIN_STATE);
+			xregs[RX(i)].dirty = false;
+		}
+		else
+		{
+			StoreFromRegister(i);
+		}
+	}
+
+	// Everything is in the register file now, so whatever is in the way can
+	// just be dropped.
+	size_t n = 0;
+	for (int i : entry)
+	{
+		X64Reg xr = (X64Reg)aOrder[n++];
+		if (IsBound(i) && RX(i) == xr)
+			continue;
+
+		if (!xregs[xr].free)
+			DiscardRegContentsIfCached(xregs[xr].ppcReg);
+
+		LoadRegister(i, xr);
+		DiscardRegContentsIfCached(i);
+		xregs[xr].free = false;
+		xregs[xr].ppcReg = i;
+		xregs[xr].dirty = false;
+		regs[i].away = true;
+		regs[i].location = ::Gen::R(xr);
+	}
+}
+
 int RegCache::NumFreeRegisters()
 {
 	int count = 0;
@@ -14,6 +14,9 @@ enum FlushMode
 {
 	FLUSH_ALL,
 	FLUSH_MAINTAIN_STATE,
+	// Writes everything back, but leaves the host registers bound (and clean), for
+	// an exit that may hand them to the next block. Immediates are dropped.
+	FLUSH_KEEP_REGISTERS,
 };
 
 struct PPCCachedReg
@@ -36,6 +39,14 @@ typedef int PReg;
 
 #define NUMXREGS 16
 
+// Where every guest register lives at some point of a block; see
+// RegCache::PrepareJoin.
+struct RegCacheState
+{
+	std::array<PPCCachedReg, 32> regs;
+	std::array<X64CachedReg, NUMXREGS> xregs;
+};
+
 class RegCache
 {
 protected:
@@ -45,7 +56,9 @@ protected:
 	virtual const int *GetAllocationOrder(size_t& count) = 0;
 
 	virtual BitSet32 GetRegUtilization() = 0;
-	virtual BitSet32 CountRegsIn(size_t preg, u32 lookahead) = 0;
+	// How many instructions ahead preg is read next, or 0 if it isn't read within
+	// lookahead or gets overwritten first.
+	virtual u32 NextUse(size_t preg, u32 lookahead) = 0;
 
 	Gen::XEmitter *emit;
 
@@ -83,6 +96,25 @@ public:
 
 	void Flush(FlushMode mode = FLUSH_ALL, BitSet32 regsToFlush = BitSet32::AllTrue(32));
 	void Flush(PPCAnalyst::CodeOp *op) {Flush();}
+
+	// Branches within a block. Every path into a join point must arrive with the
+	// cache in the same state. PrepareJoin turns the current state into one that
+	// can be used for that: immediates are loaded into (if in preload) or written
+	// back from registers, registers in preload are bound while that leaves a few
+	// free, and all bound registers are treated as dirty. Reconcile emits the code
+	// that takes the current state to such a join state.
+	RegCacheState GetState() const;
+	void SetState(const RegCacheState& state);
+	void PrepareJoin(BitSet32 preload);
+	void Reconcile(const RegCacheState& state);
+
+	// Linked blocks. A block can take the first registers it reads in host
+	// registers: the n-th register of the set in the n-th register of the
+	// allocation order, clean. This writes back everything else and moves the
+	// set there. At most MAX_ENTRY_REGISTERS, which all are callee-saved.
+	enum { MAX_ENTRY_REGISTERS = 4 };
+	void BindToEntryRegisters(BitSet32 entry);
+
 	int SanityCheck() const;
 	void KillImmediate(size_t preg, bool doLoad, bool makeDirty);
 
@@ -138,7 +170,7 @@ public:
 	const int* GetAllocationOrder(size_t& count) override;
 	void SetImmediate32(size_t preg, u32 immValue);
 	BitSet32 GetRegUtilization() override;
-	BitSet32 CountRegsIn(size_t preg, u32 lookahead) override;
+	u32 NextUse(size_t preg, u32 lookahead) override;
 };
 
 
@@ -150,5 +182,5 @@ public:
 	const int* GetAllocationOrder(size_t& count) override;
 	Gen::OpArg GetDefaultLocation(size_t reg) const override;
 	BitSet32 GetRegUtilization() override;
-	BitSet32 CountRegsIn(size_t preg, u32 lookahead) override;
+	u32 NextUse(size_t preg, u32 lookahead) override;
 };
@@ -72,9 +72,6 @@ void Jit64::bx(UGeckoInstruction inst)
 		return;
 	}
 
-	gpr.Flush();
-	fpr.Flush();
-
 	u32 destination;
 	if (inst.AA)
 		destination = SignExt26(inst.LI << 2);
@@ -92,6 +89,17 @@ void Jit64::bx(UGeckoInstruction inst)
 		// make idle loops go faster
 		js.downcountAmount += 8;
 	}
+
+	if (CanBranchWithinBlock(*js.op))
+	{
+		WriteBranchWithinBlock(*js.op);
+		return;
+	}
+
+	// This ends the block, so the registers can stay where they are for the
+	// next one; see WriteExit.
+	gpr.Flush(FLUSH_KEEP_REGISTERS);
+	fpr.Flush();
 	WriteExit(destination, inst.LK, js.compilerPC + 4);
 }
 
@@ -131,9 +139,16 @@ void Jit64::bcx(UGeckoInstruction inst)
 	else
 		destination = js.compilerPC + SignExt16(inst.BD << 2);
 
-	gpr.Flush(FLUSH_MAINTAIN_STATE);
-	fpr.Flush(FLUSH_MAINTAIN_STATE);
-	WriteExit(destination, inst.LK, js.compilerPC + 4);
+	if (CanBranchWithinBlock(*js.op))
+	{
+		WriteBranchWithinBlock(*js.op);
+	}
+	else
+	{
+		gpr.Flush(FLUSH_MAINTAIN_STATE);
+		fpr.Flush(FLUSH_MAINTAIN_STATE);
+		WriteExit(destination, inst.LK, js.compilerPC + 4);
+	}
 
 	if ((inst.BO & BO_DONT_CHECK_CONDITION) == 0)
 		SetJumpTarget( pConditionDontBranch );
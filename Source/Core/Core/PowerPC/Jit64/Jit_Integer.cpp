@@ -397,10 +397,16 @@ void Jit64::DoMergedBranchCondition()
 	else  // SO bit, do not branch (we don't emulate SO for cmp).
 		pDontBranch = J(true);
 
-	gpr.Flush(FLUSH_MAINTAIN_STATE);
-	fpr.Flush(FLUSH_MAINTAIN_STATE);
-
-	DoMergedBranch();
+	if (js.next_inst.OPCD == 16 && CanBranchWithinBlock(*js.next_op))
+	{
+		WriteBranchWithinBlock(*js.next_op);
+	}
+	else
+	{
+		gpr.Flush(FLUSH_MAINTAIN_STATE);
+		fpr.Flush(FLUSH_MAINTAIN_STATE);
+		DoMergedBranch();
+	}
 
 	SetJumpTarget(pDontBranch);
 
@@ -431,7 +437,11 @@ void Jit64::DoMergedBranchImmediate(s64 val)
 	else  // SO bit, do not branch (we don't emulate SO for cmp).
 		branch = false;
 
-	if (branch)
+	if (branch && js.next_inst.OPCD == 16 && CanBranchWithinBlock(*js.next_op))
+	{
+		WriteBranchWithinBlock(*js.next_op);
+	}
+	else if (branch)
 	{
 		gpr.Flush();
 		fpr.Flush();
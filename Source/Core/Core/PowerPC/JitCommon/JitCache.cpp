@@ -9,6 +9,8 @@
 // performance hit, it's not enabled by default, but it's useful for
 // locating performance issues.
 
+#include <algorithm>
+
 #include "disasm.h"
 
 #include "Common/CommonTypes.h"
@@ -41,6 +43,7 @@ using namespace Gen;
 		iCache.fill(JIT_ICACHE_INVALID_BYTE);
 		iCacheEx.fill(JIT_ICACHE_INVALID_BYTE);
 		iCacheVMEM.fill(JIT_ICACHE_INVALID_BYTE);
+		block_range_map.resize(BLOCK_RANGE_BUCKETS);
 		Clear();
 
 		m_initialized = true;
@@ -70,7 +73,6 @@ using namespace Gen;
 			DestroyBlock(i, false);
 		}
 		links_to.clear();
-		block_map.clear();
 
 		valid_block.ClearAll();
 
@@ -111,6 +113,8 @@ using namespace Gen;
 		JitBlock &b = blocks[num_blocks];
 		b.invalid = false;
 		b.originalAddress = em_address;
+		b.preloadCheckedEntry = nullptr;
+		b.preloadGPRs = BitSet32(0);
 		b.linkData.clear();
 		num_blocks++; //commit the current block
 		return num_blocks - 1;
@@ -129,13 +133,13 @@ using namespace Gen;
 		for (u32 block = pAddr / 32; block <= (pAddr + (b.originalSize - 1) * 4) / 32; ++block)
 			valid_block.Set(block);
 
-		block_map[std::make_pair(pAddr + 4 * b.originalSize - 1, pAddr)] = block_num;
+		AddBlockToRangeMap(block_num);
 
 		if (block_link)
 		{
 			for (const auto& e : b.linkData)
 			{
-				links_to.insert(std::pair<u32, int>(e.exitAddress, block_num));
+				links_to[e.exitAddress].push_back(block_num);
 			}
 
 			LinkBlock(block_num);
@@ -146,6 +150,32 @@ using namespace Gen;
 			"JIT_PPC", b.originalAddress);
 	}
 
+	void JitBaseBlockCache::AddBlockToRangeMap(int block_num)
+	{
+		const JitBlock &b = blocks[block_num];
+		u32 start = b.originalAddress & 0x1FFFFFFF;
+		u32 end = start + 4 * b.originalSize - 1;
+		for (u32 bucket = start >> BLOCK_RANGE_SHIFT; bucket <= end >> BLOCK_RANGE_SHIFT; ++bucket)
+			block_range_map[bucket].push_back(block_num);
+	}
+
+	void JitBaseBlockCache::RemoveBlockFromRangeMap(int block_num)
+	{
+		const JitBlock &b = blocks[block_num];
+		u32 start = b.originalAddress & 0x1FFFFFFF;
+		u32 end = start + 4 * b.originalSize - 1;
+		for (u32 bucket = start >> BLOCK_RANGE_SHIFT; bucket <= end >> BLOCK_RANGE_SHIFT; ++bucket)
+		{
+			std::vector<int>& v = block_range_map[bucket];
+			auto it = std::find(v.begin(), v.end(), block_num);
+			if (it != v.end())
+			{
+				*it = v.back();
+				v.pop_back();
+			}
+		}
+	}
+
 	const u8 **JitBaseBlockCache::GetCodePointers()
 	{
 		return blockCodePointers.data();
@@ -213,38 +243,43 @@ using namespace Gen;
 	{
 		LinkBlockExits(i);
 		JitBlock &b = blocks[i];
-		// equal_range(b) returns pair<iterator,iterator> representing the range
-		// of element with key b
-		auto ppp = links_to.equal_range(b.originalAddress);
-
-		if (ppp.first == ppp.second)
+		auto it = links_to.find(b.originalAddress);
+		if (it == links_to.end())
 			return;
 
-		for (auto iter = ppp.first; iter != ppp.second; ++iter)
+		for (int source : it->second)
 		{
-			// PanicAlert("Linking block %i to block %i", iter->second, i);
-			LinkBlockExits(iter->second);
+			// PanicAlert("Linking block %i to block %i", source, i);
+			LinkBlockExits(source);
 		}
 	}
 
 	void JitBaseBlockCache::UnlinkBlock(int i)
 	{
 		JitBlock &b = blocks[i];
-		auto ppp = links_to.equal_range(b.originalAddress);
-
-		if (ppp.first == ppp.second)
+		auto it = links_to.find(b.originalAddress);
+		if (it == links_to.end())
 			return;
 
-		for (auto iter = ppp.first; iter != ppp.second; ++iter)
+		// Keep the live sources around so that they get relinked if this address
+		// is compiled again; only drop the ones that have been destroyed.
+		std::vector<int>& sources = it->second;
+		sources.erase(std::remove_if(sources.begin(), sources.end(), [this](int source) {
+			return blocks[source].invalid;
+		}), sources.end());
+
+		for (int source : sources)
 		{
-			JitBlock &sourceBlock = blocks[iter->second];
+			JitBlock &sourceBlock = blocks[source];
 			for (auto& e : sourceBlock.linkData)
 			{
 				if (e.exitAddress == b.originalAddress)
 					e.linkStatus = false;
 			}
 		}
-		links_to.erase(b.originalAddress);
+
+		if (sources.empty())
+			links_to.erase(it);
 	}
 
 	void JitBaseBlockCache::DestroyBlock(int block_num, bool invalidate)
@@ -264,12 +299,16 @@ using namespace Gen;
 		b.invalid = true;
 		*GetICachePtr(b.originalAddress) = JIT_ICACHE_INVALID_WORD;
 
+		RemoveBlockFromRangeMap(block_num);
 		UnlinkBlock(block_num);
 
 		// Send anyone who tries to run this block back to the dispatcher.
 		// Not entirely ideal, but .. pretty good.
 		// Spurious entrances from previously linked blocks can only come through checkedEntry
+		// or preloadCheckedEntry
 		WriteDestroyBlock(b.checkedEntry, b.originalAddress);
+		if (b.preloadCheckedEntry)
+			WriteDestroyBlock(b.preloadCheckedEntry, b.originalAddress);
 	}
 
 	void JitBaseBlockCache::InvalidateICache(u32 address, const u32 length, bool forced)
@@ -288,20 +327,24 @@ using namespace Gen;
 		}
 
 		// destroy JIT blocks
-		// !! this works correctly under assumption that any two overlapping blocks end at the same address
-		if (destroy_block)
+		if (destroy_block && length != 0)
 		{
-			std::map<std::pair<u32,u32>, u32>::iterator it1 = block_map.lower_bound(std::make_pair(pAddr, 0)), it2 = it1;
-			while (it2 != block_map.end() && it2->first.second < pAddr + length)
+			u64 range_end = std::min<u64>((u64)pAddr + length, 0x20000000);
+			u32 last_bucket = (u32)((range_end - 1) >> BLOCK_RANGE_SHIFT);
+			for (u32 bucket = pAddr >> BLOCK_RANGE_SHIFT; bucket <= last_bucket; ++bucket)
 			{
-				JitBlock &b = blocks[it2->second];
-				*GetICachePtr(b.originalAddress) = JIT_ICACHE_INVALID_WORD;
-				DestroyBlock(it2->second, true);
-				++it2;
-			}
-			if (it1 != it2)
-			{
-				block_map.erase(it1, it2);
+				std::vector<int>& v = block_range_map[bucket];
+				for (size_t i = 0; i < v.size();)
+				{
+					const JitBlock &b = blocks[v[i]];
+					u32 start = b.originalAddress & 0x1FFFFFFF;
+					u64 end = (u64)start + 4 * b.originalSize;
+					// DestroyBlock swaps the last entry of the bucket into slot i.
+					if (start < range_end && end > pAddr)
+						DestroyBlock(v[i], true);
+					else
+						++i;
+				}
 			}
 
 			// If the code was actually modified, we need to clear the relevant entries from the
@@ -6,8 +6,8 @@
 
 #include <array>
 #include <bitset>
-#include <map>
 #include <memory>
+#include <unordered_map>
 #include <vector>
 
 #include "Core/PowerPC/Gekko.h"
@@ -35,6 +35,10 @@ struct JitBlock
 {
 	const u8 *checkedEntry;
 	const u8 *normalEntry;
+	// Like checkedEntry, but for exits that already have preloadGPRs in the
+	// host registers the block loads them into. Null if the block has none.
+	const u8 *preloadCheckedEntry;
+	BitSet32 preloadGPRs;
 
 	u32 originalAddress;
 	u32 codeSize;
@@ -104,13 +108,19 @@ class JitBaseBlockCache
 	enum
 	{
 		MAX_NUM_BLOCKS = 65536 * 2,
+
+		// The range index splits the physical address space into 4 KiB buckets.
+		BLOCK_RANGE_SHIFT = 12,
+		BLOCK_RANGE_BUCKETS = 0x20000000 >> BLOCK_RANGE_SHIFT,
 	};
 
 	std::array<const u8*, MAX_NUM_BLOCKS> blockCodePointers;
 	std::array<JitBlock, MAX_NUM_BLOCKS> blocks;
 	int num_blocks;
-	std::multimap<u32, int> links_to;
-	std::map<std::pair<u32,u32>, u32> block_map; // (end_addr, start_addr) -> number
+	// exit address -> blocks that have an exit to it
+	std::unordered_map<u32, std::vector<int>> links_to;
+	// physical page -> live blocks overlapping it, used to find blocks to invalidate
+	std::vector<std::vector<int>> block_range_map;
 	ValidBlockBitSet valid_block;
 
 	bool m_initialized;
@@ -122,6 +132,8 @@ class JitBaseBlockCache
 
 	u32* GetICachePtr(u32 addr);
 	void DestroyBlock(int block_num, bool invalidate);
+	void AddBlockToRangeMap(int block_num);
+	void RemoveBlockFromRangeMap(int block_num);
 
 	// Virtual for overloaded
 	virtual void WriteLinkBlock(u8* location, const u8* address) = 0;
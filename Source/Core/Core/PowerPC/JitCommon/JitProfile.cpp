@@ -0,0 +1,151 @@
+// Copyright 2015 Dolphin Emulator Project
+// Licensed under GPLv2
+// Refer to the license.txt file included.
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "Common/CommonTypes.h"
+#include "Common/FileUtil.h"
+#include "Common/Hash.h"
+#include "Common/Logging/Log.h"
+#include "Common/StringUtil.h"
+#include "Core/HW/Memmap.h"
+#include "Core/PowerPC/JitCommon/JitProfile.h"
+
+class JitBlockProfile::Reader : public LinearDiskCacheReader<u32, Entry>
+{
+public:
+	Reader(std::unordered_map<u32, Entry>* recorded) : m_recorded(recorded) {}
+
+	void Read(const u32& key, const Entry* value, u32 value_size) override
+	{
+		// Later entries for the same address replace earlier ones.
+		if (value_size == 1)
+			(*m_recorded)[key] = *value;
+	}
+
+private:
+	std::unordered_map<u32, Entry>* m_recorded;
+};
+
+JitBlockProfile::JitBlockProfile()
+{
+}
+
+JitBlockProfile::~JitBlockProfile()
+{
+	Shutdown();
+}
+
+void JitBlockProfile::Init(const std::string& unique_id)
+{
+	Shutdown();
+
+	if (unique_id.empty())
+		return;
+
+	std::string dir = File::GetUserPath(D_CACHE_IDX);
+	if (!File::Exists(dir))
+		File::CreateDir(dir);
+
+	std::string filename = StringFromFormat("%sjit-%s.profile", dir.c_str(), unique_id.c_str());
+
+	Reader reader(&m_recorded);
+	m_num_entries = m_file.OpenAndRead(filename, reader);
+	m_active = true;
+
+	m_pending.assign(m_recorded.begin(), m_recorded.end());
+	m_pending_cursor = 0;
+
+	INFO_LOG(DYNA_REC, "JIT block profile %s: %u entries, %u blocks",
+	         filename.c_str(), m_num_entries, (u32)m_pending.size());
+}
+
+void JitBlockProfile::Shutdown()
+{
+	if (m_active)
+		m_file.Close();
+
+	m_recorded.clear();
+	m_compiled.clear();
+	m_pending.clear();
+	m_pending_cursor = 0;
+	m_num_entries = 0;
+	m_active = false;
+}
+
+void JitBlockProfile::BlockCompiled(u32 address, u32 num_instructions)
+{
+	if (!m_active || !IsPlainRAM(address, num_instructions))
+		return;
+
+	Entry entry;
+	entry.num_instructions = num_instructions;
+	entry.code_hash = HashCode(address, num_instructions);
+	m_compiled[address] = entry;
+}
+
+void JitBlockProfile::RecordBlock(u32 address)
+{
+	auto compiled = m_compiled.find(address);
+	if (!m_active || compiled == m_compiled.end())
+		return;
+
+	const Entry& entry = compiled->second;
+	auto it = m_recorded.find(address);
+	if (it != m_recorded.end() &&
+	    it->second.num_instructions == entry.num_instructions &&
+	    it->second.code_hash == entry.code_hash)
+	{
+		return;
+	}
+
+	if (m_num_entries >= MAX_ENTRIES)
+		return;
+
+	m_recorded[address] = entry;
+	m_file.Append(address, &entry, 1);
+	m_num_entries++;
+}
+
+void JitBlockProfile::TakeValidBlocks(u32 max_checks, std::vector<u32>* addresses)
+{
+	for (u32 i = 0; i < max_checks && !m_pending.empty(); i++)
+	{
+		if (m_pending_cursor >= m_pending.size())
+			m_pending_cursor = 0;
+
+		const std::pair<u32, Entry>& p = m_pending[m_pending_cursor];
+		if (IsPlainRAM(p.first, p.second.num_instructions) &&
+		    HashCode(p.first, p.second.num_instructions) == p.second.code_hash)
+		{
+			addresses->push_back(p.first);
+			m_pending[m_pending_cursor] = m_pending.back();
+			m_pending.pop_back();
+		}
+		else
+		{
+			m_pending_cursor++;
+		}
+	}
+}
+
+bool JitBlockProfile::IsPlainRAM(u32 address, u32 num_instructions)
+{
+	// Hashing reads memory without going through the MMU, so stay away from
+	// anything that could be MMIO or need a translation.
+	return num_instructions != 0 &&
+	       Memory::IsRAMAddress(address) &&
+	       Memory::IsRAMAddress(address + (num_instructions - 1) * 4);
+}
+
+u32 JitBlockProfile::HashCode(u32 address, u32 num_instructions)
+{
+	std::vector<u32> code(num_instructions);
+	for (u32 i = 0; i < num_instructions; i++)
+		code[i] = Memory::ReadUnchecked_U32(address + i * 4);
+
+	return HashAdler32((const u8*)code.data(), code.size() * sizeof(u32));
+}
@@ -0,0 +1,78 @@
+// Copyright 2015 Dolphin Emulator Project
+// Licensed under GPLv2
+// Refer to the license.txt file included.
+
+// Remembers which blocks a game ran often, so that the next boot can compile
+// them up front instead of stalling on each one the first time it runs.
+//
+// The profile is a LinearDiskCache per game ID. Each entry maps a block start
+// address to the number of instructions in the block and a hash of those
+// instructions. An entry is only handed back for precompilation once the code
+// currently in memory hashes to the same value, so blocks of code that has not
+// been loaded yet (or that belongs to a different overlay) are left alone
+// until it shows up.
+
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "Common/CommonTypes.h"
+#include "Common/LinearDiskCache.h"
+
+class JitBlockProfile
+{
+public:
+	struct Entry
+	{
+		u32 num_instructions;
+		u32 code_hash;
+	};
+
+	JitBlockProfile();
+	~JitBlockProfile();
+
+	// Opens (or creates) the profile for the given game. Does nothing if the
+	// game has no usable ID.
+	void Init(const std::string& unique_id);
+	void Shutdown();
+
+	bool IsActive() const { return m_active; }
+	bool HasPendingBlocks() const { return !m_pending.empty(); }
+
+	// A block has to have run this many times before it goes into the profile,
+	// so that code that only runs once or twice doesn't fill it up.
+	static const int HOT_BLOCK_RUNS = 100;
+
+	// Called for every block the JIT finishes. Hashes its code, which might not
+	// be in memory anymore by the time the block turns out to be hot.
+	void BlockCompiled(u32 address, u32 num_instructions);
+
+	// Appends the block last compiled at this address to the profile, if this
+	// code has not been recorded there before.
+	void RecordBlock(u32 address);
+
+	// Checks up to max_checks pending entries against memory and moves the
+	// ones that match into *addresses. Entries that don't match stay pending.
+	void TakeValidBlocks(u32 max_checks, std::vector<u32>* addresses);
+
+	static bool IsPlainRAM(u32 address, u32 num_instructions);
+	static u32 HashCode(u32 address, u32 num_instructions);
+
+private:
+	class Reader;
+
+	// Stops the file from growing without bound in games that keep
+	// generating code.
+	static const u32 MAX_ENTRIES = 0x10000;
+
+	LinearDiskCache<u32, Entry> m_file;
+	std::unordered_map<u32, Entry> m_recorded;
+	std::unordered_map<u32, Entry> m_compiled;
+	std::vector<std::pair<u32, Entry>> m_pending;
+	size_t m_pending_cursor = 0;
+	u32 m_num_entries = 0;
+	bool m_active = false;
+};
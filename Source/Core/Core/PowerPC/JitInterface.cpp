@@ -14,6 +14,7 @@
 
 #include "Core/ConfigManager.h"
 #include "Core/HW/Memmap.h"
+#include "Core/PowerPC/CachedInterpreter.h"
 #include "Core/PowerPC/JitInterface.h"
 #include "Core/PowerPC/PPCSymbolDB.h"
 #include "Core/PowerPC/Profiler.h"
@@ -80,6 +81,11 @@ namespace JitInterface
 				break;
 			}
 			#endif
+			case 5:
+			{
+				ptr = new CachedInterpreter();
+				break;
+			}
 			default:
 			{
 				PanicAlert("Unrecognizable cpu_core: %d", core);
@@ -121,6 +127,9 @@ namespace JitInterface
 				break;
 			}
 			#endif
+			case 5:
+				// Uses the interpreter's tables.
+				break;
 			default:
 			{
 				PanicAlert("Unrecognizable cpu_core: %d", core);
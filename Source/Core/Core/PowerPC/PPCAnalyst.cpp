@@ -219,6 +219,9 @@ static bool CanSwapAdjacentOps(const CodeOp &a, const CodeOp &b)
 	const GekkoOPInfo *b_info = b.opinfo;
 	int a_flags = a_info->flags;
 	int b_flags = b_info->flags;
+	// Nothing moves across the label of an internal branch.
+	if (a.isBranchTarget || b.isBranchTarget)
+		return false;
 	if (b_flags & (FL_SET_CRx | FL_ENDBLOCK | FL_TIMER | FL_EVIL | FL_SET_OE))
 		return false;
 	if ((b_flags & (FL_RC_BIT | FL_RC_BIT_F)) && (b.inst.Rc))
@@ -474,6 +477,38 @@ void PPCAnalyzer::ReorderInstructions(u32 instructions, CodeOp *code)
 		ReorderInstructionsCore(instructions, code, false, REORDER_CMP);
 }
 
+bool PPCAnalyzer::FindInternalBranches(CodeBlock *block, CodeOp *code)
+{
+	bool found = false;
+	for (u32 i = 0; i < block->m_num_instructions; i++)
+	{
+		CodeOp& op = code[i];
+		// Branches that link need the return address stack, so they still leave the block.
+		if ((op.inst.OPCD != 16 && op.inst.OPCD != 18) || op.inst.LK)
+			continue;
+
+		u32 destination;
+		if (op.inst.OPCD == 16)
+			destination = op.inst.AA ? SignExt16(op.inst.BD << 2) : op.address + SignExt16(op.inst.BD << 2);
+		else
+			destination = op.inst.AA ? SignExt26(op.inst.LI << 2) : op.address + SignExt26(op.inst.LI << 2);
+
+		if (destination < block->m_address)
+			continue;
+		u32 index = (destination - block->m_address) / 4;
+		if (index >= block->m_num_instructions || code[index].address != destination)
+			continue;
+		if (!HasOption(index <= i ? OPTION_COMPLEX_BLOCK : OPTION_FORWARD_JUMP))
+			continue;
+
+		op.branchTo = destination;
+		op.branchToIndex = index;
+		code[index].isBranchTarget = true;
+		found = true;
+	}
+	return found;
+}
+
 void PPCAnalyzer::SetInstructionStats(CodeBlock *block, CodeOp *code, GekkoOPInfo *opinfo, u32 index)
 {
 	code->wantsCR0 = false;
@@ -813,6 +848,10 @@ u32 PPCAnalyzer::Analyze(u32 address, CodeBlock *block, CodeBuffer *buffer, u32
 
 	block->m_num_instructions = num_inst;
 
+	bool internal_branches = false;
+	if (HasOption(OPTION_COMPLEX_BLOCK) || HasOption(OPTION_FORWARD_JUMP))
+		internal_branches = FindInternalBranches(block, code);
+
 	if (block->m_num_instructions > 1)
 		ReorderInstructions(block->m_num_instructions, code);
 
@@ -825,7 +864,6 @@ u32 PPCAnalyzer::Analyze(u32 address, CodeBlock *block, CodeBuffer *buffer, u32
 	// Scan for flag dependencies; assume the next block (or any branch that can leave the block)
 	// wants flags, to be safe.
 	bool wantsCR0 = true, wantsCR1 = true, wantsFPRF = true, wantsCA = true;
-	BitSet32 fprInUse, gprInUse, gprInReg, fprInXmm;
 	for (int i = block->m_num_instructions - 1; i >= 0; i--)
 	{
 		bool opWantsCR0 = code[i].wantsCR0;
@@ -844,29 +882,66 @@ u32 PPCAnalyzer::Analyze(u32 address, CodeBlock *block, CodeBuffer *buffer, u32
 		wantsCR1 &= !code[i].outputCR1 || opWantsCR1;
 		wantsFPRF &= !code[i].outputFPRF || opWantsFPRF;
 		wantsCA &= !code[i].outputCA || opWantsCA;
-		code[i].gprInUse = gprInUse;
-		code[i].fprInUse = fprInUse;
-		code[i].gprInReg = gprInReg;
-		code[i].fprInXmm = fprInXmm;
-		// TODO: if there's no possible endblocks or exceptions in between, tell the regcache
-		// we can throw away a register if it's going to be overwritten later.
-		gprInUse |= code[i].regsIn;
-		gprInReg |= code[i].regsIn;
-		fprInUse |= code[i].fregsIn;
-		if (strncmp(code[i].opinfo->opname, "stfd", 4))
-			fprInXmm |= code[i].fregsIn;
-		// For now, we need to count output registers as "used" though; otherwise the flush
-		// will result in a redundant store (e.g. store to regcache, then store again to
-		// the same location later).
-		gprInUse |= code[i].regsOut;
-		if (code[i].fregOut >= 0)
-			fprInUse[code[i].fregOut] = true;
+		// Flags arriving from another path can't be in the x86 flags.
+		if (code[i].isBranchTarget)
+			code[i].wantsCAInFlags = false;
 	}
 
+	// Scan for register usage. Whatever is used where an internal branch lands is still
+	// in use at the branch; backward branches land on instructions this already went
+	// past, so go over the block again until nothing changes.
+	bool changed;
+	do
+	{
+		changed = false;
+		BitSet32 fprInUse, gprInUse, gprInReg, fprInXmm;
+		for (int i = block->m_num_instructions - 1; i >= 0; i--)
+		{
+			if (code[i].branchToIndex >= 0)
+			{
+				const CodeOp& target = code[code[i].branchToIndex];
+				gprInUse |= target.gprInUse | target.regsIn | target.regsOut;
+				gprInReg |= target.gprInReg | target.regsIn;
+				fprInUse |= target.fprInUse | target.fregsIn;
+				if (target.fregOut >= 0)
+					fprInUse[target.fregOut] = true;
+				fprInXmm |= target.fprInXmm;
+				if (strncmp(target.opinfo->opname, "stfd", 4))
+					fprInXmm |= target.fregsIn;
+			}
+			changed |= code[i].gprInUse != gprInUse || code[i].fprInUse != fprInUse ||
+			           code[i].gprInReg != gprInReg || code[i].fprInXmm != fprInXmm;
+			code[i].gprInUse = gprInUse;
+			code[i].fprInUse = fprInUse;
+			code[i].gprInReg = gprInReg;
+			code[i].fprInXmm = fprInXmm;
+			// TODO: if there's no possible endblocks or exceptions in between, tell the regcache
+			// we can throw away a register if it's going to be overwritten later.
+			gprInUse |= code[i].regsIn;
+			gprInReg |= code[i].regsIn;
+			fprInUse |= code[i].fregsIn;
+			if (strncmp(code[i].opinfo->opname, "stfd", 4))
+				fprInXmm |= code[i].fregsIn;
+			// For now, we need to count output registers as "used" though; otherwise the flush
+			// will result in a redundant store (e.g. store to regcache, then store again to
+			// the same location later).
+			gprInUse |= code[i].regsOut;
+			if (code[i].fregOut >= 0)
+				fprInUse[code[i].fregOut] = true;
+		}
+	} while (changed && internal_branches);
+
 	// Forward scan, for flags that need the other direction for calculation.
 	BitSet32 fprIsSingle, fprIsDuplicated, fprIsStoreSafe;
 	for (u32 i = 0; i < block->m_num_instructions; i++)
 	{
+		// Nothing is known about what other paths leave behind.
+		if (code[i].isBranchTarget)
+		{
+			fprIsSingle = BitSet32(0);
+			fprIsDuplicated = BitSet32(0);
+			fprIsStoreSafe = BitSet32(0);
+		}
 		code[i].fprIsSingle = fprIsSingle;
 		code[i].fprIsDuplicated = fprIsDuplicated;
 		code[i].fprIsStoreSafe = fprIsStoreSafe;
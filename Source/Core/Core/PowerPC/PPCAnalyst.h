@@ -26,7 +26,7 @@ struct CodeOp //16B
 	GekkoOPInfo * opinfo;
 	u32 address;
 	u32 branchTo; //if 0, not a branch
-	int branchToIndex; //index of target block
+	int branchToIndex; //index of the target in this block, -1 if it leaves the block
 	BitSet32 regsOut;
 	BitSet32 regsIn;
 	BitSet32 fregsIn;
@@ -170,6 +170,7 @@ private:
 	void ReorderInstructionsCore(u32 instructions, CodeOp* code, bool reverse, ReorderType type);
 	void ReorderInstructions(u32 instructions, CodeOp *code);
 	void SetInstructionStats(CodeBlock *block, CodeOp *code, GekkoOPInfo *opinfo, u32 index);
+	bool FindInternalBranches(CodeBlock *block, CodeOp *code);
 
 	// Options
 	u32 m_options;
@@ -191,14 +192,16 @@ public:
 
 		// Complex blocks support jumping backwards on to themselves.
 		// Happens commonly in loops, pretty complex to support.
-		// May require register caches to use register usage metrics.
-		// XXX: NOT COMPLETE
+		// Branches (bx/bcx without LK) that land in the block get branchToIndex set
+		// and their targets isBranchTarget; register usage accounts for them.
+		// Requires JIT support to work.
 		OPTION_COMPLEX_BLOCK = (1 << 2),
 
 		// Similar to complex blocks.
 		// Instead of jumping backwards, this jumps forwards within the block.
+		// The block still ends at the first unconditional exit, so only targets
+		// before that are found.
 		// Requires JIT support to work.
-		// XXX: NOT COMPLETE
 		OPTION_FORWARD_JUMP = (1 << 3),
 
 		// Reorder compare/Rc instructions next to their associated branches and
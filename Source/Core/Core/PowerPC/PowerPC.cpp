@@ -20,6 +20,7 @@
 #include "Core/PowerPC/JitInterface.h"
 #include "Core/PowerPC/PowerPC.h"
 #include "Core/PowerPC/PPCTables.h"
+#include "Core/PowerPC/Profiler.h"
 #include "Core/PowerPC/Interpreter/Interpreter.h"
 
 
@@ -173,10 +174,13 @@ void Init(int cpu_core)
 
 	if (SConfig::GetInstance().m_LocalCoreStartupParameter.bEnableDebugging)
 		breakpoints.ClearAllTemporary();
+
+	Profiler::Init();
 }
 
 void Shutdown()
 {
+	Profiler::Shutdown();
 	JitInterface::Shutdown();
 	interpreter->Shutdown();
 	cpu_core_base = nullptr;
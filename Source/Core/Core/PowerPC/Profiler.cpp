@@ -2,18 +2,309 @@
 // Licensed under GPLv2
 // Refer to the license.txt file included.
 
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <map>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "Common/Event.h"
+#include "Common/FileUtil.h"
+#include "Common/Flag.h"
+#include "Common/MsgHandler.h"
+#include "Common/StringUtil.h"
+#include "Common/Thread.h"
+#include "Core/CoreTiming.h"
+#include "Core/Debugger/Debugger_SymbolMap.h"
 #include "Core/PowerPC/JitInterface.h"
+#include "Core/PowerPC/PowerPC.h"
+#include "Core/PowerPC/PPCSymbolDB.h"
 #include "Core/PowerPC/Profiler.h"
+#include "Core/PowerPC/JitCommon/JitBase.h"
 
 namespace Profiler
 {
 
 bool g_ProfileBlocks;
 
+static const int SAMPLE_INTERVAL_MS = 1;
+
+static int s_sample_event;
+
+// Init and Shutdown run on the emulation thread and SetSampling on the UI
+// thread, so the sampler thread is started and stopped under this lock.
+static std::mutex s_sampler_lock;
+static bool s_initialized;
+static bool s_sampling;
+static std::thread s_sampler;
+static Common::Event s_stop_sampler;
+static Common::Flag s_sampler_running;
+
+// Set while a sample is waiting for the CPU thread, so that a paused CPU doesn't
+// make them pile up.
+static Common::Flag s_sample_pending;
+
+// Every call stack seen, innermost address first, with the number of samples
+// it was seen in.
+static std::mutex s_samples_lock;
+static std::map<std::vector<u32>, u64> s_stacks;
+static u64 s_num_samples;
+
 void WriteProfileResults(const std::string& filename)
 {
 	JitInterface::WriteProfileResults(filename);
 }
 
+// Runs on the CPU thread, between two blocks, so PC is exact: it's the start
+// of the block that is about to run.
+static void Sample(u64 userdata, int cycles_late)
+{
+	s_sample_pending.Clear();
+	// Sampling may have been switched off while this was queued.
+	if (!s_sampler_running.IsSet())
+		return;
+
+	// LR goes in as well, because a function that hasn't saved it to its stack
+	// frame yet is missing from the frames.
+	std::vector<u32> stack;
+	stack.push_back(PC);
+	stack.push_back(LR);
+	Dolphin_Debugger::WalkTheStack([&stack](u32 address) {
+		stack.push_back(address);
+	});
+
+	std::lock_guard<std::mutex> lk(s_samples_lock);
+	s_stacks[stack]++;
+	s_num_samples++;
+}
+
+static void SamplerThread()
+{
+	Common::SetCurrentThreadName("Profiler sampler");
+
+	while (!s_stop_sampler.WaitFor(std::chrono::milliseconds(SAMPLE_INTERVAL_MS)))
+	{
+		if (s_sample_pending.TestAndSet())
+		{
+			// Without cutting the slice short, the sample would wait for the slice
+			// to end, and slices end after a fixed number of guest cycles.
+			CoreTiming::ScheduleEvent_Threadsafe(0, s_sample_event);
+			CoreTiming::ForceExceptionCheck_Threadsafe();
+		}
+	}
+}
+
+static void StartSampler()
+{
+	if (s_sampler_running.IsSet())
+		return;
+
+	s_stop_sampler.Reset();
+	s_sample_pending.Clear();
+	s_sampler_running.Set();
+	s_sampler = std::thread(SamplerThread);
+}
+
+static void StopSampler()
+{
+	if (!s_sampler_running.IsSet())
+		return;
+
+	s_sampler_running.Clear();
+	s_stop_sampler.Set();
+	s_sampler.join();
+}
+
+void Init()
+{
+	s_sample_event = CoreTiming::RegisterEvent("ProfilerSample", Sample);
+	ClearSamples();
+
+	std::lock_guard<std::mutex> lk(s_sampler_lock);
+	s_initialized = true;
+	if (s_sampling)
+		StartSampler();
+}
+
+void Shutdown()
+{
+	std::lock_guard<std::mutex> lk(s_sampler_lock);
+	StopSampler();
+	s_initialized = false;
+}
+
+void SetSampling(bool enabled)
+{
+	std::lock_guard<std::mutex> lk(s_sampler_lock);
+	s_sampling = enabled;
+	if (!s_initialized)
+		return;
+
+	if (enabled)
+		StartSampler();
+	else
+		StopSampler();
+}
+
+bool IsSampling()
+{
+	return s_sampling;
+}
+
+void ClearSamples()
+{
+	std::lock_guard<std::mutex> lk(s_samples_lock);
+	s_stacks.clear();
+	s_num_samples = 0;
+}
+
+static std::string JSONString(const std::string& str)
+{
+	std::string result = "\"";
+	for (char c : str)
+	{
+		if (c == '"' || c == '\\')
+		{
+			result += '\\';
+			result += c;
+		}
+		else if ((unsigned char)c < 0x20)
+		{
+			result += StringFromFormat("\\u%04x", (unsigned char)c);
+		}
+		else
+		{
+			result += c;
+		}
+	}
+	return result + "\"";
+}
+
+static std::string FunctionName(const Symbol* symbol)
+{
+	return symbol ? symbol->name : "(unknown)";
+}
+
+struct FunctionStat
+{
+	FunctionStat() : exclusive(0), inclusive(0) {}
+	u64 exclusive;
+	u64 inclusive;
+};
+
+// The block cache is read as well, so the CPU should be paused.
+void WriteSampleResults(const std::string& filename)
+{
+	std::lock_guard<std::mutex> lk(s_samples_lock);
+
+	// GetSymbolFromAddr can be slow, and the same addresses come up in lots of stacks.
+	std::map<u32, Symbol*> symbols;
+	auto lookup = [&symbols](u32 address) {
+		auto it = symbols.find(address);
+		if (it == symbols.end())
+			it = symbols.emplace(address, g_symbolDB.GetSymbolFromAddr(address)).first;
+		return it->second;
+	};
+
+	std::map<const Symbol*, FunctionStat> functions;
+	std::map<u32, u64> blocks;
+	std::vector<std::pair<u64, std::vector<const Symbol*>>> stacks;
+	for (const auto& entry : s_stacks)
+	{
+		const std::vector<u32>& stack = entry.first;
+		u64 count = entry.second;
+
+		blocks[stack[0]] += count;
+		functions[lookup(stack[0])].exclusive += count;
+
+		// Recursion and LR both put a function in a stack more than once, but
+		// it only gets the sample once. Frames without a symbol are dropped,
+		// apart from the innermost, which has the exclusive count.
+		std::vector<const Symbol*> seen;
+		std::vector<const Symbol*> frames;
+		for (size_t i = 0; i < stack.size(); i++)
+		{
+			const Symbol* symbol = lookup(stack[i]);
+			if (!symbol && i > 0)
+				continue;
+			if (std::find(seen.begin(), seen.end(), symbol) == seen.end())
+			{
+				seen.push_back(symbol);
+				functions[symbol].inclusive += count;
+			}
+			if (frames.empty() || frames.back() != symbol)
+				frames.push_back(symbol);
+		}
+		stacks.emplace_back(count, std::move(frames));
+	}
+
+	std::vector<std::pair<const Symbol*, FunctionStat>> function_stats(functions.begin(), functions.end());
+	std::sort(function_stats.begin(), function_stats.end(), [](const std::pair<const Symbol*, FunctionStat>& a, const std::pair<const Symbol*, FunctionStat>& b) {
+		return a.second.exclusive != b.second.exclusive ? a.second.exclusive > b.second.exclusive : a.second.inclusive > b.second.inclusive;
+	});
+	std::vector<std::pair<u32, u64>> block_stats(blocks.begin(), blocks.end());
+	std::sort(block_stats.begin(), block_stats.end(), [](const std::pair<u32, u64>& a, const std::pair<u32, u64>& b) {
+		return a.second > b.second;
+	});
+	std::sort(stacks.begin(), stacks.end(), [](const std::pair<u64, std::vector<const Symbol*>>& a, const std::pair<u64, std::vector<const Symbol*>>& b) {
+		return a.first > b.first;
+	});
+
+	File::IOFile f(filename, "w");
+	if (!f)
+	{
+		PanicAlert("Failed to open %s", filename.c_str());
+		return;
+	}
+	FILE* file = f.GetHandle();
+
+	fprintf(file, "{\n\t\"interval_ms\": %d,\n\t\"samples\": %" PRIu64 ",\n", SAMPLE_INTERVAL_MS, s_num_samples);
+
+	fprintf(file, "\t\"functions\": [");
+	for (size_t i = 0; i < function_stats.size(); i++)
+	{
+		const Symbol* symbol = function_stats[i].first;
+		fprintf(file, "%s\n\t\t{\"name\": %s, \"address\": %u, \"size\": %d, \"exclusive\": %" PRIu64 ", \"inclusive\": %" PRIu64 "}",
+		        i ? "," : "", JSONString(FunctionName(symbol)).c_str(), symbol ? symbol->address : 0, symbol ? symbol->size : 0,
+		        function_stats[i].second.exclusive, function_stats[i].second.inclusive);
+	}
+	fprintf(file, "\n\t],\n");
+
+	// Also says what the JIT made of each block, if it's still in the cache.
+	JitBaseBlockCache* cache = jit ? jit->GetBlockCache() : nullptr;
+	fprintf(file, "\t\"blocks\": [");
+	for (size_t i = 0; i < block_stats.size(); i++)
+	{
+		u32 address = block_stats[i].first;
+		fprintf(file, "%s\n\t\t{\"address\": %u, \"function\": %s, \"samples\": %" PRIu64,
+		        i ? "," : "", address, JSONString(FunctionName(lookup(address))).c_str(), block_stats[i].second);
+
+		int block_num = cache ? cache->GetBlockNumberFromStartAddress(address) : -1;
+		if (block_num >= 0)
+		{
+			const JitBlock* block = cache->GetBlock(block_num);
+			fprintf(file, ", \"instructions\": %u, \"code_size\": %u", block->originalSize, block->codeSize);
+			if (g_ProfileBlocks)
+				fprintf(file, ", \"run_count\": %d, \"ticks\": %" PRIu64, block->runCount, block->ticCounter);
+		}
+		fprintf(file, "}");
+	}
+	fprintf(file, "\n\t],\n");
+
+	// Innermost function first, with runs of the same function merged.
+	fprintf(file, "\t\"stacks\": [");
+	for (size_t i = 0; i < stacks.size(); i++)
+	{
+		fprintf(file, "%s\n\t\t{\"samples\": %" PRIu64 ", \"frames\": [", i ? "," : "", stacks[i].first);
+		for (size_t j = 0; j < stacks[i].second.size(); j++)
+			fprintf(file, "%s%s", j ? ", " : "", JSONString(FunctionName(stacks[i].second[j])).c_str());
+		fprintf(file, "]}");
+	}
+	fprintf(file, "\n\t]\n}\n");
+}
+
 }  // namespace
@@ -56,5 +56,23 @@ namespace Profiler
 {
 extern bool g_ProfileBlocks;
 
+void Init();
+void Shutdown();
+
 void WriteProfileResults(const std::string& filename);
+
+// Sampling profiler. While it's on, a host thread asks the CPU thread for the
+// guest PC and call stack about once per millisecond of host time, and cuts the
+// CoreTiming slice short so the sample is taken as soon as the running block
+// ends. Guest code is therefore charged for the host time it takes, not for its
+// guest cycles. JIT code is left alone, which means it can be switched on and
+// off while a game runs without clearing the cache.
+void SetSampling(bool enabled);
+bool IsSampling();
+void ClearSamples();
+// Writes per-block and per-function sample counts as JSON. A function's
+// exclusive count is the samples taken in it, its inclusive count also has the
+// samples taken in anything it called. The collapsed stacks are written too, for
+// turning into flame graphs or pprof profiles.
+void WriteSampleResults(const std::string& filename);
 }
@@ -0,0 +1,366 @@
+// Copyright 2015 Dolphin Emulator Project
+// Licensed under GPLv2
+// Refer to the license.txt file included.
+
+#include <algorithm>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <lzo/lzo1x.h>
+
+#include "Common/CommonTypes.h"
+#include "Common/Event.h"
+#include "Common/Flag.h"
+#include "Common/StringUtil.h"
+#include "Common/Thread.h"
+
+#include "Core/ConfigManager.h"
+#include "Core/Core.h"
+#include "Core/CoreTiming.h"
+#include "Core/Movie.h"
+#include "Core/NetPlayProto.h"
+#include "Core/Rewind.h"
+#include "Core/State.h"
+#include "Core/HW/SystemTimers.h"
+#include "Core/HW/VideoInterface.h"
+
+namespace Rewind
+{
+
+// Deltas are compressed in chunks of this size. Chunks that didn't change at
+// all are stored as a zero length and never go through LZO.
+static const u32 CHUNK_SIZE = 128 * 1024;
+static const u32 CHUNK_OUT_SIZE = CHUNK_SIZE + (CHUNK_SIZE / 16) + 64 + 3;
+
+static int s_event_type;
+static bool s_enabled;
+static size_t s_memory_budget;
+
+// CPU thread -> worker thread.
+static std::mutex s_pending_lock;
+static std::vector<u8> s_pending;
+static bool s_pending_ready;
+static u32 s_pending_generation;
+// Bumped by StepBack, under both locks. Captures are tagged with it before they
+// are taken, so that the worker can drop any that rewinding made stale.
+static u32 s_generation;
+// Only touched by the CPU thread. Swapped with s_pending so that buffers get
+// reused rather than reallocated for every capture.
+static std::vector<u8> s_capture_buffer;
+
+// The newest state, and the deltas leading back from it, oldest first.
+static std::mutex s_history_lock;
+static std::vector<u8> s_head;
+static std::deque<std::vector<u8>> s_deltas;
+static size_t s_deltas_size;
+
+static std::thread s_worker;
+static Common::Event s_work_event;
+static Common::Flag s_quit;
+
+// XORs a and b (each zero-extended as needed) over [offset, offset + len)
+// into dst. Returns whether the result has any bits set.
+static bool XorRange(u8* dst, const std::vector<u8>& a, const std::vector<u8>& b, size_t offset, size_t len)
+{
+	u64 any = 0;
+	size_t i = 0;
+
+	if (offset + len <= std::min(a.size(), b.size()))
+	{
+		for (; i + 8 <= len; i += 8)
+		{
+			u64 x, y;
+			memcpy(&x, &a[offset + i], 8);
+			memcpy(&y, &b[offset + i], 8);
+			x ^= y;
+			memcpy(dst + i, &x, 8);
+			any |= x;
+		}
+	}
+
+	for (; i < len; i++)
+	{
+		size_t pos = offset + i;
+		u8 x = (pos < a.size() ? a[pos] : 0) ^ (pos < b.size() ? b[pos] : 0);
+		dst[i] = x;
+		any |= x;
+	}
+
+	return any != 0;
+}
+
+template <typename T>
+static void Append(std::vector<u8>* out, const T& value)
+{
+	const u8* p = (const u8*)&value;
+	out->insert(out->end(), p, p + sizeof(T));
+}
+
+void EncodeDelta(const std::vector<u8>& older, const std::vector<u8>& newer, std::vector<u8>* delta)
+{
+	std::vector<u8> chunk(CHUNK_SIZE);
+	std::vector<u8> out(CHUNK_OUT_SIZE);
+	std::vector<u8> wrkmem(LZO1X_1_MEM_COMPRESS);
+
+	delta->clear();
+	Append(delta, (u32)older.size());
+
+	const size_t size = std::max(older.size(), newer.size());
+	for (size_t offset = 0; offset < size; offset += CHUNK_SIZE)
+	{
+		const size_t len = std::min<size_t>(CHUNK_SIZE, size - offset);
+		if (!XorRange(chunk.data(), older, newer, offset, len))
+		{
+			Append(delta, (u32)0);
+			continue;
+		}
+
+		lzo_uint out_len = 0;
+		if (lzo1x_1_compress(chunk.data(), (lzo_uint)len, out.data(), &out_len, wrkmem.data()) != LZO_E_OK)
+			PanicAlertT("Internal LZO Error - compression failed");
+
+		Append(delta, (u32)out_len);
+		delta->insert(delta->end(), out.begin(), out.begin() + out_len);
+	}
+}
+
+bool ApplyDelta(const std::vector<u8>& delta, std::vector<u8>* state)
+{
+	std::vector<u8> chunk(CHUNK_SIZE);
+	size_t pos = 0;
+
+	auto read_u32 = [&](u32* value) {
+		if (pos + sizeof(u32) > delta.size())
+			return false;
+		memcpy(value, &delta[pos], sizeof(u32));
+		pos += sizeof(u32);
+		return true;
+	};
+
+	u32 older_size;
+	if (!read_u32(&older_size))
+		return false;
+
+	const size_t size = std::max<size_t>(older_size, state->size());
+	state->resize(size, 0);
+
+	for (size_t offset = 0; offset < size; offset += CHUNK_SIZE)
+	{
+		const size_t len = std::min<size_t>(CHUNK_SIZE, size - offset);
+
+		u32 compressed_len;
+		if (!read_u32(&compressed_len) || pos + compressed_len > delta.size())
+			return false;
+		if (compressed_len == 0)
+			continue;
+
+		lzo_uint new_len = CHUNK_SIZE;
+		if (lzo1x_decompress_safe(&delta[pos], compressed_len, chunk.data(), &new_len, nullptr) != LZO_E_OK ||
+		    new_len != len)
+		{
+			return false;
+		}
+		pos += compressed_len;
+
+		u8* dst = &(*state)[offset];
+		for (size_t i = 0; i < len; i++)
+			dst[i] ^= chunk[i];
+	}
+
+	state->resize(older_size);
+	return true;
+}
+
+static int GetCaptureInterval()
+{
+	const u32 refresh_rate = VideoInterface::TargetRefreshRate ? VideoInterface::TargetRefreshRate : 60;
+	const int frames = std::max(1, SConfig::GetInstance().m_LocalCoreStartupParameter.iRewindInterval);
+	return (int)(SystemTimers::GetTicksPerSecond() / refresh_rate * frames);
+}
+
+// Runs on the CPU thread.
+static void Capture()
+{
+	// Rewinding would desync movies and netplay.
+	if (Movie::IsMovieActive() || NetPlay::IsNetPlayRunning())
+		return;
+
+	// If the worker hasn't gotten to the previous capture yet, skip this one
+	// rather than wait for it.
+	u32 generation;
+	{
+		std::lock_guard<std::mutex> lk(s_pending_lock);
+		if (s_pending_ready)
+			return;
+		generation = s_generation;
+	}
+
+	// Core::PauseAndLock can't be used here: another thread may be in it,
+	// waiting for this one to let go of the CPU.
+	State::SaveToBufferFromCPUThread(s_capture_buffer);
+
+	{
+		std::lock_guard<std::mutex> lk(s_pending_lock);
+		s_pending.swap(s_capture_buffer);
+		s_pending_generation = generation;
+		s_pending_ready = true;
+	}
+	s_work_event.Set();
+}
+
+static void CaptureCallback(u64 userdata, int cyclesLate)
+{
+	// Schedule the next capture first, so that it is part of the state and
+	// rewinding to it keeps capturing.
+	CoreTiming::ScheduleEvent(GetCaptureInterval() - cyclesLate, s_event_type);
+	Capture();
+}
+
+static void WorkerThread()
+{
+	Common::SetCurrentThreadName("Rewind thread");
+
+	std::vector<u8> state;
+	std::vector<u8> delta;
+
+	while (true)
+	{
+		s_work_event.Wait();
+		if (s_quit.IsSet())
+			return;
+
+		u32 generation;
+		{
+			std::lock_guard<std::mutex> lk(s_pending_lock);
+			if (!s_pending_ready)
+				continue;
+			state.swap(s_pending);
+			generation = s_pending_generation;
+			s_pending_ready = false;
+		}
+
+		std::lock_guard<std::mutex> lk(s_history_lock);
+		// Taken before a rewind that happened since, so it's newer than the head.
+		if (generation != s_generation)
+			continue;
+
+		if (!s_head.empty())
+		{
+			EncodeDelta(s_head, state, &delta);
+			s_deltas_size += delta.size();
+			s_deltas.emplace_back();
+			s_deltas.back().swap(delta);
+
+			while (!s_deltas.empty() && s_head.size() + s_deltas_size > s_memory_budget)
+			{
+				s_deltas_size -= s_deltas.front().size();
+				s_deltas.pop_front();
+			}
+		}
+		// The old head is handed back to the CPU thread through s_pending.
+		s_head.swap(state);
+	}
+}
+
+void Init()
+{
+	s_event_type = CoreTiming::RegisterEvent("RewindCapture", CaptureCallback);
+
+	const SCoreStartupParameter& startup = SConfig::GetInstance().m_LocalCoreStartupParameter;
+	s_enabled = startup.bRewind;
+	if (!s_enabled)
+		return;
+
+	s_memory_budget = (size_t)std::max(1, startup.iRewindMemory) << 20;
+	s_pending_ready = false;
+	s_deltas_size = 0;
+	s_quit.Clear();
+	s_worker = std::thread(WorkerThread);
+
+	CoreTiming::ScheduleEvent(GetCaptureInterval(), s_event_type);
+}
+
+void Shutdown()
+{
+	if (s_worker.joinable())
+	{
+		s_quit.Set();
+		s_work_event.Set();
+		s_worker.join();
+	}
+
+	// swapping with empty vectors to actually free the memory
+	std::vector<u8>().swap(s_pending);
+	std::vector<u8>().swap(s_capture_buffer);
+	std::vector<u8>().swap(s_head);
+	std::deque<std::vector<u8>>().swap(s_deltas);
+	s_pending_ready = false;
+	s_deltas_size = 0;
+	s_enabled = false;
+}
+
+void OnStateLoaded()
+{
+	// The loaded state may or may not have come with a pending capture.
+	CoreTiming::RemoveEvent(s_event_type);
+	if (s_enabled)
+		CoreTiming::ScheduleEvent(GetCaptureInterval(), s_event_type);
+}
+
+bool StepBack()
+{
+	if (!s_enabled || !Core::IsRunningAndStarted())
+		return false;
+
+	if (Movie::IsMovieActive() || NetPlay::IsNetPlayRunning())
+	{
+		Core::DisplayMessage("Rewinding is not available during movies or netplay", 2000);
+		return false;
+	}
+
+	std::lock_guard<std::mutex> history_lk(s_history_lock);
+	if (s_head.empty())
+	{
+		Core::DisplayMessage("Nothing to rewind to", 2000);
+		return false;
+	}
+
+	State::LoadFromBuffer(s_head);
+
+	// Every capture so far, including one that's pending or that the worker is
+	// waiting on s_history_lock with, is newer than where we went. Bumping the
+	// generation only once the state is loaded means no capture of the old
+	// state can be tagged with the new one.
+	{
+		std::lock_guard<std::mutex> pending_lk(s_pending_lock);
+		s_generation++;
+		s_pending_ready = false;
+	}
+
+	if (!s_deltas.empty())
+	{
+		if (!ApplyDelta(s_deltas.back(), &s_head))
+		{
+			PanicAlertT("Rewind history is corrupt and has been cleared");
+			s_head.clear();
+			s_deltas.clear();
+			s_deltas_size = 0;
+			return true;
+		}
+		s_deltas_size -= s_deltas.back().size();
+		s_deltas.pop_back();
+	}
+
+	Core::DisplayMessage(StringFromFormat("Rewound (%u steps left)", (u32)s_deltas.size()), 1000);
+	return true;
+}
+
+size_t GetMemoryUsage()
+{
+	std::lock_guard<std::mutex> lk(s_history_lock);
+	return s_head.size() + s_deltas_size;
+}
+
+}  // namespace Rewind
@@ -0,0 +1,44 @@
+// Copyright 2015 Dolphin Emulator Project
+// Licensed under GPLv2
+// Refer to the license.txt file included.
+
+// In-memory rewind support.
+//
+// While enabled, a state is captured every few frames (Core/RewindInterval)
+// on the CPU thread. A worker thread then stores it as a delta against the
+// state captured before it: the two are XORed together and compressed in
+// chunks, so everything that didn't change between captures (most of RAM)
+// costs next to nothing. Only the newest state is kept whole. The deltas are
+// kept in a ring that drops the oldest ones once Core/RewindMemory MiB are
+// used.
+//
+// Each StepBack() loads the newest remaining state and then applies one
+// delta to it, so that the next call goes one capture further back.
+
+#pragma once
+
+#include <vector>
+
+#include "Common/CommonTypes.h"
+
+namespace Rewind
+{
+
+void Init();
+void Shutdown();
+
+// Called by State after a state has been loaded into the emulator.
+void OnStateLoaded();
+
+// Loads the newest state in the ring and steps back one capture.
+// Returns false if there is nothing to rewind to.
+bool StepBack();
+
+// Memory used by the captured states and deltas, in bytes.
+size_t GetMemoryUsage();
+
+// The delta encoding. ApplyDelta(EncodeDelta(older, newer), newer) == older.
+void EncodeDelta(const std::vector<u8>& older, const std::vector<u8>& newer, std::vector<u8>* delta);
+bool ApplyDelta(const std::vector<u8>& delta, std::vector<u8>* state);
+
+}
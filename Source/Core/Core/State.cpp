@@ -2,19 +2,25 @@
 // Licensed under GPLv2
 // Refer to the license.txt file included.
 
+#include <algorithm>
+#include <atomic>
+#include <memory>
 #include <mutex>
 #include <thread>
 #include <lzo/lzo1x.h>
 
 #include "Common/CommonTypes.h"
 #include "Common/Event.h"
+#include "Common/StdMakeUnique.h"
 #include "Common/StringUtil.h"
+#include "Common/ThreadPool.h"
 #include "Common/Timer.h"
 
 #include "Core/ConfigManager.h"
 #include "Core/Core.h"
 #include "Core/CoreTiming.h"
 #include "Core/Movie.h"
+#include "Core/Rewind.h"
 #include "Core/State.h"
 #include "Core/HW/CPU.h"
 #include "Core/HW/DSP.h"
@@ -31,22 +37,35 @@
 namespace State
 {
 
-#if defined(__LZO_STRICT_16BIT)
-static const u32 IN_LEN = 8 * 1024u;
-#elif defined(LZO_ARCH_I086) && !defined(LZO_HAVE_MM_HUGE_ARRAY)
-static const u32 IN_LEN = 60 * 1024u;
-#else
-static const u32 IN_LEN = 128 * 1024u;
-#endif
-
-static const u32 OUT_LEN = IN_LEN + (IN_LEN / 16) + 64 + 3;
+// Compressed states are made of independent LZO chunks, so that they can be
+// compressed and decompressed on all cores at once. After the StateHeader
+// comes a ChunkedStateHeader, then the compressed size of every chunk, then
+// the chunks themselves back to back. Every chunk except the last one holds
+// chunk_size bytes of state, so any part of the state can be found without
+// touching the chunks before it.
+//
+// Older versions wrote a plain sequence of (u32 length, LZO data) pairs of
+// at most IN_LEN bytes of state each instead. Those still load; they are
+// told apart by the first word, which can't be the magic for them.
+static const u32 CHUNKED_STATE_MAGIC = 0x4B4E4843; // "CHNK"
+static const u32 CHUNK_SIZE = 1024 * 1024;
+
+struct ChunkedStateHeader
+{
+	u32 magic;
+	u32 chunk_size;
+	u32 num_chunks;
+};
 
-static unsigned char __LZO_MMODEL out[OUT_LEN];
+static u32 LZOBound(u32 len)
+{
+	return len + (len / 16) + 64 + 3;
+}
 
-#define HEAP_ALLOC(var, size) \
-	lzo_align_t __LZO_MMODEL var[((size) + (sizeof(lzo_align_t) - 1)) / sizeof(lzo_align_t)]
+// The chunk size of the old format.
+static const u32 IN_LEN = 128 * 1024u;
 
-static HEAP_ALLOC(wrkmem, LZO1X_1_MEM_COMPRESS);
+static std::unique_ptr<Common::ThreadPool> s_compression_pool;
 
 static std::string g_last_filename;
 
@@ -64,7 +83,7 @@ static Common::Event g_compressAndDumpStateSyncEvent;
 static std::thread g_save_thread;
 
 // Don't forget to increase this after doing changes on the savestate system
-static const u32 STATE_VERSION = 38;
+static const u32 STATE_VERSION = 39;
 
 enum
 {
@@ -120,6 +139,9 @@ static void DoState(PointerWrap &p)
 #if defined(HAVE_LIBAV) || defined (WIN32)
 	AVIDump::DoState();
 #endif
+
+	if (p.GetMode() == PointerWrap::MODE_READ)
+		Rewind::OnStateLoaded();
 }
 
 void LoadFromBuffer(std::vector<u8>& buffer)
@@ -133,10 +155,8 @@ void LoadFromBuffer(std::vector<u8>& buffer)
 	Core::PauseAndLock(false, wasUnpaused);
 }
 
-void SaveToBuffer(std::vector<u8>& buffer)
+static void DoSaveToBuffer(std::vector<u8>& buffer)
 {
-	bool wasUnpaused = Core::PauseAndLock(true);
-
 	u8* ptr = nullptr;
 	PointerWrap p(&ptr, PointerWrap::MODE_MEASURE);
 
@@ -147,10 +167,22 @@ void SaveToBuffer(std::vector<u8>& buffer)
 	ptr = &buffer[0];
 	p.SetMode(PointerWrap::MODE_WRITE);
 	DoState(p);
+}
 
+void SaveToBuffer(std::vector<u8>& buffer)
+{
+	bool wasUnpaused = Core::PauseAndLock(true);
+	DoSaveToBuffer(buffer);
 	Core::PauseAndLock(false, wasUnpaused);
 }
 
+void SaveToBufferFromCPUThread(std::vector<u8>& buffer)
+{
+	Core::PauseAndLockFromCPUThread(true);
+	DoSaveToBuffer(buffer);
+	Core::PauseAndLockFromCPUThread(false);
+}
+
 void VerifyBuffer(std::vector<u8>& buffer)
 {
 	bool wasUnpaused = Core::PauseAndLock(true);
@@ -263,33 +295,30 @@ static void CompressAndDumpState(CompressAndDumpState_args save_args)
 
 	if (header.size != 0) // non-zero header size means the state is compressed
 	{
-		lzo_uint i = 0;
-		while (true)
-		{
-			lzo_uint32 cur_len = 0;
-			lzo_uint out_len = 0;
+		ChunkedStateHeader chunked_header;
+		chunked_header.magic = CHUNKED_STATE_MAGIC;
+		chunked_header.chunk_size = CHUNK_SIZE;
+		chunked_header.num_chunks = (u32)((buffer_size + CHUNK_SIZE - 1) / CHUNK_SIZE);
 
-			if ((i + IN_LEN) >= buffer_size)
-			{
-				cur_len = (lzo_uint32)(buffer_size - i);
-			}
-			else
-			{
-				cur_len = IN_LEN;
-			}
-
-			if (lzo1x_1_compress(buffer_data + i, cur_len, out, &out_len, wrkmem) != LZO_E_OK)
-				PanicAlertT("Internal LZO Error - compression failed");
+		std::vector<std::vector<u8>> chunks(chunked_header.num_chunks);
+		std::vector<u32> chunk_sizes(chunked_header.num_chunks);
 
-			// The size of the data to write is 'out_len'
-			f.WriteArray((lzo_uint32*)&out_len, 1);
-			f.WriteBytes(out, out_len);
+		s_compression_pool->ParallelFor(chunks.size(), [&](size_t i) {
+			const size_t offset = i * CHUNK_SIZE;
+			const u32 cur_len = (u32)std::min<size_t>(CHUNK_SIZE, buffer_size - offset);
+			std::vector<lzo_align_t> wrkmem((LZO1X_1_MEM_COMPRESS + sizeof(lzo_align_t) - 1) / sizeof(lzo_align_t));
 
-			if (cur_len != IN_LEN)
-				break;
+			chunks[i].resize(LZOBound(cur_len));
+			lzo_uint out_len = 0;
+			if (lzo1x_1_compress(buffer_data + offset, cur_len, chunks[i].data(), &out_len, wrkmem.data()) != LZO_E_OK)
+				PanicAlertT("Internal LZO Error - compression failed");
+			chunk_sizes[i] = (u32)out_len;
+		});
 
-			i += cur_len;
-		}
+		f.WriteArray(&chunked_header, 1);
+		f.WriteArray(chunk_sizes.data(), chunk_sizes.size());
+		for (size_t i = 0; i < chunks.size(); i++)
+			f.WriteBytes(chunks[i].data(), chunk_sizes[i]);
 	}
 	else // uncompressed
 	{
@@ -360,6 +389,101 @@ bool ReadHeader(const std::string& filename, StateHeader& header)
 	return true;
 }
 
+static bool ReadChunkedStateData(File::IOFile& f, const ChunkedStateHeader& chunked_header, std::vector<u8>& buffer)
+{
+	const size_t buffer_size = buffer.size();
+	const u32 chunk_size = chunked_header.chunk_size;
+	if (chunk_size == 0 || chunked_header.num_chunks != (buffer_size + chunk_size - 1) / chunk_size ||
+	    (u64)chunked_header.num_chunks * sizeof(u32) > f.GetSize() - f.Tell())
+	{
+		PanicAlertT("Internal LZO Error - the state's chunk table is corrupt");
+		return false;
+	}
+
+	std::vector<u32> chunk_sizes(chunked_header.num_chunks);
+	if (!f.ReadArray(chunk_sizes.data(), chunk_sizes.size()))
+		return false;
+
+	// Nothing compresses to more than LZOBound of its size, and the chunks can't
+	// be bigger than what's left of the file. Check before allocating anything
+	// from the sizes in a state that might be corrupt.
+	std::vector<size_t> chunk_offsets(chunk_sizes.size());
+	u64 compressed_size = 0;
+	for (size_t i = 0; i < chunk_sizes.size(); i++)
+	{
+		const size_t cur_len = std::min<size_t>(chunk_size, buffer_size - i * chunk_size);
+		if (chunk_sizes[i] > LZOBound((u32)cur_len))
+		{
+			PanicAlertT("Internal LZO Error - the state's chunk table is corrupt");
+			return false;
+		}
+		chunk_offsets[i] = (size_t)compressed_size;
+		compressed_size += chunk_sizes[i];
+	}
+
+	if (compressed_size > f.GetSize() - f.Tell())
+	{
+		PanicAlertT("Internal LZO Error - the state's chunk table is corrupt");
+		return false;
+	}
+
+	std::vector<u8> compressed((size_t)compressed_size);
+	if (!f.ReadBytes(compressed.data(), compressed.size()))
+	{
+		PanicAlertT("Internal LZO Error - the state is truncated");
+		return false;
+	}
+
+	std::atomic<bool> failed(false);
+	s_compression_pool->ParallelFor(chunk_sizes.size(), [&](size_t i) {
+		const size_t offset = i * chunk_size;
+		const size_t cur_len = std::min<size_t>(chunk_size, buffer_size - offset);
+		lzo_uint new_len = (lzo_uint)cur_len;
+		const int res = lzo1x_decompress_safe(&compressed[chunk_offsets[i]], chunk_sizes[i],
+		                                      &buffer[offset], &new_len, nullptr);
+		if (res != LZO_E_OK || new_len != cur_len)
+			failed = true;
+	});
+
+	if (failed)
+	{
+		PanicAlertT("Internal LZO Error - decompression failed\n"
+			"Try loading the state again");
+		return false;
+	}
+
+	return true;
+}
+
+static bool ReadLegacyStateData(File::IOFile& f, std::vector<u8>& buffer)
+{
+	std::vector<u8> out(LZOBound(IN_LEN));
+
+	lzo_uint i = 0;
+	while (true)
+	{
+		lzo_uint32 cur_len = 0;  // number of bytes to read
+		lzo_uint new_len = 0;  // number of bytes to write
+
+		if (!f.ReadArray(&cur_len, 1))
+			break;
+
+		f.ReadBytes(out.data(), cur_len);
+		const int res = lzo1x_decompress(out.data(), cur_len, &buffer[i], &new_len, nullptr);
+		if (res != LZO_E_OK)
+		{
+			// This doesn't seem to happen anymore.
+			PanicAlertT("Internal LZO Error - decompression failed (%d) (%li, %li) \n"
+				"Try loading the state again", res, i, new_len);
+			return false;
+		}
+
+		i += new_len;
+	}
+
+	return true;
+}
+
 static void LoadFileStateData(const std::string& filename, std::vector<u8>& ret_data)
 {
 	Flush();
@@ -388,26 +512,22 @@ static void LoadFileStateData(const std::string& filename, std::vector<u8>& ret_
 
 		buffer.resize(header.size);
 
-		lzo_uint i = 0;
-		while (true)
-		{
-			lzo_uint32 cur_len = 0;  // number of bytes to read
-			lzo_uint new_len = 0;  // number of bytes to write
-
-			if (!f.ReadArray(&cur_len, 1))
-				break;
+		ChunkedStateHeader chunked_header = {};
+		const u64 data_start = f.Tell();
+		f.ReadArray(&chunked_header, 1);
 
-			f.ReadBytes(out, cur_len);
-			const int res = lzo1x_decompress(out, cur_len, &buffer[i], &new_len, nullptr);
-			if (res != LZO_E_OK)
-			{
-				// This doesn't seem to happen anymore.
-				PanicAlertT("Internal LZO Error - decompression failed (%d) (%li, %li) \n"
-					"Try loading the state again", res, i, new_len);
+		if (chunked_header.magic == CHUNKED_STATE_MAGIC)
+		{
+			if (!ReadChunkedStateData(f, chunked_header, buffer))
+				return;
+		}
+		else
+		{
+			// Very short legacy states don't even fill a ChunkedStateHeader.
+			f.Clear();
+			f.Seek(data_start, SEEK_SET);
+			if (!ReadLegacyStateData(f, buffer))
 				return;
-			}
-
-			i += new_len;
 		}
 	}
 	else // uncompressed
@@ -527,11 +647,17 @@ void Init()
 {
 	if (lzo_init() != LZO_E_OK)
 		PanicAlertT("Internal LZO Error - lzo_init() failed");
+
+	s_compression_pool = std::make_unique<Common::ThreadPool>();
+
+	Rewind::Init();
 }
 
 void Shutdown()
 {
 	Flush();
+	Rewind::Shutdown();
+	s_compression_pool.reset();
 
 	// swapping with an empty vector, rather than clear()ing
 	// this gives a better guarantee to free the allocated memory right NOW (as opposed to, actually, never)
@@ -47,6 +47,8 @@ void LoadAs(const std::string &filename);
 void VerifyAt(const std::string &filename);
 
 void SaveToBuffer(std::vector<u8>& buffer);
+// For the CPU thread, which mustn't go through Core::PauseAndLock.
+void SaveToBufferFromCPUThread(std::vector<u8>& buffer);
 void LoadFromBuffer(std::vector<u8>& buffer);
 void VerifyBuffer(std::vector<u8>& buffer);
 
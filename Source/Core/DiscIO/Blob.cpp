@@ -2,13 +2,16 @@
 // Licensed under GPLv2
 // Refer to the license.txt file included.
 
+#include <algorithm>
 #include <cstddef>
 #include <cstring>
 #include <string>
+#include <vector>
 
 #include "Common/CDUtils.h"
 #include "Common/CommonTypes.h"
 #include "Common/FileUtil.h"
+#include "Common/Thread.h"
 
 #include "DiscIO/Blob.h"
 #include "DiscIO/CISOBlob.h"
@@ -23,36 +26,192 @@ namespace DiscIO
 // Provides caching and split-operation-to-block-operations facilities.
 // Used for compressed blob reading and direct drive reading.
 
-void SectorReader::SetSectorSize(int blocksize)
+// Number of consecutive block reads after which read-ahead kicks in.
+static const u32 SEQUENTIAL_READS_THRESHOLD = 2;
+
+void SectorReader::SetSectorSize(int blocksize, u32 cache_blocks)
 {
-	for (int i = 0; i < CACHE_SIZE; i++)
-	{
-		m_cache[i] = new u8[blocksize];
-		m_cache_tags[i] = (u64)(s64) - 1;
-	}
+	// At least two slots are needed so that read-ahead never has to evict the pinned slot.
+	cache_blocks = std::max<u32>(cache_blocks, 2);
+
+	std::lock_guard<std::mutex> lk(m_cache_lock);
+	m_cache.assign(cache_blocks, std::vector<u8>(blocksize));
+	m_cache_tags.assign(cache_blocks, (u64)(s64)-1);
+	m_cache_age.assign(cache_blocks, 0);
+	m_pinned_slot = -1;
 	m_blocksize = blocksize;
 }
 
 SectorReader::~SectorReader()
 {
-	for (u8*& block : m_cache)
+	StopReadAhead();
+}
+
+void SectorReader::SetReadAhead(u32 num_blocks)
+{
+	std::unique_lock<std::mutex> lk(m_cache_lock);
+	m_read_ahead_blocks = std::min<u32>(num_blocks, (u32)m_cache.size() / 2);
+	m_read_ahead_next = m_read_ahead_end = 0;
+
+	if (m_read_ahead_blocks && !m_read_ahead_thread.joinable())
+	{
+		m_read_ahead_quit = false;
+		m_read_ahead_thread = std::thread(&SectorReader::ReadAheadThread, this);
+	}
+	else if (!m_read_ahead_blocks && m_read_ahead_thread.joinable())
+	{
+		lk.unlock();
+		StopReadAhead();
+	}
+}
+
+void SectorReader::StopReadAhead()
+{
+	if (!m_read_ahead_thread.joinable())
+		return;
+
+	{
+		std::lock_guard<std::mutex> lk(m_cache_lock);
+		m_read_ahead_quit = true;
+	}
+	m_read_ahead_cv.notify_one();
+	m_read_ahead_thread.join();
+}
+
+int SectorReader::FindCacheEntry(u64 block_num) const
+{
+	for (size_t i = 0; i < m_cache_tags.size(); i++)
 	{
-		delete [] block;
+		if (m_cache_tags[i] == block_num)
+			return (int)i;
 	}
+	return -1;
+}
+
+int SectorReader::GetEvictionSlot() const
+{
+	int oldest = -1;
+	for (int i = 0; i < (int)m_cache_age.size(); i++)
+	{
+		if (i == m_pinned_slot)
+			continue;
+		if (oldest == -1 || m_cache_age[i] < m_cache_age[oldest])
+			oldest = i;
+	}
+	return oldest;
+}
+
+void SectorReader::TouchCacheEntry(int slot, u64 block_num)
+{
+	m_cache_tags[slot] = block_num;
+	m_cache_age[slot] = ++m_cache_clock;
 }
 
 const u8 *SectorReader::GetBlockData(u64 block_num)
 {
-	// TODO : Expand usage of the cache to more than one block :P
-	if (m_cache_tags[0] == block_num)
+	std::unique_lock<std::mutex> cache_lk(m_cache_lock);
+
+	if (block_num == m_last_block + 1)
+		m_sequential_run++;
+	else if (block_num != m_last_block)
+		m_sequential_run = 0;
+	m_last_block = block_num;
+
+	if (m_read_ahead_blocks && m_sequential_run >= SEQUENTIAL_READS_THRESHOLD)
+	{
+		u64 num_blocks = (GetDataSize() + m_blocksize - 1) / m_blocksize;
+		u64 first = block_num + 1;
+		u64 end = std::min<u64>(first + m_read_ahead_blocks, num_blocks);
+		// Restart the window if the pending one doesn't overlap this run.
+		if (m_read_ahead_next < first || m_read_ahead_next > end)
+			m_read_ahead_next = first;
+		m_read_ahead_end = end;
+		if (m_read_ahead_next < m_read_ahead_end)
+			m_read_ahead_cv.notify_one();
+	}
+
+	int slot = FindCacheEntry(block_num);
+	if (slot != -1)
 	{
-		return m_cache[0];
+		m_cache_hits++;
+		TouchCacheEntry(slot, block_num);
+		m_pinned_slot = slot;
+		return m_cache[slot].data();
+	}
+
+	// Lock order is always m_io_lock, then m_cache_lock.
+	cache_lk.unlock();
+	std::lock_guard<std::mutex> io_lk(m_io_lock);
+	cache_lk.lock();
+
+	// The read-ahead thread may have fetched it while we were waiting.
+	slot = FindCacheEntry(block_num);
+	if (slot != -1)
+	{
+		m_cache_hits++;
 	}
 	else
 	{
-		GetBlock(block_num, m_cache[0]);
-		m_cache_tags[0] = block_num;
-		return m_cache[0];
+		m_cache_misses++;
+		slot = GetEvictionSlot();
+		m_cache_tags[slot] = (u64)(s64)-1;
+		m_pinned_slot = slot;
+		cache_lk.unlock();
+
+		GetBlock(block_num, m_cache[slot].data());
+
+		cache_lk.lock();
+	}
+
+	TouchCacheEntry(slot, block_num);
+	m_pinned_slot = slot;
+	return m_cache[slot].data();
+}
+
+CacheStats SectorReader::GetCacheStats()
+{
+	std::lock_guard<std::mutex> lk(m_cache_lock);
+	CacheStats stats;
+	stats.hits = m_cache_hits;
+	stats.misses = m_cache_misses;
+	return stats;
+}
+
+void SectorReader::ReadAheadThread()
+{
+	Common::SetCurrentThreadName("Blob read-ahead thread");
+
+	std::vector<u8> buffer(m_blocksize);
+	std::unique_lock<std::mutex> cache_lk(m_cache_lock);
+
+	while (true)
+	{
+		m_read_ahead_cv.wait(cache_lk, [this] {
+			return m_read_ahead_quit || m_read_ahead_next < m_read_ahead_end;
+		});
+		if (m_read_ahead_quit)
+			return;
+
+		u64 block_num = m_read_ahead_next++;
+		if (FindCacheEntry(block_num) != -1)
+			continue;
+
+		cache_lk.unlock();
+		std::lock_guard<std::mutex> io_lk(m_io_lock);
+		cache_lk.lock();
+
+		if (m_read_ahead_quit)
+			return;
+		if (FindCacheEntry(block_num) != -1)
+			continue;
+
+		cache_lk.unlock();
+		GetBlock(block_num, buffer.data());
+		cache_lk.lock();
+
+		int slot = GetEvictionSlot();
+		std::swap(m_cache[slot], buffer);
+		TouchCacheEntry(slot, block_num);
 	}
 }
 
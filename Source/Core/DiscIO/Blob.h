@@ -14,12 +14,26 @@
 // detect whether the file is a compressed blob, or just a big hunk of data, or a drive, and
 // automatically do the right thing.
 
+#include <condition_variable>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <vector>
+
 #include "Common/CommonTypes.h"
 
 namespace DiscIO
 {
 
+class DedupIndex;
+
+// How often a cache had what it was asked for. Used for benchmarking.
+struct CacheStats
+{
+	u64 hits;
+	u64 misses;
+};
+
 class IBlobReader
 {
 public:
@@ -30,6 +44,13 @@ public:
 	// NOT thread-safe - can't call this from multiple threads.
 	virtual bool Read(u64 offset, u64 size, u8* out_ptr) = 0;
 
+	// Readers without a cache report no hits and no misses.
+	virtual CacheStats GetCacheStats()
+	{
+		CacheStats stats = {};
+		return stats;
+	}
+
 protected:
 	IBlobReader() {}
 };
@@ -37,7 +58,8 @@ protected:
 
 // Provides caching and split-operation-to-block-operations facilities.
 // Used for compressed blob reading and direct drive reading.
-// Currently only uses a single entry cache.
+// Keeps a small LRU cache of blocks, and can optionally prefetch the blocks
+// following a sequential run of reads on a background thread.
 // Multi-block reads are not cached.
 class SectorReader : public IBlobReader
 {
@@ -47,20 +69,61 @@ public:
 	// A pointer returned by GetBlockData is invalidated as soon as GetBlockData, Read, or ReadMultipleAlignedBlocks is called again.
 	const u8 *GetBlockData(u64 block_num);
 	virtual bool Read(u64 offset, u64 size, u8 *out_ptr) override;
+	// Blocks returned by GetBlockData. Blocks brought in by read-ahead count as hits.
+	CacheStats GetCacheStats() override;
+
+	// Prefetches up to num_blocks blocks ahead once sequential access is detected. 0 disables read-ahead.
+	// Clamped so that prefetching can never evict the block most recently returned by GetBlockData.
+	void SetReadAhead(u32 num_blocks);
+
 	friend class DriveReader;
 
 protected:
-	void SetSectorSize(int blocksize);
+	enum { DEFAULT_CACHE_BLOCKS = 32 };
+
+	void SetSectorSize(int blocksize, u32 cache_blocks = DEFAULT_CACHE_BLOCKS);
+	// Derived classes that enable read-ahead must call this in their destructor,
+	// since the read-ahead thread calls GetBlock.
+	void StopReadAhead();
 	virtual void GetBlock(u64 block_num, u8 *out) = 0;
 	// This one is uncached. The default implementation is to simply call GetBlockData multiple times and memcpy.
 	virtual bool ReadMultipleAlignedBlocks(u64 block_num, u64 num_blocks, u8 *out_ptr);
 
+	// Held around every GetBlock call. Overrides of ReadMultipleAlignedBlocks
+	// that access the underlying file directly must hold it as well.
+	std::mutex m_io_lock;
+
 private:
-	enum { CACHE_SIZE = 32 };
+	// All of these require m_cache_lock to be held.
+	int FindCacheEntry(u64 block_num) const;
+	int GetEvictionSlot() const;
+	void TouchCacheEntry(int slot, u64 block_num);
+
+	void ReadAheadThread();
+
 	int m_blocksize;
-	u8* m_cache[CACHE_SIZE];
-	u64 m_cache_tags[CACHE_SIZE];
-	int m_cache_age[CACHE_SIZE];
+
+	std::mutex m_cache_lock;
+	std::vector<std::vector<u8>> m_cache;
+	std::vector<u64> m_cache_tags;
+	std::vector<u64> m_cache_age;
+	u64 m_cache_clock = 0;
+	u64 m_cache_hits = 0;
+	u64 m_cache_misses = 0;
+	// The slot returned by the last GetBlockData call, which must not be evicted by the read-ahead thread.
+	int m_pinned_slot = -1;
+
+	// Sequential access detection
+	u64 m_last_block = (u64)(s64)-1;
+	u32 m_sequential_run = 0;
+
+	// Read-ahead state, protected by m_cache_lock
+	u32 m_read_ahead_blocks = 0;
+	u64 m_read_ahead_next = 0;
+	u64 m_read_ahead_end = 0;
+	bool m_read_ahead_quit = false;
+	std::condition_variable m_read_ahead_cv;
+	std::thread m_read_ahead_thread;
 };
 
 // Factory function - examines the path to choose the right type of IBlobReader, and returns one.
@@ -68,8 +131,9 @@ IBlobReader* CreateBlobReader(const std::string& filename);
 
 typedef bool (*CompressCB)(const std::string& text, float percent, void* arg);
 
+// If dedup is given, the content hashes of the image's blocks get added to it.
 bool CompressFileToBlob(const std::string& infile, const std::string& outfile, u32 sub_type = 0, int sector_size = 16384,
-		CompressCB callback = nullptr, void *arg = nullptr);
+		CompressCB callback = nullptr, void *arg = nullptr, DedupIndex* dedup = nullptr);
 bool DecompressBlobToFile(const std::string& infile, const std::string& outfile,
 		CompressCB callback = nullptr, void *arg = nullptr);
 
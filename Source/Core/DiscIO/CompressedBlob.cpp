@@ -19,9 +19,12 @@
 #include "Common/CommonTypes.h"
 #include "Common/FileUtil.h"
 #include "Common/Hash.h"
+#include "Common/StdMakeUnique.h"
 #include "Common/StringUtil.h"
+#include "Common/ThreadPool.h"
 #include "DiscIO/Blob.h"
 #include "DiscIO/CompressedBlob.h"
+#include "DiscIO/DedupIndex.h"
 #include "DiscIO/DiscScrubber.h"
 
 
@@ -51,6 +54,8 @@ CompressedBlobReader::CompressedBlobReader(const std::string& filename) : m_file
 	m_zlib_buffer_size = m_header.block_size + 64;
 	m_zlib_buffer = new u8[m_zlib_buffer_size];
 	memset(m_zlib_buffer, 0, m_zlib_buffer_size);
+
+	SetReadAhead(READ_AHEAD_BLOCKS);
 }
 
 CompressedBlobReader* CompressedBlobReader::Create(const std::string& filename)
@@ -63,6 +68,7 @@ CompressedBlobReader* CompressedBlobReader::Create(const std::string& filename)
 
 CompressedBlobReader::~CompressedBlobReader()
 {
+	StopReadAhead();
 	delete [] m_zlib_buffer;
 	delete [] m_block_pointers;
 	delete [] m_hashes;
@@ -83,26 +89,24 @@ u64 CompressedBlobReader::GetBlockCompressedSize(u64 block_num) const
 
 void CompressedBlobReader::GetBlock(u64 block_num, u8 *out_ptr)
 {
-	bool uncompressed = false;
 	u32 comp_block_size = (u32)GetBlockCompressedSize(block_num);
 	u64 offset = m_block_pointers[block_num] + m_data_offset;
 
-	if (offset & (1ULL << 63))
-	{
-		if (comp_block_size != m_header.block_size)
-			PanicAlert("Uncompressed block with wrong size");
-		uncompressed = true;
-		offset &= ~(1ULL << 63);
-	}
-
 	// clear unused part of zlib buffer. maybe this can be deleted when it works fully.
 	memset(m_zlib_buffer + comp_block_size, 0, m_zlib_buffer_size - comp_block_size);
 
-	m_file.Seek(offset, SEEK_SET);
+	m_file.Seek(offset & ~(1ULL << 63), SEEK_SET);
 	m_file.ReadBytes(m_zlib_buffer, comp_block_size);
 
-	u8* source = m_zlib_buffer;
-	u8* dest = out_ptr;
+	DecompressBlock(block_num, m_zlib_buffer, comp_block_size, out_ptr);
+}
+
+// Only touches the given buffers and immutable header data, so it can run on several threads at once.
+void CompressedBlobReader::DecompressBlock(u64 block_num, const u8* source, u32 comp_block_size, u8* dest) const
+{
+	bool uncompressed = (m_block_pointers[block_num] & (1ULL << 63)) != 0;
+	if (uncompressed && comp_block_size != m_header.block_size)
+		PanicAlert("Uncompressed block with wrong size");
 
 	// First, check hash.
 	u32 block_hash = HashAdler32(source, comp_block_size);
@@ -120,7 +124,7 @@ void CompressedBlobReader::GetBlock(u64 block_num, u8 *out_ptr)
 	{
 		z_stream z;
 		memset(&z, 0, sizeof(z));
-		z.next_in  = source;
+		z.next_in  = const_cast<u8*>(source);
 		z.avail_in = comp_block_size;
 		if (z.avail_in > m_header.block_size)
 		{
@@ -143,9 +147,127 @@ void CompressedBlobReader::GetBlock(u64 block_num, u8 *out_ptr)
 	}
 }
 
+bool CompressedBlobReader::ReadMultipleAlignedBlocks(u64 block_num, u64 num_blocks, u8* out_ptr)
+{
+	if (block_num + num_blocks > m_header.num_blocks)
+		return false;
+
+	std::lock_guard<std::mutex> lk(m_io_lock);
+
+	if (!m_pool)
+		m_pool = std::make_unique<Common::ThreadPool>();
+
+	while (num_blocks > 0)
+	{
+		const u64 batch_blocks = std::min<u64>(num_blocks, MAX_BATCH_BLOCKS);
+
+		// Blocks are stored back to back, so the whole batch is one contiguous read.
+		u64 start = m_block_pointers[block_num] & ~(1ULL << 63);
+		std::vector<u64> block_offsets(batch_blocks + 1);
+		for (u64 i = 0; i < batch_blocks; i++)
+			block_offsets[i] = (m_block_pointers[block_num + i] & ~(1ULL << 63)) - start;
+		block_offsets[batch_blocks] = block_offsets[batch_blocks - 1] + GetBlockCompressedSize(block_num + batch_blocks - 1);
+
+		m_batch_buffer.resize((size_t)block_offsets[batch_blocks]);
+		m_file.Seek(start + m_data_offset, SEEK_SET);
+		if (!m_file.ReadBytes(m_batch_buffer.data(), m_batch_buffer.size()))
+			return false;
+
+		m_pool->ParallelFor((size_t)batch_blocks, [&](size_t i) {
+			DecompressBlock(block_num + i, m_batch_buffer.data() + block_offsets[i],
+			                (u32)(block_offsets[i + 1] - block_offsets[i]),
+			                out_ptr + i * m_header.block_size);
+		});
+
+		block_num += batch_blocks;
+		num_blocks -= batch_blocks;
+		out_ptr += batch_blocks * m_header.block_size;
+	}
+
+	return true;
+}
+
+namespace
+{
+
+// How many blocks each thread gets per batch when compressing.
+const u32 BATCH_BLOCKS_PER_THREAD = 4;
+
+// Per-block state for the compression workers. Each one owns its own
+// zlib stream so that blocks of a batch can be deflated independently.
+struct CompressJob
+{
+	z_stream z;
+	std::vector<u8> in_buf;
+	std::vector<u8> out_buf;
+	int comp_size;
+	bool stored;
+	bool failed;
+	u32 hash;
+	// Unused according to the scrubber. Not read from the disc at all.
+	bool scrubbed;
+	DedupIndex::BlockHash content_hash;
+};
+
+// Reads the next count blocks into the jobs, in disc order. Blocks that the
+// scrubber says aren't used are skipped over and left to PrepareBlock.
+void ReadBlocks(File::IOFile& in, const DiscScrubber* scrubber, u64 first_block, u32 count,
+                int block_size, std::vector<CompressJob>& jobs)
+{
+	for (u32 j = 0; j < count; j++)
+	{
+		CompressJob& job = jobs[j];
+		job.scrubbed = scrubber && scrubber->CanBlockBeScrubbed((first_block + j) * block_size);
+		if (job.scrubbed)
+		{
+			in.Seek(block_size, SEEK_CUR);
+			continue;
+		}
+
+		size_t read_bytes;
+		in.ReadArray(job.in_buf.data(), block_size, &read_bytes);
+		if (read_bytes < (size_t)block_size)
+			std::fill(job.in_buf.begin() + read_bytes, job.in_buf.end(), 0);
+	}
+}
+
+// The part of a block's processing that doesn't depend on the output format.
+// Runs on the worker threads.
+void PrepareBlock(CompressJob& job, int block_size, bool hash_content)
+{
+	if (job.scrubbed)
+		std::fill(job.in_buf.begin(), job.in_buf.end(), 0xFF);
+	if (hash_content)
+		job.content_hash = DedupIndex::HashBlock(job.in_buf.data(), block_size);
+}
+
+void CompressBlock(CompressJob& job, int block_size)
+{
+	job.failed = deflateReset(&job.z) != Z_OK;
+	if (job.failed)
+		return;
+
+	job.z.next_in   = job.in_buf.data();
+	job.z.avail_in  = block_size;
+	job.z.next_out  = job.out_buf.data();
+	job.z.avail_out = block_size;
+
+	int status = deflate(&job.z, Z_FINISH);
+	job.comp_size = block_size - job.z.avail_out;
+	// Blocks that don't compress well enough are stored as-is.
+	job.stored = (status != Z_STREAM_END) || (job.z.avail_out < 10);
+	if (job.stored)
+		job.hash = HashAdler32(job.in_buf.data(), block_size);
+	else
+		job.hash = HashAdler32(job.out_buf.data(), job.comp_size);
+}
+
+}  // namespace
+
 bool CompressFileToBlob(const std::string& infile, const std::string& outfile, u32 sub_type,
-						int block_size, CompressCB callback, void* arg)
+						int block_size, CompressCB callback, void* arg, DedupIndex* dedup)
 {
+	DiscScrubber disc_scrubber;
 	bool scrubbing = false;
 
 	if (IsCompressedBlob(infile))
@@ -156,7 +278,7 @@ bool CompressFileToBlob(const std::string& infile, const std::string& outfile, u
 
 	if (sub_type == 1)
 	{
-		if (!DiscScrubber::SetupScrub(infile, block_size))
+		if (!disc_scrubber.SetupScrub(infile, block_size))
 		{
 			PanicAlertT("%s failed to be scrubbed. Probably the image is corrupt.", infile.c_str());
 			return false;
@@ -165,20 +287,35 @@ bool CompressFileToBlob(const std::string& infile, const std::string& outfile, u
 		scrubbing = true;
 	}
 
-	z_stream z = {};
-	if (deflateInit(&z, 9) != Z_OK)
-		return false;
-
 	File::IOFile inf(infile, "rb");
 	File::IOFile f(outfile, "wb");
 
 	if (!f || !inf)
-	{
-		deflateEnd(&z);
 		return false;
+
+	// Blocks are read on this thread, blanked, hashed and deflated a batch at a time
+	// across all cores, and then written out in order. The output is identical to
+	// compressing one block at a time.
+	Common::ThreadPool pool;
+	std::vector<CompressJob> jobs(pool.GetThreadCount() * BATCH_BLOCKS_PER_THREAD);
+	for (CompressJob& job : jobs)
+	{
+		job.z = {};
+		job.in_buf.resize(block_size);
+		job.out_buf.resize(block_size);
 	}
+	size_t num_streams = 0;
+	for (; num_streams < jobs.size(); num_streams++)
+	{
+		if (deflateInit(&jobs[num_streams].z, 9) != Z_OK)
+			break;
+	}
+
+	bool success = num_streams == jobs.size();
+	bool was_cancelled = false;
 
-	callback("Files opened, ready to compress.", 0, arg);
+	if (success)
+		callback("Files opened, ready to compress.", 0, arg);
 
 	CompressedBlobHeader header;
 	header.magic_cookie = kBlobCookie;
@@ -189,10 +326,9 @@ bool CompressFileToBlob(const std::string& infile, const std::string& outfile, u
 	// round upwards!
 	header.num_blocks = (u32)((header.data_size + (block_size - 1)) / block_size);
 
-	u64* offsets = new u64[header.num_blocks];
-	u32* hashes = new u32[header.num_blocks];
-	u8* out_buf = new u8[block_size];
-	u8* in_buf = new u8[block_size];
+	std::vector<u64> offsets(header.num_blocks);
+	std::vector<u32> hashes(header.num_blocks);
+	std::vector<DedupIndex::BlockHash> content_hashes(dedup ? header.num_blocks : 0);
 
 	// seek past the header (we will write it at the end)
 	f.Seek(sizeof(CompressedBlobHeader), SEEK_CUR);
@@ -204,71 +340,68 @@ bool CompressFileToBlob(const std::string& infile, const std::string& outfile, u
 	int num_compressed = 0;
 	int num_stored = 0;
 	int progress_monitor = std::max<int>(1, header.num_blocks / 1000);
-	bool was_cancelled = false;
 
-	for (u32 i = 0; i < header.num_blocks; i++)
+	for (u32 batch_start = 0; success && !was_cancelled && batch_start < header.num_blocks; batch_start += (u32)jobs.size())
 	{
-		if (i % progress_monitor == 0)
-		{
-			const u64 inpos = inf.Tell();
-			int ratio = 0;
-			if (inpos != 0)
-				ratio = (int)(100 * position / inpos);
+		const u32 batch_blocks = std::min<u32>((u32)jobs.size(), header.num_blocks - batch_start);
 
-			std::string temp = StringFromFormat("%i of %i blocks. Compression ratio %i%%", i, header.num_blocks, ratio);
-			was_cancelled = !callback(temp, (float)i / (float)header.num_blocks, arg);
-			if (was_cancelled)
-				break;
-		}
+		ReadBlocks(inf, scrubbing ? &disc_scrubber : nullptr, batch_start, batch_blocks, block_size, jobs);
 
-		offsets[i] = position;
+		pool.ParallelFor(batch_blocks, [&](size_t j) {
+			PrepareBlock(jobs[j], block_size, dedup != nullptr);
+			CompressBlock(jobs[j], block_size);
+		});
 
-		size_t read_bytes;
-		if (scrubbing)
-			read_bytes = DiscScrubber::GetNextBlock(inf, in_buf);
-		else
-			inf.ReadArray(in_buf, header.block_size, &read_bytes);
-		if (read_bytes < header.block_size)
-			std::fill(in_buf + read_bytes, in_buf + header.block_size, 0);
-
-		int retval = deflateReset(&z);
-		z.next_in   = in_buf;
-		z.avail_in  = header.block_size;
-		z.next_out  = out_buf;
-		z.avail_out = block_size;
-
-		if (retval != Z_OK)
+		for (u32 j = 0; j < batch_blocks; j++)
 		{
-			ERROR_LOG(DISCIO, "Deflate failed");
-			goto cleanup;
-		}
-
-		int status = deflate(&z, Z_FINISH);
-		int comp_size = block_size - z.avail_out;
-		if ((status != Z_STREAM_END) || (z.avail_out < 10))
-		{
-			//PanicAlert("%i %i Store %i", i*block_size, position, comp_size);
-			// let's store uncompressed
-			offsets[i] |= 0x8000000000000000ULL;
-			f.WriteBytes(in_buf, block_size);
-			hashes[i] = HashAdler32(in_buf, block_size);
-			position += block_size;
-			num_stored++;
-		}
-		else
-		{
-			// let's store compressed
-			//PanicAlert("Comp %i to %i", block_size, comp_size);
-			f.WriteBytes(out_buf, comp_size);
-			hashes[i] = HashAdler32(out_buf, comp_size);
-			position += comp_size;
-			num_compressed++;
+			const u32 i = batch_start + j;
+			const CompressJob& job = jobs[j];
+
+			if (i % progress_monitor == 0)
+			{
+				int ratio = 0;
+				if (i != 0)
+					ratio = (int)(100 * position / ((u64)i * block_size));
+
+				std::string temp = StringFromFormat("%i of %i blocks. Compression ratio %i%%", i, header.num_blocks, ratio);
+				was_cancelled = !callback(temp, (float)i / (float)header.num_blocks, arg);
+				if (was_cancelled)
+					break;
+			}
+
+			if (job.failed)
+			{
+				ERROR_LOG(DISCIO, "Deflate failed");
+				success = false;
+				break;
+			}
+
+			offsets[i] = position;
+			hashes[i] = job.hash;
+			if (dedup)
+				content_hashes[i] = job.content_hash;
+
+			if (job.stored)
+			{
+				// let's store uncompressed
+				offsets[i] |= 0x8000000000000000ULL;
+				f.WriteBytes(job.in_buf.data(), block_size);
+				position += block_size;
+				num_stored++;
+			}
+			else
+			{
+				// let's store compressed
+				f.WriteBytes(job.out_buf.data(), job.comp_size);
+				position += job.comp_size;
+				num_compressed++;
+			}
 		}
 	}
 
 	header.compressed_data_size = position;
 
-	if (was_cancelled)
+	if (was_cancelled || !success)
 	{
 		// Remove the incomplete output file.
 		f.Close();
@@ -279,22 +412,19 @@ bool CompressFileToBlob(const std::string& infile, const std::string& outfile, u
 		// Okay, go back and fill in headers
 		f.Seek(0, SEEK_SET);
 		f.WriteArray(&header, 1);
-		f.WriteArray(offsets, header.num_blocks);
-		f.WriteArray(hashes, header.num_blocks);
+		f.WriteArray(offsets.data(), header.num_blocks);
+		f.WriteArray(hashes.data(), header.num_blocks);
+
+		if (dedup)
+			dedup->AddImage(infile, content_hashes);
 	}
 
-cleanup:
 	// Cleanup
-	delete[] in_buf;
-	delete[] out_buf;
-	delete[] offsets;
-	delete[] hashes;
+	for (size_t i = 0; i < num_streams; i++)
+		deflateEnd(&jobs[i].z);
 
-	deflateEnd(&z);
-
-	DiscScrubber::Cleanup();
 	callback("Done compressing disc image.", 1.0f, arg);
-	return true;
+	return success;
 }
 
 bool DecompressBlobToFile(const std::string& infile, const std::string& outfile, CompressCB callback, void* arg)
@@ -314,10 +444,11 @@ bool DecompressBlobToFile(const std::string& infile, const std::string& outfile,
 		return false;
 
 	const CompressedBlobHeader &header = reader->GetHeader();
-	static const size_t BUFFER_BLOCKS = 32;
-	size_t buffer_size = header.block_size * BUFFER_BLOCKS;
-	std::vector<u8> buffer(buffer_size);
-	u32 num_buffers = header.num_blocks / BUFFER_BLOCKS;
+	// Each buffer is decompressed in parallel by the reader, so make it big enough to keep every core busy.
+	const size_t buffer_blocks = std::max<size_t>(32, Common::ThreadPool::GetDefaultThreadCount() * 4);
+	const u64 buffer_size = (u64)header.block_size * buffer_blocks;
+	std::vector<u8> buffer((size_t)buffer_size);
+	u32 num_buffers = (u32)((header.num_blocks + buffer_blocks - 1) / buffer_blocks);
 	int progress_monitor = std::max<int>(1, num_buffers / 100);
 	bool was_cancelled = false;
 
@@ -329,8 +460,10 @@ bool DecompressBlobToFile(const std::string& infile, const std::string& outfile,
 			if (was_cancelled)
 				break;
 		}
-		reader->Read(i * buffer_size, buffer_size, buffer.data());
-		f.WriteBytes(buffer.data(), buffer_size);
+		const u64 offset = i * buffer_size;
+		const u64 size = std::min<u64>(buffer_size, header.data_size - offset);
+		reader->Read(offset, size, buffer.data());
+		f.WriteBytes(buffer.data(), (size_t)size);
 	}
 
 	if (was_cancelled)
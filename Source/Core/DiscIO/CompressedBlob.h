@@ -14,10 +14,13 @@
 
 #pragma once
 
+#include <memory>
 #include <string>
+#include <vector>
 
 #include "Common/CommonTypes.h"
 #include "Common/FileUtil.h"
+#include "Common/ThreadPool.h"
 #include "DiscIO/Blob.h"
 
 namespace DiscIO
@@ -53,8 +56,17 @@ public:
 	u64 GetRawSize() const override { return m_file_size; }
 	u64 GetBlockCompressedSize(u64 block_num) const;
 	void GetBlock(u64 block_num, u8* out_ptr) override;
+	// Reads the whole run of compressed blocks at once and decompresses them in parallel.
+	bool ReadMultipleAlignedBlocks(u64 block_num, u64 num_blocks, u8* out_ptr) override;
 private:
+	enum
+	{
+		READ_AHEAD_BLOCKS = 8,
+		MAX_BATCH_BLOCKS = 64,
+	};
+
 	CompressedBlobReader(const std::string& filename);
+	void DecompressBlock(u64 block_num, const u8* source, u32 comp_block_size, u8* dest) const;
 
 	CompressedBlobHeader m_header;
 	u64* m_block_pointers;
@@ -65,6 +77,9 @@ private:
 	u8* m_zlib_buffer;
 	int m_zlib_buffer_size;
 	std::string m_file_name;
+	std::vector<u8> m_batch_buffer;
+	// Created on the first multi-block read, so that merely opening a GCZ doesn't spawn threads.
+	std::unique_ptr<Common::ThreadPool> m_pool;
 };
 
 }  // namespace
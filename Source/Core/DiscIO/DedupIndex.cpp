@@ -0,0 +1,107 @@
+// Copyright 2015 Dolphin Emulator Project
+// Licensed under GPLv2
+// Refer to the license.txt file included.
+
+#include <cinttypes>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <polarssl/sha1.h>
+
+#include "Common/CommonTypes.h"
+#include "Common/FileUtil.h"
+#include "DiscIO/DedupIndex.h"
+
+namespace DiscIO
+{
+
+DedupIndex::BlockHash DedupIndex::HashBlock(const u8* data, size_t size)
+{
+	BlockHash hash;
+	sha1(data, size, hash.data());
+	return hash;
+}
+
+void DedupIndex::AddImage(const std::string& name, const std::vector<BlockHash>& hashes)
+{
+	std::lock_guard<std::mutex> lk(m_lock);
+
+	const u32 index = (u32)m_images.size();
+	std::vector<u64> shared(m_images.size());
+
+	ImageInfo info;
+	info.name = name;
+	info.blocks = hashes.size();
+	info.new_blocks = 0;
+	info.most_shared_with = -1;
+	info.most_shared_blocks = 0;
+
+	for (const BlockHash& hash : hashes)
+	{
+		auto result = m_blocks.emplace(hash, index);
+		if (result.second)
+			info.new_blocks++;
+		else if (result.first->second != index)
+			shared[result.first->second]++;
+	}
+
+	for (u32 i = 0; i < shared.size(); i++)
+	{
+		if (shared[i] > info.most_shared_blocks)
+		{
+			info.most_shared_with = i;
+			info.most_shared_blocks = shared[i];
+		}
+	}
+
+	m_images.push_back(info);
+	m_total_blocks += hashes.size();
+}
+
+size_t DedupIndex::GetImageCount() const
+{
+	std::lock_guard<std::mutex> lk(m_lock);
+	return m_images.size();
+}
+
+u64 DedupIndex::GetTotalBlocks() const
+{
+	std::lock_guard<std::mutex> lk(m_lock);
+	return m_total_blocks;
+}
+
+u64 DedupIndex::GetDistinctBlocks() const
+{
+	std::lock_guard<std::mutex> lk(m_lock);
+	return m_blocks.size();
+}
+
+bool DedupIndex::WriteReport(const std::string& filename) const
+{
+	std::lock_guard<std::mutex> lk(m_lock);
+
+	File::IOFile f(filename, "w");
+	if (!f)
+		return false;
+
+	fprintf(f.GetHandle(), "image\tblocks\tnew\tshared most with\n");
+	for (const ImageInfo& info : m_images)
+	{
+		fprintf(f.GetHandle(), "%s\t%" PRIu64 "\t%" PRIu64, info.name.c_str(), info.blocks, info.new_blocks);
+		if (info.most_shared_with >= 0)
+		{
+			fprintf(f.GetHandle(), "\t%s (%" PRIu64 " blocks)",
+			        m_images[info.most_shared_with].name.c_str(), info.most_shared_blocks);
+		}
+		fprintf(f.GetHandle(), "\n");
+	}
+
+	const u64 distinct_blocks = m_blocks.size();
+	fprintf(f.GetHandle(), "\n%" PRIu64 " blocks of %u bytes, %" PRIu64 " distinct, %" PRIu64 " MiB saved by deduplication\n",
+	        m_total_blocks, m_block_size, distinct_blocks,
+	        (m_total_blocks - distinct_blocks) * m_block_size / (1024 * 1024));
+
+	return true;
+}
+
+}  // namespace
@@ -0,0 +1,78 @@
+// Copyright 2015 Dolphin Emulator Project
+// Licensed under GPLv2
+// Refer to the license.txt file included.
+
+// DedupIndex finds the blocks that disc images have in common, so that a
+// library of images can be stored with every distinct block only once.
+// Blocks are told apart by the SHA-1 of their contents; the images have to be
+// cut into blocks of the same size for the comparison to mean anything.
+
+#pragma once
+
+#include <array>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Common/CommonTypes.h"
+
+namespace DiscIO
+{
+
+class DedupIndex final
+{
+public:
+	typedef std::array<u8, 20> BlockHash;
+
+	explicit DedupIndex(u32 block_size) : m_block_size(block_size) {}
+
+	u32 GetBlockSize() const { return m_block_size; }
+
+	static BlockHash HashBlock(const u8* data, size_t size);
+
+	// Adds the blocks of one image, in disc order. Can be called from several
+	// threads at once.
+	void AddImage(const std::string& name, const std::vector<BlockHash>& hashes);
+
+	size_t GetImageCount() const;
+	u64 GetTotalBlocks() const;
+	u64 GetDistinctBlocks() const;
+
+	// One line per image: its size in blocks, how many of them weren't in
+	// any image added before it, and which earlier image it shares the most
+	// blocks with. The totals go at the end.
+	bool WriteReport(const std::string& filename) const;
+
+private:
+	struct BlockHashHasher
+	{
+		size_t operator()(const BlockHash& hash) const
+		{
+			size_t result;
+			std::memcpy(&result, hash.data(), sizeof(result));
+			return result;
+		}
+	};
+
+	struct ImageInfo
+	{
+		std::string name;
+		u64 blocks;
+		u64 new_blocks;
+		// The earlier image that holds the most of this one's blocks, or -1.
+		s32 most_shared_with;
+		u64 most_shared_blocks;
+	};
+
+	const u32 m_block_size;
+
+	mutable std::mutex m_lock;
+	// Every distinct block, and the image it was first seen in.
+	std::unordered_map<BlockHash, u32, BlockHashHasher> m_blocks;
+	std::vector<ImageInfo> m_images;
+	u64 m_total_blocks = 0;
+};
+
+}  // namespace
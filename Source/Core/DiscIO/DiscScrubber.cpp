@@ -12,6 +12,7 @@
 
 #include "Common/CommonTypes.h"
 #include "Common/FileUtil.h"
+#include "Common/ThreadPool.h"
 #include "DiscIO/DiscScrubber.h"
 #include "DiscIO/Filesystem.h"
 #include "DiscIO/Volume.h"
@@ -20,69 +21,67 @@
 namespace DiscIO
 {
 
-namespace DiscScrubber
-{
-
 #define CLUSTER_SIZE 0x8000
 
-static u8* m_FreeTable = nullptr;
-static u64 m_FileSize;
-static u64 m_BlockCount;
-static u32 m_BlockSize;
-static int m_BlocksPerCluster;
-static bool m_isScrubbing = false;
-
-static std::string m_Filename;
-static IVolume* m_Disc = nullptr;
-
-struct SPartitionHeader
+// Helper functions for reading the BE volume
+static void ReadFromVolume(IVolume& disc, u64 _Offset, u64 _Length, u32& _Buffer, bool _Decrypt)
 {
-	u8* Ticket[0x2a4];
-	u32 TMDSize;
-	u64 TMDOffset;
-	u32 CertChainSize;
-	u64 CertChainOffset;
-	// H3Size is always 0x18000
-	u64 H3Offset;
-	u64 DataOffset;
-	u64 DataSize;
-	// TMD would be here
-	u64 DOLOffset;
-	u64 DOLSize;
-	u64 FSTOffset;
-	u64 FSTSize;
-	u32 ApploaderSize;
-	u32 ApploaderTrailerSize;
-};
-struct SPartition
+	disc.Read(_Offset, _Length, (u8*)&_Buffer, _Decrypt);
+	_Buffer = Common::swap32(_Buffer);
+}
+static void ReadFromVolume(IVolume& disc, u64 _Offset, u64 _Length, u64& _Buffer, bool _Decrypt)
+{
+	disc.Read(_Offset, _Length, (u8*)&_Buffer, _Decrypt);
+	_Buffer = Common::swap32((u32)_Buffer);
+	_Buffer <<= 2;
+}
+
+// Compensate for 0x400(SHA-1) per 0x8000(cluster)
+void DiscScrubber::AddUsedE(std::vector<SUsedRange>& used, u64 _PartitionDataOffset, u64 _Offset, u64 _Size)
 {
-	u32 GroupNumber;
-	u32 Number;
 	u64 Offset;
-	u32 Type;
-	SPartitionHeader Header;
-};
-struct SPartitionGroup
+	u64 Size;
+
+	Offset = _Offset / 0x7c00;
+	Offset = Offset * CLUSTER_SIZE;
+	Offset += _PartitionDataOffset;
+
+	Size = _Size / 0x7c00;
+	Size = (Size + 1) * CLUSTER_SIZE;
+
+	// Add on the offset in the first block for the case where data straddles blocks
+	Size += _Offset % 0x7c00;
+
+	used.push_back({Offset, Size});
+}
+
+static u32 GetDOLSize(IVolume& disc, u64 _DOLOffset)
 {
-	u32 numPartitions;
-	u64 PartitionsOffset;
-	std::vector<SPartition> PartitionsVec;
-};
-static SPartitionGroup PartitionGroup[4];
+	u32 offset = 0, size = 0, max = 0;
 
+	// Iterate through the 7 code segments
+	for (u8 i = 0; i < 7; i++)
+	{
+		ReadFromVolume(disc, _DOLOffset + 0x00 + i * 4, 4, offset, true);
+		ReadFromVolume(disc, _DOLOffset + 0x90 + i * 4, 4, size, true);
+		if (offset + size > max)
+			max = offset + size;
+	}
 
-void MarkAsUsed(u64 _Offset, u64 _Size);
-void MarkAsUsedE(u64 _PartitionDataOffset, u64 _Offset, u64 _Size);
-void ReadFromVolume(u64 _Offset, u64 _Length, u32& _Buffer, bool _Decrypt);
-void ReadFromVolume(u64 _Offset, u64 _Length, u64& _Buffer, bool _Decrypt);
-bool ParseDisc();
-bool ParsePartitionData(SPartition& _rPartition);
-u32 GetDOLSize(u64 _DOLOffset);
+	// Iterate through the 11 data segments
+	for (u8 i = 0; i < 11; i++)
+	{
+		ReadFromVolume(disc, _DOLOffset + 0x1c + i * 4, 4, offset, true);
+		ReadFromVolume(disc, _DOLOffset + 0xac + i * 4, 4, size, true);
+		if (offset + size > max)
+			max = offset + size;
+	}
 
+	return max;
+}
 
-bool SetupScrub(const std::string& filename, int block_size)
+bool DiscScrubber::SetupScrub(const std::string& filename, int block_size)
 {
-	bool success = true;
 	m_Filename = filename;
 	m_BlockSize = block_size;
 
@@ -92,10 +91,10 @@ bool SetupScrub(const std::string& filename, int block_size)
 		return false;
 	}
 
-	m_BlocksPerCluster = CLUSTER_SIZE / m_BlockSize;
-
-	m_Disc = CreateVolumeFromFilename(filename);
-	m_FileSize = m_Disc->GetSize();
+	std::unique_ptr<IVolume> disc(CreateVolumeFromFilename(filename));
+	if (!disc)
+		return false;
+	m_FileSize = disc->GetSize();
 
 	u32 numClusters = (u32)(m_FileSize / CLUSTER_SIZE);
 
@@ -104,59 +103,26 @@ bool SetupScrub(const std::string& filename, int block_size)
 		WARN_LOG(DISCIO, "%s is not a standard sized Wii disc! (%x blocks)", filename.c_str(), numClusters);
 
 	// Table of free blocks
-	m_FreeTable = new u8[numClusters];
-	std::fill(m_FreeTable, m_FreeTable + numClusters, 1);
+	m_FreeTable.assign(numClusters, 1);
 
 	// Fill out table of free blocks
-	success = ParseDisc();
-	// Done with it; need it closed for the next part
-	delete m_Disc;
-	m_Disc = nullptr;
-	m_BlockCount = 0;
-
-	// Let's not touch the file if we've failed up to here :p
-	if (!success)
-		Cleanup();
-
-	m_isScrubbing = success;
-	return success;
-}
-
-size_t GetNextBlock(File::IOFile& in, u8* buffer)
-{
-	u64 CurrentOffset = m_BlockCount * m_BlockSize;
-	u64 i = CurrentOffset / CLUSTER_SIZE;
-
-	size_t ReadBytes = 0;
-	if (m_isScrubbing && m_FreeTable[i])
-	{
-		DEBUG_LOG(DISCIO, "Freeing 0x%016" PRIx64, CurrentOffset);
-		std::fill(buffer, buffer + m_BlockSize, 0xFF);
-		in.Seek(m_BlockSize, SEEK_CUR);
-		ReadBytes = m_BlockSize;
-	}
-	else
+	if (!ParseDisc(*disc))
 	{
-		DEBUG_LOG(DISCIO, "Used    0x%016" PRIx64, CurrentOffset);
-		in.ReadArray(buffer, m_BlockSize, &ReadBytes);
+		// Let's not touch the file if we've failed up to here :p
+		m_FreeTable.clear();
+		return false;
 	}
 
-	m_BlockCount++;
-	return ReadBytes;
+	return true;
 }
 
-void Cleanup()
+bool DiscScrubber::CanBlockBeScrubbed(u64 offset) const
 {
-	if (m_FreeTable) delete[] m_FreeTable;
-	m_FreeTable = nullptr;
-	m_FileSize = 0;
-	m_BlockCount = 0;
-	m_BlockSize = 0;
-	m_BlocksPerCluster = 0;
-	m_isScrubbing = false;
+	u64 i = offset / CLUSTER_SIZE;
+	return i < m_FreeTable.size() && m_FreeTable[i];
 }
 
-void MarkAsUsed(u64 _Offset, u64 _Size)
+void DiscScrubber::MarkAsUsed(u64 _Offset, u64 _Size)
 {
 	u64 CurrentOffset = _Offset;
 	u64 EndOffset = CurrentOffset + _Size;
@@ -169,189 +135,134 @@ void MarkAsUsed(u64 _Offset, u64 _Size)
 		CurrentOffset += CLUSTER_SIZE;
 	}
 }
-// Compensate for 0x400(SHA-1) per 0x8000(cluster)
-void MarkAsUsedE(u64 _PartitionDataOffset, u64 _Offset, u64 _Size)
-{
-	u64 Offset;
-	u64 Size;
 
-	Offset = _Offset / 0x7c00;
-	Offset = Offset * CLUSTER_SIZE;
-	Offset += _PartitionDataOffset;
-
-	Size = _Size / 0x7c00;
-	Size = (Size + 1) * CLUSTER_SIZE;
-
-	// Add on the offset in the first block for the case where data straddles blocks
-	Size += _Offset % 0x7c00;
-
-	MarkAsUsed(Offset, Size);
-}
-
-// Helper functions for reading the BE volume
-void ReadFromVolume(u64 _Offset, u64 _Length, u32& _Buffer, bool _Decrypt)
-{
-	m_Disc->Read(_Offset, _Length, (u8*)&_Buffer, _Decrypt);
-	_Buffer = Common::swap32(_Buffer);
-}
-void ReadFromVolume(u64 _Offset, u64 _Length, u64& _Buffer, bool _Decrypt)
-{
-	m_Disc->Read(_Offset, _Length, (u8*)&_Buffer, _Decrypt);
-	_Buffer = Common::swap32((u32)_Buffer);
-	_Buffer <<= 2;
-}
-
-bool ParseDisc()
+bool DiscScrubber::ParseDisc(IVolume& disc)
 {
 	// Mark the header as used - it's mostly 0s anyways
 	MarkAsUsed(0, 0x50000);
 
-	for (int x = 0; x < 4; x++)
+	std::vector<SPartition> partitions;
+
+	for (u32 x = 0; x < 4; x++)
 	{
-		ReadFromVolume(0x40000 + (x * 8) + 0, 4, PartitionGroup[x].numPartitions, false);
-		ReadFromVolume(0x40000 + (x * 8) + 4, 4, PartitionGroup[x].PartitionsOffset, false);
+		u32 numPartitions;
+		u64 PartitionsOffset;
+		ReadFromVolume(disc, 0x40000 + (x * 8) + 0, 4, numPartitions, false);
+		ReadFromVolume(disc, 0x40000 + (x * 8) + 4, 4, PartitionsOffset, false);
 
 		// Read all partitions
-		for (u32 i = 0; i < PartitionGroup[x].numPartitions; i++)
+		for (u32 i = 0; i < numPartitions; i++)
 		{
 			SPartition Partition;
 
 			Partition.GroupNumber = x;
 			Partition.Number = i;
 
-			ReadFromVolume(PartitionGroup[x].PartitionsOffset + (i * 8) + 0, 4, Partition.Offset, false);
-			ReadFromVolume(PartitionGroup[x].PartitionsOffset + (i * 8) + 4, 4, Partition.Type, false);
+			ReadFromVolume(disc, PartitionsOffset + (i * 8) + 0, 4, Partition.Offset, false);
+			ReadFromVolume(disc, PartitionsOffset + (i * 8) + 4, 4, Partition.Type, false);
 
-			ReadFromVolume(Partition.Offset + 0x2a4, 4, Partition.Header.TMDSize, false);
-			ReadFromVolume(Partition.Offset + 0x2a8, 4, Partition.Header.TMDOffset, false);
-			ReadFromVolume(Partition.Offset + 0x2ac, 4, Partition.Header.CertChainSize, false);
-			ReadFromVolume(Partition.Offset + 0x2b0, 4, Partition.Header.CertChainOffset, false);
-			ReadFromVolume(Partition.Offset + 0x2b4, 4, Partition.Header.H3Offset, false);
-			ReadFromVolume(Partition.Offset + 0x2b8, 4, Partition.Header.DataOffset, false);
-			ReadFromVolume(Partition.Offset + 0x2bc, 4, Partition.Header.DataSize, false);
+			ReadFromVolume(disc, Partition.Offset + 0x2a4, 4, Partition.Header.TMDSize, false);
+			ReadFromVolume(disc, Partition.Offset + 0x2a8, 4, Partition.Header.TMDOffset, false);
+			ReadFromVolume(disc, Partition.Offset + 0x2ac, 4, Partition.Header.CertChainSize, false);
+			ReadFromVolume(disc, Partition.Offset + 0x2b0, 4, Partition.Header.CertChainOffset, false);
+			ReadFromVolume(disc, Partition.Offset + 0x2b4, 4, Partition.Header.H3Offset, false);
+			ReadFromVolume(disc, Partition.Offset + 0x2b8, 4, Partition.Header.DataOffset, false);
+			ReadFromVolume(disc, Partition.Offset + 0x2bc, 4, Partition.Header.DataSize, false);
 
-			PartitionGroup[x].PartitionsVec.push_back(Partition);
-		}
-
-		for (auto& rPartition : PartitionGroup[x].PartitionsVec)
-		{
-			const SPartitionHeader& rHeader = rPartition.Header;
-
-			MarkAsUsed(rPartition.Offset, 0x2c0);
-
-			MarkAsUsed(rPartition.Offset + rHeader.TMDOffset, rHeader.TMDSize);
-			MarkAsUsed(rPartition.Offset + rHeader.CertChainOffset, rHeader.CertChainSize);
-			MarkAsUsed(rPartition.Offset + rHeader.H3Offset, 0x18000);
-			// This would mark the whole (encrypted) data area
-			// we need to parse FST and other crap to find what's free within it!
-			//MarkAsUsed(rPartition.Offset + rHeader.DataOffset, rHeader.DataSize);
-
-			// Parse Data! This is where the big gain is
-			if (!ParsePartitionData(rPartition))
-				return false;
+			partitions.push_back(Partition);
 		}
 	}
 
-	return true;
-}
+	for (const SPartition& rPartition : partitions)
+	{
+		const SPartitionHeader& rHeader = rPartition.Header;
 
-// Operations dealing with encrypted space are done here - the volume is swapped to allow this
-bool ParsePartitionData(SPartition& _rPartition)
-{
-	bool ParsedOK = true;
+		MarkAsUsed(rPartition.Offset, 0x2c0);
 
-	// Switch out the main volume temporarily
-	IVolume *OldVolume = m_Disc;
+		MarkAsUsed(rPartition.Offset + rHeader.TMDOffset, rHeader.TMDSize);
+		MarkAsUsed(rPartition.Offset + rHeader.CertChainOffset, rHeader.CertChainSize);
+		MarkAsUsed(rPartition.Offset + rHeader.H3Offset, 0x18000);
+		// This would mark the whole (encrypted) data area
+		// we need to parse FST and other crap to find what's free within it!
+		//MarkAsUsed(rPartition.Offset + rHeader.DataOffset, rHeader.DataSize);
+	}
 
-	// Ready some stuff
-	m_Disc = CreateVolumeFromFilename(m_Filename, _rPartition.GroupNumber, _rPartition.Number);
-	std::unique_ptr<IFileSystem> filesystem(CreateFileSystem(m_Disc));
+	// Parse Data! This is where the big gain is. Going through the file system
+	// means decrypting it, so every partition gets a thread and a volume of its own.
+	std::vector<std::vector<SUsedRange>> used(partitions.size());
+	std::unique_ptr<bool[]> parsed(new bool[partitions.size()]);
+	Common::ThreadPool pool((unsigned int)std::max<size_t>(1, std::min<size_t>(partitions.size(), Common::ThreadPool::GetDefaultThreadCount())));
+	pool.ParallelFor(partitions.size(), [&](size_t i) {
+		parsed[i] = ParsePartitionData(partitions[i], used[i]);
+	});
 
-	if (!filesystem)
-	{
-		ERROR_LOG(DISCIO, "Failed to create filesystem for group %d partition %u", _rPartition.GroupNumber, _rPartition.Number);
-		ParsedOK = false;
-	}
-	else
+	for (size_t i = 0; i < partitions.size(); i++)
 	{
-		std::vector<const SFileInfo *> Files;
-		size_t numFiles = filesystem->GetFileList(Files);
-
-		// Mark things as used which are not in the filesystem
-		// Header, Header Information, Apploader
-		ReadFromVolume(0x2440 + 0x14, 4, _rPartition.Header.ApploaderSize, true);
-		ReadFromVolume(0x2440 + 0x18, 4, _rPartition.Header.ApploaderTrailerSize, true);
-		MarkAsUsedE(_rPartition.Offset
-			+ _rPartition.Header.DataOffset
-			, 0
-			, 0x2440
-			+ _rPartition.Header.ApploaderSize
-			+ _rPartition.Header.ApploaderTrailerSize);
-
-		// DOL
-		ReadFromVolume(0x420, 4, _rPartition.Header.DOLOffset, true);
-		_rPartition.Header.DOLSize = GetDOLSize(_rPartition.Header.DOLOffset);
-		MarkAsUsedE(_rPartition.Offset
-			+ _rPartition.Header.DataOffset
-			, _rPartition.Header.DOLOffset
-			, _rPartition.Header.DOLSize);
-
-		// FST
-		ReadFromVolume(0x424, 4, _rPartition.Header.FSTOffset, true);
-		ReadFromVolume(0x428, 4, _rPartition.Header.FSTSize, true);
-		MarkAsUsedE(_rPartition.Offset
-			+ _rPartition.Header.DataOffset
-			, _rPartition.Header.FSTOffset
-			, _rPartition.Header.FSTSize);
-
-		// Go through the filesystem and mark entries as used
-		for (size_t currentFile = 0; currentFile < numFiles; currentFile++)
-		{
-			DEBUG_LOG(DISCIO, "%s", currentFile ? (*Files.at(currentFile)).m_FullPath.c_str() : "/");
-			// Just 1byte for directory? - it will end up reserving a cluster this way
-			if ((*Files.at(currentFile)).m_NameOffset & 0x1000000)
-				MarkAsUsedE(_rPartition.Offset
-				+ _rPartition.Header.DataOffset
-				, (*Files.at(currentFile)).m_Offset, 1);
-			else
-				MarkAsUsedE(_rPartition.Offset
-				+ _rPartition.Header.DataOffset
-				, (*Files.at(currentFile)).m_Offset, (*Files.at(currentFile)).m_FileSize);
-		}
-	}
+		if (!parsed[i])
+			return false;
 
-	// Swap back
-	delete m_Disc;
-	m_Disc = OldVolume;
+		for (const SUsedRange& range : used[i])
+			MarkAsUsed(range.Offset, range.Size);
+	}
 
-	return ParsedOK;
+	return true;
 }
 
-u32 GetDOLSize(u64 _DOLOffset)
+// Operations dealing with encrypted space are done here, on a volume for the partition
+bool DiscScrubber::ParsePartitionData(SPartition& _rPartition, std::vector<SUsedRange>& used) const
 {
-	u32 offset = 0, size = 0, max = 0;
+	std::unique_ptr<IVolume> disc(CreateVolumeFromFilename(m_Filename, _rPartition.GroupNumber, _rPartition.Number));
+	std::unique_ptr<IFileSystem> filesystem(disc ? CreateFileSystem(disc.get()) : nullptr);
 
-	// Iterate through the 7 code segments
-	for (u8 i = 0; i < 7; i++)
+	if (!filesystem)
 	{
-		ReadFromVolume(_DOLOffset + 0x00 + i * 4, 4, offset, true);
-		ReadFromVolume(_DOLOffset + 0x90 + i * 4, 4, size, true);
-		if (offset + size > max)
-			max = offset + size;
+		ERROR_LOG(DISCIO, "Failed to create filesystem for group %d partition %u", _rPartition.GroupNumber, _rPartition.Number);
+		return false;
 	}
 
-	// Iterate through the 11 data segments
-	for (u8 i = 0; i < 11; i++)
+	const u64 PartitionDataOffset = _rPartition.Offset + _rPartition.Header.DataOffset;
+
+	std::vector<const SFileInfo *> Files;
+	size_t numFiles = filesystem->GetFileList(Files);
+
+	// Mark things as used which are not in the filesystem
+	// Header, Header Information, Apploader
+	ReadFromVolume(*disc, 0x2440 + 0x14, 4, _rPartition.Header.ApploaderSize, true);
+	ReadFromVolume(*disc, 0x2440 + 0x18, 4, _rPartition.Header.ApploaderTrailerSize, true);
+	AddUsedE(used, PartitionDataOffset
+		, 0
+		, 0x2440
+		+ _rPartition.Header.ApploaderSize
+		+ _rPartition.Header.ApploaderTrailerSize);
+
+	// DOL
+	ReadFromVolume(*disc, 0x420, 4, _rPartition.Header.DOLOffset, true);
+	_rPartition.Header.DOLSize = GetDOLSize(*disc, _rPartition.Header.DOLOffset);
+	AddUsedE(used, PartitionDataOffset
+		, _rPartition.Header.DOLOffset
+		, _rPartition.Header.DOLSize);
+
+	// FST
+	ReadFromVolume(*disc, 0x424, 4, _rPartition.Header.FSTOffset, true);
+	ReadFromVolume(*disc, 0x428, 4, _rPartition.Header.FSTSize, true);
+	AddUsedE(used, PartitionDataOffset
+		, _rPartition.Header.FSTOffset
+		, _rPartition.Header.FSTSize);
+
+	// Go through the filesystem and mark entries as used
+	for (size_t currentFile = 0; currentFile < numFiles; currentFile++)
 	{
-		ReadFromVolume(_DOLOffset + 0x1c + i * 4, 4, offset, true);
-		ReadFromVolume(_DOLOffset + 0xac + i * 4, 4, size, true);
-		if (offset + size > max)
-			max = offset + size;
+		DEBUG_LOG(DISCIO, "%s", currentFile ? (*Files.at(currentFile)).m_FullPath.c_str() : "/");
+		// Just 1byte for directory? - it will end up reserving a cluster this way
+		if ((*Files.at(currentFile)).m_NameOffset & 0x1000000)
+			AddUsedE(used, PartitionDataOffset
+			, (*Files.at(currentFile)).m_Offset, 1);
+		else
+			AddUsedE(used, PartitionDataOffset
+			, (*Files.at(currentFile)).m_Offset, (*Files.at(currentFile)).m_FileSize);
 	}
 
-	return max;
+	return true;
 }
 
-} // namespace DiscScrubber
-
 } // namespace DiscIO
@@ -14,20 +14,67 @@
 #pragma once
 
 #include <string>
+#include <vector>
 #include "Common/CommonTypes.h"
 
-namespace File { class IOFile; }
-
 namespace DiscIO
 {
 
-namespace DiscScrubber
+class IVolume;
+
+class DiscScrubber final
 {
+public:
+	// Works out which parts of the disc are in use. The partitions are
+	// parsed in parallel, each through its own volume.
+	bool SetupScrub(const std::string& filename, int block_size);
+
+	// Whether the block at offset holds nothing the disc needs. Blocks can be
+	// asked about in any order, and from several threads at once.
+	bool CanBlockBeScrubbed(u64 offset) const;
+
+private:
+	struct SPartitionHeader
+	{
+		u32 TMDSize;
+		u64 TMDOffset;
+		u32 CertChainSize;
+		u64 CertChainOffset;
+		// H3Size is always 0x18000
+		u64 H3Offset;
+		u64 DataOffset;
+		u64 DataSize;
+		// TMD would be here
+		u64 DOLOffset;
+		u64 DOLSize;
+		u64 FSTOffset;
+		u64 FSTSize;
+		u32 ApploaderSize;
+		u32 ApploaderTrailerSize;
+	};
+	struct SPartition
+	{
+		u32 GroupNumber;
+		u32 Number;
+		u64 Offset;
+		u32 Type;
+		SPartitionHeader Header;
+	};
+	struct SUsedRange
+	{
+		u64 Offset;
+		u64 Size;
+	};
 
-bool SetupScrub(const std::string& filename, int block_size);
-size_t GetNextBlock(File::IOFile& in, u8* buffer);
-void Cleanup();
+	void MarkAsUsed(u64 _Offset, u64 _Size);
+	static void AddUsedE(std::vector<SUsedRange>& used, u64 _PartitionDataOffset, u64 _Offset, u64 _Size);
+	bool ParseDisc(IVolume& disc);
+	bool ParsePartitionData(SPartition& _rPartition, std::vector<SUsedRange>& used) const;
 
-} // namespace DiscScrubber
+	std::string m_Filename;
+	u64 m_FileSize = 0;
+	u32 m_BlockSize = 0;
+	std::vector<u8> m_FreeTable;
+};
 
 } // namespace DiscIO
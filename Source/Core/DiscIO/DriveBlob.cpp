@@ -4,6 +4,7 @@
 
 #include <cstdio>
 #include <cstring>
+#include <mutex>
 #include <string>
 
 #include "Common/CommonTypes.h"
@@ -21,7 +22,7 @@ namespace DiscIO
 DriveReader::DriveReader(const std::string& drive)
 {
 #ifdef _WIN32
-	SectorReader::SetSectorSize(2048);
+	SectorReader::SetSectorSize(2048, DRIVE_CACHE_BLOCKS);
 	auto const path = UTF8ToTStr(std::string("\\\\.\\") + drive);
 	m_disc_handle = CreateFile(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE,
 	                           nullptr, OPEN_EXISTING, FILE_FLAG_RANDOM_ACCESS, nullptr);
@@ -50,7 +51,7 @@ DriveReader::DriveReader(const std::string& drive)
 		                0, &dwNotUsed, nullptr);
 	#endif
 #else
-	SectorReader::SetSectorSize(2048);
+	SectorReader::SetSectorSize(2048, DRIVE_CACHE_BLOCKS);
 	m_file.Open(drive, "rb");
 	if (m_file)
 	{
@@ -64,6 +65,8 @@ DriveReader::DriveReader(const std::string& drive)
 
 DriveReader::~DriveReader()
 {
+	StopReadAhead();
+
 #ifdef _WIN32
 #ifdef _LOCKDRIVE // Do we want to lock the drive?
 	// Unlock the disc in the CD-ROM drive.
@@ -92,6 +95,9 @@ DriveReader* DriveReader::Create(const std::string& drive)
 		return nullptr;
 	}
 
+	// Physical drives have high seek latency, so keep the next few sectors coming.
+	reader->SetReadAhead(DRIVE_READ_AHEAD_BLOCKS);
+
 	return reader;
 }
 
@@ -116,6 +122,7 @@ void DriveReader::GetBlock(u64 block_num, u8* out_ptr)
 
 bool DriveReader::ReadMultipleAlignedBlocks(u64 block_num, u64 num_blocks, u8* out_ptr)
 {
+	std::lock_guard<std::mutex> lk(m_io_lock);
 #ifdef _WIN32
 	u32 NotUsed;
 	u64 offset = m_blocksize * block_num;
@@ -29,6 +29,12 @@ public:
 	virtual bool ReadMultipleAlignedBlocks(u64 block_num, u64 num_blocks, u8 *out_ptr) override;
 
 private:
+	enum
+	{
+		DRIVE_CACHE_BLOCKS = 256,
+		DRIVE_READ_AHEAD_BLOCKS = 32,
+	};
+
 	DriveReader(const std::string& drive);
 	void GetBlock(u64 block_num, u8 *out_ptr) override;
 
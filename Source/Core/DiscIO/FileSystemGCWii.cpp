@@ -3,6 +3,7 @@
 // Refer to the license.txt file included.
 
 #include <algorithm>
+#include <cctype>
 #include <cinttypes>
 #include <cstddef>
 #include <cstring>
@@ -51,16 +52,25 @@ const std::string CFileSystemGCWii::GetFileName(u64 _Address)
 	if (!m_Initialized)
 		InitFileSystem();
 
-	for (auto& fileInfo : m_FileInfoVector)
+	// The last file starting at or before the address
+	auto it = std::upper_bound(m_OffsetIndex.begin(), m_OffsetIndex.end(), _Address,
+		[this](u64 address, const SOffsetEntry& entry) { return address < m_FileInfoVector[entry.index].m_Offset; });
+
+	// Files don't normally overlap, so this is usually one step. If they do,
+	// the one that comes first in the FST wins.
+	const SFileInfo* pFound = nullptr;
+	while (it != m_OffsetIndex.begin())
 	{
-		if ((fileInfo.m_Offset <= _Address) &&
-		    ((fileInfo.m_Offset + fileInfo.m_FileSize) > _Address))
-		{
-			return fileInfo.m_FullPath;
-		}
+		--it;
+		if (it->max_end <= _Address)
+			break;
+
+		const SFileInfo& rFileInfo = m_FileInfoVector[it->index];
+		if (rFileInfo.m_Offset + rFileInfo.m_FileSize > _Address && (!pFound || &rFileInfo < pFound))
+			pFound = &rFileInfo;
 	}
 
-	return "";
+	return pFound ? pFound->m_FullPath : "";
 }
 
 u64 CFileSystemGCWii::ReadFile(const std::string& _rFullPath, u8* _pBuffer, size_t _MaxBufferSize)
@@ -204,16 +214,16 @@ u32 CFileSystemGCWii::Read32(u64 _Offset) const
 	return Common::swap32(Temp);
 }
 
-std::string CFileSystemGCWii::GetStringFromOffset(u64 _Offset) const
+u32 CFileSystemGCWii::HashPath(const std::string& _rFullPath)
 {
-	std::string data;
-	data.resize(255);
-	m_rVolume->Read(_Offset, data.size(), (u8*)&data[0], m_Wii);
-	data.erase(std::find(data.begin(), data.end(), 0x00), data.end());
-
-	// TODO: Should we really always use SHIFT-JIS?
-	// It makes some filenames in Pikmin (NTSC-U) sane, but is it correct?
-	return SHIFTJISToUTF8(data);
+	// FNV-1a over the lowercased path, to match strcasecmp
+	u32 hash = 2166136261u;
+	for (char c : _rFullPath)
+	{
+		hash ^= (u8)tolower((u8)c);
+		hash *= 16777619u;
+	}
+	return hash;
 }
 
 size_t CFileSystemGCWii::GetFileList(std::vector<const SFileInfo *> &_rFilenames)
@@ -235,10 +245,15 @@ const SFileInfo* CFileSystemGCWii::FindFileInfo(const std::string& _rFullPath)
 	if (!m_Initialized)
 		InitFileSystem();
 
-	for (auto& fileInfo : m_FileInfoVector)
+	const u32 hash = HashPath(_rFullPath);
+	auto it = std::lower_bound(m_PathIndex.begin(), m_PathIndex.end(), hash,
+		[](const SPathHash& entry, u32 value) { return entry.hash < value; });
+
+	for (; it != m_PathIndex.end() && it->hash == hash; ++it)
 	{
-		if (!strcasecmp(fileInfo.m_FullPath.c_str(), _rFullPath.c_str()))
-			return &fileInfo;
+		const SFileInfo& rFileInfo = m_FileInfoVector[it->index];
+		if (!strcasecmp(rFileInfo.m_FullPath.c_str(), _rFullPath.c_str()))
+			return &rFileInfo;
 	}
 
 	return nullptr;
@@ -264,57 +279,72 @@ void CFileSystemGCWii::InitFileSystem()
 {
 	m_Initialized = true;
 
-	// read the whole FST
 	u64 FSTOffset = (u64)Read32(0x424) << GetOffsetShift();
-	// u32 FSTSize     = Read32(0x428);
+	u64 FSTSize   = (u64)Read32(0x428) << GetOffsetShift();
 	// u32 FSTMaxSize  = Read32(0x42C);
 
-
-	// read all fileinfos
 	SFileInfo Root;
 	Root.m_NameOffset = Read32(FSTOffset + 0x0);
 	Root.m_Offset     = (u64)Read32(FSTOffset + 0x4) << GetOffsetShift();
 	Root.m_FileSize   = Read32(FSTOffset + 0x8);
 
-	if (Root.IsDirectory())
-	{
-		if (m_FileInfoVector.size())
-			PanicAlert("Wtf?");
-		u64 NameTableOffset = FSTOffset;
+	if (!Root.IsDirectory())
+		return;
 
-		m_FileInfoVector.reserve((unsigned int)Root.m_FileSize);
-		for (u32 i = 0; i < Root.m_FileSize; i++)
-		{
-			SFileInfo sfi;
-			u64 Offset = FSTOffset + (i * 0xC);
-			sfi.m_NameOffset = Read32(Offset + 0x0);
-			sfi.m_Offset     = (u64)Read32(Offset + 0x4) << GetOffsetShift();
-			sfi.m_FileSize   = Read32(Offset + 0x8);
-
-			m_FileInfoVector.push_back(sfi);
-			NameTableOffset += 0xC;
-		}
+	// Read the whole FST at once, the name table follows the entries.
+	// Names past the end of it (if the size in the header is off) come out empty.
+	const u64 EntriesSize = Root.m_FileSize * 0xC;
+	if (EntriesSize > 0x10000000)
+		return;
+	std::vector<u8> FST((size_t)std::min(std::max(FSTSize, EntriesSize), (u64)0x10000000));
+	if (!m_rVolume->Read(FSTOffset, FST.size(), FST.data(), m_Wii))
+		return;
+
+	// read all fileinfos
+	m_FileInfoVector.reserve((size_t)Root.m_FileSize);
+	for (u32 i = 0; i < Root.m_FileSize; i++)
+	{
+		const u8* pEntry = &FST[i * 0xC];
+		SFileInfo sfi;
+		sfi.m_NameOffset = Common::swap32(pEntry + 0x0);
+		sfi.m_Offset     = (u64)Common::swap32(pEntry + 0x4) << GetOffsetShift();
+		sfi.m_FileSize   = Common::swap32(pEntry + 0x8);
 
-		BuildFilenames(1, m_FileInfoVector.size(), "", NameTableOffset);
+		m_FileInfoVector.push_back(sfi);
 	}
+
+	FST.erase(FST.begin(), FST.begin() + (size_t)EntriesSize);
+	BuildFilenames(1, m_FileInfoVector.size(), "", FST);
+	BuildIndexes();
 }
 
-size_t CFileSystemGCWii::BuildFilenames(const size_t _FirstIndex, const size_t _LastIndex, const std::string& _szDirectory, u64 _NameTableOffset)
+size_t CFileSystemGCWii::BuildFilenames(const size_t _FirstIndex, const size_t _LastIndex, const std::string& _szDirectory, const std::vector<u8>& _rNameTable)
 {
 	size_t CurrentIndex = _FirstIndex;
 
 	while (CurrentIndex < _LastIndex)
 	{
 		SFileInfo& rFileInfo = m_FileInfoVector[CurrentIndex];
-		u64 const uOffset = _NameTableOffset + (rFileInfo.m_NameOffset & 0xFFFFFF);
+		size_t const uOffset = (size_t)(rFileInfo.m_NameOffset & 0xFFFFFF);
 
-		rFileInfo.m_FullPath = _szDirectory + GetStringFromOffset(uOffset);
+		std::string Name;
+		if (uOffset < _rNameTable.size())
+		{
+			const char* pName = (const char*)&_rNameTable[uOffset];
+			Name.assign(pName, strnlen(pName, std::min<size_t>(_rNameTable.size() - uOffset, 255)));
+		}
+
+		// TODO: Should we really always use SHIFT-JIS?
+		// It makes some filenames in Pikmin (NTSC-U) sane, but is it correct?
+		rFileInfo.m_FullPath = _szDirectory + SHIFTJISToUTF8(Name);
 
 		// check next index
 		if (rFileInfo.IsDirectory())
 		{
 			rFileInfo.m_FullPath += '/';
-			CurrentIndex = BuildFilenames(CurrentIndex + 1, (size_t) rFileInfo.m_FileSize, rFileInfo.m_FullPath, _NameTableOffset);
+			// Never let a broken FST send this backwards or past the end.
+			size_t NextIndex = (size_t)std::min<u64>(std::max<u64>(rFileInfo.m_FileSize, CurrentIndex + 1), _LastIndex);
+			CurrentIndex = BuildFilenames(CurrentIndex + 1, NextIndex, rFileInfo.m_FullPath, _rNameTable);
 		}
 		else
 		{
@@ -325,6 +355,50 @@ size_t CFileSystemGCWii::BuildFilenames(const size_t _FirstIndex, const size_t _
 	return CurrentIndex;
 }
 
+void CFileSystemGCWii::BuildIndexes()
+{
+	m_PathIndex.clear();
+	m_OffsetIndex.clear();
+	m_PathIndex.reserve(m_FileInfoVector.size());
+
+	// The root entry has no path, so it can't be looked up.
+	for (u32 i = 1; i < (u32)m_FileInfoVector.size(); i++)
+	{
+		const SFileInfo& rFileInfo = m_FileInfoVector[i];
+		SPathHash entry;
+		entry.hash = HashPath(rFileInfo.m_FullPath);
+		entry.index = i;
+		m_PathIndex.push_back(entry);
+
+		// Directories don't take up any space on the disc.
+		if (!rFileInfo.IsDirectory() && rFileInfo.m_FileSize != 0)
+		{
+			SOffsetEntry offset_entry;
+			offset_entry.max_end = 0;
+			offset_entry.index = i;
+			m_OffsetIndex.push_back(offset_entry);
+		}
+	}
+
+	// Equal hashes stay in FST order, so the first match is the one the
+	// linear search used to find.
+	std::stable_sort(m_PathIndex.begin(), m_PathIndex.end(),
+		[](const SPathHash& a, const SPathHash& b) { return a.hash < b.hash; });
+
+	std::stable_sort(m_OffsetIndex.begin(), m_OffsetIndex.end(),
+		[this](const SOffsetEntry& a, const SOffsetEntry& b) {
+			return m_FileInfoVector[a.index].m_Offset < m_FileInfoVector[b.index].m_Offset;
+		});
+
+	u64 max_end = 0;
+	for (SOffsetEntry& entry : m_OffsetIndex)
+	{
+		const SFileInfo& rFileInfo = m_FileInfoVector[entry.index];
+		max_end = std::max(max_end, rFileInfo.m_Offset + rFileInfo.m_FileSize);
+		entry.max_end = max_end;
+	}
+}
+
 u32 CFileSystemGCWii::GetOffsetShift() const
 {
 	return m_Wii ? 2 : 0;
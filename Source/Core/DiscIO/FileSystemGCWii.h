@@ -38,12 +38,32 @@ private:
 	bool m_Wii;
 
 	std::vector <SFileInfo> m_FileInfoVector;
+
+	// Lookup tables over m_FileInfoVector, built once by InitFileSystem.
+	// Paths are found by a case-insensitive hash, kept sorted so it's a
+	// binary search over 8 bytes per file. Addresses are found in the files
+	// sorted by offset; max_end is the furthest any file up to and including
+	// this one reaches, which bounds how far back overlapping files can be.
+	struct SPathHash
+	{
+		u32 hash;
+		u32 index;
+	};
+	struct SOffsetEntry
+	{
+		u64 max_end;
+		u32 index;
+	};
+	std::vector<SPathHash> m_PathIndex;
+	std::vector<SOffsetEntry> m_OffsetIndex;
+
 	u32 Read32(u64 _Offset) const;
-	std::string GetStringFromOffset(u64 _Offset) const;
+	static u32 HashPath(const std::string& _rFullPath);
 	const SFileInfo* FindFileInfo(const std::string& _rFullPath);
 	bool DetectFileSystem();
 	void InitFileSystem();
-	size_t BuildFilenames(const size_t _FirstIndex, const size_t _LastIndex, const std::string& _szDirectory, u64 _NameTableOffset);
+	void BuildIndexes();
+	size_t BuildFilenames(const size_t _FirstIndex, const size_t _LastIndex, const std::string& _szDirectory, const std::vector<u8>& _rNameTable);
 	u32 GetOffsetShift() const;
 };
 
@@ -2,15 +2,19 @@
 // Licensed under GPLv2
 // Refer to the license.txt file included.
 
+#include <algorithm>
 #include <cstddef>
 #include <cstdio>
 #include <cstring>
 #include <functional>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <utility>
 #include <vector>
 #include <polarssl/aes.h>
+#include <polarssl/sha1.h>
 
 #include "Common/CommonTypes.h"
 #include "Common/FileUtil.h"
@@ -19,6 +23,7 @@
 #include "Common/StringUtil.h"
 #include "Common/Logging/Log.h"
 
+#include "DiscIO/Blob.h"
 #include "DiscIO/NANDContentLoader.h"
 #include "DiscIO/Volume.h"
 #include "DiscIO/WiiWad.h"
@@ -91,6 +96,177 @@ std::string CSharedContent::AddSharedContent(const u8* _pHash)
 }
 
 
+// WAD contents are encrypted with AES-128-CBC as a whole, so any block of
+// them can be decrypted on its own, using the ciphertext right before it as
+// the IV. This decrypts BLOCK_SIZE blocks when they are first read and keeps
+// the most recently used ones around. The SHA-1 from the TMD is checked as
+// the blocks get decrypted in order, which they are when the content is read
+// from start to end.
+class CNANDContentDataWAD : public CNANDContentData
+{
+public:
+	CNANDContentDataWAD(std::shared_ptr<IBlobReader> reader, u64 offset, const SNANDContent& content, const u8* title_key);
+
+	bool GetRange(u32 start, u32 size, u8* buffer) override;
+	std::vector<u8> Get() override;
+
+private:
+	enum
+	{
+		BLOCK_SIZE = 0x4000,
+		MAX_CACHED_BLOCKS = 64
+	};
+
+	struct SBlock
+	{
+		std::vector<u8> m_Data;
+		u64 m_LastUsed;
+	};
+
+	const SBlock* GetBlock(u32 index);
+	void UpdateHash();
+
+	std::mutex m_Lock;
+
+	std::shared_ptr<IBlobReader> m_Reader;
+	u64 m_Offset;
+	u32 m_Size;
+	u32 m_EncryptedSize;
+	u32 m_ContentID;
+	aes_context m_AES;
+	u8 m_IV[16];
+
+	std::map<u32, SBlock> m_Cache;
+	u64 m_UseCounter;
+
+	sha1_context m_SHA1;
+	u32 m_HashedSize;
+	u8 m_ExpectedHash[20];
+};
+
+CNANDContentDataWAD::CNANDContentDataWAD(std::shared_ptr<IBlobReader> reader, u64 offset, const SNANDContent& content, const u8* title_key)
+	: m_Reader(reader)
+	, m_Offset(offset)
+	, m_Size(content.m_Size)
+	, m_EncryptedSize(ROUND_UP(content.m_Size, 0x40))
+	, m_ContentID(content.m_ContentID)
+	, m_UseCounter(0)
+	, m_HashedSize(0)
+{
+	aes_setkey_dec(&m_AES, title_key, 128);
+
+	// The IV is the content's index.
+	memset(m_IV, 0, sizeof m_IV);
+	m_IV[0] = (u8)(content.m_Index >> 8);
+	m_IV[1] = (u8)content.m_Index;
+
+	sha1_starts(&m_SHA1);
+	memcpy(m_ExpectedHash, content.m_SHA1Hash, sizeof m_ExpectedHash);
+}
+
+const CNANDContentDataWAD::SBlock* CNANDContentDataWAD::GetBlock(u32 index)
+{
+	auto iter = m_Cache.find(index);
+	if (iter != m_Cache.end())
+	{
+		iter->second.m_LastUsed = ++m_UseCounter;
+		return &iter->second;
+	}
+
+	if (m_Cache.size() >= MAX_CACHED_BLOCKS)
+	{
+		auto oldest = std::min_element(m_Cache.begin(), m_Cache.end(),
+			[](const std::pair<const u32, SBlock>& a, const std::pair<const u32, SBlock>& b) {
+				return a.second.m_LastUsed < b.second.m_LastUsed;
+			});
+		m_Cache.erase(oldest);
+	}
+
+	const u32 start = index * BLOCK_SIZE;
+	const u32 length = std::min<u32>(BLOCK_SIZE, m_EncryptedSize - start);
+
+	// Read the previous ciphertext block along with the block itself.
+	const u32 iv_length = start ? 16 : 0;
+	std::vector<u8> encrypted(iv_length + length);
+	if (!m_Reader->Read(m_Offset + start - iv_length, encrypted.size(), encrypted.data()))
+	{
+		ERROR_LOG(DISCIO, "Could not read content %08x from WAD", m_ContentID);
+		return nullptr;
+	}
+
+	u8 iv[16];
+	memcpy(iv, start ? encrypted.data() : m_IV, sizeof iv);
+
+	SBlock& block = m_Cache[index];
+	block.m_Data.resize(length);
+	block.m_LastUsed = ++m_UseCounter;
+	aes_crypt_cbc(&m_AES, AES_DECRYPT, length, iv, encrypted.data() + iv_length, block.m_Data.data());
+
+	if (start == m_HashedSize)
+		UpdateHash();
+
+	return &block;
+}
+
+void CNANDContentDataWAD::UpdateHash()
+{
+	if (m_HashedSize == m_Size)
+		return;
+
+	// Hash as many blocks as are there in order.
+	for (auto iter = m_Cache.find(m_HashedSize / BLOCK_SIZE);
+	     iter != m_Cache.end() && iter->first * BLOCK_SIZE == m_HashedSize;
+	     ++iter)
+	{
+		const u32 length = std::min<u32>(BLOCK_SIZE, m_Size - m_HashedSize);
+		sha1_update(&m_SHA1, iter->second.m_Data.data(), length);
+		m_HashedSize += length;
+
+		if (m_HashedSize == m_Size)
+		{
+			u8 hash[20];
+			sha1_finish(&m_SHA1, hash);
+			if (memcmp(hash, m_ExpectedHash, sizeof hash) != 0)
+				ERROR_LOG(DISCIO, "Content %08x doesn't match the SHA-1 in the TMD", m_ContentID);
+			return;
+		}
+	}
+}
+
+bool CNANDContentDataWAD::GetRange(u32 start, u32 size, u8* buffer)
+{
+	if (start > m_Size || size > m_Size - start)
+		return false;
+
+	std::lock_guard<std::mutex> lk(m_Lock);
+
+	while (size > 0)
+	{
+		const SBlock* block = GetBlock(start / BLOCK_SIZE);
+		if (!block)
+			return false;
+
+		const u32 offset = start % BLOCK_SIZE;
+		const u32 length = std::min<u32>(size, BLOCK_SIZE - offset);
+		memcpy(buffer, block->m_Data.data() + offset, length);
+
+		start += length;
+		buffer += length;
+		size -= length;
+	}
+
+	return true;
+}
+
+std::vector<u8> CNANDContentDataWAD::Get()
+{
+	std::vector<u8> data(m_Size);
+	if (!GetRange(0, m_Size, data.data()))
+		data.clear();
+	return data;
+}
+
+
 // this classes must be created by the CNANDContentManager
 class CNANDContentLoader : public INANDContentLoader
 {
@@ -157,10 +333,6 @@ CNANDContentLoader::CNANDContentLoader(const std::string& _rName)
 
 CNANDContentLoader::~CNANDContentLoader()
 {
-	for (auto& content : m_Content)
-	{
-		delete [] content.m_pData;
-	}
 	m_Content.clear();
 	if (m_TIK)
 	{
@@ -187,10 +359,10 @@ bool CNANDContentLoader::Initialize(const std::string& _rName)
 		return false;
 	m_Path = _rName;
 	WiiWAD Wad(_rName);
-	u8* pDataApp = nullptr;
+	std::shared_ptr<IBlobReader> pWadReader;
+	u64 DataAppOffset = 0;
 	u8* pTMD = nullptr;
 	u8 DecryptTitleKey[16];
-	u8 IV[16];
 	if (Wad.IsValid())
 	{
 		m_isWAD = true;
@@ -198,10 +370,18 @@ bool CNANDContentLoader::Initialize(const std::string& _rName)
 		m_TIK = new u8[m_TIKSize];
 		memcpy(m_TIK, Wad.GetTicket(), m_TIKSize);
 		GetKeyFromTicket(m_TIK, DecryptTitleKey);
+		// The contents are decrypted when they are read (see CNANDContentDataWAD),
+		// so the WAD stays open, shared by them, for as long as they are around.
+		pWadReader.reset(CreateBlobReader(_rName));
+		if (!pWadReader)
+		{
+			ERROR_LOG(DISCIO, "CNANDContentLoader: error opening %s", _rName.c_str());
+			return false;
+		}
 		u32 pTMDSize = Wad.GetTMDSize();
 		pTMD = new u8[pTMDSize];
 		memcpy(pTMD, Wad.GetTMD(), pTMDSize);
-		pDataApp = Wad.GetDataApp();
+		DataAppOffset = Wad.GetDataAppOffset();
 	}
 	else
 	{
@@ -253,19 +433,11 @@ bool CNANDContentLoader::Initialize(const std::string& _rName)
 
 		if (m_isWAD)
 		{
-			u32 RoundedSize = ROUND_UP(rContent.m_Size, 0x40);
-			rContent.m_pData = new u8[RoundedSize];
-
-			memset(IV, 0, sizeof IV);
-			memcpy(IV, pTMD + 0x01e8 + 0x24*i, 2);
-			AESDecode(DecryptTitleKey, IV, pDataApp, RoundedSize, rContent.m_pData);
-
-			pDataApp += RoundedSize;
+			rContent.m_pData = std::make_shared<CNANDContentDataWAD>(pWadReader, DataAppOffset, rContent, DecryptTitleKey);
+			DataAppOffset += ROUND_UP(rContent.m_Size, 0x40);
 			continue;
 		}
 
-		rContent.m_pData = nullptr;
-
 		if (rContent.m_Type & 0x8000)  // shared app
 			rContent.m_Filename = CSharedContent::AccessInstance().GetFilenameFromSHA1(rContent.m_SHA1Hash);
 		else
@@ -492,7 +664,18 @@ u64 CNANDContentManager::Install_WiiWAD(std::string &fileName)
 				return 0;
 			}
 
-			pAPPFile.WriteBytes(Content.m_pData, Content.m_Size);
+			// Copy over in pieces, so that the content never has to be in
+			// memory as a whole.
+			std::vector<u8> buffer(std::min<u32>(Content.m_Size, 1024 * 1024));
+			for (u32 offset = 0; offset < Content.m_Size; offset += (u32)buffer.size())
+			{
+				const u32 size = std::min<u32>((u32)buffer.size(), Content.m_Size - offset);
+				if (!Content.m_pData->GetRange(offset, size, buffer.data()) || !pAPPFile.WriteBytes(buffer.data(), size))
+				{
+					PanicAlertT("WAD installation failed: error writing %s", APPFileName.c_str());
+					return 0;
+				}
+			}
 		}
 		else
 		{
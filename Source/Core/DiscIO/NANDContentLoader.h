@@ -6,6 +6,7 @@
 
 #include <cstddef>
 #include <map>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -15,6 +16,20 @@
 namespace DiscIO
 {
 	bool Add_Ticket(u64 TitleID, const u8 *p_tik, u32 tikSize);
+
+// The contents of a title that was loaded from a WAD. They are decrypted on
+// demand, so that only the parts that actually get read are.
+class CNANDContentData
+{
+public:
+	virtual ~CNANDContentData() {}
+
+	// Copies [start, start + size) of the decrypted content to buffer.
+	virtual bool GetRange(u32 start, u32 size, u8* buffer) = 0;
+	// The whole decrypted content.
+	virtual std::vector<u8> Get() = 0;
+};
+
 struct SNANDContent
 {
 	u32 m_ContentID;
@@ -25,7 +40,9 @@ struct SNANDContent
 	u8 m_Header[36]; //all of the above
 
 	std::string m_Filename;
-	u8* m_pData;
+	// Only set for titles loaded from a WAD. Otherwise the content is read
+	// from m_Filename.
+	std::shared_ptr<CNANDContentData> m_pData;
 };
 
 // pure virtual interface so just the NANDContentManager can create these files only
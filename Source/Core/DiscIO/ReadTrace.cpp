@@ -0,0 +1,97 @@
+// Copyright 2015 Dolphin Emulator Project
+// Licensed under GPLv2
+// Refer to the license.txt file included.
+
+#include <cinttypes>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "Common/CommonTypes.h"
+#include "Common/FileUtil.h"
+#include "DiscIO/ReadTrace.h"
+
+namespace DiscIO
+{
+
+static const char TRACE_MAGIC[] = "# dolphin disc read trace 1";
+
+bool ReadTraceWriter::Open(const std::string& filename, const std::string& game_id)
+{
+	if (!m_file.Open(filename, "w"))
+		return false;
+
+	fprintf(m_file.GetHandle(), "%s %s\n", TRACE_MAGIC, game_id.c_str());
+	return true;
+}
+
+void ReadTraceWriter::Close()
+{
+	m_file.Close();
+}
+
+void ReadTraceWriter::Write(const ReadTraceEvent& event)
+{
+	if (!m_file)
+		return;
+
+	if (event.type == ReadTraceEvent::READ)
+	{
+		fprintf(m_file.GetHandle(), "R %" PRIu64 " %" PRIx64 " %x %d\n",
+		        event.time_us, event.offset, event.length, event.decrypt ? 1 : 0);
+	}
+	else
+	{
+		fprintf(m_file.GetHandle(), "P %" PRIu64 " %" PRIx64 "\n", event.time_us, event.offset);
+	}
+}
+
+bool LoadReadTrace(const std::string& filename, std::vector<ReadTraceEvent>* events, std::string* game_id)
+{
+	std::ifstream in;
+	OpenFStream(in, filename, std::ios_base::in);
+	if (!in)
+		return false;
+
+	std::string line;
+	if (!std::getline(in, line) || line.compare(0, sizeof(TRACE_MAGIC) - 1, TRACE_MAGIC) != 0)
+		return false;
+	*game_id = line.size() > sizeof(TRACE_MAGIC) ? line.substr(sizeof(TRACE_MAGIC)) : "";
+
+	events->clear();
+	while (std::getline(in, line))
+	{
+		if (line.empty())
+			continue;
+
+		std::istringstream ss(line);
+		char type;
+		ReadTraceEvent event = {};
+		ss >> type >> event.time_us >> std::hex >> event.offset;
+		if (type == 'R')
+		{
+			int decrypt;
+			ss >> event.length >> std::dec >> decrypt;
+			event.type = ReadTraceEvent::READ;
+			event.decrypt = decrypt != 0;
+		}
+		else if (type == 'P')
+		{
+			event.type = ReadTraceEvent::OPEN_PARTITION;
+		}
+		else
+		{
+			return false;
+		}
+
+		if (ss.fail())
+			return false;
+		events->push_back(event);
+	}
+
+	return true;
+}
+
+}  // namespace
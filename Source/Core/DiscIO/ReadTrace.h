@@ -0,0 +1,57 @@
+// Copyright 2015 Dolphin Emulator Project
+// Licensed under GPLv2
+// Refer to the license.txt file included.
+
+// Disc read traces: everything a game read from the disc during a session,
+// and when. DVDInterface records them when SConfig::m_DumpDiscReads is set,
+// and discbench replays them against any image to compare formats.
+//
+// The file is plain text. The first line is
+//   # dolphin disc read trace 1 <game id>
+// followed by one line per event, times in emulated microseconds:
+//   R <time> <offset> <length> <decrypt>   a read, offsets in hex
+//   P <time> <offset>                      a switch to the Wii partition at offset
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "Common/CommonTypes.h"
+#include "Common/FileUtil.h"
+
+namespace DiscIO
+{
+
+struct ReadTraceEvent
+{
+	enum EType
+	{
+		READ,
+		OPEN_PARTITION,
+	};
+
+	EType type;
+	u64 time_us;
+	u64 offset;
+	// Only for reads
+	u32 length;
+	bool decrypt;
+};
+
+class ReadTraceWriter
+{
+public:
+	bool Open(const std::string& filename, const std::string& game_id);
+	void Close();
+	bool IsOpen() { return m_file.IsOpen(); }
+
+	void Write(const ReadTraceEvent& event);
+
+private:
+	File::IOFile m_file;
+};
+
+bool LoadReadTrace(const std::string& filename, std::vector<ReadTraceEvent>* events, std::string* game_id);
+
+}  // namespace
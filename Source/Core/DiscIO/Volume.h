@@ -12,6 +12,9 @@
 
 namespace DiscIO
 {
+
+struct CacheStats;
+
 class IVolume
 {
 public:
@@ -42,6 +45,10 @@ public:
 
 	virtual bool ChangePartition(u64 offset) { return false; }
 
+	// Fills in the hit counts of the volume's own cache and of the blob
+	// reader's, for benchmarking. False if the volume doesn't have a reader.
+	virtual bool GetCacheStats(CacheStats* volume_cache, CacheStats* blob_cache) const { return false; }
+
 	// Increment CACHE_REVISION if values are changed (ISOFile.cpp)
 	enum ECountry
 	{
@@ -3,20 +3,22 @@
 // Refer to the license.txt file included.
 
 #include <algorithm>
+#include <cinttypes>
 #include <cstddef>
 #include <cstring>
-#include <map>
 #include <memory>
+#include <mutex>
 #include <string>
-#include <utility>
 #include <vector>
 
 #include "Common/CommonPaths.h"
 #include "Common/CommonTypes.h"
 #include "Common/FileUtil.h"
+#include "Common/MappedFile.h"
 #include "Common/MathUtil.h"
+#include "Common/StdMakeUnique.h"
+#include "Common/Timer.h"
 #include "Core/VolumeHandler.h"
-#include "DiscIO/FileBlob.h"
 #include "DiscIO/Volume.h"
 #include "DiscIO/VolumeDirectory.h"
 
@@ -81,6 +83,8 @@ bool CVolumeDirectory::Read(u64 _Offset, u64 _Length, u8* _pBuffer, bool decrypt
 	if (decrypt && !wii)
 		PanicAlertT("Tried to decrypt data from a non-Wii volume");
 
+	std::lock_guard<std::mutex> lk(m_lock);
+
 	// header
 	if (_Offset < DISKHEADERINFO_ADDRESS)
 	{
@@ -104,6 +108,7 @@ bool CVolumeDirectory::Read(u64 _Offset, u64 _Length, u8* _pBuffer, bool decrypt
 	// fst
 	if (_Offset >= m_fst_address && _Offset < m_dataStartAddress)
 	{
+		UpdateFSTFileSizes();
 		WriteToBuffer(m_fst_address, m_FSTData.size(), m_FSTData.data(), _Offset, _Length, _pBuffer);
 	}
 
@@ -111,31 +116,24 @@ bool CVolumeDirectory::Read(u64 _Offset, u64 _Length, u8* _pBuffer, bool decrypt
 		return true;
 
 	// Determine which file the offset refers to
-	std::map<u64, std::string>::const_iterator fileIter = m_virtualDisk.lower_bound(_Offset);
-	if (fileIter->first > _Offset && fileIter != m_virtualDisk.begin())
+	auto fileIter = std::upper_bound(m_virtualDisk.begin(), m_virtualDisk.end(), _Offset,
+		[](u64 offset, const SVirtualFile& file) { return offset < file.Offset; });
+	if (fileIter != m_virtualDisk.begin())
 		--fileIter;
 
 	// zero fill to start of file data
-	PadToAddress(fileIter->first, _Offset, _Length, _pBuffer);
+	PadToAddress(fileIter->Offset, _Offset, _Length, _pBuffer);
 
 	while (fileIter != m_virtualDisk.end() && _Length > 0)
 	{
-		_dbg_assert_(DVDINTERFACE, fileIter->first <= _Offset);
-		u64 fileOffset = _Offset - fileIter->first;
-
-		std::unique_ptr<PlainFileReader> reader(PlainFileReader::Create(fileIter->second));
-		if (reader == nullptr)
-			return false;
+		_dbg_assert_(DVDINTERFACE, fileIter->Offset <= _Offset);
+		u64 fileOffset = _Offset - fileIter->Offset;
 
-		u64 fileSize = reader->GetDataSize();
-
-		if (fileOffset < fileSize)
+		if (fileOffset < fileIter->MaxSize)
 		{
-			u64 fileBytes = fileSize - fileOffset;
-			if (_Length < fileBytes)
-				fileBytes = _Length;
-
-			if (!reader->Read(fileOffset, fileBytes, _pBuffer))
+			u64 fileBytes;
+			if (!ReadFromFile(fileIter - m_virtualDisk.begin(), fileOffset,
+			                  std::min(_Length, fileIter->MaxSize - fileOffset), _pBuffer, &fileBytes))
 				return false;
 
 			_Length -= fileBytes;
@@ -147,14 +145,104 @@ bool CVolumeDirectory::Read(u64 _Offset, u64 _Length, u8* _pBuffer, bool decrypt
 
 		if (fileIter != m_virtualDisk.end())
 		{
-			_dbg_assert_(DVDINTERFACE, fileIter->first >= _Offset);
-			PadToAddress(fileIter->first, _Offset, _Length, _pBuffer);
+			_dbg_assert_(DVDINTERFACE, fileIter->Offset >= _Offset);
+			PadToAddress(fileIter->Offset, _Offset, _Length, _pBuffer);
 		}
 	}
 
 	return true;
 }
 
+bool CVolumeDirectory::ReadFromFile(size_t file_index, u64 _Offset, u64 _Length, u8* _pBuffer, u64* _ReadBytes) const
+{
+	*_ReadBytes = 0;
+
+	CheckHostFile(file_index);
+	SHostFile& host = m_hostFiles[file_index];
+	// Reading past the end of a mapped file that got truncated crashes, so
+	// mapped files get checked on every read rather than every so often.
+	if (host.Mapping && host.Mapping->HasChanged())
+	{
+		host.Checked = false;
+		CheckHostFile(file_index);
+	}
+	if (_Offset >= host.Size)
+		return true;
+
+	u64 bytes = std::min(_Length, host.Size - _Offset);
+	if (host.Mapping)
+	{
+		memcpy(_pBuffer, host.Mapping->GetData() + _Offset, (size_t)bytes);
+		*_ReadBytes = bytes;
+		return true;
+	}
+
+	// The file isn't kept open, so that it can be edited while the game runs.
+	File::IOFile file(m_virtualDisk[file_index].PhysicalName, "rb");
+	if (!file.Seek(_Offset, SEEK_SET) || !file.ReadBytes(_pBuffer, (size_t)bytes))
+	{
+		// It may have shrunk since it was checked.
+		host.Checked = false;
+		return false;
+	}
+	*_ReadBytes = bytes;
+	return true;
+}
+
+void CVolumeDirectory::CheckHostFile(size_t file_index) const
+{
+	// Games read small parts of files at a time, so stat()ing on every read adds
+	// up. Edits take up to this long to show up instead.
+	const u32 CHECK_INTERVAL_MS = 1000;
+
+	SHostFile& host = m_hostFiles[file_index];
+	const u32 now = Common::Timer::GetTimeMs();
+	if (host.Checked && now - host.CheckedTime < CHECK_INTERVAL_MS)
+		return;
+	host.Checked = true;
+	host.CheckedTime = now;
+
+	// The file keeps its place on the disc, so nothing else needs to be rebuilt
+	// when it changes, as long as it still fits.
+	const SVirtualFile& file = m_virtualDisk[file_index];
+	if (host.Mapping)
+	{
+		if (!host.Mapping->HasChanged())
+			return;
+		INFO_LOG(DISCIO, "%s has changed, mapping it again", file.PhysicalName.c_str());
+	}
+
+	host.Mapping = std::make_unique<File::MappedFile>();
+	if (host.Mapping->Open(file.PhysicalName))
+	{
+		host.Size = host.Mapping->GetSize();
+	}
+	else
+	{
+		host.Mapping.reset();
+		host.Size = File::GetSize(file.PhysicalName);
+	}
+
+	SetFSTFileSize(file, host.Size);
+}
+
+void CVolumeDirectory::UpdateFSTFileSizes() const
+{
+	for (size_t i = 0; i < m_virtualDisk.size(); i++)
+		CheckHostFile(i);
+}
+
+void CVolumeDirectory::SetFSTFileSize(const SVirtualFile& file, u64 size) const
+{
+	if (size > file.MaxSize)
+	{
+		WARN_LOG(DISCIO, "%s no longer fits in its place on the disc, only the first %" PRIu64 " bytes can be read until the game is restarted",
+		         file.PhysicalName.c_str(), file.MaxSize);
+		size = file.MaxSize;
+	}
+	Write32((u32)size, file.FSTEntryOffset + 8, &m_FSTData);
+}
+
 std::string CVolumeDirectory::GetUniqueID() const
 {
 	static const size_t ID_LENGTH = 6;
@@ -315,6 +403,9 @@ void CVolumeDirectory::SetDOL(const std::string& rDOL)
 void CVolumeDirectory::BuildFST()
 {
 	m_FSTData.clear();
+	m_virtualDisk.clear();
+	m_hostFiles.clear();
+	m_totalNameSize = 0;
 
 	File::FSTEntry rootEntry;
 
@@ -442,15 +533,19 @@ void CVolumeDirectory::WriteEntry(const File::FSTEntry& entry, u32& fstOffset, u
 	else
 	{
 		// put entry in FST
+		u32 entryOffset = fstOffset;
 		WriteEntryData(fstOffset, FILE_ENTRY, nameOffset, dataOffset, (u32)entry.size);
 		WriteEntryName(nameOffset, entry.virtualName);
 
+		// 4 byte aligned
+		u64 nextDataOffset = ROUND_UP(dataOffset + entry.size, 0x8000ull);
+
 		// write entry to virtual disk
-		_dbg_assert_(DVDINTERFACE, m_virtualDisk.find(dataOffset) == m_virtualDisk.end());
-		m_virtualDisk.insert(make_pair(dataOffset, entry.physicalName));
+		_dbg_assert_(DVDINTERFACE, m_virtualDisk.empty() || m_virtualDisk.back().Offset <= dataOffset);
+		m_virtualDisk.push_back({dataOffset, nextDataOffset - dataOffset, entryOffset, entry.physicalName});
+		m_hostFiles.emplace_back();
 
-		// 4 byte aligned
-		dataOffset = ROUND_UP(dataOffset + entry.size, 0x8000ull);
+		dataOffset = nextDataOffset;
 	}
 }
 
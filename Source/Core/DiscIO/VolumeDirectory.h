@@ -4,15 +4,15 @@
 
 #pragma once
 
-#include <map>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 
 #include "Common/CommonTypes.h"
 #include "DiscIO/Volume.h"
 
-namespace File { struct FSTEntry; }
+namespace File { struct FSTEntry; class MappedFile; }
 
 //
 // --- this volume type is used for reading files directly from the hard drive ---
@@ -69,7 +69,16 @@ private:
 
 	void PadToAddress(u64 _StartAddress, u64& _Address, u64& _Length, u8*& _pBuffer) const;
 
-	void Write32(u32 data, u32 offset, std::vector<u8>* const buffer);
+	// Copies up to _Length bytes from _Offset in the host file behind file_index.
+	// Sets _ReadBytes to how many the file had to give.
+	bool ReadFromFile(size_t file_index, u64 _Offset, u64 _Length, u8* _pBuffer, u64* _ReadBytes) const;
+	// Looks at the host file again, unless that was done very recently: maps
+	// it if it can be, and updates its size in the FST.
+	void CheckHostFile(size_t file_index) const;
+	// Brings the file sizes in the FST up to date before it gets read.
+	void UpdateFSTFileSizes() const;
+
+	static void Write32(u32 data, u32 offset, std::vector<u8>* const buffer);
 
 	// FST creation
 	void WriteEntryData(u32& entryOffset, u8 type, u32 nameOffset, u64 dataOffset, u32 length);
@@ -81,7 +90,35 @@ private:
 
 	std::string m_rootDirectory;
 
-	std::map<u64, std::string> m_virtualDisk;
+	struct SVirtualFile
+	{
+		// Where the file starts on the disc, and how much room it has there.
+		u64 Offset;
+		u64 MaxSize;
+		// Where the file's FST entry is, to keep its size up to date.
+		u32 FSTEntryOffset;
+		std::string PhysicalName;
+	};
+
+	// Sorted by offset.
+	std::vector<SVirtualFile> m_virtualDisk;
+
+	struct SHostFile
+	{
+		// Files that can't be mapped are opened for each read instead.
+		std::unique_ptr<File::MappedFile> Mapping;
+		// The size when the file was last checked, and when that was.
+		u64 Size = 0;
+		u32 CheckedTime = 0;
+		bool Checked = false;
+	};
+
+	// The state of the host file behind each entry of m_virtualDisk. m_lock
+	// covers these and the parts of the FST that change with them.
+	mutable std::mutex m_lock;
+	mutable std::vector<SHostFile> m_hostFiles;
+
+	void SetFSTFileSize(const SVirtualFile& file, u64 size) const;
 
 	u32 m_totalNameSize;
 
@@ -92,7 +129,7 @@ private:
 	u64 m_dataStartAddress;
 
 	u64 m_fstNameOffset;
-	std::vector<u8> m_FSTData;
+	mutable std::vector<u8> m_FSTData;
 
 	std::vector<u8> m_diskHeader;
 
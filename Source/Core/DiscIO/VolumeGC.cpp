@@ -159,6 +159,17 @@ bool CVolumeGC::IsDiscTwo() const
 	return discTwo;
 }
 
+bool CVolumeGC::GetCacheStats(CacheStats* volume_cache, CacheStats* blob_cache) const
+{
+	if (m_pReader == nullptr)
+		return false;
+
+	// Reads go straight to the blob.
+	volume_cache->hits = volume_cache->misses = 0;
+	*blob_cache = m_pReader->GetCacheStats();
+	return true;
+}
+
 CVolumeGC::StringDecoder CVolumeGC::GetStringDecoder(ECountry country)
 {
 	return (COUNTRY_JAPAN == country || COUNTRY_TAIWAN == country) ?
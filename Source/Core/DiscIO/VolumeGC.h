@@ -35,6 +35,7 @@ public:
 	u64 GetSize() const override;
 	u64 GetRawSize() const override;
 	bool IsDiscTwo() const override;
+	bool GetCacheStats(CacheStats* volume_cache, CacheStats* blob_cache) const override;
 
 	typedef std::string(*StringDecoder)(const std::string&);
 
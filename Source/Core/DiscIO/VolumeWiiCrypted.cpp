@@ -2,6 +2,7 @@
 // Licensed under GPLv2
 // Refer to the license.txt file included.
 
+#include <algorithm>
 #include <cstddef>
 #include <cstring>
 #include <string>
@@ -12,6 +13,7 @@
 #include "Common/CommonFuncs.h"
 #include "Common/CommonTypes.h"
 #include "Common/MsgHandler.h"
+#include "Common/StdMakeUnique.h"
 #include "Common/Logging/Log.h"
 #include "DiscIO/Blob.h"
 #include "DiscIO/FileMonitor.h"
@@ -27,19 +29,23 @@ CVolumeWiiCrypted::CVolumeWiiCrypted(IBlobReader* _pReader, u64 _VolumeOffset,
 									 const unsigned char* _pVolumeKey)
 	: m_pReader(_pReader),
 	m_AES_ctx(new aes_context),
-	m_pBuffer(nullptr),
 	m_VolumeOffset(_VolumeOffset),
 	m_dataOffset(0x20000),
-	m_LastDecryptedBlockOffset(-1)
+	m_cluster_cache(CLUSTER_CACHE_SIZE * CLUSTER_DATA_SIZE),
+	m_cluster_tags(CLUSTER_CACHE_SIZE),
+	m_cluster_age(CLUSTER_CACHE_SIZE),
+	m_cluster_clock(0),
+	m_cluster_hits(0),
+	m_cluster_misses(0)
 {
 	aes_setkey_dec(m_AES_ctx.get(), _pVolumeKey, 128);
-	m_pBuffer = new u8[0x8000];
+	InvalidateClusterCache();
 }
 
 bool CVolumeWiiCrypted::ChangePartition(u64 offset)
 {
 	m_VolumeOffset = offset;
-	m_LastDecryptedBlockOffset = -1;
+	InvalidateClusterCache();
 
 	u8 volume_key[16];
 	DiscIO::VolumeKeyForParition(*m_pReader, offset, volume_key);
@@ -47,11 +53,85 @@ bool CVolumeWiiCrypted::ChangePartition(u64 offset)
 	return true;
 }
 
+bool CVolumeWiiCrypted::GetCacheStats(CacheStats* volume_cache, CacheStats* blob_cache) const
+{
+	if (m_pReader == nullptr)
+		return false;
+
+	volume_cache->hits = m_cluster_hits;
+	volume_cache->misses = m_cluster_misses;
+	*blob_cache = m_pReader->GetCacheStats();
+	return true;
+}
+
 
 CVolumeWiiCrypted::~CVolumeWiiCrypted()
 {
-	delete[] m_pBuffer;
-	m_pBuffer = nullptr;
+}
+
+void CVolumeWiiCrypted::InvalidateClusterCache()
+{
+	std::fill(m_cluster_tags.begin(), m_cluster_tags.end(), (u64)(s64)-1);
+	std::fill(m_cluster_age.begin(), m_cluster_age.end(), 0);
+}
+
+int CVolumeWiiCrypted::FindCachedCluster(u64 cluster) const
+{
+	for (int i = 0; i < CLUSTER_CACHE_SIZE; i++)
+	{
+		if (m_cluster_tags[i] == cluster)
+		{
+			m_cluster_age[i] = ++m_cluster_clock;
+			return i;
+		}
+	}
+	return -1;
+}
+
+// Reads a run of clusters with a single blob read and decrypts them into the
+// least recently used cache slots. Clusters are independent CBC streams (each
+// carries its own IV), so a batch is decrypted across several threads.
+// PolarSSL picks AES-NI on its own when the host CPU supports it.
+bool CVolumeWiiCrypted::DecryptClusters(u64 first_cluster, u64 count) const
+{
+	m_raw_buffer.resize((size_t)(count * CLUSTER_SIZE));
+	if (!m_pReader->Read(m_VolumeOffset + m_dataOffset + first_cluster * CLUSTER_SIZE, count * CLUSTER_SIZE, m_raw_buffer.data()))
+		return false;
+
+	int slots[MAX_DECRYPT_BATCH];
+	for (u64 i = 0; i < count; i++)
+	{
+		int oldest = 0;
+		for (int j = 1; j < CLUSTER_CACHE_SIZE; j++)
+		{
+			if (m_cluster_age[j] < m_cluster_age[oldest])
+				oldest = j;
+		}
+		slots[i] = oldest;
+		m_cluster_tags[oldest] = first_cluster + i;
+		m_cluster_age[oldest] = ++m_cluster_clock;
+	}
+
+	auto decrypt = [&](size_t i) {
+		const u8* raw = m_raw_buffer.data() + i * CLUSTER_SIZE;
+		u8 iv[16];
+		memcpy(iv, raw + 0x3d0, 16);
+		aes_crypt_cbc(m_AES_ctx.get(), AES_DECRYPT, CLUSTER_DATA_SIZE, iv, raw + 0x400,
+		              &m_cluster_cache[slots[i] * CLUSTER_DATA_SIZE]);
+	};
+
+	if (count > 1)
+	{
+		if (!m_pool)
+			m_pool = std::make_unique<Common::ThreadPool>();
+		m_pool->ParallelFor((size_t)count, decrypt);
+	}
+	else
+	{
+		decrypt(0);
+	}
+
+	return true;
 }
 
 bool CVolumeWiiCrypted::Read(u64 _ReadOffset, u64 _Length, u8* _pBuffer, bool decrypt) const
@@ -66,28 +146,34 @@ bool CVolumeWiiCrypted::Read(u64 _ReadOffset, u64 _Length, u8* _pBuffer, bool de
 
 	while (_Length > 0)
 	{
-		static unsigned char IV[16];
-
 		// math block offset
-		u64 Block  = _ReadOffset / 0x7C00;
-		u64 Offset = _ReadOffset % 0x7C00;
-
-		// read current block
-		if (!m_pReader->Read(m_VolumeOffset + m_dataOffset + Block * 0x8000, 0x8000, m_pBuffer))
-			return(false);
+		u64 Block  = _ReadOffset / CLUSTER_DATA_SIZE;
+		u64 Offset = _ReadOffset % CLUSTER_DATA_SIZE;
 
-		if (m_LastDecryptedBlockOffset != Block)
+		int slot = FindCachedCluster(Block);
+		if (slot == -1)
 		{
-			memcpy(IV, m_pBuffer + 0x3d0, 16);
-			aes_crypt_cbc(m_AES_ctx.get(), AES_DECRYPT, 0x7C00, IV, m_pBuffer + 0x400, m_LastDecryptedBlock);
+			// Pull in every uncached cluster this read still needs in one go
+			u64 LastBlock = (_ReadOffset + _Length - 1) / CLUSTER_DATA_SIZE;
+			u64 Count = 1;
+			while (Block + Count <= LastBlock && Count < MAX_DECRYPT_BATCH && FindCachedCluster(Block + Count) == -1)
+				Count++;
+
+			if (!DecryptClusters(Block, Count))
+				return(false);
 
-			m_LastDecryptedBlockOffset = Block;
+			m_cluster_misses += Count;
+			slot = FindCachedCluster(Block);
+		}
+		else
+		{
+			m_cluster_hits++;
 		}
 
-		// copy the encrypted data
-		u64 MaxSizeToCopy = 0x7C00 - Offset;
+		// copy the decrypted data
+		u64 MaxSizeToCopy = CLUSTER_DATA_SIZE - Offset;
 		u64 CopySize = (_Length > MaxSizeToCopy) ? MaxSizeToCopy : _Length;
-		memcpy(_pBuffer, &m_LastDecryptedBlock[Offset], (size_t)CopySize);
+		memcpy(_pBuffer, &m_cluster_cache[slot * CLUSTER_DATA_SIZE + Offset], (size_t)CopySize);
 
 		// increase buffers
 		_Length -= CopySize;
@@ -10,6 +10,7 @@
 #include <polarssl/aes.h>
 
 #include "Common/CommonTypes.h"
+#include "Common/ThreadPool.h"
 #include "DiscIO/Volume.h"
 
 // --- this volume type is used for encrypted Wii images ---
@@ -41,18 +42,41 @@ public:
 	bool CheckIntegrity() const override;
 
 	bool ChangePartition(u64 offset) override;
+	bool GetCacheStats(CacheStats* volume_cache, CacheStats* blob_cache) const override;
 
 private:
+	enum
+	{
+		CLUSTER_SIZE = 0x8000,
+		CLUSTER_DATA_SIZE = 0x7C00,
+		// Decrypted clusters kept around, about 2 MiB worth.
+		CLUSTER_CACHE_SIZE = 64,
+		// Upper bound on how many clusters one raw read + decrypt batch covers.
+		// Must stay below CLUSTER_CACHE_SIZE so a batch never evicts itself.
+		MAX_DECRYPT_BATCH = CLUSTER_CACHE_SIZE / 2,
+	};
+
+	int FindCachedCluster(u64 cluster) const;
+	bool DecryptClusters(u64 first_cluster, u64 count) const;
+	void InvalidateClusterCache();
+
 	std::unique_ptr<IBlobReader> m_pReader;
 	std::unique_ptr<aes_context> m_AES_ctx;
 
-	u8* m_pBuffer;
-
 	u64 m_VolumeOffset;
 	u64 m_dataOffset;
 
-	mutable u64 m_LastDecryptedBlockOffset;
-	mutable unsigned char m_LastDecryptedBlock[0x8000];
+	// LRU cache of decrypted cluster data, indexed by slot
+	mutable std::vector<u8> m_cluster_cache;
+	mutable std::vector<u64> m_cluster_tags;
+	mutable std::vector<u64> m_cluster_age;
+	mutable u64 m_cluster_clock;
+	mutable u64 m_cluster_hits;
+	mutable u64 m_cluster_misses;
+
+	mutable std::vector<u8> m_raw_buffer;
+	// Created on the first multi-cluster read
+	mutable std::unique_ptr<Common::ThreadPool> m_pool;
 };
 
 } // namespace
@@ -70,6 +70,7 @@ const CPUCore CPUCores[] = {
 #elif defined(_M_ARM_64)
 	{4, wxTRANSLATE("Arm64 JIT (experimental)")},
 #endif
+	{5, wxTRANSLATE("Cached Interpreter (slower)")},
 };
 
 // keep these in sync with CConfigMain::InitializeGUILists
@@ -32,6 +32,7 @@
 #include "Core/Core.h"
 #include "Core/Host.h"
 #include "Core/Boot/Boot.h"
+#include "Core/DSP/DSPCore.h"
 #include "Core/HLE/HLE.h"
 #include "Core/PowerPC/PowerPC.h"
 #include "Core/PowerPC/PPCAnalyst.h"
@@ -187,8 +188,12 @@ void CCodeWindow::CreateMenuSymbols(wxMenuBar *pMenuBar)
 
 	wxMenu *pProfilerMenu = new wxMenu;
 	pProfilerMenu->Append(IDM_PROFILE_BLOCKS, _("&Profile blocks"), wxEmptyString, wxITEM_CHECK);
+	pProfilerMenu->Append(IDM_SAMPLE_PROFILE, _("&Sample functions"),
+		_("Periodically record where the CPU is and what called it. Cheap enough to leave on, and doesn't need the code cache cleared."), wxITEM_CHECK);
+	pProfilerMenu->Check(IDM_SAMPLE_PROFILE, Profiler::IsSampling());
 	pProfilerMenu->AppendSeparator();
 	pProfilerMenu->Append(IDM_WRITE_PROFILE, _("&Write to profile.txt, show"));
+	pProfilerMenu->Append(IDM_WRITE_SAMPLE_PROFILE, _("Write &samples to profile.json"));
 	pMenuBar->Append(pProfilerMenu, _("&Profiler"));
 }
 
@@ -203,6 +208,21 @@ void CCodeWindow::OnProfilerMenu(wxCommandEvent& event)
 		Profiler::g_ProfileBlocks = GetMenuBar()->IsChecked(IDM_PROFILE_BLOCKS);
 		Core::SetState(Core::CORE_RUN);
 		break;
+	case IDM_SAMPLE_PROFILE:
+		Profiler::SetSampling(GetMenuBar()->IsChecked(IDM_SAMPLE_PROFILE));
+		break;
+	case IDM_WRITE_SAMPLE_PROFILE:
+		if (Core::GetState() == Core::CORE_RUN)
+			Core::SetState(Core::CORE_PAUSE);
+
+		if (Core::GetState() == Core::CORE_PAUSE)
+		{
+			std::string filename = File::GetUserPath(D_DUMP_IDX) + "Debug/profile.json";
+			File::CreateFullPath(filename);
+			Profiler::WriteSampleResults(filename);
+			Parent->StatusBarMessage("Wrote %s", filename.c_str());
+		}
+		break;
 	case IDM_WRITE_PROFILE:
 		if (Core::GetState() == Core::CORE_RUN)
 			Core::SetState(Core::CORE_PAUSE);
@@ -214,6 +234,7 @@ void CCodeWindow::OnProfilerMenu(wxCommandEvent& event)
 				std::string filename = File::GetUserPath(D_DUMP_IDX) + "Debug/profiler.txt";
 				File::CreateFullPath(filename);
 				Profiler::WriteProfileResults(filename);
+				DSPCore_WriteProfileResults(File::GetUserPath(D_DUMP_IDX) + "Debug/dsp_profiler.txt");
 
 				wxFileType* filetype = nullptr;
 				if (!(filetype = wxTheMimeTypesManager->GetFileTypeFromExtension("txt")))
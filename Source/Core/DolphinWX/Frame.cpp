@@ -302,6 +302,7 @@ EVT_MENU(IDM_SAVE_FIRST_STATE, CFrame::OnSaveFirstState)
 EVT_MENU(IDM_UNDO_LOAD_STATE,     CFrame::OnUndoLoadState)
 EVT_MENU(IDM_UNDO_SAVE_STATE,     CFrame::OnUndoSaveState)
 EVT_MENU(IDM_LOAD_STATE_FILE, CFrame::OnLoadStateFromFile)
+EVT_MENU(IDM_REWIND, CFrame::OnRewind)
 EVT_MENU(IDM_SAVE_STATE_FILE, CFrame::OnSaveStateToFile)
 EVT_MENU(IDM_SAVE_SELECTED_SLOT, CFrame::OnSaveCurrentSlot)
 EVT_MENU(IDM_LOAD_SELECTED_SLOT, CFrame::OnLoadCurrentSlot)
@@ -963,6 +964,7 @@ int GetCmdForHotkey(unsigned int key)
 	case HK_UNDO_LOAD_STATE: return IDM_UNDO_LOAD_STATE;
 	case HK_UNDO_SAVE_STATE: return IDM_UNDO_SAVE_STATE;
 	case HK_LOAD_STATE_FILE: return IDM_LOAD_STATE_FILE;
+	case HK_REWIND: return IDM_REWIND;
 	case HK_SAVE_STATE_FILE: return IDM_SAVE_STATE_FILE;
 
 	case HK_SELECT_STATE_SLOT_1: return IDM_SELECT_SLOT_1;
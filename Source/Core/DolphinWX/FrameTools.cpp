@@ -47,6 +47,7 @@
 #include "Core/CoreParameter.h"
 #include "Core/Host.h"
 #include "Core/Movie.h"
+#include "Core/Rewind.h"
 #include "Core/State.h"
 #include "Core/HW/CPU.h"
 #include "Core/HW/DVDInterface.h"
@@ -191,6 +192,7 @@ wxMenuBar* CFrame::CreateMenu()
 	loadMenu->Append(IDM_LOAD_STATE_FILE,  GetMenuLabel(HK_LOAD_STATE_FILE));
 	loadMenu->Append(IDM_LOAD_SELECTED_SLOT, GetMenuLabel(HK_LOAD_STATE_SLOT_SELECTED));
 	loadMenu->Append(IDM_UNDO_LOAD_STATE, GetMenuLabel(HK_UNDO_LOAD_STATE));
+	loadMenu->Append(IDM_REWIND, GetMenuLabel(HK_REWIND));
 	loadMenu->AppendSeparator();
 
 	for (unsigned int i = 1; i <= State::NUM_STATES; i++)
@@ -512,6 +514,7 @@ wxString CFrame::GetMenuLabel(int Id)
 		case HK_SAVE_FIRST_STATE: Label = _("Save Oldest State"); break;
 		case HK_UNDO_LOAD_STATE:  Label = _("Undo Load State");   break;
 		case HK_UNDO_SAVE_STATE:  Label = _("Undo Save State");   break;
+		case HK_REWIND:           Label = _("Rewind");            break;
 
 		case HK_SAVE_STATE_SLOT_SELECTED:
 			Label = _("Save state to selected slot");
@@ -1634,6 +1637,12 @@ void CFrame::OnUndoSaveState(wxCommandEvent& WXUNUSED (event))
 		State::UndoSaveState();
 }
 
+void CFrame::OnRewind(wxCommandEvent& WXUNUSED (event))
+{
+	if (Core::IsRunningAndStarted())
+		Rewind::StepBack();
+}
+
 
 void CFrame::OnLoadState(wxCommandEvent& event)
 {
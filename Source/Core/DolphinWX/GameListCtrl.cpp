@@ -56,6 +56,7 @@
 #include "Core/HW/DVDInterface.h"
 #include "Core/HW/WiiSaveCrypted.h"
 #include "DiscIO/Blob.h"
+#include "DiscIO/DedupIndex.h"
 #include "DiscIO/Volume.h"
 #include "DiscIO/VolumeCreator.h"
 #include "DolphinWX/Frame.h"
@@ -1155,6 +1156,10 @@ void CGameListCtrl::CompressSelection(bool _compress)
 
 	bool all_good = true;
 
+	// Finds out how much of the batch could be shared between the images.
+	DiscIO::DedupIndex dedup(16384);
+	DiscIO::DedupIndex* dedup_ptr = SConfig::GetInstance().m_DedupReport ? &dedup : nullptr;
+
 	{
 		wxProgressDialog progressDialog(
 			_compress ? _("Compressing ISO") : _("Decompressing ISO"),
@@ -1198,7 +1203,7 @@ void CGameListCtrl::CompressSelection(bool _compress)
 				all_good &= DiscIO::CompressFileToBlob(iso->GetFileName(),
 						OutputFileName,
 						(iso->GetPlatform() == GameListItem::WII_DISC) ? 1 : 0,
-						16384, &MultiCompressCB, &progressDialog);
+						16384, &MultiCompressCB, &progressDialog, dedup_ptr);
 			}
 			else if (iso->IsCompressed() && !_compress)
 			{
@@ -1230,6 +1235,14 @@ void CGameListCtrl::CompressSelection(bool _compress)
 		}
 	}
 
+	if (dedup.GetImageCount() > 1)
+	{
+		std::string report = File::GetUserPath(D_DUMP_IDX) + "dedup_report.txt";
+		if (dedup.WriteReport(report))
+			NOTICE_LOG(DISCIO, "%" PRIu64 " of %" PRIu64 " blocks are distinct, see %s",
+			           dedup.GetDistinctBlocks(), dedup.GetTotalBlocks(), report.c_str());
+	}
+
 	if (!all_good)
 		WxUtils::ShowErrorDialog(_("Dolphin was unable to complete the requested action."));
 
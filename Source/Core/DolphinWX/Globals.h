@@ -30,6 +30,7 @@ enum
 	IDM_UNDO_LOAD_STATE,
 	IDM_UNDO_SAVE_STATE,
 	IDM_LOAD_STATE_FILE,
+	IDM_REWIND,
 	IDM_SAVE_STATE_FILE,
 	IDM_SAVE_SLOT_1,
 	IDM_SAVE_SLOT_2,
@@ -230,6 +231,8 @@ enum
 
 	// Profiler
 	IDM_PROFILE_BLOCKS,
+	IDM_SAMPLE_PROFILE,
+	IDM_WRITE_SAMPLE_PROFILE,
 	IDM_WRITE_PROFILE,
 	// --------------------------------------------------------------
 
@@ -81,6 +81,10 @@ SoftwareVideoConfigDialog::SoftwareVideoConfigDialog(wxWindow* parent, const std
 
 	// xfb
 	szr_rendering->Add(new SettingCheckBox(page_general, _("Bypass XFB"), "", vconfig.bBypassXFB));
+
+	// threads, 0 for one per core
+	szr_rendering->Add(new wxStaticText(page_general, wxID_ANY, _("Rasterizer threads:")), 1, wxALIGN_CENTER_VERTICAL, 5);
+	szr_rendering->Add(new U32Setting(page_general, _("Rasterizer threads"), vconfig.rasterizerThreads, 0, 64));
 	}
 
 	// - info
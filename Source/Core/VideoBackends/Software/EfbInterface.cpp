@@ -3,6 +3,7 @@
 // Refer to the license.txt file included.
 
 #include <algorithm>
+#include <cstring>
 
 #include "Common/CommonFuncs.h"
 #include "Common/CommonTypes.h"
@@ -20,6 +21,7 @@ static u8 efb[EFB_WIDTH*EFB_HEIGHT*6];
 namespace EfbInterface
 {
 	u32 perf_values[PQ_NUM_MEMBERS];
+	u32 perf_quads[PQ_NUM_MEMBERS];
 
 	static inline u32 GetColorOffset(u16 x, u16 y)
 	{
@@ -36,6 +38,21 @@ namespace EfbInterface
 		p.DoArray(efb, EFB_WIDTH*EFB_HEIGHT*6);
 	}
 
+	// Pixels are three bytes. Only those are touched, because the rasterizer
+	// threads own whole rows and a u32 access at the end of a row would reach
+	// into the next one.
+	static inline u32 ReadPixel(u32 offset)
+	{
+		u32 val = 0;
+		memcpy(&val, &efb[offset], 3);
+		return val;
+	}
+
+	static inline void WritePixel(u32 offset, u32 val)
+	{
+		memcpy(&efb[offset], &val, 3);
+	}
+
 	static void SetPixelAlphaOnly(u32 offset, u8 a)
 	{
 		switch (bpmem.zcontrol.pixel_format)
@@ -48,10 +65,9 @@ namespace EfbInterface
 		case PEControl::RGBA6_Z24:
 			{
 				u32 a32 = a;
-				u32 *dst = (u32*)&efb[offset];
-				u32 val = *dst & 0xffffffc0;
+				u32 val = ReadPixel(offset) & 0xffffffc0;
 				val |= (a32 >> 2) & 0x0000003f;
-				*dst = val;
+				WritePixel(offset, val);
 			}
 			break;
 		default:
@@ -67,31 +83,28 @@ namespace EfbInterface
 		case PEControl::Z24:
 			{
 				u32 src = *(u32*)rgb;
-				u32 *dst = (u32*)&efb[offset];
-				u32 val = *dst & 0xff000000;
+				u32 val = ReadPixel(offset) & 0xff000000;
 				val |= src >> 8;
-				*dst = val;
+				WritePixel(offset, val);
 			}
 			break;
 		case PEControl::RGBA6_Z24:
 			{
 				u32 src = *(u32*)rgb;
-				u32 *dst = (u32*)&efb[offset];
-				u32 val = *dst & 0xff00003f;
+				u32 val = ReadPixel(offset) & 0xff00003f;
 				val |= (src >> 4) & 0x00000fc0; // blue
 				val |= (src >> 6) & 0x0003f000; // green
 				val |= (src >> 8) & 0x00fc0000; // red
-				*dst = val;
+				WritePixel(offset, val);
 			}
 			break;
 		case PEControl::RGB565_Z16:
 			{
 				INFO_LOG(VIDEO, "RGB565_Z16 is not supported correctly yet");
 				u32 src = *(u32*)rgb;
-				u32 *dst = (u32*)&efb[offset];
-				u32 val = *dst & 0xff000000;
+				u32 val = ReadPixel(offset) & 0xff000000;
 				val |= src >> 8;
-				*dst = val;
+				WritePixel(offset, val);
 			}
 			break;
 		default:
@@ -107,32 +120,29 @@ namespace EfbInterface
 		case PEControl::Z24:
 			{
 				u32 src = *(u32*)color;
-				u32 *dst = (u32*)&efb[offset];
-				u32 val = *dst & 0xff000000;
+				u32 val = ReadPixel(offset) & 0xff000000;
 				val |= src >> 8;
-				*dst = val;
+				WritePixel(offset, val);
 			}
 			break;
 		case PEControl::RGBA6_Z24:
 			{
 				u32 src = *(u32*)color;
-				u32 *dst = (u32*)&efb[offset];
-				u32 val = *dst & 0xff000000;
+				u32 val = ReadPixel(offset) & 0xff000000;
 				val |= (src >> 2) & 0x0000003f; // alpha
 				val |= (src >> 4) & 0x00000fc0; // blue
 				val |= (src >> 6) & 0x0003f000; // green
 				val |= (src >> 8) & 0x00fc0000; // red
-				*dst = val;
+				WritePixel(offset, val);
 			}
 			break;
 		case PEControl::RGB565_Z16:
 			{
 				INFO_LOG(VIDEO, "RGB565_Z16 is not supported correctly yet");
 				u32 src = *(u32*)color;
-				u32 *dst = (u32*)&efb[offset];
-				u32 val = *dst & 0xff000000;
+				u32 val = ReadPixel(offset) & 0xff000000;
 				val |= src >> 8;
-				*dst = val;
+				WritePixel(offset, val);
 			}
 			break;
 		default:
@@ -147,7 +157,7 @@ namespace EfbInterface
 		case PEControl::RGB8_Z24:
 		case PEControl::Z24:
 			{
-				u32 src = *(u32*)&efb[offset];
+				u32 src = ReadPixel(offset);
 				u32 *dst = (u32*)color;
 				u32 val = 0xff | ((src & 0x00ffffff) << 8);
 				*dst = val;
@@ -155,7 +165,7 @@ namespace EfbInterface
 			break;
 		case PEControl::RGBA6_Z24:
 			{
-				u32 src = *(u32*)&efb[offset];
+				u32 src = ReadPixel(offset);
 				color[ALP_C] = Convert6To8(src & 0x3f);
 				color[BLU_C] = Convert6To8((src >> 6) & 0x3f);
 				color[GRN_C] = Convert6To8((src >> 12) & 0x3f);
@@ -165,7 +175,7 @@ namespace EfbInterface
 		case PEControl::RGB565_Z16:
 			{
 				INFO_LOG(VIDEO, "RGB565_Z16 is not supported correctly yet");
-				u32 src = *(u32*)&efb[offset];
+				u32 src = ReadPixel(offset);
 				u32 *dst = (u32*)color;
 				u32 val = 0xff | ((src & 0x00ffffff) << 8);
 				*dst = val;
@@ -184,19 +194,17 @@ namespace EfbInterface
 		case PEControl::RGBA6_Z24:
 		case PEControl::Z24:
 			{
-				u32 *dst = (u32*)&efb[offset];
-				u32 val = *dst & 0xff000000;
+				u32 val = ReadPixel(offset) & 0xff000000;
 				val |= depth & 0x00ffffff;
-				*dst = val;
+				WritePixel(offset, val);
 			}
 			break;
 		case PEControl::RGB565_Z16:
 			{
 				INFO_LOG(VIDEO, "RGB565_Z16 is not supported correctly yet");
-				u32 *dst = (u32*)&efb[offset];
-				u32 val = *dst & 0xff000000;
+				u32 val = ReadPixel(offset) & 0xff000000;
 				val |= depth & 0x00ffffff;
-				*dst = val;
+				WritePixel(offset, val);
 			}
 			break;
 		default:
@@ -214,13 +222,13 @@ namespace EfbInterface
 		case PEControl::RGBA6_Z24:
 		case PEControl::Z24:
 			{
-				depth = (*(u32*)&efb[offset]) & 0x00ffffff;
+				depth = ReadPixel(offset) & 0x00ffffff;
 			}
 			break;
 		case PEControl::RGB565_Z16:
 			{
 				INFO_LOG(VIDEO, "RGB565_Z16 is not supported correctly yet");
-				depth = (*(u32*)&efb[offset]) & 0x00ffffff;
+				depth = ReadPixel(offset) & 0x00ffffff;
 			}
 			break;
 		default:
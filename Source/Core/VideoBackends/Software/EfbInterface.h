@@ -61,16 +61,15 @@ namespace EfbInterface
 	void DoState(PointerWrap &p);
 
 	extern u32 perf_values[PQ_NUM_MEMBERS];
-	inline void IncPerfCounterQuadCount(PerfQueryType type)
+	extern u32 perf_quads[PQ_NUM_MEMBERS];
+	inline void AddPerfCounterPixels(PerfQueryType type, u32 pixels)
 	{
 		// NOTE: hardware doesn't process individual pixels but quads instead.
 		// Current software renderer architecture works on pixels though, so
 		// we have this "quad" hack here to only increment the registers on
 		// every fourth rendered pixel
-		static u32 quad[PQ_NUM_MEMBERS];
-		if (++quad[type] != 3)
-			return;
-		quad[type] = 0;
-		++perf_values[type];
+		perf_quads[type] += pixels;
+		perf_values[type] += perf_quads[type] / 3;
+		perf_quads[type] %= 3;
 	}
 }
@@ -9,6 +9,7 @@
 #include "VideoBackends/Software/CPMemLoader.h"
 #include "VideoBackends/Software/DebugUtil.h"
 #include "VideoBackends/Software/OpcodeDecoder.h"
+#include "VideoBackends/Software/Rasterizer.h"
 #include "VideoBackends/Software/SWCommandProcessor.h"
 #include "VideoBackends/Software/SWStatistics.h"
 #include "VideoBackends/Software/SWVertexLoader.h"
@@ -70,6 +71,9 @@ static void DecodePrimitiveStream(u32 iBufferSize)
 			iBufferSize -= vertexSize;
 			streamSize--;
 		}
+
+		// Registers can change once we return, so draw what was binned.
+		Rasterizer::Flush();
 	}
 
 	if (streamSize == 0)
@@ -3,8 +3,13 @@
 // Refer to the license.txt file included.
 
 #include <algorithm>
+#include <cstring>
+#include <memory>
+#include <vector>
 
 #include "Common/CommonTypes.h"
+#include "Common/StdMakeUnique.h"
+#include "Common/ThreadPool.h"
 #include "VideoBackends/Software/BPMemLoader.h"
 #include "VideoBackends/Software/EfbInterface.h"
 #include "VideoBackends/Software/HwRasterizer.h"
@@ -34,54 +39,107 @@ static inline s32 FixedLog2(float f)
 
 namespace Rasterizer
 {
-static Slope ZSlope;
-static Slope WSlope;
-static Slope ColorSlopes[2][4];
-static Slope TexSlopes[8][3];
+// Everything needed to draw the pixels of a triangle.
+struct Triangle
+{
+	Slope ZSlope;
+	Slope WSlope;
+	Slope ColorSlopes[2][4];
+	Slope TexSlopes[8][3];
+
+	s32 vertex0X;
+	s32 vertex0Y;
+	float vertexOffsetX;
+	float vertexOffsetY;
+
+	// Half-edge constants and deltas, in 28.4 fixed point
+	s32 C1, C2, C3;
+	s32 DX12, DX23, DX31;
+	s32 DY12, DY23, DY31;
+
+	// Scissored bounding rectangle, with the top left corner on a block
+	s32 minx, maxx, miny, maxy;
+};
+
+// What a thread needs to draw pixels on its own.
+struct DrawContext
+{
+	Tev tev;
+	RasterBlock rasterBlock;
+
+	// Position in the serial drawing order, made of the triangle number in the
+	// batch, the block and the pixel, of the block being drawn, the last block
+	// built and the last pixel that reached the TEV.
+	u32 triangle;
+	u64 blockKey;
+	u64 lastBlock;
+	u64 lastDraw;
+
+	u16 bboxCoords[4];
+	u32 rasterizedPixels;
+};
 
-static s32 vertex0X;
-static s32 vertex0Y;
-static float vertexOffsetX;
-static float vertexOffsetY;
+// Height of the bands of EFB rows that are handed out to the threads. Each
+// thread owns whole rows, so no two of them touch the same pixel.
+static const s32 BAND_HEIGHT = 8;
+
+// Batches covering less than this many pixels are drawn on the calling thread.
+static const u32 MIN_PARALLEL_AREA = 1024;
+
+// The setup of the last triangle, which zfreeze keeps the depth slope of.
+static Triangle s_triangle;
 
 static s32 scissorLeft = 0;
 static s32 scissorTop = 0;
 static s32 scissorRight = 0;
 static s32 scissorBottom = 0;
 
-static Tev tev;
-static RasterBlock rasterBlock;
+static DrawContext s_main;
+
+// Triangles are binned until the end of the primitive stream, which keeps the
+// BP and XF state the same for all of them.
+static std::vector<Triangle> s_batch;
+static u32 s_batch_area;
+static std::unique_ptr<Common::ThreadPool> s_pool;
+static std::unique_ptr<DrawContext[]> s_contexts;
 
 void DoState(PointerWrap &p)
 {
-	ZSlope.DoState(p);
-	WSlope.DoState(p);
-	for (auto& color_slopes_1d : ColorSlopes)
+	s_triangle.ZSlope.DoState(p);
+	s_triangle.WSlope.DoState(p);
+	for (auto& color_slopes_1d : s_triangle.ColorSlopes)
 		for (Slope& color_slope : color_slopes_1d)
 			color_slope.DoState(p);
-	for (auto& tex_slopes_1d : TexSlopes)
+	for (auto& tex_slopes_1d : s_triangle.TexSlopes)
 		for (Slope& tex_slope : tex_slopes_1d)
 			tex_slope.DoState(p);
-	p.Do(vertex0X);
-	p.Do(vertex0Y);
-	p.Do(vertexOffsetX);
-	p.Do(vertexOffsetY);
+	p.Do(s_triangle.vertex0X);
+	p.Do(s_triangle.vertex0Y);
+	p.Do(s_triangle.vertexOffsetX);
+	p.Do(s_triangle.vertexOffsetY);
 	p.Do(scissorLeft);
 	p.Do(scissorTop);
 	p.Do(scissorRight);
 	p.Do(scissorBottom);
-	tev.DoState(p);
-	p.Do(rasterBlock);
+	s_main.tev.DoState(p);
+	p.Do(s_main.rasterBlock);
 }
 
 void Init()
 {
-	tev.Init();
+	s_main.tev.Init();
 
 	// Set initial z reference plane in the unlikely case that zfreeze is enabled when drawing the first primitive.
 	// TODO: This is just a guess!
-	ZSlope.dfdx = ZSlope.dfdy = 0.f;
-	ZSlope.f0 = 1.f;
+	s_triangle.ZSlope.dfdx = s_triangle.ZSlope.dfdy = 0.f;
+	s_triangle.ZSlope.f0 = 1.f;
+}
+
+void Shutdown()
+{
+	s_batch.clear();
+	s_pool.reset();
+	s_contexts.reset();
 }
 
 static inline int iround(float x)
@@ -117,34 +175,38 @@ void SetScissor()
 
 void SetTevReg(int reg, int comp, bool konst, s16 color)
 {
-	tev.SetRegColor(reg, comp, konst, color);
+	s_main.tev.SetRegColor(reg, comp, konst, color);
 }
 
-inline void Draw(s32 x, s32 y, s32 xi, s32 yi)
+static inline void Draw(DrawContext& ctx, const Triangle& tri, s32 x, s32 y, s32 xi, s32 yi)
 {
-	INCSTAT(swstats.thisFrame.rasterizedPixels);
+	INCSTAT(ctx.rasterizedPixels);
 
-	float dx = vertexOffsetX + (float)(x - vertex0X);
-	float dy = vertexOffsetY + (float)(y - vertex0Y);
+	float dx = tri.vertexOffsetX + (float)(x - tri.vertex0X);
+	float dy = tri.vertexOffsetY + (float)(y - tri.vertex0Y);
 
-	s32 z = (s32)ZSlope.GetValue(dx, dy);
+	s32 z = (s32)tri.ZSlope.GetValue(dx, dy);
 	if (z < 0 || z > 0x00ffffff)
 		return;
 
+	Tev& tev = ctx.tev;
+
 	if (!BoundingBox::active && bpmem.UseEarlyDepthTest() && g_SWVideoConfig.bZComploc)
 	{
 		// TODO: Test if perf regs are incremented even if test is disabled
-		EfbInterface::IncPerfCounterQuadCount(PQ_ZCOMP_INPUT_ZCOMPLOC);
+		tev.PerfPixels[PQ_ZCOMP_INPUT_ZCOMPLOC]++;
 		if (bpmem.zmode.testenable)
 		{
 			// early z
 			if (!EfbInterface::ZCompare(x, y, z))
 				return;
 		}
-		EfbInterface::IncPerfCounterQuadCount(PQ_ZCOMP_OUTPUT_ZCOMPLOC);
+		tev.PerfPixels[PQ_ZCOMP_OUTPUT_ZCOMPLOC]++;
 	}
 
-	RasterBlockPixel& pixel = rasterBlock.Pixel[xi][yi];
+	ctx.lastDraw = ctx.blockKey | (yi << 1) | xi;
+
+	RasterBlockPixel& pixel = ctx.rasterBlock.Pixel[xi][yi];
 
 	tev.Position[0] = x;
 	tev.Position[1] = y;
@@ -155,7 +217,7 @@ inline void Draw(s32 x, s32 y, s32 xi, s32 yi)
 	{
 		for (int comp = 0; comp < 4; comp++)
 		{
-			u16 color = (u16)ColorSlopes[i][comp].GetValue(dx, dy);
+			u16 color = (u16)tri.ColorSlopes[i][comp].GetValue(dx, dy);
 
 			// clamp color value to 0
 			u16 mask = ~(color >> 8);
@@ -174,29 +236,29 @@ inline void Draw(s32 x, s32 y, s32 xi, s32 yi)
 
 	for (unsigned int i = 0; i < bpmem.genMode.numindstages; i++)
 	{
-		tev.IndirectLod[i] = rasterBlock.IndirectLod[i];
-		tev.IndirectLinear[i] = rasterBlock.IndirectLinear[i];
+		tev.IndirectLod[i] = ctx.rasterBlock.IndirectLod[i];
+		tev.IndirectLinear[i] = ctx.rasterBlock.IndirectLinear[i];
 	}
 
 	for (unsigned int i = 0; i <= bpmem.genMode.numtevstages; i++)
 	{
-		tev.TextureLod[i] = rasterBlock.TextureLod[i];
-		tev.TextureLinear[i] = rasterBlock.TextureLinear[i];
+		tev.TextureLod[i] = ctx.rasterBlock.TextureLod[i];
+		tev.TextureLinear[i] = ctx.rasterBlock.TextureLinear[i];
 	}
 
 	tev.Draw();
 }
 
-static void InitTriangle(float X1, float Y1, s32 xi, s32 yi)
+static void InitTriangle(Triangle& tri, float X1, float Y1, s32 xi, s32 yi)
 {
-	vertex0X = xi;
-	vertex0Y = yi;
+	tri.vertex0X = xi;
+	tri.vertex0Y = yi;
 
 	// adjust a little less than 0.5
 	const float adjust = 0.495f;
 
-	vertexOffsetX = ((float)xi - X1) + adjust;
-	vertexOffsetY = ((float)yi - Y1) + adjust;
+	tri.vertexOffsetX = ((float)xi - X1) + adjust;
+	tri.vertexOffsetY = ((float)yi - Y1) + adjust;
 }
 
 static void InitSlope(Slope *slope, float f1, float f2, float f3, float DX31, float DX12, float DY12, float DY31)
@@ -211,7 +273,7 @@ static void InitSlope(Slope *slope, float f1, float f2, float f3, float DX31, fl
 	slope->f0 = f1;
 }
 
-static inline void CalculateLOD(s32* lodp, bool* linear, u32 texmap, u32 texcoord)
+static inline void CalculateLOD(const RasterBlock& rasterBlock, s32* lodp, bool* linear, u32 texmap, u32 texcoord)
 {
 	FourTexUnits& texUnit = bpmem.tex[(texmap >> 2) & 1];
 	u8 subTexmap = texmap & 3;
@@ -224,17 +286,17 @@ static inline void CalculateLOD(s32* lodp, bool* linear, u32 texmap, u32 texcoor
 	float sDelta, tDelta;
 	if (tm0.diag_lod)
 	{
-		float *uv0 = rasterBlock.Pixel[0][0].Uv[texcoord];
-		float *uv1 = rasterBlock.Pixel[1][1].Uv[texcoord];
+		const float *uv0 = rasterBlock.Pixel[0][0].Uv[texcoord];
+		const float *uv1 = rasterBlock.Pixel[1][1].Uv[texcoord];
 
 		sDelta = fabsf(uv0[0] - uv1[0]);
 		tDelta = fabsf(uv0[1] - uv1[1]);
 	}
 	else
 	{
-		float *uv0 = rasterBlock.Pixel[0][0].Uv[texcoord];
-		float *uv1 = rasterBlock.Pixel[1][0].Uv[texcoord];
-		float *uv2 = rasterBlock.Pixel[0][1].Uv[texcoord];
+		const float *uv0 = rasterBlock.Pixel[0][0].Uv[texcoord];
+		const float *uv1 = rasterBlock.Pixel[1][0].Uv[texcoord];
+		const float *uv2 = rasterBlock.Pixel[0][1].Uv[texcoord];
 
 		sDelta = std::max(fabsf(uv0[0] - uv1[0]), fabsf(uv0[0] - uv2[0]));
 		tDelta = std::max(fabsf(uv0[1] - uv1[1]), fabsf(uv0[1] - uv2[1]));
@@ -258,7 +320,7 @@ static inline void CalculateLOD(s32* lodp, bool* linear, u32 texmap, u32 texcoor
 	*lodp = lod;
 }
 
-static void BuildBlock(s32 blockX, s32 blockY)
+static void BuildBlock(RasterBlock& rasterBlock, const Triangle& tri, s32 blockX, s32 blockY)
 {
 	for (s32 yi = 0; yi < BLOCK_SIZE; yi++)
 	{
@@ -266,10 +328,10 @@ static void BuildBlock(s32 blockX, s32 blockY)
 		{
 			RasterBlockPixel& pixel = rasterBlock.Pixel[xi][yi];
 
-			float dx = vertexOffsetX + (float)(xi + blockX - vertex0X);
-			float dy = vertexOffsetY + (float)(yi + blockY - vertex0Y);
+			float dx = tri.vertexOffsetX + (float)(xi + blockX - tri.vertex0X);
+			float dy = tri.vertexOffsetY + (float)(yi + blockY - tri.vertex0Y);
 
-			float invW = 1.0f / WSlope.GetValue(dx, dy);
+			float invW = 1.0f / tri.WSlope.GetValue(dx, dy);
 			pixel.InvW = invW;
 
 			// tex coords
@@ -278,13 +340,13 @@ static void BuildBlock(s32 blockX, s32 blockY)
 				float projection = invW;
 				if (xfmem.texMtxInfo[i].projection)
 				{
-					float q = TexSlopes[i][2].GetValue(dx, dy) * invW;
+					float q = tri.TexSlopes[i][2].GetValue(dx, dy) * invW;
 					if (q != 0.0f)
 						projection = invW / q;
 				}
 
-				pixel.Uv[i][0] = TexSlopes[i][0].GetValue(dx, dy) * projection;
-				pixel.Uv[i][1] = TexSlopes[i][1].GetValue(dx, dy) * projection;
+				pixel.Uv[i][0] = tri.TexSlopes[i][0].GetValue(dx, dy) * projection;
+				pixel.Uv[i][1] = tri.TexSlopes[i][1].GetValue(dx, dy) * projection;
 			}
 		}
 	}
@@ -297,7 +359,7 @@ static void BuildBlock(s32 blockX, s32 blockY)
 		u32 texcoord = indref & 3;
 		indref >>= 3;
 
-		CalculateLOD(&rasterBlock.IndirectLod[i], &rasterBlock.IndirectLinear[i], texmap, texcoord);
+		CalculateLOD(rasterBlock, &rasterBlock.IndirectLod[i], &rasterBlock.IndirectLinear[i], texmap, texcoord);
 	}
 
 	for (unsigned int i = 0; i <= bpmem.genMode.numtevstages; i++)
@@ -309,12 +371,12 @@ static void BuildBlock(s32 blockX, s32 blockY)
 			u32 texmap = order.getTexMap(stageOdd);
 			u32 texcoord = order.getTexCoord(stageOdd);
 
-			CalculateLOD(&rasterBlock.TextureLod[i], &rasterBlock.TextureLinear[i], texmap, texcoord);
+			CalculateLOD(rasterBlock, &rasterBlock.TextureLod[i], &rasterBlock.TextureLinear[i], texmap, texcoord);
 		}
 	}
 }
 
-static inline void PrepareBlock(s32 blockX, s32 blockY)
+static inline void PrepareBlock(const Triangle& tri, s32 blockX, s32 blockY)
 {
 	static s32 x = -1;
 	static s32 y = -1;
@@ -326,10 +388,238 @@ static inline void PrepareBlock(s32 blockX, s32 blockY)
 	{
 		x = blockX;
 		y = blockY;
-		BuildBlock(x, y);
+		BuildBlock(s_main.rasterBlock, tri, x, y);
+	}
+}
+
+// Rasterizes the blocks of the triangle that start in rows [miny, maxy).
+static void DrawBlocks(DrawContext& ctx, const Triangle& tri, s32 miny, s32 maxy)
+{
+	const s32 C1 = tri.C1;
+	const s32 C2 = tri.C2;
+	const s32 C3 = tri.C3;
+
+	const s32 DX12 = tri.DX12;
+	const s32 DX23 = tri.DX23;
+	const s32 DX31 = tri.DX31;
+
+	const s32 DY12 = tri.DY12;
+	const s32 DY23 = tri.DY23;
+	const s32 DY31 = tri.DY31;
+
+	// Fixed-pos32 deltas
+	const s32 FDX12 = DX12 << 4;
+	const s32 FDX23 = DX23 << 4;
+	const s32 FDX31 = DX31 << 4;
+
+	const s32 FDY12 = DY12 << 4;
+	const s32 FDY23 = DY23 << 4;
+	const s32 FDY31 = DY31 << 4;
+
+	// Loop through blocks
+	for (s32 y = miny; y < maxy; y += BLOCK_SIZE)
+	{
+		for (s32 x = tri.minx; x < tri.maxx; x += BLOCK_SIZE)
+		{
+			// Corners of block
+			s32 x0 = x << 4;
+			s32 x1 = (x + BLOCK_SIZE - 1) << 4;
+			s32 y0 = y << 4;
+			s32 y1 = (y + BLOCK_SIZE - 1) << 4;
+
+			// Evaluate half-space functions
+			bool a00 = C1 + DX12 * y0 - DY12 * x0 > 0;
+			bool a10 = C1 + DX12 * y0 - DY12 * x1 > 0;
+			bool a01 = C1 + DX12 * y1 - DY12 * x0 > 0;
+			bool a11 = C1 + DX12 * y1 - DY12 * x1 > 0;
+			int a = (a00 << 0) | (a10 << 1) | (a01 << 2) | (a11 << 3);
+
+			bool b00 = C2 + DX23 * y0 - DY23 * x0 > 0;
+			bool b10 = C2 + DX23 * y0 - DY23 * x1 > 0;
+			bool b01 = C2 + DX23 * y1 - DY23 * x0 > 0;
+			bool b11 = C2 + DX23 * y1 - DY23 * x1 > 0;
+			int b = (b00 << 0) | (b10 << 1) | (b01 << 2) | (b11 << 3);
+
+			bool c00 = C3 + DX31 * y0 - DY31 * x0 > 0;
+			bool c10 = C3 + DX31 * y0 - DY31 * x1 > 0;
+			bool c01 = C3 + DX31 * y1 - DY31 * x0 > 0;
+			bool c11 = C3 + DX31 * y1 - DY31 * x1 > 0;
+			int c = (c00 << 0) | (c10 << 1) | (c01 << 2) | (c11 << 3);
+
+			// Skip block when outside an edge
+			if (a == 0x0 || b == 0x0 || c == 0x0)
+				continue;
+
+			ctx.blockKey = (((u64)ctx.triangle << 32) | ((u32)y << 16) | (u32)x) << 2;
+			BuildBlock(ctx.rasterBlock, tri, x, y);
+			ctx.lastBlock = ctx.blockKey;
+
+			// Accept whole block when totally covered
+			if (a == 0xF && b == 0xF && c == 0xF)
+			{
+				for (s32 iy = 0; iy < BLOCK_SIZE; iy++)
+				{
+					for (s32 ix = 0; ix < BLOCK_SIZE; ix++)
+					{
+						Draw(ctx, tri, x + ix, y + iy, ix, iy);
+					}
+				}
+			}
+			else // Partially covered block
+			{
+				s32 CY1 = C1 + DX12 * y0 - DY12 * x0;
+				s32 CY2 = C2 + DX23 * y0 - DY23 * x0;
+				s32 CY3 = C3 + DX31 * y0 - DY31 * x0;
+
+				for (s32 iy = 0; iy < BLOCK_SIZE; iy++)
+				{
+					s32 CX1 = CY1;
+					s32 CX2 = CY2;
+					s32 CX3 = CY3;
+
+					for (s32 ix = 0; ix < BLOCK_SIZE; ix++)
+					{
+						if (CX1 > 0 && CX2 > 0 && CX3 > 0)
+						{
+							Draw(ctx, tri, x + ix, y + iy, ix, iy);
+						}
+
+						CX1 -= FDY12;
+						CX2 -= FDY23;
+						CX3 -= FDY31;
+					}
+
+					CY1 += FDX12;
+					CY2 += FDX23;
+					CY3 += FDX31;
+				}
+			}
+		}
+	}
+}
+
+// Adds what a context counted to the global counters.
+static void FlushCounters(DrawContext& ctx)
+{
+	Tev& tev = ctx.tev;
+	for (int i = 0; i < PQ_NUM_MEMBERS; i++)
+	{
+		if (tev.PerfPixels[i])
+			EfbInterface::AddPerfCounterPixels((PerfQueryType)i, tev.PerfPixels[i]);
+		tev.PerfPixels[i] = 0;
+	}
+
+	ADDSTAT(swstats.thisFrame.rasterizedPixels, ctx.rasterizedPixels);
+	ADDSTAT(swstats.thisFrame.tevPixelsIn, tev.PixelsIn);
+	ADDSTAT(swstats.thisFrame.tevPixelsOut, tev.PixelsOut);
+	ctx.rasterizedPixels = 0;
+	tev.PixelsIn = 0;
+	tev.PixelsOut = 0;
+}
+
+static unsigned int GetThreadCount()
+{
+	if (g_SWVideoConfig.rasterizerThreads)
+		return g_SWVideoConfig.rasterizerThreads;
+	return Common::ThreadPool::GetDefaultThreadCount();
+}
+
+static bool CanDrawInParallel()
+{
+	return GetThreadCount() > 1 &&
+	       !g_SWVideoConfig.bDumpTevStages && !g_SWVideoConfig.bDumpTevTextureFetches &&
+	       !Tev::DependsOnDrawOrder();
+}
+
+// Draws this thread's bands of every triangle in the batch. Going through the
+// triangles in order keeps the order in which each pixel is drawn.
+static void DrawBatchBands(size_t index, size_t count)
+{
+	DrawContext& ctx = s_contexts[index];
+	for (size_t i = 0; i < s_batch.size(); i++)
+	{
+		const Triangle& tri = s_batch[i];
+		ctx.triangle = (u32)i + 1;
+
+		// Bands go round robin, starting with the first thread at the top.
+		size_t band = tri.miny / BAND_HEIGHT;
+		band += (index + count - band % count) % count;
+		for (s32 y = (s32)band * BAND_HEIGHT; y < tri.maxy; y += (s32)count * BAND_HEIGHT)
+			DrawBlocks(ctx, tri, std::max(y, tri.miny), std::min(y + BAND_HEIGHT, tri.maxy));
 	}
 }
 
+void Flush()
+{
+	if (s_batch.empty())
+		return;
+
+	unsigned int num_threads = GetThreadCount();
+	if (num_threads <= 1 || s_batch_area < MIN_PARALLEL_AREA)
+	{
+		for (const Triangle& tri : s_batch)
+			DrawBlocks(s_main, tri, tri.miny, tri.maxy);
+		FlushCounters(s_main);
+
+		s_batch.clear();
+		s_batch_area = 0;
+		return;
+	}
+
+	if (!s_pool || s_pool->GetThreadCount() != num_threads)
+	{
+		s_pool = std::make_unique<Common::ThreadPool>(num_threads);
+		s_contexts = std::make_unique<DrawContext[]>(num_threads);
+		for (unsigned int i = 0; i < num_threads; i++)
+		{
+			s_contexts[i].tev.Init();
+			s_contexts[i].tev.BoundingBoxCoords = s_contexts[i].bboxCoords;
+		}
+	}
+
+	for (unsigned int i = 0; i < num_threads; i++)
+	{
+		DrawContext& ctx = s_contexts[i];
+		ctx.tev.CopyStateFrom(s_main.tev);
+		ctx.rasterBlock = s_main.rasterBlock;
+		ctx.lastBlock = 0;
+		ctx.lastDraw = 0;
+		memcpy(ctx.bboxCoords, BoundingBox::coords, sizeof(ctx.bboxCoords));
+	}
+
+	s_pool->ParallelFor(num_threads, [num_threads](size_t i) {
+		DrawBatchBands(i, num_threads);
+	});
+
+	// Leave things the way drawing everything on one thread would have: the
+	// TEV and raster block come from whoever drew last in that order.
+	DrawContext* last_draw = nullptr;
+	DrawContext* last_block = nullptr;
+	for (unsigned int i = 0; i < num_threads; i++)
+	{
+		DrawContext& ctx = s_contexts[i];
+		if (ctx.lastDraw && (!last_draw || ctx.lastDraw > last_draw->lastDraw))
+			last_draw = &ctx;
+		if (ctx.lastBlock && (!last_block || ctx.lastBlock > last_block->lastBlock))
+			last_block = &ctx;
+
+		BoundingBox::coords[BoundingBox::LEFT] = std::min(ctx.bboxCoords[BoundingBox::LEFT], BoundingBox::coords[BoundingBox::LEFT]);
+		BoundingBox::coords[BoundingBox::RIGHT] = std::max(ctx.bboxCoords[BoundingBox::RIGHT], BoundingBox::coords[BoundingBox::RIGHT]);
+		BoundingBox::coords[BoundingBox::TOP] = std::min(ctx.bboxCoords[BoundingBox::TOP], BoundingBox::coords[BoundingBox::TOP]);
+		BoundingBox::coords[BoundingBox::BOTTOM] = std::max(ctx.bboxCoords[BoundingBox::BOTTOM], BoundingBox::coords[BoundingBox::BOTTOM]);
+
+		FlushCounters(ctx);
+	}
+
+	if (last_draw)
+		s_main.tev.CopyStateFrom(last_draw->tev);
+	if (last_block)
+		s_main.rasterBlock = last_block->rasterBlock;
+
+	s_batch.clear();
+	s_batch_area = 0;
+}
+
 void DrawTriangleFrontFace(OutputVertexData *v0, OutputVertexData *v1, OutputVertexData *v2)
 {
 	INCSTAT(swstats.thisFrame.numTrianglesDrawn);
@@ -393,28 +683,29 @@ void DrawTriangleFrontFace(OutputVertexData *v0, OutputVertexData *v1, OutputVer
 	float fltdy12 = flty1 - v1->screenPosition.y;
 	float fltdy31 = v2->screenPosition.y - flty1;
 
-	InitTriangle(fltx1, flty1, (X1 + 0xF) >> 4, (Y1 + 0xF) >> 4);
+	Triangle& tri = s_triangle;
+	InitTriangle(tri, fltx1, flty1, (X1 + 0xF) >> 4, (Y1 + 0xF) >> 4);
 
 	float w[3] = { 1.0f / v0->projectedPosition.w, 1.0f / v1->projectedPosition.w, 1.0f / v2->projectedPosition.w };
-	InitSlope(&WSlope, w[0], w[1], w[2], fltdx31, fltdx12, fltdy12, fltdy31);
+	InitSlope(&tri.WSlope, w[0], w[1], w[2], fltdx31, fltdx12, fltdy12, fltdy31);
 
 	// TODO: The zfreeze emulation is not quite correct, yet!
 	// Many things might prevent us from reaching this line (culling, clipping, scissoring).
 	// However, the zslope is always guaranteed to be calculated unless all vertices are trivially rejected during clipping!
 	// We're currently sloppy at this since we abort early if any of the culling/clipping/scissoring tests fail.
 	if (!bpmem.genMode.zfreeze || !g_SWVideoConfig.bZFreeze)
-		InitSlope(&ZSlope, v0->screenPosition[2], v1->screenPosition[2], v2->screenPosition[2], fltdx31, fltdx12, fltdy12, fltdy31);
+		InitSlope(&tri.ZSlope, v0->screenPosition[2], v1->screenPosition[2], v2->screenPosition[2], fltdx31, fltdx12, fltdy12, fltdy31);
 
 	for (unsigned int i = 0; i < bpmem.genMode.numcolchans; i++)
 	{
 		for (int comp = 0; comp < 4; comp++)
-			InitSlope(&ColorSlopes[i][comp], v0->color[i][comp], v1->color[i][comp], v2->color[i][comp], fltdx31, fltdx12, fltdy12, fltdy31);
+			InitSlope(&tri.ColorSlopes[i][comp], v0->color[i][comp], v1->color[i][comp], v2->color[i][comp], fltdx31, fltdx12, fltdy12, fltdy31);
 	}
 
 	for (unsigned int i = 0; i < bpmem.genMode.numtexgens; i++)
 	{
 		for (int comp = 0; comp < 3; comp++)
-			InitSlope(&TexSlopes[i][comp], v0->texCoords[i][comp] * w[0], v1->texCoords[i][comp] * w[1], v2->texCoords[i][comp] * w[2], fltdx31, fltdx12, fltdy12, fltdy31);
+			InitSlope(&tri.TexSlopes[i][comp], v0->texCoords[i][comp] * w[0], v1->texCoords[i][comp] * w[1], v2->texCoords[i][comp] * w[2], fltdx31, fltdx12, fltdy12, fltdy31);
 	}
 
 	// Half-edge constants
@@ -430,88 +721,32 @@ void DrawTriangleFrontFace(OutputVertexData *v0, OutputVertexData *v1, OutputVer
 	// If drawing, rasterize every block
 	if (!BoundingBox::active)
 	{
+		tri.C1 = C1;
+		tri.C2 = C2;
+		tri.C3 = C3;
+		tri.DX12 = DX12;
+		tri.DX23 = DX23;
+		tri.DX31 = DX31;
+		tri.DY12 = DY12;
+		tri.DY23 = DY23;
+		tri.DY31 = DY31;
+
 		// Start in corner of 8x8 block
-		minx &= ~(BLOCK_SIZE - 1);
-		miny &= ~(BLOCK_SIZE - 1);
+		tri.minx = minx & ~(BLOCK_SIZE - 1);
+		tri.maxx = maxx;
+		tri.miny = miny & ~(BLOCK_SIZE - 1);
+		tri.maxy = maxy;
 
-		// Loop through blocks
-		for (s32 y = miny; y < maxy; y += BLOCK_SIZE)
+		if (CanDrawInParallel())
 		{
-			for (s32 x = minx; x < maxx; x += BLOCK_SIZE)
-			{
-				// Corners of block
-				s32 x0 = x << 4;
-				s32 x1 = (x + BLOCK_SIZE - 1) << 4;
-				s32 y0 = y << 4;
-				s32 y1 = (y + BLOCK_SIZE - 1) << 4;
-
-				// Evaluate half-space functions
-				bool a00 = C1 + DX12 * y0 - DY12 * x0 > 0;
-				bool a10 = C1 + DX12 * y0 - DY12 * x1 > 0;
-				bool a01 = C1 + DX12 * y1 - DY12 * x0 > 0;
-				bool a11 = C1 + DX12 * y1 - DY12 * x1 > 0;
-				int a = (a00 << 0) | (a10 << 1) | (a01 << 2) | (a11 << 3);
-
-				bool b00 = C2 + DX23 * y0 - DY23 * x0 > 0;
-				bool b10 = C2 + DX23 * y0 - DY23 * x1 > 0;
-				bool b01 = C2 + DX23 * y1 - DY23 * x0 > 0;
-				bool b11 = C2 + DX23 * y1 - DY23 * x1 > 0;
-				int b = (b00 << 0) | (b10 << 1) | (b01 << 2) | (b11 << 3);
-
-				bool c00 = C3 + DX31 * y0 - DY31 * x0 > 0;
-				bool c10 = C3 + DX31 * y0 - DY31 * x1 > 0;
-				bool c01 = C3 + DX31 * y1 - DY31 * x0 > 0;
-				bool c11 = C3 + DX31 * y1 - DY31 * x1 > 0;
-				int c = (c00 << 0) | (c10 << 1) | (c01 << 2) | (c11 << 3);
-
-				// Skip block when outside an edge
-				if (a == 0x0 || b == 0x0 || c == 0x0)
-					continue;
-
-				BuildBlock(x, y);
-
-				// Accept whole block when totally covered
-				if (a == 0xF && b == 0xF && c == 0xF)
-				{
-					for (s32 iy = 0; iy < BLOCK_SIZE; iy++)
-					{
-						for (s32 ix = 0; ix < BLOCK_SIZE; ix++)
-						{
-							Draw(x + ix, y + iy, ix, iy);
-						}
-					}
-				}
-				else // Partially covered block
-				{
-					s32 CY1 = C1 + DX12 * y0 - DY12 * x0;
-					s32 CY2 = C2 + DX23 * y0 - DY23 * x0;
-					s32 CY3 = C3 + DX31 * y0 - DY31 * x0;
-
-					for (s32 iy = 0; iy < BLOCK_SIZE; iy++)
-					{
-						s32 CX1 = CY1;
-						s32 CX2 = CY2;
-						s32 CX3 = CY3;
-
-						for (s32 ix = 0; ix < BLOCK_SIZE; ix++)
-						{
-							if (CX1 > 0 && CX2 > 0 && CX3 > 0)
-							{
-								Draw(x + ix, y + iy, ix, iy);
-							}
-
-							CX1 -= FDY12;
-							CX2 -= FDY23;
-							CX3 -= FDY31;
-						}
-
-						CY1 += FDX12;
-						CY2 += FDX23;
-						CY3 += FDX31;
-					}
-				}
-			}
+			s_batch.push_back(tri);
+			s_batch_area += (maxx - minx) * (maxy - miny);
+			return;
 		}
+
+		Flush();
+		DrawBlocks(s_main, tri, tri.miny, tri.maxy);
+		FlushCounters(s_main);
 	}
 	else
 	{
@@ -564,8 +799,8 @@ void DrawTriangleFrontFace(OutputVertexData *v0, OutputVertexData *v1, OutputVer
 				if (CX1 > 0 && CX2 > 0 && CX3 > 0)
 				{
 					// Build the new raster block every other pixel
-					PrepareBlock(x, y);
-					Draw(x, y, x & (BLOCK_SIZE - 1), y & (BLOCK_SIZE - 1));
+					PrepareBlock(tri, x, y);
+					Draw(s_main, tri, x, y, x & (BLOCK_SIZE - 1), y & (BLOCK_SIZE - 1));
 
 					if (y >= BoundingBox::coords[BoundingBox::TOP])
 						break;
@@ -604,8 +839,8 @@ void DrawTriangleFrontFace(OutputVertexData *v0, OutputVertexData *v1, OutputVer
 			{
 				if (CY1 > 0 && CY2 > 0 && CY3 > 0)
 				{
-					PrepareBlock(x, y);
-					Draw(x, y, x & (BLOCK_SIZE - 1), y & (BLOCK_SIZE - 1));
+					PrepareBlock(tri, x, y);
+					Draw(s_main, tri, x, y, x & (BLOCK_SIZE - 1), y & (BLOCK_SIZE - 1));
 
 					if (x >= BoundingBox::coords[BoundingBox::LEFT])
 						break;
@@ -644,8 +879,8 @@ void DrawTriangleFrontFace(OutputVertexData *v0, OutputVertexData *v1, OutputVer
 				if (CX1 > 0 && CX2 > 0 && CX3 > 0)
 				{
 					// Build the new raster block every other pixel
-					PrepareBlock(x, y);
-					Draw(x, y, x & (BLOCK_SIZE - 1), y & (BLOCK_SIZE - 1));
+					PrepareBlock(tri, x, y);
+					Draw(s_main, tri, x, y, x & (BLOCK_SIZE - 1), y & (BLOCK_SIZE - 1));
 
 					if (y <= BoundingBox::coords[BoundingBox::BOTTOM])
 						break;
@@ -685,8 +920,8 @@ void DrawTriangleFrontFace(OutputVertexData *v0, OutputVertexData *v1, OutputVer
 				if (CY1 > 0 && CY2 > 0 && CY3 > 0)
 				{
 					// Build the new raster block every other pixel
-					PrepareBlock(x, y);
-					Draw(x, y, x & (BLOCK_SIZE - 1), y & (BLOCK_SIZE - 1));
+					PrepareBlock(tri, x, y);
+					Draw(s_main, tri, x, y, x & (BLOCK_SIZE - 1), y & (BLOCK_SIZE - 1));
 
 					if (x <= BoundingBox::coords[BoundingBox::RIGHT])
 						break;
@@ -701,6 +936,8 @@ void DrawTriangleFrontFace(OutputVertexData *v0, OutputVertexData *v1, OutputVer
 			CX2 += FDY23;
 			CX3 += FDY31;
 		}
+
+		FlushCounters(s_main);
 	}
 }
 
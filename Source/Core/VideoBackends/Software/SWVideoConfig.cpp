@@ -17,6 +17,8 @@ SWVideoConfig::SWVideoConfig()
 	bHwRasterizer = false;
 	bBypassXFB = false;
 
+	rasterizerThreads = 0;
+
 	bShowStats = false;
 
 	bDumpTextures = false;
@@ -46,6 +48,7 @@ void SWVideoConfig::Load(const char* ini_file)
 	rendering->Get("BypassXFB", &bBypassXFB, false);
 	rendering->Get("ZComploc", &bZComploc, true);
 	rendering->Get("ZFreeze", &bZFreeze, true);
+	rendering->Get("RasterizerThreads", &rasterizerThreads, 0);
 
 	IniFile::Section* info = iniFile.GetOrCreateSection("Info");
 	info->Get("ShowStats", &bShowStats, false);
@@ -75,6 +78,7 @@ void SWVideoConfig::Save(const char* ini_file)
 	rendering->Set("BypassXFB", bBypassXFB);
 	rendering->Set("ZComploc", bZComploc);
 	rendering->Set("ZFreeze", bZFreeze);
+	rendering->Set("RasterizerThreads", rasterizerThreads);
 
 	IniFile::Section* info = iniFile.GetOrCreateSection("Info");
 	info->Set("ShowStats", bShowStats);
@@ -23,6 +23,9 @@ struct SWVideoConfig : NonCopyable
 	bool bHwRasterizer;
 	bool bBypassXFB;
 
+	// 0 picks one thread per host core
+	u32 rasterizerThreads;
+
 	// Emulation features
 	bool bZComploc;
 	bool bZFreeze;
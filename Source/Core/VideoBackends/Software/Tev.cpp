@@ -3,6 +3,7 @@
 // Refer to the license.txt file included.
 
 #include <cmath>
+#include <cstring>
 
 #include "Common/ChunkFile.h"
 #include "Common/CommonTypes.h"
@@ -122,6 +123,12 @@ void Tev::Init()
 	m_ScaleRShiftLUT[1] = 0;
 	m_ScaleRShiftLUT[2] = 0;
 	m_ScaleRShiftLUT[3] = 1;
+
+	for (u32& count : PerfPixels)
+		count = 0;
+	PixelsIn = 0;
+	PixelsOut = 0;
+	BoundingBoxCoords = BoundingBox::coords;
 }
 
 static inline s16 Clamp255(s16 in)
@@ -509,7 +516,7 @@ void Tev::Draw()
 	_assert_(Position[0] >= 0 && Position[0] < EFB_WIDTH);
 	_assert_(Position[1] >= 0 && Position[1] < EFB_HEIGHT);
 
-	INCSTAT(swstats.thisFrame.tevPixelsIn);
+	INCSTAT(PixelsIn);
 
 	for (unsigned int stageNum = 0; stageNum < bpmem.genMode.numindstages; stageNum++)
 	{
@@ -762,20 +769,20 @@ void Tev::Draw()
 		if (late_ztest && bpmem.zmode.testenable)
 		{
 			// TODO: Check against hw if these values get incremented even if depth testing is disabled
-			EfbInterface::IncPerfCounterQuadCount(PQ_ZCOMP_INPUT);
+			PerfPixels[PQ_ZCOMP_INPUT]++;
 
 			if (!EfbInterface::ZCompare(Position[0], Position[1], Position[2]))
 				return;
 
-			EfbInterface::IncPerfCounterQuadCount(PQ_ZCOMP_OUTPUT);
+			PerfPixels[PQ_ZCOMP_OUTPUT]++;
 		}
 	}
 
 	// branchless bounding box update
-	BoundingBox::coords[BoundingBox::LEFT] = std::min((u16)Position[0], BoundingBox::coords[BoundingBox::LEFT]);
-	BoundingBox::coords[BoundingBox::RIGHT] = std::max((u16)Position[0], BoundingBox::coords[BoundingBox::RIGHT]);
-	BoundingBox::coords[BoundingBox::TOP] = std::min((u16)Position[1], BoundingBox::coords[BoundingBox::TOP]);
-	BoundingBox::coords[BoundingBox::BOTTOM] = std::max((u16)Position[1], BoundingBox::coords[BoundingBox::BOTTOM]);
+	BoundingBoxCoords[BoundingBox::LEFT] = std::min((u16)Position[0], BoundingBoxCoords[BoundingBox::LEFT]);
+	BoundingBoxCoords[BoundingBox::RIGHT] = std::max((u16)Position[0], BoundingBoxCoords[BoundingBox::RIGHT]);
+	BoundingBoxCoords[BoundingBox::TOP] = std::min((u16)Position[1], BoundingBoxCoords[BoundingBox::TOP]);
+	BoundingBoxCoords[BoundingBox::BOTTOM] = std::max((u16)Position[1], BoundingBoxCoords[BoundingBox::BOTTOM]);
 
 	// if we are only calculating the bounding box,
 	// there's no need to actually draw anything
@@ -803,8 +810,8 @@ void Tev::Draw()
 	}
 #endif
 
-	INCSTAT(swstats.thisFrame.tevPixelsOut);
-	EfbInterface::IncPerfCounterQuadCount(PQ_BLEND_INPUT);
+	INCSTAT(PixelsOut);
+	PerfPixels[PQ_BLEND_INPUT]++;
 
 	EfbInterface::BlendTev(Position[0], Position[1], output);
 }
@@ -821,6 +828,79 @@ void Tev::SetRegColor(int reg, int comp, bool konst, s16 color)
 	}
 }
 
+void Tev::CopyStateFrom(const Tev& other)
+{
+	memcpy(Reg, other.Reg, sizeof(Reg));
+	memcpy(KonstantColors, other.KonstantColors, sizeof(KonstantColors));
+	memcpy(TexColor, other.TexColor, sizeof(TexColor));
+	memcpy(RasColor, other.RasColor, sizeof(RasColor));
+	memcpy(StageKonst, other.StageKonst, sizeof(StageKonst));
+	AlphaBump = other.AlphaBump;
+	memcpy(IndirectTex, other.IndirectTex, sizeof(IndirectTex));
+	TexCoord = other.TexCoord;
+
+	memcpy(Position, other.Position, sizeof(Position));
+	memcpy(Color, other.Color, sizeof(Color));
+	memcpy(Uv, other.Uv, sizeof(Uv));
+	memcpy(IndirectLod, other.IndirectLod, sizeof(IndirectLod));
+	memcpy(IndirectLinear, other.IndirectLinear, sizeof(IndirectLinear));
+	memcpy(TextureLod, other.TextureLod, sizeof(TextureLod));
+	memcpy(TextureLinear, other.TextureLinear, sizeof(TextureLinear));
+}
+
+// Bits 0-3 are the color of PREV, C0, C1 and C2, bits 4-7 their alpha and bit 8
+// the texture color.
+enum
+{
+	REG_COLOR = 0,
+	REG_ALPHA = 4,
+	TEX_COLOR = 8
+};
+
+static u32 ColorInputRegs(u32 input)
+{
+	if (input < 8)
+		return 1 << ((input & 1 ? REG_ALPHA : REG_COLOR) + input / 2);
+	if (input == 8 || input == 9)
+		return 1 << TEX_COLOR;
+	return 0;
+}
+
+static u32 AlphaInputRegs(u32 input)
+{
+	if (input < 4)
+		return 1 << (REG_ALPHA + input);
+	if (input == 4)
+		return 1 << TEX_COLOR;
+	return 0;
+}
+
+bool Tev::DependsOnDrawOrder()
+{
+	// Rasterized colors, konstants and indirect results are set by every pixel
+	// before they're used, but registers and the texture color keep whatever the
+	// last stage to write them left, and that might be in the previous pixel.
+	u32 written = 0;
+	u32 read_first = 0;
+	for (unsigned int stageNum = 0; stageNum <= bpmem.genMode.numtevstages; stageNum++)
+	{
+		TevStageCombiner::ColorCombiner &cc = bpmem.combiners[stageNum].colorC;
+		TevStageCombiner::AlphaCombiner &ac = bpmem.combiners[stageNum].alphaC;
+
+		if (bpmem.tevorders[stageNum >> 1].getEnable(stageNum & 1))
+			written |= 1 << TEX_COLOR;
+
+		u32 read = ColorInputRegs(cc.a) | ColorInputRegs(cc.b) | ColorInputRegs(cc.c) | ColorInputRegs(cc.d) |
+		           AlphaInputRegs(ac.a) | AlphaInputRegs(ac.b) | AlphaInputRegs(ac.c) | AlphaInputRegs(ac.d);
+		read_first |= read & ~written;
+
+		written |= 1 << (REG_COLOR + cc.dest);
+		written |= 1 << (REG_ALPHA + ac.dest);
+	}
+
+	return (read_first & written) != 0;
+}
+
 void Tev::DoState(PointerWrap &p)
 {
 	p.DoArray(Reg, sizeof(Reg));
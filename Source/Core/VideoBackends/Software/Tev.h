@@ -5,6 +5,7 @@
 #pragma once
 
 #include "VideoBackends/Software/BPMemLoader.h"
+#include "VideoCommon/PerfQueryBase.h"
 
 class PointerWrap;
 
@@ -77,6 +78,13 @@ public:
 	s32 TextureLod[16];
 	bool TextureLinear[16];
 
+	// Drawing only counts into these, so that several Tevs can draw at once.
+	// The rasterizer adds them to the global counters.
+	u32 PerfPixels[PQ_NUM_MEMBERS];
+	u32 PixelsIn;
+	u32 PixelsOut;
+	u16* BoundingBoxCoords;
+
 	enum
 	{
 		ALP_C,
@@ -91,5 +99,12 @@ public:
 
 	void SetRegColor(int reg, int comp, bool konst, s16 color);
 
+	// Copies the values that carry over from one pixel to the next.
+	void CopyStateFrom(const Tev& other);
+
+	// Whether the current TEV setup reads something the previous pixel left
+	// behind, so that pixels have to be drawn in order.
+	static bool DependsOnDrawOrder();
+
 	void DoState(PointerWrap &p);
 };
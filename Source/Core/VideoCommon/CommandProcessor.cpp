@@ -375,6 +375,7 @@ void UpdateInterrupts(u64 userdata)
 	}
 	CoreTiming::ForceExceptionCheck(0);
 	interruptWaiting = false;
+	WakeGpuLoop();
 }
 
 void UpdateInterruptsFromVideoBackend(u64 userdata)
@@ -525,6 +526,7 @@ void SetCpControlRegister()
 	else
 	{
 		fifo.bFF_GPReadEnable = m_CPCtrlReg.GPReadEnable;
+		WakeGpuLoop();
 	}
 
 	DEBUG_LOG(COMMANDPROCESSOR, "\t GPREAD %s | BP %s | Int %s | OvF %s | UndF %s | LINK %s"
@@ -550,6 +552,9 @@ void Update()
 		Common::YieldCPU();
 
 	if (fifo.isGpuReadingData)
+	{
 		Common::AtomicAdd(VITicks, SystemTimers::GetTicksPerSecond() / 10000);
+		WakeGpuLoop();
+	}
 }
 } // end of namespace CommandProcessor
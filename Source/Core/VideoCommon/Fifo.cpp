@@ -2,11 +2,14 @@
 // Licensed under GPLv2
 // Refer to the license.txt file included.
 
+#include <atomic>
+#include <chrono>
+
 #include "Common/Atomic.h"
 #include "Common/ChunkFile.h"
-#include "Common/CPUDetect.h"
 #include "Common/FPURoundMode.h"
 #include "Common/MemoryUtil.h"
+#include "Common/SpinEvent.h"
 #include "Common/Thread.h"
 
 #include "Core/ConfigManager.h"
@@ -26,10 +29,17 @@
 
 bool g_bSkipCurrentFrame = false;
 
-static volatile bool GpuRunningState = false;
-static volatile bool EmuRunningState = false;
+static std::atomic<bool> GpuRunningState(false);
+static std::atomic<bool> EmuRunningState(false);
 static std::mutex m_csHWVidOccupied;
 
+// Set whenever RunGpuLoop might have something new to do. While it has
+// nothing to do, the GPU thread spins for a moment and then sleeps on this.
+static Common::SpinEvent s_gpu_wakeup;
+
+// How many times SyncGPU yields before it sleeps on s_video_buffer_cond.
+static const int SYNC_GPU_SPIN_COUNT = 1000;
+
 // Most of this array is unlikely to be faulted in...
 static u8 s_fifo_aux_data[FIFO_SIZE];
 static u8* s_fifo_aux_write_ptr;
@@ -53,8 +63,9 @@ static u8* s_video_buffer_pp_read_ptr;
 // caused it to stop, not the same as the read ptr.  It's written by the GPU,
 // under the lock, and updating the cond.
 // - The write_ptr is written by the CPU thread after it copies data from the
-// FIFO.  Maybe someday it will be under the lock.  For now, because RunGpuLoop
-// polls, it's just atomic.
+// FIFO, with release semantics, and read by the GPU thread with acquire
+// semantics, so the data up to it is visible to the GPU once it sees the new
+// pointer.  The CPU thread sets s_gpu_wakeup after every update.
 // - The pp_read_ptr is the CPU preprocessing version of the read_ptr.
 
 void Fifo_DoState(PointerWrap &p)
@@ -140,21 +151,38 @@ void ExitGpuLoop()
 	// Terminate GPU thread loop
 	GpuRunningState = false;
 	EmuRunningState = true;
+	s_gpu_wakeup.Set();
 }
 
 void EmulatorState(bool running)
 {
 	EmuRunningState = running;
+	s_gpu_wakeup.Set();
+}
+
+void WakeGpuLoop()
+{
+	s_gpu_wakeup.Set();
 }
 
 void SyncGPU(SyncGPUReason reason, bool may_move_read_ptr)
 {
 	if (g_use_deterministic_gpu_thread && GpuRunningState)
 	{
+		u8* write_ptr = s_video_buffer_write_ptr.load(std::memory_order_relaxed);
+
+		// The GPU thread is usually close behind, so give it a moment before
+		// going to sleep on the condition variable.
+		for (int i = 0; i < SYNC_GPU_SPIN_COUNT && GpuRunningState; i++)
+		{
+			if (s_video_buffer_seen_ptr.load(std::memory_order_acquire) == write_ptr)
+				break;
+			Common::YieldCPU();
+		}
+
 		std::unique_lock<std::mutex> lk(s_video_buffer_lock);
-		u8* write_ptr = s_video_buffer_write_ptr;
 		s_video_buffer_cond.wait(lk, [&]() {
-			return !GpuRunningState || s_video_buffer_seen_ptr == write_ptr;
+			return !GpuRunningState || s_video_buffer_seen_ptr.load(std::memory_order_acquire) == write_ptr;
 		});
 		if (!GpuRunningState)
 			return;
@@ -174,12 +202,14 @@ void SyncGPU(SyncGPUReason reason, bool may_move_read_ptr)
 
 			memmove(s_video_buffer, s_video_buffer_pp_read_ptr, size);
 			// This change always decreases the pointers.  We write seen_ptr
-			// after write_ptr here, and read it before in RunGpuLoop, so
-			// 'write_ptr > seen_ptr' there cannot become spuriously true.
-			s_video_buffer_write_ptr = write_ptr = s_video_buffer + size;
+			// after write_ptr here (with release), and read it before in
+			// RunGpuLoop (with acquire), so 'write_ptr > seen_ptr' there
+			// cannot become spuriously true.
+			write_ptr = s_video_buffer + size;
+			s_video_buffer_write_ptr.store(write_ptr, std::memory_order_relaxed);
 			s_video_buffer_pp_read_ptr = s_video_buffer;
 			s_video_buffer_read_ptr = s_video_buffer;
-			s_video_buffer_seen_ptr = write_ptr;
+			s_video_buffer_seen_ptr.store(write_ptr, std::memory_order_release);
 		}
 	}
 }
@@ -209,31 +239,34 @@ void* PopFifoAuxBuffer(size_t size)
 }
 
 // Description: RunGpuLoop() sends data through this function.
+// Only the thread that decodes the data touches the video buffer in this
+// mode, so the write_ptr accesses don't need any ordering.
 static void ReadDataFromFifo(u32 readPtr)
 {
 	size_t len = 32;
-	if (len > (size_t)(s_video_buffer + FIFO_SIZE - s_video_buffer_write_ptr))
+	u8* write_ptr = s_video_buffer_write_ptr.load(std::memory_order_relaxed);
+	if (len > (size_t)(s_video_buffer + FIFO_SIZE - write_ptr))
 	{
-		size_t existing_len = s_video_buffer_write_ptr - s_video_buffer_read_ptr;
+		size_t existing_len = write_ptr - s_video_buffer_read_ptr;
 		if (len > (size_t)(FIFO_SIZE - existing_len))
 		{
 			PanicAlert("FIFO out of bounds (existing %lu + new %lu > %lu)", (unsigned long) existing_len, (unsigned long) len, (unsigned long) FIFO_SIZE);
 			return;
 		}
 		memmove(s_video_buffer, s_video_buffer_read_ptr, existing_len);
-		s_video_buffer_write_ptr = s_video_buffer + existing_len;
+		write_ptr = s_video_buffer + existing_len;
 		s_video_buffer_read_ptr = s_video_buffer;
 	}
 	// Copy new video instructions to s_video_buffer for future use in rendering the new picture
-	Memory::CopyFromEmu(s_video_buffer_write_ptr, readPtr, len);
-	s_video_buffer_write_ptr += len;
+	Memory::CopyFromEmu(write_ptr, readPtr, len);
+	s_video_buffer_write_ptr.store(write_ptr + len, std::memory_order_relaxed);
 }
 
 // The deterministic_gpu_thread version.
 static void ReadDataFromFifoOnCPU(u32 readPtr)
 {
 	size_t len = 32;
-	u8 *write_ptr = s_video_buffer_write_ptr;
+	u8 *write_ptr = s_video_buffer_write_ptr.load(std::memory_order_relaxed);
 	if (len > (size_t)(s_video_buffer + FIFO_SIZE - write_ptr))
 	{
 		// We can't wrap around while the GPU is working on the data.
@@ -244,7 +277,7 @@ static void ReadDataFromFifoOnCPU(u32 readPtr)
 			PanicAlert("desynced read pointers");
 			return;
 		}
-		write_ptr = s_video_buffer_write_ptr;
+		write_ptr = s_video_buffer_write_ptr.load(std::memory_order_relaxed);
 		size_t existing_len = write_ptr - s_video_buffer_pp_read_ptr;
 		if (len > (size_t)(FIFO_SIZE - existing_len))
 		{
@@ -252,10 +285,11 @@ static void ReadDataFromFifoOnCPU(u32 readPtr)
 			return;
 		}
 	}
-	Memory::CopyFromEmu(s_video_buffer_write_ptr, readPtr, len);
+	Memory::CopyFromEmu(write_ptr, readPtr, len);
 	s_video_buffer_pp_read_ptr = OpcodeDecoder_Run<true>(DataReader(s_video_buffer_pp_read_ptr, write_ptr + len), nullptr, false);
-	// This would have to be locked if the GPU thread didn't spin.
-	s_video_buffer_write_ptr = write_ptr + len;
+	// Publishes the data to the GPU thread.
+	s_video_buffer_write_ptr.store(write_ptr + len, std::memory_order_release);
+	s_gpu_wakeup.Set();
 }
 
 void ResetVideoBuffer()
@@ -269,6 +303,24 @@ void ResetVideoBuffer()
 }
 
 
+// Whether RunGpuLoop has FIFO data that it can process right now.
+static bool GpuHasWork()
+{
+	if (!GpuRunningState || !EmuRunningState)
+		return true;
+
+	if (g_use_deterministic_gpu_thread)
+	{
+		// See comment in SyncGPU
+		u8* seen_ptr = s_video_buffer_seen_ptr.load(std::memory_order_acquire);
+		u8* write_ptr = s_video_buffer_write_ptr.load(std::memory_order_acquire);
+		return write_ptr > seen_ptr;
+	}
+
+	SCPFifoStruct &fifo = CommandProcessor::fifo;
+	return !CommandProcessor::interruptWaiting && fifo.bFF_GPReadEnable && fifo.CPReadWriteDistance && !AtBreakpoint();
+}
+
 // Description: Main FIFO update loop
 // Purpose: Keep the Core HW updated about the CPU-GPU distance
 void RunGpuLoop()
@@ -278,10 +330,6 @@ void RunGpuLoop()
 	SCPFifoStruct &fifo = CommandProcessor::fifo;
 	u32 cyclesExecuted = 0;
 
-	// If the host CPU has only two cores, idle loop instead of busy loop
-	// This allows a system that we are maxing out in dual core mode to do other things
-	bool yield_cpu = cpu_info.num_cores <= 2;
-
 	while (GpuRunningState)
 	{
 		g_video_backend->PeekMessages();
@@ -290,8 +338,8 @@ void RunGpuLoop()
 		if (g_use_deterministic_gpu_thread)
 		{
 			// All the fifo/CP stuff is on the CPU.  We just need to run the opcode decoder.
-			u8* seen_ptr = s_video_buffer_seen_ptr;
-			u8* write_ptr = s_video_buffer_write_ptr;
+			u8* seen_ptr = s_video_buffer_seen_ptr.load(std::memory_order_acquire);
+			u8* write_ptr = s_video_buffer_write_ptr.load(std::memory_order_acquire);
 			// See comment in SyncGPU
 			if (write_ptr > seen_ptr)
 			{
@@ -299,7 +347,7 @@ void RunGpuLoop()
 
 				{
 					std::lock_guard<std::mutex> vblk(s_video_buffer_lock);
-					s_video_buffer_seen_ptr = write_ptr;
+					s_video_buffer_seen_ptr.store(write_ptr, std::memory_order_release);
 					s_video_buffer_cond.notify_all();
 				}
 			}
@@ -330,7 +378,7 @@ void RunGpuLoop()
 						"Negative fifo.CPReadWriteDistance = %i in FIFO Loop !\nThat can produce instability in the game. Please report it.", fifo.CPReadWriteDistance - 32);
 
 
-					u8* write_ptr = s_video_buffer_write_ptr;
+					u8* write_ptr = s_video_buffer_write_ptr.load(std::memory_order_relaxed);
 					s_video_buffer_read_ptr = OpcodeDecoder_Run(DataReader(s_video_buffer_read_ptr, write_ptr), &cyclesExecuted, false);
 
 
@@ -357,11 +405,11 @@ void RunGpuLoop()
 
 		if (EmuRunningState)
 		{
-			// NOTE(jsd): Calling SwitchToThread() on Windows 7 x64 is a hot spot, according to profiler.
-			// See https://docs.google.com/spreadsheet/ccc?key=0Ah4nh0yGtjrgdFpDeF9pS3V6RUotRVE3S3J4TGM1NlE#gid=0
-			// for benchmark details.
-			if (yield_cpu)
-				Common::YieldCPU();
+			// Out of work: spin for a moment, then sleep until the CPU thread
+			// hands over more data or posts a request. The timeout keeps
+			// window messages flowing and covers state changes that don't
+			// wake us up explicitly.
+			s_gpu_wakeup.Wait(GpuHasWork, std::chrono::milliseconds(1));
 		}
 		else
 		{
@@ -390,7 +438,11 @@ void RunGpu()
 {
 	if (SConfig::GetInstance().m_LocalCoreStartupParameter.bCPUThread &&
 	    !g_use_deterministic_gpu_thread)
+	{
+		// RunGpuLoop picks up the data.
+		s_gpu_wakeup.Set();
 		return;
+	}
 
 	SCPFifoStruct &fifo = CommandProcessor::fifo;
 	while (fifo.bFF_GPReadEnable && fifo.CPReadWriteDistance && !AtBreakpoint() )
@@ -404,7 +456,7 @@ void RunGpu()
 			FPURoundMode::SaveSIMDState();
 			FPURoundMode::LoadDefaultSIMDState();
 			ReadDataFromFifo(fifo.CPReadPointer);
-			s_video_buffer_read_ptr = OpcodeDecoder_Run(DataReader(s_video_buffer_read_ptr, s_video_buffer_write_ptr), nullptr, false);
+			s_video_buffer_read_ptr = OpcodeDecoder_Run(DataReader(s_video_buffer_read_ptr, s_video_buffer_write_ptr.load(std::memory_order_relaxed)), nullptr, false);
 			FPURoundMode::LoadSIMDState();
 		}
 
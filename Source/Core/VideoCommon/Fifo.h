@@ -50,6 +50,8 @@ void RunGpu();
 void RunGpuLoop();
 void ExitGpuLoop();
 void EmulatorState(bool running);
+// Wakes up RunGpuLoop if it is waiting for work. May be called from any thread.
+void WakeGpuLoop();
 bool AtBreakpoint();
 void ResetVideoBuffer();
 void Fifo_SetRendering(bool bEnabled);
@@ -126,6 +126,7 @@ void VideoBackendHardware::Video_EndField()
 	{
 		SyncGPU(SYNC_GPU_SWAP);
 		s_swapRequested.Set();
+		WakeGpuLoop();
 	}
 }
 
@@ -175,6 +176,7 @@ u32 VideoBackendHardware::Video_AccessEFB(EFBAccessType type, u32 x, u32 y, u32
 			if (s_FifoShuttingDown.IsSet())
 				return 0;
 			s_efbAccessRequested.Set();
+			WakeGpuLoop();
 			s_efbAccessReadyEvent.Wait();
 		}
 		else
@@ -214,6 +216,7 @@ u32 VideoBackendHardware::Video_GetQueryResult(PerfQueryType type)
 			if (s_FifoShuttingDown.IsSet())
 				return 0;
 			s_perfQueryRequested.Set();
+			WakeGpuLoop();
 			s_perfQueryReadyEvent.Wait();
 		}
 		else
@@ -237,6 +240,7 @@ u16 VideoBackendHardware::Video_GetBoundingBox(int index)
 			return 0;
 		s_BBoxIndex = index;
 		s_BBoxRequested.Set();
+		WakeGpuLoop();
 		s_BBoxReadyEvent.Wait();
 		return s_BBoxResult;
 	}
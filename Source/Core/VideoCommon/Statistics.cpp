@@ -29,6 +29,10 @@ std::string Statistics::ToString()
 	std::string str;
 	str += StringFromFormat("Textures created: %i\n", stats.numTexturesCreated);
 	str += StringFromFormat("Textures alive: %i\n", stats.numTexturesAlive);
+	str += StringFromFormat("Texture cache hits: %i\n", stats.thisFrame.numTextureCacheHits);
+	str += StringFromFormat("Texture cache hits (by hash): %i\n", stats.thisFrame.numTextureCacheHashHits);
+	str += StringFromFormat("Texture cache misses: %i\n", stats.thisFrame.numTextureCacheMisses);
+	str += StringFromFormat("Textures uploaded: %i kB\n", stats.thisFrame.bytesTextureUploaded/1024);
 	str += StringFromFormat("pshaders created: %i\n", stats.numPixelShadersCreated);
 	str += StringFromFormat("pshaders alive: %i\n", stats.numPixelShadersAlive);
 	str += StringFromFormat("vshaders created: %i\n", stats.numVertexShadersCreated);
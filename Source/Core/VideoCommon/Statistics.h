@@ -53,6 +53,11 @@ struct Statistics
 		int bytesVertexStreamed;
 		int bytesIndexStreamed;
 		int bytesUniformStreamed;
+
+		int numTextureCacheHits;
+		int numTextureCacheHashHits;
+		int numTextureCacheMisses;
+		int bytesTextureUploaded;
 	};
 	ThisFrame thisFrame;
 	void ResetFrame();
@@ -31,14 +31,21 @@ GC_ALIGNED16(u8 *TextureCache::temp) = nullptr;
 unsigned int TextureCache::temp_size;
 
 TextureCache::TexCache TextureCache::textures;
+TextureCache::TexHashCache TextureCache::textures_by_hash;
+TextureCache::TexAddressIndex TextureCache::textures_by_address;
 TextureCache::RenderTargetPool TextureCache::render_target_pool;
 
 TextureCache::BackupConfig TextureCache::backup_config;
 
 static bool invalidate_texture_cache_requested;
+// The size of the largest texture created since the last invalidation, which
+// bounds how far before a range the textures overlapping it can start.
+static u32 s_max_texture_size;
 
 TextureCache::TCacheEntryBase::~TCacheEntryBase()
 {
+	UnlinkHash(this);
+	UnlinkAddress(this);
 }
 
 TextureCache::TextureCache()
@@ -69,6 +76,9 @@ void TextureCache::Invalidate()
 		delete tex.second;
 	}
 	textures.clear();
+	textures_by_hash.clear();
+	textures_by_address.clear();
+	s_max_texture_size = 0;
 
 	for (auto& rt : render_target_pool)
 	{
@@ -148,7 +158,7 @@ void TextureCache::Cleanup()
 		    !iter->second->IsEfbCopy())
 		{
 			delete iter->second;
-			textures.erase(iter++);
+			iter = textures.erase(iter);
 		}
 		else
 		{
@@ -184,7 +194,7 @@ void TextureCache::InvalidateRange(u32 start_address, u32 size)
 		if (0 == rangePosition)
 		{
 			delete iter->second;
-			textures.erase(iter++);
+			iter = textures.erase(iter);
 		}
 		else
 		{
@@ -195,18 +205,17 @@ void TextureCache::InvalidateRange(u32 start_address, u32 size)
 
 void TextureCache::MakeRangeDynamic(u32 start_address, u32 size)
 {
-	TexCache::iterator
-		iter = textures.lower_bound(start_address),
-		tcend = textures.upper_bound(start_address + size);
-
-	if (iter != textures.begin())
-		--iter;
+	const u32 first = start_address > s_max_texture_size ? start_address - s_max_texture_size : 0;
+	TexAddressIndex::iterator
+		iter = textures_by_address.lower_bound(std::make_pair(first, nullptr)),
+		tcend = textures_by_address.end();
 
-	for (; iter != tcend; ++iter)
+	for (; iter != tcend && iter->first <= start_address + size; ++iter)
 	{
 		const int rangePosition = iter->second->IntersectsMemoryRange(start_address, size);
 		if (0 == rangePosition)
 		{
+			UnlinkHash(iter->second);
 			iter->second->SetHashes(TEXHASH_INVALID);
 		}
 	}
@@ -214,12 +223,55 @@ void TextureCache::MakeRangeDynamic(u32 start_address, u32 size)
 
 bool TextureCache::Find(u32 start_address, u64 hash)
 {
-	TexCache::iterator iter = textures.lower_bound(start_address);
+	TexCache::iterator iter = textures.find(start_address);
+
+	return iter != textures.end() && iter->second->hash == hash;
+}
+
+u64 TextureCache::GetContentKey(u64 hash, u32 format, unsigned int width, unsigned int height)
+{
+	return hash ^ ((u64)format * 0x9E3779B97F4A7C15ULL) ^ (((u64)width << 32 | height) * 0xC2B2AE3D27D4EB4FULL);
+}
+
+void TextureCache::LinkHash(TCacheEntryBase* entry)
+{
+	UnlinkHash(entry);
+	entry->content_key = GetContentKey(entry->hash, entry->format, entry->native_width, entry->native_height);
+	entry->in_hash_index = true;
+	textures_by_hash.emplace(entry->content_key, entry);
+}
+
+void TextureCache::UnlinkHash(TCacheEntryBase* entry)
+{
+	if (!entry->in_hash_index)
+		return;
+
+	auto range = textures_by_hash.equal_range(entry->content_key);
+	for (auto iter = range.first; iter != range.second; ++iter)
+	{
+		if (iter->second == entry)
+		{
+			textures_by_hash.erase(iter);
+			break;
+		}
+	}
+	entry->in_hash_index = false;
+}
+
+void TextureCache::LinkAddress(TCacheEntryBase* entry)
+{
+	UnlinkAddress(entry);
+	entry->in_address_index = true;
+	textures_by_address.emplace(entry->addr, entry);
+}
 
-	if (iter->second->hash == hash)
-		return true;
+void TextureCache::UnlinkAddress(TCacheEntryBase* entry)
+{
+	if (!entry->in_address_index)
+		return;
 
-	return false;
+	textures_by_address.erase(std::make_pair(entry->addr, entry));
+	entry->in_address_index = false;
 }
 
 int TextureCache::TCacheEntryBase::IntersectsMemoryRange(u32 range_address, u32 range_size) const
@@ -244,7 +296,7 @@ void TextureCache::ClearRenderTargets()
 		if (iter->second->type == TCET_EC_VRAM)
 		{
 			delete iter->second;
-			textures.erase(iter++);
+			iter = textures.erase(iter);
 		}
 		else
 		{
@@ -350,6 +402,28 @@ static u32 CalculateLevelSize(u32 level_0_size, u32 level)
 	return (level_0_size + ((1 << level) - 1)) >> level;
 }
 
+// Bytes handed to the backend for a decoded texture level.
+static u32 GetUploadSize(PC_TexFormat pcfmt, u32 width, u32 height)
+{
+	switch (pcfmt)
+	{
+	case PC_TEX_FMT_BGRA32:
+	case PC_TEX_FMT_RGBA32:
+		return width * height * 4;
+	case PC_TEX_FMT_IA4_AS_IA8:
+	case PC_TEX_FMT_IA8:
+	case PC_TEX_FMT_RGB565:
+		return width * height * 2;
+	case PC_TEX_FMT_I4_AS_I8:
+	case PC_TEX_FMT_I8:
+		return width * height;
+	case PC_TEX_FMT_DXT1:
+		return width * height / 2;
+	default:
+		return 0;
+	}
+}
+
 // Used by TextureCache::Load
 static TextureCache::TCacheEntryBase* ReturnEntry(unsigned int stage, TextureCache::TCacheEntryBase* entry)
 {
@@ -384,6 +458,7 @@ TextureCache::TCacheEntryBase* TextureCache::Load(unsigned int const stage,
 
 	u32 full_format = texformat;
 	PC_TexFormat pcfmt = PC_TEX_FMT_NONE;
+	u32 palette_size = 0;
 
 	const bool isPaletteTexture = (texformat == GX_TF_C4 || texformat == GX_TF_C8 || texformat == GX_TF_C14X2);
 	if (isPaletteTexture)
@@ -401,7 +476,7 @@ TextureCache::TCacheEntryBase* TextureCache::Load(unsigned int const stage,
 	tex_hash = GetHash64(src_data, texture_size, g_ActiveConfig.iSafeTextureCache_ColorSamples);
 	if (isPaletteTexture)
 	{
-		const u32 palette_size = TexDecoder_GetPaletteSize(texformat);
+		palette_size = TexDecoder_GetPaletteSize(texformat);
 		tlut_hash = GetHash64(&texMem[tlutaddr], palette_size, g_ActiveConfig.iSafeTextureCache_ColorSamples);
 
 		// NOTE: For non-paletted textures, texID is equal to the texture address.
@@ -422,7 +497,8 @@ TextureCache::TCacheEntryBase* TextureCache::Load(unsigned int const stage,
 	while (g_ActiveConfig.backend_info.bUseMinimalMipCount && std::max(width, height) >> maxlevel == 0)
 		--maxlevel;
 
-	TCacheEntryBase *entry = textures[texID];
+	TexCache::iterator iter = textures.find(texID);
+	TCacheEntryBase *entry = iter != textures.end() ? iter->second : nullptr;
 	if (entry)
 	{
 		// 1. Calculate reference hash:
@@ -438,6 +514,7 @@ TextureCache::TCacheEntryBase* TextureCache::Load(unsigned int const stage,
 			// TODO: Print a warning if the format changes! In this case,
 			// we could reinterpret the internal texture object data to the new pixel format
 			// (similar to what is already being done in Renderer::ReinterpretPixelFormat())
+			INCSTAT(stats.thisFrame.numTextureCacheHits);
 			return ReturnEntry(stage, entry);
 		}
 
@@ -445,9 +522,36 @@ TextureCache::TCacheEntryBase* TextureCache::Load(unsigned int const stage,
 		if (address == entry->addr && tex_hash == entry->hash && full_format == entry->format &&
 			entry->num_mipmaps > maxlevel && entry->native_width == nativeW && entry->native_height == nativeH)
 		{
+			INCSTAT(stats.thisFrame.numTextureCacheHits);
 			return ReturnEntry(stage, entry);
 		}
+	}
 
+	// 2. c) The same data may already have been decoded at another address (or for another tlut).
+	//       This is only safe if the hash covers all of the data, since partial hashes of
+	//       different textures can collide.
+	const u32 samples = g_ActiveConfig.iSafeTextureCache_ColorSamples;
+	const bool full_hash = samples == 0 || std::max(texture_size, palette_size) <= samples * 8;
+	if (full_hash && tex_hash != TEXHASH_INVALID)
+	{
+		auto range = textures_by_hash.equal_range(GetContentKey(tex_hash, full_format, nativeW, nativeH));
+		for (auto it = range.first; it != range.second; ++it)
+		{
+			TCacheEntryBase* candidate = it->second;
+			if (candidate != entry && candidate->type == TCET_NORMAL && candidate->hash == tex_hash &&
+			    candidate->format == full_format && candidate->num_mipmaps > maxlevel &&
+			    candidate->native_width == nativeW && candidate->native_height == nativeH)
+			{
+				INCSTAT(stats.thisFrame.numTextureCacheHashHits);
+				return ReturnEntry(stage, candidate);
+			}
+		}
+	}
+
+	INCSTAT(stats.thisFrame.numTextureCacheMisses);
+
+	if (entry)
+	{
 		// 3. If we reach this line, we'll have to upload the new texture data to VRAM.
 		//    If we're lucky, the texture parameters didn't change and we can reuse the internal texture object instead of destroying and recreating it.
 		//
@@ -469,6 +573,7 @@ TextureCache::TCacheEntryBase* TextureCache::Load(unsigned int const stage,
 		{
 			// delete the texture and make a new one
 			delete entry;
+			textures.erase(iter);
 			entry = nullptr;
 		}
 	}
@@ -489,6 +594,7 @@ TextureCache::TCacheEntryBase* TextureCache::Load(unsigned int const stage,
 				if (entry)
 				{
 					delete entry;
+					textures.erase(texID);
 					entry = nullptr;
 				}
 			}
@@ -540,7 +646,12 @@ TextureCache::TCacheEntryBase* TextureCache::Load(unsigned int const stage,
 		entry->Load(width, height, expandedWidth, 0);
 	}
 
+	ADDSTAT(stats.thisFrame.bytesTextureUploaded, GetUploadSize(pcfmt, width, height));
+
+	UnlinkAddress(entry);
 	entry->SetGeneralParameters(address, texture_size, full_format, entry->num_mipmaps, entry->num_layers);
+	LinkAddress(entry);
+	s_max_texture_size = std::max(s_max_texture_size, texture_size);
 	entry->SetDimensions(nativeW, nativeH, width, height);
 	entry->hash = tex_hash;
 
@@ -549,6 +660,11 @@ TextureCache::TCacheEntryBase* TextureCache::Load(unsigned int const stage,
 	else
 		entry->type = TCET_NORMAL;
 
+	if (entry->type == TCET_NORMAL && full_hash)
+		LinkHash(entry);
+	else
+		UnlinkHash(entry);
+
 	if (g_ActiveConfig.bDumpTextures && !using_custom_texture)
 		DumpTexture(entry, 0);
 
@@ -583,6 +699,7 @@ TextureCache::TCacheEntryBase* TextureCache::Load(unsigned int const stage,
 				mip_src_data += TexDecoder_GetTextureSizeInBytes(expanded_mip_width, expanded_mip_height, texformat);
 
 				entry->Load(mip_width, mip_height, expanded_mip_width, level);
+				ADDSTAT(stats.thisFrame.bytesTextureUploaded, GetUploadSize(pcfmt, mip_width, mip_height));
 
 				if (g_ActiveConfig.bDumpTextures)
 					DumpTexture(entry, level);
@@ -927,6 +1044,7 @@ void TextureCache::CopyRenderTargetToTexture(u32 dstAddr, unsigned int dstFormat
 
 		// TODO: Using the wrong dstFormat, dumb...
 		entry->SetGeneralParameters(dstAddr, 0, dstFormat, 1, efb_layers);
+		LinkAddress(entry);
 		entry->SetDimensions(tex_w, tex_h, scaled_tex_w, scaled_tex_h);
 		entry->SetHashes(TEXHASH_INVALID);
 		entry->type = TCET_EC_VRAM;
@@ -957,5 +1075,6 @@ TextureCache::TCacheEntryBase* TextureCache::AllocateRenderTarget(unsigned int w
 
 void TextureCache::FreeRenderTarget(TCacheEntryBase* entry)
 {
+	UnlinkAddress(entry);
 	render_target_pool.push_back(entry);
 }
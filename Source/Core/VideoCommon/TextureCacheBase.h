@@ -4,7 +4,9 @@
 
 #pragma once
 
-#include <map>
+#include <set>
+#include <unordered_map>
+#include <utility>
 
 #include "Common/CommonTypes.h"
 #include "Common/Thread.h"
@@ -46,6 +48,12 @@ public:
 		// used to delete textures which haven't been used for TEXTURE_KILL_THRESHOLD frames
 		int frameCount;
 
+		// key of this entry in textures_by_hash, valid if in_hash_index is set
+		u64 content_key;
+		bool in_hash_index = false;
+		// whether the entry is in textures_by_address, under its addr
+		bool in_address_index = false;
+
 
 		void SetGeneralParameters(u32 _addr, u32 _size, u32 _format, unsigned int _num_mipmaps, unsigned int _num_layers)
 		{
@@ -127,10 +135,26 @@ private:
 	static TCacheEntryBase* AllocateRenderTarget(unsigned int width, unsigned int height);
 	static void FreeRenderTarget(TCacheEntryBase* entry);
 
-	typedef std::map<u32, TCacheEntryBase*> TexCache;
+	static u64 GetContentKey(u64 hash, u32 format, unsigned int width, unsigned int height);
+	static void LinkHash(TCacheEntryBase* entry);
+	static void UnlinkHash(TCacheEntryBase* entry);
+	static void LinkAddress(TCacheEntryBase* entry);
+	static void UnlinkAddress(TCacheEntryBase* entry);
+
+	typedef std::unordered_map<u32, TCacheEntryBase*> TexCache;
+	// The cached textures ordered by address, so that the ones overlapping a
+	// range can be found without going through all of them. Doesn't own the
+	// entries either.
+	typedef std::set<std::pair<u32, TCacheEntryBase*>> TexAddressIndex;
+	// Normal textures by content (hash, format and size), for sharing one
+	// texture between all addresses that hold the same data. Doesn't own the
+	// entries; they unlink themselves when they are deleted.
+	typedef std::unordered_multimap<u64, TCacheEntryBase*> TexHashCache;
 	typedef std::vector<TCacheEntryBase*> RenderTargetPool;
 
 	static TexCache textures;
+	static TexHashCache textures_by_hash;
+	static TexAddressIndex textures_by_address;
 	static RenderTargetPool render_target_pool;
 
 	// Backup configuration values
@@ -0,0 +1,180 @@
+// Copyright 2015 Dolphin Emulator Project
+// Licensed under GPLv2
+// Refer to the license.txt file included.
+
+// Replays a disc read trace (see DiscIO/ReadTrace.h) against disc images and
+// reports how each one holds up: throughput, read latency and cache hit rates.
+// Give the same game in several formats to compare them.
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Common/CommonTypes.h"
+#include "Common/FileUtil.h"
+#include "Common/Thread.h"
+#include "Common/Timer.h"
+#include "Core/Host.h"
+#include "DiscIO/Blob.h"
+#include "DiscIO/ReadTrace.h"
+#include "DiscIO/Volume.h"
+#include "DiscIO/VolumeCreator.h"
+#include "VideoBackends/OGL/GLInterfaceBase.h"
+
+// Stub out the host callbacks, nothing here ever runs the emulator.
+void Host_NotifyMapLoaded() {}
+void Host_RefreshDSPDebuggerWindow() {}
+void Host_Message(int) {}
+void* Host_GetRenderHandle() { return nullptr; }
+void Host_UpdateTitle(const std::string&) {}
+void Host_UpdateDisasmDialog() {}
+void Host_UpdateMainFrame() {}
+void Host_RequestRenderWindowSize(int, int) {}
+void Host_RequestFullscreen(bool) {}
+void Host_SetStartupDebuggingParameters() {}
+bool Host_UIHasFocus() { return false; }
+bool Host_RendererHasFocus() { return false; }
+bool Host_RendererIsFullscreen() { return false; }
+void Host_ConnectWiimote(int, bool) {}
+void Host_SetWiiMoteConnectionState(int) {}
+void Host_ShowVideoConfig(void*, const std::string&, const std::string&) {}
+cInterfaceBase* HostGL_CreateGLInterface() { return nullptr; }
+
+static void PrintUsage()
+{
+	printf("usage: discbench [-n passes] [-p] <trace> <image> [<image> ...]\n"
+	       "  -n passes  replay the trace this many times per image (default 1)\n"
+	       "  -p         keep the pacing of the trace: wait until each read's time\n"
+	       "             comes, which gives read-ahead the idle time it would get\n");
+}
+
+static double GetHitRate(const DiscIO::CacheStats& stats)
+{
+	u64 total = stats.hits + stats.misses;
+	return total ? 100.0 * stats.hits / total : 0.0;
+}
+
+static bool Replay(const std::vector<DiscIO::ReadTraceEvent>& events, const std::string& image, int passes, bool paced)
+{
+	std::unique_ptr<DiscIO::IVolume> volume(DiscIO::CreateVolumeFromFilename(image));
+	if (!volume)
+	{
+		fprintf(stderr, "%s: couldn't open\n", image.c_str());
+		return false;
+	}
+
+	u32 max_length = 0;
+	for (const DiscIO::ReadTraceEvent& event : events)
+		max_length = std::max(max_length, event.length);
+	std::vector<u8> buffer(max_length);
+
+	std::vector<u32> latencies;
+	u64 total_bytes = 0;
+	u64 failed_reads = 0;
+	const u64 start = Common::Timer::GetTimeUs();
+
+	for (int pass = 0; pass < passes; pass++)
+	{
+		const u64 pass_start = Common::Timer::GetTimeUs();
+		for (const DiscIO::ReadTraceEvent& event : events)
+		{
+			if (paced)
+			{
+				u64 now = Common::Timer::GetTimeUs() - pass_start;
+				if (event.time_us > now + 1000)
+					Common::SleepCurrentThread((int)((event.time_us - now) / 1000));
+			}
+
+			if (event.type == DiscIO::ReadTraceEvent::OPEN_PARTITION)
+			{
+				volume->ChangePartition(event.offset);
+				continue;
+			}
+
+			u64 read_start = Common::Timer::GetTimeUs();
+			if (!volume->Read(event.offset, event.length, buffer.data(), event.decrypt))
+				failed_reads++;
+			latencies.push_back((u32)(Common::Timer::GetTimeUs() - read_start));
+			total_bytes += event.length;
+		}
+	}
+
+	const u64 elapsed = std::max<u64>(Common::Timer::GetTimeUs() - start, 1);
+	std::sort(latencies.begin(), latencies.end());
+	auto percentile = [&](double p) -> u32 {
+		if (latencies.empty())
+			return 0;
+		return latencies[std::min(latencies.size() - 1, (size_t)(p * latencies.size()))];
+	};
+
+	printf("%s\n", image.c_str());
+	printf("  %" PRIu64 " reads, %.1f MiB in %.3f s", (u64)latencies.size(),
+	       total_bytes / (1024.0 * 1024.0), elapsed / 1000000.0);
+	if (!paced)
+		printf(", %.1f MiB/s", total_bytes / (1024.0 * 1024.0) / (elapsed / 1000000.0));
+	printf("\n");
+	printf("  latency us: p50 %u, p90 %u, p99 %u, max %u\n",
+	       percentile(0.5), percentile(0.9), percentile(0.99), latencies.empty() ? 0 : latencies.back());
+
+	DiscIO::CacheStats volume_cache, blob_cache;
+	if (volume->GetCacheStats(&volume_cache, &blob_cache))
+	{
+		if (volume_cache.hits + volume_cache.misses)
+		{
+			printf("  cluster cache: %" PRIu64 " hits, %" PRIu64 " misses (%.1f%%)\n",
+			       volume_cache.hits, volume_cache.misses, GetHitRate(volume_cache));
+		}
+		if (blob_cache.hits + blob_cache.misses)
+		{
+			printf("  block cache: %" PRIu64 " hits, %" PRIu64 " misses (%.1f%%)\n",
+			       blob_cache.hits, blob_cache.misses, GetHitRate(blob_cache));
+		}
+	}
+
+	if (failed_reads)
+		printf("  %" PRIu64 " reads failed\n", failed_reads);
+
+	return failed_reads == 0;
+}
+
+int main(int argc, char* argv[])
+{
+	int passes = 1;
+	bool paced = false;
+	int arg = 1;
+	for (; arg < argc && argv[arg][0] == '-'; arg++)
+	{
+		if (!strcmp(argv[arg], "-n") && arg + 1 < argc)
+			passes = std::max(atoi(argv[++arg]), 1);
+		else if (!strcmp(argv[arg], "-p"))
+			paced = true;
+		else
+			break;
+	}
+
+	if (argc - arg < 2)
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	std::vector<DiscIO::ReadTraceEvent> events;
+	std::string game_id;
+	if (!DiscIO::LoadReadTrace(argv[arg], &events, &game_id))
+	{
+		fprintf(stderr, "%s: not a disc read trace\n", argv[arg]);
+		return 1;
+	}
+	printf("%s: %u events from %s\n", argv[arg], (u32)events.size(), game_id.c_str());
+
+	bool success = true;
+	for (arg++; arg < argc; arg++)
+		success &= Replay(events, argv[arg], passes, paced);
+
+	return success ? 0 : 1;
+}
@@ -0,0 +1,68 @@
+// Copyright 2015 Dolphin Emulator Project
+// Licensed under GPLv2
+// Refer to the license.txt file included.
+
+#include <gtest/gtest.h>
+#include <thread>
+#include <vector>
+
+#include "Common/CommonTypes.h"
+#include "Common/MPSCQueue.h"
+
+TEST(MPSCQueue, Simple)
+{
+	Common::MPSCQueue<u32> q;
+	EXPECT_TRUE(q.Empty());
+
+	u32 v;
+	EXPECT_FALSE(q.Pop(v));
+
+	for (u32 i = 0; i < 1000; ++i)
+		q.Push(i);
+	EXPECT_FALSE(q.Empty());
+	for (u32 i = 0; i < 1000; ++i)
+	{
+		EXPECT_TRUE(q.Pop(v));
+		EXPECT_EQ(i, v);
+	}
+	EXPECT_TRUE(q.Empty());
+
+	for (u32 i = 0; i < 1000; ++i)
+		q.Push(i);
+	q.Clear();
+	EXPECT_TRUE(q.Empty());
+}
+
+TEST(MPSCQueue, MultipleWriters)
+{
+	const u32 NUM_WRITERS = 4;
+	const u32 COUNT = 100000;
+	Common::MPSCQueue<u32> q;
+
+	std::vector<std::thread> writers;
+	for (u32 w = 0; w < NUM_WRITERS; ++w)
+	{
+		writers.emplace_back([&q, w] {
+			for (u32 i = 0; i < COUNT; ++i)
+				q.Push(w * COUNT + i);
+		});
+	}
+
+	// Every writer's values have to come out in the order it pushed them.
+	std::vector<u32> next(NUM_WRITERS, 0);
+	for (u32 received = 0; received < NUM_WRITERS * COUNT;)
+	{
+		u32 v;
+		if (!q.Pop(v))
+			continue;
+		u32 w = v / COUNT;
+		ASSERT_LT(w, NUM_WRITERS);
+		EXPECT_EQ(next[w], v % COUNT);
+		next[w] = v % COUNT + 1;
+		received++;
+	}
+
+	for (std::thread& writer : writers)
+		writer.join();
+	EXPECT_TRUE(q.Empty());
+}
@@ -0,0 +1,58 @@
+// Copyright 2015 Dolphin Emulator Project
+// Licensed under GPLv2
+// Refer to the license.txt file included.
+
+#include <atomic>
+#include <chrono>
+#include <gtest/gtest.h>
+#include <thread>
+
+#include "Common/SpinEvent.h"
+
+using Common::SpinEvent;
+
+TEST(SpinEvent, NoLostWakeups)
+{
+	SpinEvent event;
+	std::atomic<int> produced(0);
+	const int ITERATIONS_COUNT = 100000;
+
+	std::thread producer([&] {
+		for (int i = 1; i <= ITERATIONS_COUNT; ++i)
+		{
+			produced.store(i, std::memory_order_release);
+			event.Set();
+			// Give the consumer a chance to park now and then.
+			if (i % 1000 == 0)
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+	});
+
+	// With a lost wakeup, the consumer would sit out the whole timeout and
+	// the test would take minutes instead of a fraction of a second.
+	auto start = std::chrono::steady_clock::now();
+	int consumed = 0;
+	while (consumed < ITERATIONS_COUNT)
+	{
+		int available = produced.load(std::memory_order_acquire);
+		if (available == consumed)
+		{
+			event.Wait([&] { return produced.load(std::memory_order_acquire) != consumed; },
+			           std::chrono::seconds(1));
+			continue;
+		}
+		consumed = available;
+	}
+	auto elapsed = std::chrono::steady_clock::now() - start;
+
+	producer.join();
+	EXPECT_LT(elapsed, std::chrono::seconds(10));
+}
+
+TEST(SpinEvent, Timeout)
+{
+	SpinEvent event;
+	auto start = std::chrono::steady_clock::now();
+	event.Wait([] { return false; }, std::chrono::milliseconds(20));
+	EXPECT_GE(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(15));
+}
@@ -0,0 +1,51 @@
+// Copyright 2015 Dolphin Emulator Project
+// Licensed under GPLv2
+// Refer to the license.txt file included.
+
+#include <atomic>
+#include <gtest/gtest.h>
+#include <vector>
+
+#include "Common/ThreadPool.h"
+
+using Common::ThreadPool;
+
+TEST(ThreadPool, RunsEveryIndexOnce)
+{
+	ThreadPool pool(4);
+	EXPECT_EQ(4u, pool.GetThreadCount());
+
+	const size_t COUNT = 10000;
+	std::vector<int> hits(COUNT, 0);
+	pool.ParallelFor(COUNT, [&](size_t i) { hits[i]++; });
+
+	for (size_t i = 0; i < COUNT; i++)
+		EXPECT_EQ(1, hits[i]);
+}
+
+TEST(ThreadPool, ManyBatches)
+{
+	ThreadPool pool(3);
+	std::atomic<size_t> total(0);
+
+	for (size_t batch = 0; batch < 1000; batch++)
+		pool.ParallelFor(batch % 7, [&](size_t i) { total += i + 1; });
+
+	size_t expected = 0;
+	for (size_t batch = 0; batch < 1000; batch++)
+	{
+		size_t n = batch % 7;
+		expected += n * (n + 1) / 2;
+	}
+	EXPECT_EQ(expected, total.load());
+}
+
+TEST(ThreadPool, SingleThread)
+{
+	ThreadPool pool(1);
+	EXPECT_EQ(1u, pool.GetThreadCount());
+
+	std::vector<size_t> order;
+	pool.ParallelFor(5, [&](size_t i) { order.push_back(i); });
+	EXPECT_EQ((std::vector<size_t>{0, 1, 2, 3, 4}), order);
+}
@@ -0,0 +1,170 @@
+// Copyright 2015 Dolphin Emulator Project
+// Licensed under GPLv2
+// Refer to the license.txt file included.
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Common/ChunkFile.h"
+#include "Common/CommonTypes.h"
+#include "Core/ConfigManager.h"
+#include "Core/CoreTiming.h"
+#include "Core/PowerPC/PowerPC.h"
+
+// include order is important
+#include <gtest/gtest.h>
+
+static std::vector<u64> s_fired;
+
+static void RecordCallback(u64 userdata, int cyclesLate)
+{
+	s_fired.push_back(userdata);
+}
+
+class CoreTimingTest : public testing::Test
+{
+protected:
+	static void SetUpTestCase()
+	{
+		// CoreTiming reads the overclock factor from here. It is deliberately
+		// never shut down, since that would write out a config file.
+		SConfig::Init();
+	}
+
+	void SetUp() override
+	{
+		s_fired.clear();
+		CoreTiming::Init();
+		type_a = CoreTiming::RegisterEvent("A", &RecordCallback);
+		type_b = CoreTiming::RegisterEvent("B", &RecordCallback);
+	}
+
+	void TearDown() override
+	{
+		CoreTiming::Shutdown();
+	}
+
+	// Pretends the CPU ran the whole current slice and runs the due events.
+	void AdvanceSlice()
+	{
+		PowerPC::ppcState.downcount = 0;
+		CoreTiming::Advance();
+	}
+
+	int type_a;
+	int type_b;
+};
+
+TEST_F(CoreTimingTest, RunsInTimeThenScheduleOrder)
+{
+	CoreTiming::ScheduleEvent(300, type_a, 3);
+	CoreTiming::ScheduleEvent(100, type_a, 1);
+	CoreTiming::ScheduleEvent(200, type_b, 2);
+	// Same time as an earlier event: runs after it.
+	CoreTiming::ScheduleEvent(100, type_b, 10);
+	CoreTiming::ScheduleEvent(100000, type_a, 100);
+
+	AdvanceSlice();
+	EXPECT_EQ((std::vector<u64>{1, 10, 2, 3}), s_fired);
+
+	// The next slice ends exactly at the remaining event.
+	AdvanceSlice();
+	AdvanceSlice();
+	AdvanceSlice();
+	AdvanceSlice();
+	EXPECT_EQ(100u, s_fired.back());
+	EXPECT_EQ(100000u, CoreTiming::GetTicks());
+}
+
+TEST_F(CoreTimingTest, RemoveEvent)
+{
+	CoreTiming::ScheduleEvent(100, type_a, 1);
+	CoreTiming::ScheduleEvent(200, type_b, 2);
+	CoreTiming::ScheduleEvent(300, type_a, 3);
+	EXPECT_TRUE(CoreTiming::IsScheduled(type_a));
+
+	CoreTiming::RemoveEvent(type_a);
+	EXPECT_FALSE(CoreTiming::IsScheduled(type_a));
+	EXPECT_TRUE(CoreTiming::IsScheduled(type_b));
+
+	AdvanceSlice();
+	EXPECT_EQ((std::vector<u64>{2}), s_fired);
+	EXPECT_FALSE(CoreTiming::IsScheduled(type_b));
+}
+
+TEST_F(CoreTimingTest, Threadsafe)
+{
+	std::thread other([this] {
+		for (u64 i = 0; i < 100; i++)
+			CoreTiming::ScheduleEvent_Threadsafe(0, type_a, i);
+	});
+	other.join();
+
+	AdvanceSlice();
+	ASSERT_EQ(100u, s_fired.size());
+	for (u64 i = 0; i < 100; i++)
+		EXPECT_EQ(i, s_fired[i]);
+}
+
+TEST_F(CoreTimingTest, SaveState)
+{
+	CoreTiming::ScheduleEvent(300, type_a, 3);
+	CoreTiming::ScheduleEvent(100, type_b, 1);
+	CoreTiming::ScheduleEvent(100, type_a, 2);
+
+	u8* ptr = nullptr;
+	PointerWrap p_measure(&ptr, PointerWrap::MODE_MEASURE);
+	CoreTiming::DoState(p_measure);
+	std::vector<u8> buffer((size_t)ptr);
+
+	ptr = buffer.data();
+	PointerWrap p_write(&ptr, PointerWrap::MODE_WRITE);
+	CoreTiming::DoState(p_write);
+
+	CoreTiming::ClearPendingEvents();
+	CoreTiming::ScheduleEvent(50, type_a, 99);
+
+	ptr = buffer.data();
+	PointerWrap p_read(&ptr, PointerWrap::MODE_READ);
+	CoreTiming::DoState(p_read);
+	EXPECT_EQ(PointerWrap::MODE_READ, p_read.GetMode());
+
+	AdvanceSlice();
+	EXPECT_EQ((std::vector<u64>{1, 2, 3}), s_fired);
+}
+
+// Microbenchmark for the queue itself: a few thousand events in flight that
+// keep getting cancelled and rescheduled, like the audio and SI timers do.
+TEST_F(CoreTimingTest, Throughput)
+{
+	const int NUM_TYPES = 64;
+	const int ROUNDS = 500;
+
+	std::vector<int> types;
+	for (int i = 0; i < NUM_TYPES; i++)
+		types.push_back(CoreTiming::RegisterEvent("Bench" + std::to_string(i), &RecordCallback));
+
+	auto start = std::chrono::high_resolution_clock::now();
+	for (int round = 0; round < ROUNDS; round++)
+	{
+		for (int i = 0; i < NUM_TYPES; i++)
+		{
+			for (int j = 0; j < 32; j++)
+				CoreTiming::ScheduleEvent(1000 + ((i * 7919 + j * 104729 + round) % 19000), types[i], j);
+		}
+		for (int i = 0; i < NUM_TYPES; i += 4)
+			CoreTiming::RemoveEvent(types[i]);
+		AdvanceSlice();
+	}
+	auto end = std::chrono::high_resolution_clock::now();
+
+	EXPECT_EQ((size_t)ROUNDS * (NUM_TYPES - NUM_TYPES / 4) * 32, s_fired.size());
+
+	double seconds = std::chrono::duration<double>(end - start).count();
+	printf("CoreTiming throughput:\n");
+	printf("%zu events scheduled and run in %.3f ms (%.0f events/s)\n",
+	       s_fired.size(), seconds * 1000, s_fired.size() / seconds);
+}
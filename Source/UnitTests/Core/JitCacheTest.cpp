@@ -0,0 +1,168 @@
+// Copyright 2015 Dolphin Emulator Project
+// Licensed under GPLv2
+// Refer to the license.txt file included.
+
+#include <chrono>
+#include <cstdio>
+#include <memory>
+
+#include "Common/CommonTypes.h"
+#include "Core/ConfigManager.h"
+#include "Core/PowerPC/JitCommon/JitBase.h"
+#include "Core/PowerPC/JitCommon/JitCache.h"
+
+// include order is important
+#include <gtest/gtest.h>
+
+class TestBlockCache : public JitBaseBlockCache
+{
+public:
+	int num_links = 0;
+	int num_destroys = 0;
+
+private:
+	void WriteLinkBlock(u8* location, const u8* address) override { num_links++; }
+	void WriteDestroyBlock(const u8* location, u32 address) override { num_destroys++; }
+};
+
+class JitCacheFakeJit : public JitBase
+{
+public:
+	// CPUCoreBase methods
+	void Init() override {}
+	void Shutdown() override {}
+	void ClearCache() override {}
+	void Run() override {}
+	void SingleStep() override {}
+	const char *GetName() override { return nullptr; }
+
+	// JitBase methods
+	JitBaseBlockCache *GetBlockCache() override { return m_cache.get(); }
+	void Jit(u32 em_address) override {}
+	const CommonAsmRoutinesBase *GetAsmRoutines() override { return nullptr; }
+	bool HandleFault(uintptr_t access_address, SContext* ctx) override { return false; }
+
+	std::unique_ptr<TestBlockCache> m_cache{new TestBlockCache};
+};
+
+class JitCacheTest : public testing::Test
+{
+protected:
+	static void SetUpTestCase()
+	{
+		// JitRegister reads the perf map setting from here. It is deliberately
+		// never shut down, since that would write out a config file.
+		SConfig::Init();
+	}
+
+	void SetUp() override
+	{
+		m_jit.reset(new JitCacheFakeJit);
+		jit = m_jit.get();
+		cache = m_jit->m_cache.get();
+		cache->Init();
+	}
+
+	void TearDown() override
+	{
+		cache->Shutdown();
+		jit = nullptr;
+	}
+
+	int AddBlock(u32 address, u32 num_instructions, u32 exit_address)
+	{
+		int block_num = cache->AllocateBlock(address);
+		JitBlock* b = cache->GetBlock(block_num);
+		b->checkedEntry = nullptr;
+		b->normalEntry = nullptr;
+		b->codeSize = 0;
+		b->originalSize = num_instructions;
+
+		JitBlock::LinkData link;
+		link.exitPtrs = nullptr;
+		link.exitAddress = exit_address;
+		link.linkStatus = false;
+		b->linkData.push_back(link);
+
+		cache->FinalizeBlock(block_num, true, nullptr);
+		return block_num;
+	}
+
+	std::unique_ptr<JitCacheFakeJit> m_jit;
+	TestBlockCache* cache;
+};
+
+TEST_F(JitCacheTest, LinksInBothDirections)
+{
+	int a = AddBlock(0x80001000, 4, 0x80002000);
+	EXPECT_FALSE(cache->GetBlock(a)->linkData[0].linkStatus);
+
+	// Compiling the destination links the exit that was waiting for it.
+	int b = AddBlock(0x80002000, 4, 0x80001000);
+	EXPECT_TRUE(cache->GetBlock(a)->linkData[0].linkStatus);
+	EXPECT_TRUE(cache->GetBlock(b)->linkData[0].linkStatus);
+	EXPECT_EQ(2, cache->num_links);
+}
+
+TEST_F(JitCacheTest, InvalidateOnlyOverlappingBlocks)
+{
+	int a = AddBlock(0x80001000, 8, 0x80003000);
+	int b = AddBlock(0x80001020, 8, 0x80003000);
+	// Spans two range buckets.
+	int c = AddBlock(0x80001FF0, 8, 0x80001000);
+	int target = AddBlock(0x80003000, 4, 0x80001000);
+	EXPECT_TRUE(cache->GetBlock(a)->linkData[0].linkStatus);
+
+	cache->InvalidateICache(0x80001020, 32, true);
+	EXPECT_FALSE(cache->GetBlock(a)->invalid);
+	EXPECT_TRUE(cache->GetBlock(b)->invalid);
+	EXPECT_EQ(-1, cache->GetBlockNumberFromStartAddress(0x80001020));
+	EXPECT_EQ(a, cache->GetBlockNumberFromStartAddress(0x80001000));
+
+	cache->InvalidateICache(0x80002004, 4, true);
+	EXPECT_TRUE(cache->GetBlock(c)->invalid);
+
+	// Destroying a target unlinks every exit pointing to it.
+	cache->InvalidateICache(0x80003000, 0x1000, true);
+	EXPECT_TRUE(cache->GetBlock(target)->invalid);
+	EXPECT_FALSE(cache->GetBlock(a)->linkData[0].linkStatus);
+	EXPECT_EQ(3, cache->num_destroys);
+
+	// Recompiling it relinks the surviving block.
+	AddBlock(0x80003000, 4, 0x80001000);
+	EXPECT_TRUE(cache->GetBlock(a)->linkData[0].linkStatus);
+
+	// A full flush gets everything.
+	cache->InvalidateICache(0, 0xffffffff, true);
+	EXPECT_TRUE(cache->GetBlock(a)->invalid);
+}
+
+// Microbenchmark for the block bookkeeping: allocate, link and invalidate
+// many small blocks the way code overlays and self-modifying code do.
+TEST_F(JitCacheTest, Throughput)
+{
+	const int ROUNDS = 8;
+	const u32 BLOCKS_PER_ROUND = 8192;
+	const u32 BLOCK_INSTRUCTIONS = 8;
+
+	auto start = std::chrono::high_resolution_clock::now();
+	for (int round = 0; round < ROUNDS; round++)
+	{
+		for (u32 i = 0; i < BLOCKS_PER_ROUND; i++)
+		{
+			u32 address = 0x80100000 + i * BLOCK_INSTRUCTIONS * 4;
+			AddBlock(address, BLOCK_INSTRUCTIONS, address + BLOCK_INSTRUCTIONS * 4);
+		}
+		// Invalidate one cache line at a time, like dcbi/icbi loops do.
+		for (u32 offset = 0; offset < BLOCKS_PER_ROUND * BLOCK_INSTRUCTIONS * 4; offset += 32)
+			cache->InvalidateICache(0x80100000 + offset, 32, true);
+	}
+	auto end = std::chrono::high_resolution_clock::now();
+
+	EXPECT_EQ(ROUNDS * BLOCKS_PER_ROUND, (u32)cache->num_destroys);
+
+	double seconds = std::chrono::duration<double>(end - start).count();
+	printf("JIT block cache throughput:\n");
+	printf("%u blocks allocated, linked and invalidated in %.3f ms (%.0f blocks/s)\n",
+	       ROUNDS * BLOCKS_PER_ROUND, seconds * 1000, ROUNDS * BLOCKS_PER_ROUND / seconds);
+}
@@ -0,0 +1,82 @@
+// Copyright 2015 Dolphin Emulator Project
+// Licensed under GPLv2
+// Refer to the license.txt file included.
+
+#include <vector>
+#include <lzo/lzo1x.h>
+
+#include "Common/CommonTypes.h"
+#include "Core/Rewind.h"
+
+// include order is important
+#include <gtest/gtest.h>
+
+static std::vector<u8> MakeState(size_t size, u32 seed)
+{
+	std::vector<u8> state(size);
+	for (size_t i = 0; i < size; i++)
+		state[i] = (u8)((i * 2654435761u) >> 13);
+	// A few scattered changes, like a frame's worth of RAM writes.
+	for (size_t i = seed; i < size; i += 100003)
+		state[i] ^= (u8)(seed | 1);
+	return state;
+}
+
+class RewindTest : public testing::Test
+{
+protected:
+	static void SetUpTestCase()
+	{
+		lzo_init();
+	}
+
+	void RoundTrip(const std::vector<u8>& older, const std::vector<u8>& newer)
+	{
+		std::vector<u8> delta;
+		Rewind::EncodeDelta(older, newer, &delta);
+
+		std::vector<u8> state = newer;
+		ASSERT_TRUE(Rewind::ApplyDelta(delta, &state));
+		EXPECT_EQ(older, state);
+	}
+};
+
+TEST_F(RewindTest, Identical)
+{
+	std::vector<u8> state = MakeState(1000000, 7);
+	std::vector<u8> delta;
+	Rewind::EncodeDelta(state, state, &delta);
+	// Unchanged chunks take nothing but their length.
+	EXPECT_LT(delta.size(), 64u);
+	RoundTrip(state, state);
+}
+
+TEST_F(RewindTest, SmallChanges)
+{
+	std::vector<u8> older = MakeState(3000000, 7);
+	std::vector<u8> newer = MakeState(3000000, 11);
+	std::vector<u8> delta;
+	Rewind::EncodeDelta(older, newer, &delta);
+	EXPECT_LT(delta.size(), older.size() / 10);
+	RoundTrip(older, newer);
+}
+
+TEST_F(RewindTest, SizeChanges)
+{
+	RoundTrip(MakeState(500000, 3), MakeState(700001, 5));
+	RoundTrip(MakeState(700001, 3), MakeState(500000, 5));
+	RoundTrip(std::vector<u8>(), MakeState(1000, 5));
+	RoundTrip(MakeState(1000, 3), std::vector<u8>());
+}
+
+TEST_F(RewindTest, Corrupt)
+{
+	std::vector<u8> older = MakeState(300000, 3);
+	std::vector<u8> newer = MakeState(300000, 5);
+	std::vector<u8> delta;
+	Rewind::EncodeDelta(older, newer, &delta);
+
+	delta.resize(delta.size() / 2);
+	std::vector<u8> state = newer;
+	EXPECT_FALSE(Rewind::ApplyDelta(delta, &state));
+}
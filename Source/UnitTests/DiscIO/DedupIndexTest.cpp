@@ -0,0 +1,68 @@
+// Copyright 2015 Dolphin Emulator Project
+// Licensed under GPLv2
+// Refer to the license.txt file included.
+
+#include <gtest/gtest.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Common/FileUtil.h"
+#include "DiscIO/DedupIndex.h"
+
+using DiscIO::DedupIndex;
+
+static DedupIndex::BlockHash HashOf(u8 fill)
+{
+	std::vector<u8> block(0x400, fill);
+	return DedupIndex::HashBlock(block.data(), block.size());
+}
+
+TEST(DedupIndex, HashBlock)
+{
+	EXPECT_EQ(HashOf(1), HashOf(1));
+	EXPECT_NE(HashOf(1), HashOf(2));
+}
+
+TEST(DedupIndex, CountsSharedBlocks)
+{
+	DedupIndex dedup(0x400);
+	dedup.AddImage("a", {HashOf(1), HashOf(2), HashOf(3)});
+	// A block repeated within an image is only new once.
+	dedup.AddImage("b", {HashOf(2), HashOf(3), HashOf(4), HashOf(4)});
+	dedup.AddImage("c", {HashOf(5)});
+
+	EXPECT_EQ(3u, dedup.GetImageCount());
+	EXPECT_EQ(8u, dedup.GetTotalBlocks());
+	EXPECT_EQ(5u, dedup.GetDistinctBlocks());
+
+	const std::string filename = "DedupIndexTest.txt";
+	ASSERT_TRUE(dedup.WriteReport(filename));
+	std::string report;
+	ASSERT_TRUE(File::ReadFileToString(filename, report));
+	File::Delete(filename);
+
+	EXPECT_NE(std::string::npos, report.find("a\t3\t3\n"));
+	EXPECT_NE(std::string::npos, report.find("b\t4\t1\ta (2 blocks)\n"));
+	EXPECT_NE(std::string::npos, report.find("c\t1\t1\n"));
+	EXPECT_NE(std::string::npos, report.find("8 blocks of 1024 bytes, 5 distinct"));
+}
+
+TEST(DedupIndex, AddImageFromSeveralThreads)
+{
+	DedupIndex dedup(0x400);
+	std::vector<std::thread> threads;
+	for (int i = 0; i < 4; i++)
+	{
+		threads.emplace_back([&dedup, i] {
+			// Every image has one block of its own, and one all of them share.
+			dedup.AddImage(std::to_string(i), {HashOf(0), HashOf((u8)(i + 1))});
+		});
+	}
+	for (std::thread& thread : threads)
+		thread.join();
+
+	EXPECT_EQ(4u, dedup.GetImageCount());
+	EXPECT_EQ(8u, dedup.GetTotalBlocks());
+	EXPECT_EQ(5u, dedup.GetDistinctBlocks());
+}
@@ -0,0 +1,163 @@
+// Copyright 2015 Dolphin Emulator Project
+// Licensed under GPLv2
+// Refer to the license.txt file included.
+
+#include <algorithm>
+#include <cstring>
+#include <gtest/gtest.h>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <polarssl/aes.h>
+
+#include "Common/CommonTypes.h"
+#include "Common/FileUtil.h"
+#include "DiscIO/Blob.h"
+#include "DiscIO/DiscScrubber.h"
+#include "DiscIO/VolumeCreator.h"
+
+namespace
+{
+
+const u64 CLUSTER_SIZE = 0x8000;
+const u64 CLUSTER_DATA_SIZE = 0x7C00;
+const u64 PARTITION_OFFSET = 0x50000;
+const u64 DATA_OFFSET = PARTITION_OFFSET + 0x20000;
+const u64 DATA_CLUSTERS = 64;
+const u64 IMAGE_CLUSTERS = DATA_OFFSET / CLUSTER_SIZE + DATA_CLUSTERS;
+
+void Write32(std::vector<u8>& buffer, u64 offset, u32 value)
+{
+	value = Common::swap32(value);
+	std::memcpy(&buffer[offset], &value, sizeof(value));
+}
+
+// A Wii image with one game partition, holding a DOL in the first cluster and
+// two files: a.bin spans the 17th and 18th clusters of the partition's data,
+// b.bin sits in the 41st. Everything else in the data area is random and unused.
+bool WriteTestImage(const std::string& filename)
+{
+	std::mt19937 rng(1);
+
+	std::vector<u8> plain(DATA_CLUSTERS * CLUSTER_DATA_SIZE);
+	for (u8& byte : plain)
+		byte = (u8)rng();
+	std::fill(plain.begin(), plain.begin() + 0x4000, 0);
+	Write32(plain, 0x18, 0x5D1C9EA3);
+	Write32(plain, 0x420, 0x2480 >> 2);
+	Write32(plain, 0x424, 0x3000 >> 2);
+	Write32(plain, 0x428, 0x40 >> 2);
+	// text0 is the only segment in the DOL.
+	Write32(plain, 0x2480 + 0x00, 0x100);
+	Write32(plain, 0x2480 + 0x90, 0x100);
+	Write32(plain, 0x3000 + 0x00, 0x01000000);
+	Write32(plain, 0x3000 + 0x08, 3);
+	Write32(plain, 0x3000 + 0x0C, 0);
+	Write32(plain, 0x3000 + 0x10, (u32)(16 * CLUSTER_DATA_SIZE >> 2));
+	Write32(plain, 0x3000 + 0x14, 0x9000);
+	Write32(plain, 0x3000 + 0x18, 6);
+	Write32(plain, 0x3000 + 0x1C, (u32)(40 * CLUSTER_DATA_SIZE >> 2));
+	Write32(plain, 0x3000 + 0x20, 0x100);
+	std::memcpy(&plain[0x3000 + 0x24], "a.bin\0b.bin", 12);
+
+	std::vector<u8> image(IMAGE_CLUSTERS * CLUSTER_SIZE);
+	for (u64 i = DATA_OFFSET; i < image.size(); i++)
+		image[i] = (u8)rng();
+	Write32(image, 0x18, 0x5D1C9EA3);
+	Write32(image, 0x40000, 1);
+	Write32(image, 0x40004, 0x40020 >> 2);
+	Write32(image, 0x40020, PARTITION_OFFSET >> 2);
+	Write32(image, PARTITION_OFFSET + 0x2B4, 0x8000 >> 2);
+	Write32(image, PARTITION_OFFSET + 0x2B8, 0x20000 >> 2);
+	Write32(image, PARTITION_OFFSET + 0x2BC, (u32)(DATA_CLUSTERS * CLUSTER_SIZE >> 2));
+
+	// The partition key comes from the (blank) ticket, so it can be worked
+	// out before the data is encrypted.
+	if (!File::IOFile(filename, "wb").WriteBytes(image.data(), image.size()))
+		return false;
+	u8 key[16];
+	{
+		std::unique_ptr<DiscIO::IBlobReader> reader(DiscIO::CreateBlobReader(filename));
+		if (!reader)
+			return false;
+		DiscIO::VolumeKeyForParition(*reader, PARTITION_OFFSET, key);
+	}
+
+	aes_context aes;
+	aes_setkey_enc(&aes, key, 128);
+	for (u64 i = 0; i < DATA_CLUSTERS; i++)
+	{
+		u8* cluster = &image[DATA_OFFSET + i * CLUSTER_SIZE];
+		u8 iv[16];
+		std::memcpy(iv, cluster + 0x3D0, sizeof(iv));
+		aes_crypt_cbc(&aes, AES_ENCRYPT, CLUSTER_DATA_SIZE, iv, &plain[i * CLUSTER_DATA_SIZE], cluster + 0x400);
+	}
+
+	return File::IOFile(filename, "wb").WriteBytes(image.data(), image.size());
+}
+
+bool IsUsed(u64 cluster)
+{
+	const u64 data_cluster = DATA_OFFSET / CLUSTER_SIZE;
+	// The disc header, the partition header and its H3 table
+	if (cluster < data_cluster)
+		return true;
+	// The partition's own header, DOL and FST, plus the cluster after them since
+	// the scrubber rounds ranges that don't start on a cluster up. Then a.bin
+	// and b.bin.
+	return cluster == data_cluster || cluster == data_cluster + 1 || cluster == data_cluster + 16 ||
+	       cluster == data_cluster + 17 || cluster == data_cluster + 40;
+}
+
+bool Progress(const std::string& text, float percent, void* arg)
+{
+	return true;
+}
+
+}  // namespace
+
+TEST(DiscScrubber, FindsUsedClusters)
+{
+	const std::string filename = "DiscScrubberTest.iso";
+	ASSERT_TRUE(WriteTestImage(filename));
+
+	DiscIO::DiscScrubber scrubber;
+	bool setup = scrubber.SetupScrub(filename, (int)CLUSTER_SIZE);
+	File::Delete(filename);
+	ASSERT_TRUE(setup);
+
+	for (u64 i = 0; i < IMAGE_CLUSTERS; i++)
+		EXPECT_NE(IsUsed(i), scrubber.CanBlockBeScrubbed(i * CLUSTER_SIZE)) << "cluster " << i;
+	EXPECT_FALSE(scrubber.CanBlockBeScrubbed(IMAGE_CLUSTERS * CLUSTER_SIZE));
+}
+
+TEST(DiscScrubber, CompressBlanksUnusedClusters)
+{
+	const std::string filename = "DiscScrubberTest.iso";
+	const std::string compressed = "DiscScrubberTest.gcz";
+	ASSERT_TRUE(WriteTestImage(filename));
+
+	std::vector<u8> original(IMAGE_CLUSTERS * CLUSTER_SIZE);
+	ASSERT_TRUE(File::IOFile(filename, "rb").ReadBytes(original.data(), original.size()));
+	bool compressed_ok = DiscIO::CompressFileToBlob(filename, compressed, 1, (int)CLUSTER_SIZE, Progress);
+	File::Delete(filename);
+	ASSERT_TRUE(compressed_ok);
+
+	std::vector<u8> result(original.size());
+	{
+		std::unique_ptr<DiscIO::IBlobReader> reader(DiscIO::CreateBlobReader(compressed));
+		ASSERT_TRUE(reader != nullptr);
+		EXPECT_EQ(original.size(), reader->GetDataSize());
+		ASSERT_TRUE(reader->Read(0, result.size(), result.data()));
+	}
+	File::Delete(compressed);
+
+	const std::vector<u8> blank(CLUSTER_SIZE, 0xFF);
+	for (u64 i = 0; i < IMAGE_CLUSTERS; i++)
+	{
+		const u8* expected = IsUsed(i) ? &original[i * CLUSTER_SIZE] : blank.data();
+		EXPECT_EQ(0, std::memcmp(expected, &result[i * CLUSTER_SIZE], CLUSTER_SIZE)) << "cluster " << i;
+	}
+}
@@ -0,0 +1,122 @@
+// Copyright 2015 Dolphin Emulator Project
+// Licensed under GPLv2
+// Refer to the license.txt file included.
+
+#include <chrono>
+#include <cstring>
+#include <gtest/gtest.h>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Common/CommonTypes.h"
+#include "Common/FileUtil.h"
+#include "DiscIO/Filesystem.h"
+#include "DiscIO/Volume.h"
+#include "DiscIO/VolumeCreator.h"
+
+namespace
+{
+
+const std::string DIRECTORY = "VolumeDirectoryTest/";
+
+class VolumeDirectoryTest : public testing::Test
+{
+protected:
+	void SetUp() override
+	{
+		File::DeleteDirRecursively(DIRECTORY);
+		File::CreateFullPath(DIRECTORY + "sub/");
+		m_contents["a.bin"] = MakeContents(40000, 1);
+		m_contents["sub/b.bin"] = MakeContents(100000, 2);
+		for (const auto& file : m_contents)
+			File::WriteStringToFile(file.second, DIRECTORY + file.first);
+	}
+
+	void TearDown() override
+	{
+		File::DeleteDirRecursively(DIRECTORY);
+	}
+
+	static std::string MakeContents(size_t size, u8 seed)
+	{
+		std::string contents(size, '\0');
+		for (size_t i = 0; i < size; i++)
+			contents[i] = (char)(i * 7 + seed);
+		return contents;
+	}
+
+	// Reads every file back through the volume, the way a game would.
+	void CheckContents(DiscIO::IVolume* volume)
+	{
+		std::unique_ptr<DiscIO::IFileSystem> filesystem(DiscIO::CreateFileSystem(volume));
+		ASSERT_TRUE(filesystem != nullptr);
+		for (const auto& file : m_contents)
+		{
+			ASSERT_EQ(file.second.size(), filesystem->GetFileSize(file.first)) << file.first;
+			std::vector<u8> buffer(file.second.size());
+			EXPECT_EQ(buffer.size(), filesystem->ReadFile(file.first, buffer.data(), buffer.size())) << file.first;
+			EXPECT_EQ(0, std::memcmp(buffer.data(), file.second.data(), buffer.size())) << file.first;
+		}
+	}
+
+	std::map<std::string, std::string> m_contents;
+};
+
+}  // namespace
+
+TEST_F(VolumeDirectoryTest, ReadsFiles)
+{
+	std::unique_ptr<DiscIO::IVolume> volume(DiscIO::CreateVolumeFromDirectory(DIRECTORY, false));
+	CheckContents(volume.get());
+}
+
+TEST_F(VolumeDirectoryTest, SeesFilesEditedInPlace)
+{
+	std::unique_ptr<DiscIO::IVolume> volume(DiscIO::CreateVolumeFromDirectory(DIRECTORY, false));
+	CheckContents(volume.get());
+
+	m_contents["a.bin"][5] ^= 0x55;
+	File::IOFile file(DIRECTORY + "a.bin", "r+b");
+	ASSERT_TRUE(file.Seek(5, SEEK_SET));
+	ASSERT_TRUE(file.WriteBytes(&m_contents["a.bin"][5], 1));
+	file.Flush();
+	CheckContents(volume.get());
+}
+
+TEST_F(VolumeDirectoryTest, SeesTruncatedFiles)
+{
+	std::unique_ptr<DiscIO::IVolume> volume(DiscIO::CreateVolumeFromDirectory(DIRECTORY, false));
+	std::unique_ptr<DiscIO::IFileSystem> filesystem(DiscIO::CreateFileSystem(volume.get()));
+	ASSERT_TRUE(filesystem != nullptr);
+	std::vector<u8> buffer(m_contents["sub/b.bin"].size());
+	ASSERT_EQ(buffer.size(), filesystem->ReadFile("sub/b.bin", buffer.data(), buffer.size()));
+
+	File::IOFile file(DIRECTORY + "sub/b.bin", "r+b");
+	ASSERT_TRUE(file.Resize(3000));
+	file.Close();
+
+	// The old FST still has the old size, so this reads past the file's new end.
+	// Only what's left of the file may come from it.
+	filesystem->ReadFile("sub/b.bin", buffer.data(), buffer.size());
+	EXPECT_EQ(0, std::memcmp(buffer.data(), m_contents["sub/b.bin"].data(), 3000));
+
+	// New sizes only show up in the FST when the files get checked again.
+	std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+	m_contents["sub/b.bin"].resize(3000);
+	CheckContents(volume.get());
+}
+
+TEST_F(VolumeDirectoryTest, SeesReplacedFiles)
+{
+	std::unique_ptr<DiscIO::IVolume> volume(DiscIO::CreateVolumeFromDirectory(DIRECTORY, false));
+	CheckContents(volume.get());
+
+	m_contents["sub/b.bin"] = MakeContents(500, 3);
+	File::WriteStringToFile(m_contents["sub/b.bin"], DIRECTORY + "new.bin");
+	ASSERT_TRUE(File::Rename(DIRECTORY + "new.bin", DIRECTORY + "sub/b.bin"));
+	std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+	CheckContents(volume.get());
+}